@@ -0,0 +1,43 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+
+namespace i2pcpp {
+    namespace Benchmark {
+        typedef std::function<void(void)> Function;
+
+        /**
+         * @return all benchmarks registered with I2PCPP_BENCHMARK, by name
+         */
+        std::map<std::string, Function>& registry();
+
+        struct Registrar {
+            Registrar(std::string const &name, Function const &f)
+            {
+                registry()[name] = f;
+            }
+        };
+
+        /**
+         * Runs \a f \a n times.
+         * @return the elapsed wall clock time in seconds
+         */
+        double time(std::size_t n, std::function<void(void)> const &f);
+
+        /**
+         * Prints a line with the rate of \a n operations done in \a seconds.
+         */
+        void report(std::string const &what, std::size_t n, double seconds, std::string const &unit = "ops");
+    }
+}
+
+#define I2PCPP_BENCHMARK(name) \
+    static void name(); \
+    static ::i2pcpp::Benchmark::Registrar name##_registrar(#name, &name); \
+    static void name()
+
+#endif
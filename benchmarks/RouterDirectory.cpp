@@ -0,0 +1,78 @@
+#include "Benchmark.h"
+
+#include <lib/i2p/RouterDirectory.h>
+
+#include <i2pcpp/datatypes/RouterInfo.h>
+
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+using namespace i2pcpp;
+
+/**
+ * @return a RouterInfo with \a caps and an SSU address. Only the options and
+ * addresses are looked at by the directory, so the keys are left empty.
+ */
+static RouterInfo makeRouterInfo(std::string const &caps)
+{
+    Mapping rm;
+    rm.setValue("caps", caps);
+
+    RouterInfo ri(RouterIdentity(ByteArray(256), ByteArray(128), Certificate()), Date(), rm, ByteArray(40));
+    ri.addAddress(RouterAddress(5, Date(0), "SSU", Mapping()));
+
+    return ri;
+}
+
+/**
+ * Measures uniform and weighted picks from the directory, with and without
+ * an exclusion set, and replacing routers as received DatabaseStores do.
+ * Every pick used to be an ORDER BY RANDOM() scan of the routers table.
+ */
+I2PCPP_BENCHMARK(RouterDirectoryPick)
+{
+    const std::size_t numRouters = 10000;
+    const std::size_t numOps = 100000;
+    const std::vector<std::string> caps = {"LR", "MR", "NR", "OfR", "PR", "XfR", "LU", "OU"};
+
+    std::mt19937_64 gen(1);
+
+    std::vector<RouterHash> hashes(numRouters);
+    for(auto& h: hashes)
+        for(auto& b: h)
+            b = (unsigned char)gen();
+
+    std::vector<RouterInfo> infos;
+    for(auto& c: caps)
+        infos.push_back(makeRouterInfo(c));
+
+    RouterDirectory dir;
+    std::size_t i = 0;
+    double t = Benchmark::time(numRouters, [&]() {
+        dir.add(hashes[i], infos[i % infos.size()]);
+        ++i;
+    });
+    Benchmark::report("add", numRouters, t, "routers");
+
+    t = Benchmark::time(numOps, [&]() {
+        dir.pick(RouterDirectory::REACHABLE);
+    });
+    Benchmark::report("uniform pick", numOps, t, "picks");
+
+    t = Benchmark::time(numOps, [&]() {
+        dir.pickWeighted(RouterDirectory::SSU);
+    });
+    Benchmark::report("weighted pick", numOps, t, "picks");
+
+    std::unordered_set<RouterHash> excluded(hashes.begin(), hashes.begin() + 50);
+    t = Benchmark::time(numOps, [&]() {
+        dir.pickWeighted(RouterDirectory::SSU, excluded);
+    });
+    Benchmark::report("weighted pick, 50 excluded", numOps, t, "picks");
+
+    t = Benchmark::time(numOps, [&]() {
+        dir.add(hashes[gen() % numRouters], infos[gen() % infos.size()]);
+    });
+    Benchmark::report("replace", numOps, t, "routers");
+}
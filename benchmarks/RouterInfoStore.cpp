@@ -0,0 +1,89 @@
+#include "Benchmark.h"
+
+#include <i2pcpp/Database.h>
+#include <i2pcpp/datatypes/RouterInfo.h>
+
+#include <botan/auto_rng.h>
+
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace i2pcpp;
+
+/**
+ * @return a RouterInfo of typical size with random keys. It is not signed
+ * properly, which the database does not check.
+ */
+static RouterInfo makeRouterInfo(Botan::AutoSeeded_RNG &rng)
+{
+    ByteArray encryptionKey(256), signingKey(128), signature(40);
+    rng.randomize(encryptionKey.data(), encryptionKey.size());
+    rng.randomize(signingKey.data(), signingKey.size());
+    rng.randomize(signature.data(), signature.size());
+
+    Mapping am;
+    am.setValue("caps", "BC");
+    am.setValue("host", "192.0.2.1");
+    am.setValue("key", "nwV6qV3LnBm4Qo9QYOWyyRyeaR4vcHjqxbgjRqH6Mxo=");
+    am.setValue("port", "12345");
+
+    Mapping rm;
+    rm.setValue("caps", "OfR");
+    rm.setValue("coreVersion", "0.9.11");
+    rm.setValue("netId", "2");
+    rm.setValue("router.version", "0.9.11");
+    rm.setValue("stat_uptime", "90m");
+
+    RouterInfo ri(RouterIdentity(encryptionKey, signingKey, Certificate()), Date(), rm, signature);
+    ri.addAddress(RouterAddress(5, Date(0), "SSU", am));
+    ri.addAddress(RouterAddress(10, Date(0), "NTCP", am));
+
+    return ri;
+}
+
+/**
+ * Measures how fast RouterInfos are stored, in one transaction as the
+ * importer does, and read back with the RouterInfo cache disabled.
+ */
+I2PCPP_BENCHMARK(RouterInfoStore)
+{
+    const std::string file = "benchmark_routerinfo.db";
+    const std::size_t numRouters = 5000;
+
+    Botan::AutoSeeded_RNG rng;
+
+    std::vector<RouterInfo> routers;
+    for(std::size_t i = 0; i < numRouters; ++i)
+        routers.push_back(makeRouterInfo(rng));
+
+    std::remove(file.c_str());
+    Database::createDb(file);
+    {
+        Database db(file);
+        db.setConfigValue("router_info_cache_size", "0");
+    }
+
+    {
+        Database db(file);
+
+        double t = Benchmark::time(1, [&]() {
+            db.setRouterInfo(routers);
+        });
+        Benchmark::report("import", numRouters, t, "routers");
+
+        std::mt19937_64 gen(1);
+        std::vector<RouterHash> order;
+        for(std::size_t i = 0; i < numRouters; ++i)
+            order.push_back(routers[gen() % numRouters].getIdentity().getHash());
+
+        std::size_t i = 0;
+        t = Benchmark::time(numRouters, [&]() {
+            db.getRouterInfo(order[i++]);
+        });
+        Benchmark::report("uncached lookup", numRouters, t, "lookups");
+    }
+
+    std::remove(file.c_str());
+}
@@ -0,0 +1,144 @@
+#include "Benchmark.h"
+
+#include <lib/i2p/kad/RoutingTable.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <random>
+
+using namespace i2pcpp;
+
+/**
+ * @return a key which shares exactly \a prefix leading bits with the zero
+ *  key, the rest filled with bytes from \a gen
+ */
+static Kad::RoutingTable::key_type bucketKey(std::mt19937_64 &gen, std::size_t prefix)
+{
+    Kad::RoutingTable::key_type k;
+    for(auto& b: k)
+        b = (unsigned char)gen();
+
+    for(std::size_t i = 0; i < prefix; ++i)
+        k[i / 8] &= ~(0x80 >> (i % 8));
+    k[prefix / 8] |= 0x80 >> (prefix % 8);
+
+    return k;
+}
+
+/**
+ * @return the bucket of \a k in a table around the zero key, which is the
+ *  number of leading bits it shares with it. DHT::Kademlia grouped the
+ *  entries of its multimap the same way.
+ */
+static std::size_t multimapBucket(Kad::RoutingTable::key_type const &k)
+{
+    std::size_t prefix = 0;
+    for(auto b: k) {
+        for(unsigned char mask = 0x80; mask; mask >>= 1, ++prefix)
+            if(b & mask)
+                return prefix;
+    }
+
+    return prefix;
+}
+
+/**
+ * Compares the k closest scan over the key arrays of the routing table with
+ * the two lookups it replaced, for a table with \a numBuckets full buckets:
+ * the bucket lookup on the multimap of DHT::Kademlia, which only returned
+ * the bucket of the key, and the scan which copied the distance to every
+ * entry and partially sorted them. The recall of the bucket lookup is the
+ * share of the k closest entries it returned; with every bucket full, this
+ * is its best case.
+ *
+ * The table holds at most K_VALUE routers in each of its NUM_BUCKETS
+ * buckets, so the largest size measured is the largest it gets.
+ */
+I2PCPP_BENCHMARK(RoutingTableClosest)
+{
+    std::mt19937_64 gen(1);
+
+    for(std::size_t numBuckets: { 16, 64, NUM_BUCKETS }) {
+        Kad::RoutingTable::key_type ref;
+        ref.fill(0);
+        Kad::RoutingTable rt(ref);
+
+        std::vector<std::pair<Kad::RoutingTable::key_type, RouterHash>> entries;
+        RouterHash questionable;
+        for(std::size_t b = 0; b < numBuckets; ++b) {
+            for(std::size_t i = 0; i < K_VALUE; ++i) {
+                RouterHash rh;
+                for(auto& x: rh)
+                    x = (unsigned char)gen();
+
+                entries.push_back(std::make_pair(bucketKey(gen, b), rh));
+                rt.update(rh, entries.back().first, true, questionable);
+            }
+        }
+
+        const std::size_t numQueries = 20000000 / entries.size();
+        std::vector<Kad::RoutingTable::key_type> queries;
+        for(std::size_t i = 0; i < numQueries; ++i)
+            queries.push_back(bucketKey(gen, gen() % numBuckets));
+
+        std::cout << rt.size() << " entries:" << std::endl;
+
+        std::multimap<std::size_t, RouterHash> buckets;
+        for(auto& e: entries)
+            buckets.insert(std::make_pair(multimapBucket(e.first), e.second));
+
+        // DHT::Kademlia::find, truncated to K_VALUE
+        auto bucketLookup = [&buckets](Kad::RoutingTable::key_type const &k) {
+            auto r = buckets.equal_range(multimapBucket(k));
+
+            std::vector<RouterHash> found;
+            for(auto itr = r.first; itr != r.second && found.size() < K_VALUE; ++itr)
+                found.push_back(itr->second);
+
+            return found;
+        };
+
+        std::size_t q = 0, numFound = 0;
+        double t = Benchmark::time(numQueries, [&]() {
+            numFound += bucketLookup(queries[q++]).size();
+        });
+        Benchmark::report("multimap bucket lookup", numQueries, t, "lookups");
+
+        q = 0;
+        t = Benchmark::time(numQueries, [&]() {
+            const Kad::RoutingTable::key_type &k = queries[q++];
+
+            std::vector<std::pair<Kad::RoutingTable::key_type, RouterHash>> candidates;
+            candidates.reserve(entries.size());
+            for(auto& e: entries) {
+                Kad::RoutingTable::key_type d;
+                std::transform(e.first.cbegin(), e.first.cend(), k.cbegin(), d.begin(), std::bit_xor<unsigned char>());
+                candidates.push_back(std::make_pair(d, e.second));
+            }
+
+            std::size_t count = std::min<std::size_t>(K_VALUE, candidates.size());
+            std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+                    [](std::pair<Kad::RoutingTable::key_type, RouterHash> const &a, std::pair<Kad::RoutingTable::key_type, RouterHash> const &b) {
+                        return a.first < b.first;
+                    });
+        });
+        Benchmark::report("copy and partial sort", numQueries, t, "lookups");
+
+        q = 0;
+        t = Benchmark::time(numQueries, [&]() {
+            rt.closest(queries[q++], K_VALUE);
+        });
+        Benchmark::report("k closest scan", numQueries, t, "lookups");
+
+        std::size_t hits = 0;
+        for(auto& k: queries) {
+            auto closest = rt.closest(k, K_VALUE);
+            for(auto& rh: bucketLookup(k))
+                hits += std::count(closest.cbegin(), closest.cend(), rh);
+        }
+
+        std::cout << "  bucket lookup returned " << (double)numFound / numQueries << " entries on average, recall "
+            << (100.0 * hits / (numQueries * K_VALUE)) << "%" << std::endl;
+    }
+}
@@ -0,0 +1,72 @@
+#include "Benchmark.h"
+
+#include <lib/i2p/tunnel/OutboundTunnel.h>
+#include <lib/i2p/tunnel/ElGamalPool.h>
+
+#include <i2pcpp/datatypes/RouterIdentity.h>
+
+#include <botan/auto_rng.h>
+#include <botan/elgamal.h>
+
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace i2pcpp;
+
+static std::vector<RouterIdentity> makeHops(std::size_t n)
+{
+    Botan::AutoSeeded_RNG rng;
+    Botan::DL_Group group("modp/ietf/2048");
+
+    std::vector<RouterIdentity> hops;
+    for(std::size_t i = 0; i < n; ++i) {
+        Botan::ElGamal_PrivateKey key(rng, group);
+        ByteArray encryptionKey = Botan::BigInt::encode(key.get_y());
+        ByteArray signingKey(128);
+        rng.randomize(signingKey.data(), signingKey.size());
+
+        hops.emplace_back(encryptionKey, signingKey, Certificate());
+    }
+
+    return hops;
+}
+
+/**
+ * Measures how many three hop outbound tunnels can be built per second,
+ * with and without precomputed ElGamal ephemeral pairs.
+ */
+I2PCPP_BENCHMARK(TunnelBuild)
+{
+    const std::size_t numTunnels = 50;
+    const std::vector<RouterIdentity> hops = makeHops(3);
+    RouterHash replyHash;
+
+    double t = Benchmark::time(numTunnels, [&]() {
+        Tunnel::OutboundTunnel ot(hops, 1, replyHash, 1);
+    });
+    Benchmark::report("inline ElGamal", numTunnels, t, "tunnels");
+
+    /* Pool filled ahead of time: the cost of a burst of builds. */
+    {
+        Tunnel::ElGamalPool pool(numTunnels * hops.size(), numTunnels * hops.size());
+        while(pool.size() < numTunnels * hops.size())
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        t = Benchmark::time(numTunnels, [&]() {
+            Tunnel::OutboundTunnel ot(hops, 1, replyHash, 1, &pool);
+        });
+        Benchmark::report("precomputed pool (burst)", numTunnels, t, "tunnels");
+    }
+
+    /* Default sized pool refilled while building: the sustained rate. */
+    {
+        Tunnel::ElGamalPool pool(16, 64);
+
+        t = Benchmark::time(numTunnels, [&]() {
+            Tunnel::OutboundTunnel ot(hops, 1, replyHash, 1, &pool);
+        });
+        Benchmark::report("precomputed pool (sustained)", numTunnels, t, "tunnels");
+        std::cout << "  pool misses: " << pool.getMisses() << std::endl;
+    }
+}
@@ -0,0 +1,185 @@
+#include "Benchmark.h"
+
+#include <lib/i2p/i2np/TunnelData.h>
+#include <lib/i2p/tunnel/Message.h>
+
+#include <i2pcpp/datatypes/StaticByteArray.h>
+
+#include <botan/auto_rng.h>
+#include <botan/lookup.h>
+#include <botan/pipe.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+
+using namespace i2pcpp;
+
+/**
+ * Heap allocations made while \a counting is set. operator new is replaced
+ * for the whole benchmark binary, but only counts while this benchmark
+ * runs.
+ */
+static std::atomic<bool> counting(false);
+static std::atomic<std::size_t> numAllocations(0), bytesAllocated(0);
+
+void* operator new(std::size_t n)
+{
+    if(counting.load(std::memory_order_relaxed)) {
+        numAllocations.fetch_add(1, std::memory_order_relaxed);
+        bytesAllocated.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    if(void *p = std::malloc(n ? n : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+/**
+ * Runs \a f \a n times, counting the heap allocations it makes.
+ * @return the elapsed wall clock time in seconds
+ */
+static double timeAndCount(std::size_t n, std::function<void(void)> const &f)
+{
+    numAllocations = 0;
+    bytesAllocated = 0;
+
+    counting = true;
+    double t = Benchmark::time(n, f);
+    counting = false;
+
+    return t;
+}
+
+/**
+ * Prints the heap allocations counted by timeAndCount, per message.
+ */
+static void reportAllocations(std::size_t n)
+{
+    std::cout << "  " << (double)numAllocations / n << " allocations, "
+        << (double)bytesAllocated / n << " bytes allocated per message" << std::endl;
+}
+
+template<typename Src, typename Dst>
+static void copyAll(Src const &src, Dst &dst)
+{
+    std::copy(src.cbegin(), src.cend(), dst.begin());
+}
+
+/**
+ * @return a TunnelData message as handed over by SSU: a short I2NP header,
+ * the tunnel ID and 1024 bytes of data
+ */
+static ByteArray arrivingMessage(Botan::RandomNumberGenerator &rng)
+{
+    ByteArray b(5 + 4 + 1024);
+    rng.randomize(b.data(), b.size());
+    b[0] = (unsigned char)I2NP::Message::Type::TUNNEL_DATA;
+
+    return b;
+}
+
+/**
+ * Measures the rate at which a participating hop can take a TunnelData
+ * message from the transport, add its layer of encryption and serialize it
+ * for the next hop, and counts the heap allocations it makes on the way.
+ *
+ * The previous path is reproduced step by step, with the same copies it
+ * made in I2NP::TunnelData, the tunnel data signal, Tunnel::Manager and
+ * Tunnel::Message, on the heap where it made them there. Copies made by the
+ * SSU receive signal are not included. The in place path also counts the
+ * messages that were no longer in the buffer they arrived in after they
+ * had been encrypted.
+ */
+I2PCPP_BENCHMARK(TunnelForward)
+{
+    const std::size_t numMessages = 20000;
+
+    Botan::AutoSeeded_RNG rng;
+    Botan::SymmetricKey ivKey(rng, 32), layerKey(rng, 32);
+
+    {
+        double t = timeAndCount(numMessages, [&]() {
+            ByteArray arrived = arrivingMessage(rng);
+
+            // I2NP::TunnelData::parse and std::make_shared
+            StaticByteArray<1024> parsed;
+            std::copy(arrived.cbegin() + 9, arrived.cend(), parsed.begin());
+            auto stored = std::make_shared<StaticByteArray<1024>>(parsed);
+
+            // Signals::invokeTunnelData binds by value, Manager::receiveData takes by value
+            StaticByteArray<1024> received;
+            std::function<void(void)> bound = std::bind(&copyAll<StaticByteArray<1024>, StaticByteArray<1024>>, *stored, std::ref(received));
+            bound();
+
+            // Tunnel::Message(StaticByteArray<1024>)
+            StaticByteArray<16> iv;
+            StaticByteArray<1008> encrypted;
+            std::copy(received.cbegin(), received.cbegin() + 16, iv.begin());
+            std::copy(received.cbegin() + 16, received.cend(), encrypted.begin());
+
+            // Tunnel::Message::encrypt, through Botan::Pipe
+            Botan::Pipe ivPipe(get_cipher("AES-256/ECB/NoPadding", ivKey, Botan::ENCRYPTION));
+            ivPipe.process_msg(iv.data(), iv.size());
+            Botan::secure_vector<Botan::byte> v(16);
+            ivPipe.read(v.data(), v.size());
+
+            Botan::Pipe dataPipe(get_cipher("AES-256/CBC/NoPadding", layerKey, Botan::InitializationVector(v), Botan::ENCRYPTION));
+            dataPipe.process_msg(encrypted.data(), encrypted.size());
+            dataPipe.read(encrypted.data(), encrypted.size());
+
+            Botan::Pipe ivPipe2(get_cipher("AES-256/ECB/NoPadding", ivKey, Botan::ENCRYPTION));
+            ivPipe2.process_msg(v);
+            ivPipe2.read(iv.data(), iv.size());
+
+            // Tunnel::Message::getEncryptedData and the I2NP::TunnelData constructor
+            StaticByteArray<1024> payload;
+            std::copy(iv.cbegin(), iv.cend(), payload.begin());
+            std::copy(encrypted.cbegin(), encrypted.cend(), payload.begin() + 16);
+            auto data = std::make_shared<StaticByteArray<1024>>(payload);
+
+            // I2NP::TunnelData::compile and the five header bytes inserted at the front
+            ByteArray b(4);
+            b.insert(b.end(), data->cbegin(), data->cend());
+            for(int i = 0; i < 5; ++i)
+                b.insert(b.begin(), 0);
+        });
+
+        Benchmark::report("previous path", numMessages, t, "msgs");
+        reportAllocations(numMessages);
+    }
+
+    {
+        std::size_t moved = 0;
+
+        double t = timeAndCount(numMessages, [&]() {
+            ByteArray arrived = arrivingMessage(rng);
+            const unsigned char *arrivedData = arrived.data();
+
+            I2NP::MessagePtr m = I2NP::Message::fromBytes(1, std::move(arrived), false);
+            std::shared_ptr<I2NP::TunnelData> td = std::static_pointer_cast<I2NP::TunnelData>(m);
+
+            Tunnel::Message msg(td->getData());
+            msg.encrypt(ivKey, layerKey);
+            td->reroute(1);
+
+            ByteArray out = td->toBytes(false);
+
+            if(td->getData() != arrivedData + 9)
+                ++moved;
+        });
+
+        Benchmark::report("in place", numMessages, t, "msgs");
+        reportAllocations(numMessages);
+        std::cout << "  " << moved << " messages left the buffer they arrived in" << std::endl;
+    }
+}
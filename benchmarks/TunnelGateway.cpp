@@ -0,0 +1,67 @@
+#include "Benchmark.h"
+
+#include <lib/i2p/tunnel/Message.h>
+#include <lib/i2p/tunnel/Fragment.h>
+#include <lib/i2p/tunnel/GatewayBatcher.h>
+
+#include <botan/auto_rng.h>
+
+#include <iostream>
+
+using namespace i2pcpp;
+
+/**
+ * Measures the rate at which a tunnel gateway can turn I2NP messages in to
+ * encrypted tunnel messages: fragmenting, building the tunnel message,
+ * checksumming, padding and encrypting.
+ */
+I2PCPP_BENCHMARK(TunnelGateway)
+{
+    const std::size_t numMessages = 20000;
+
+    Botan::AutoSeeded_RNG rng;
+    Botan::SymmetricKey ivKey(rng, 32), layerKey(rng, 32);
+
+    for(std::size_t messageSize: { 64, 512, 996, 4096 }) {
+        ByteArray data(messageSize);
+        rng.randomize(data.data(), data.size());
+
+        double t = Benchmark::time(numMessages, [&]() {
+            for(auto& f: Tunnel::Fragment::fragmentMessage(data)) {
+                std::list<Tunnel::FragmentPtr> fragments;
+                fragments.push_back(std::move(f));
+
+                Tunnel::Message msg(fragments);
+                msg.compile();
+                msg.encrypt(ivKey, layerKey);
+            }
+        });
+        Benchmark::report("unbatched, " + std::to_string(messageSize) + " byte messages", numMessages, t, "msgs");
+    }
+
+    /* Small messages packed by the batcher. The delay is never reached, so
+     * only full tunnel messages are sent until the final flush.
+     */
+    {
+        boost::asio::io_service ios;
+        std::size_t tunnelMessages = 0;
+
+        auto batcher = std::make_shared<Tunnel::GatewayBatcher>(ios, 1000, [&](std::list<Tunnel::FragmentPtr> &fragments) {
+            Tunnel::Message msg(fragments);
+            msg.compile();
+            msg.encrypt(ivKey, layerKey);
+            ++tunnelMessages;
+        });
+
+        ByteArray data(64);
+        rng.randomize(data.data(), data.size());
+
+        double t = Benchmark::time(numMessages, [&]() {
+            batcher->queue(data);
+        });
+        batcher->flush();
+
+        Benchmark::report("batched, 64 byte messages", numMessages, t, "msgs");
+        std::cout << "  " << tunnelMessages << " tunnel messages, average fill " << (int)(batcher->getFillRatio() * 100) << "%" << std::endl;
+    }
+}
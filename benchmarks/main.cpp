@@ -0,0 +1,69 @@
+#include "Benchmark.h"
+
+#include <botan/botan.h>
+
+#include <iomanip>
+#include <iostream>
+
+namespace i2pcpp {
+    namespace Benchmark {
+        std::map<std::string, Function>& registry()
+        {
+            static std::map<std::string, Function> r;
+            return r;
+        }
+
+        double time(std::size_t n, std::function<void(void)> const &f)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for(std::size_t i = 0; i < n; ++i)
+                f();
+            auto end = std::chrono::steady_clock::now();
+
+            return std::chrono::duration<double>(end - start).count();
+        }
+
+        void report(std::string const &what, std::size_t n, double seconds, std::string const &unit)
+        {
+            std::cout << "  " << std::left << std::setw(40) << what
+                << std::right << std::setw(12) << std::fixed << std::setprecision(1) << (n / seconds) << " " << unit << "/s"
+                << " (" << n << " in " << std::setprecision(3) << seconds << "s)" << std::endl;
+        }
+    }
+}
+
+using namespace i2pcpp;
+
+/**
+ * Runs all registered benchmarks, or only those named on the command line.
+ */
+int main(int argc, char **argv)
+{
+    Botan::LibraryInitializer init("thread_safe=true");
+
+    auto& benchmarks = Benchmark::registry();
+
+    if(argc > 1 && std::string(argv[1]) == "--list") {
+        for(auto& b: benchmarks)
+            std::cout << b.first << std::endl;
+
+        return 0;
+    }
+
+    for(auto& b: benchmarks) {
+        if(argc > 1) {
+            bool selected = false;
+            for(int i = 1; i < argc; ++i)
+                if(b.first == argv[i])
+                    selected = true;
+
+            if(!selected)
+                continue;
+        }
+
+        std::cout << b.first << std::endl;
+        b.second();
+    }
+
+    return 0;
+}
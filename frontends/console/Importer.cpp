@@ -0,0 +1,198 @@
+#include "Importer.h"
+
+#include <i2pcpp/Database.h>
+#include <i2pcpp/util/make_unique.h>
+
+#include <boost/filesystem.hpp>
+
+#include <fstream>
+#include <thread>
+
+using namespace i2pcpp;
+
+template<typename T>
+bool Importer::Queue<T>::push(T t)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_notFull.wait(lock, [this]() { return m_closed || m_items.size() < m_capacity; });
+    if(m_closed)
+        return false;
+
+    m_items.push_back(std::move(t));
+    m_notEmpty.notify_one();
+
+    return true;
+}
+
+template<typename T>
+bool Importer::Queue<T>::pop(T &t)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_notEmpty.wait(lock, [this]() { return m_closed || !m_items.empty(); });
+    if(m_items.empty())
+        return false;
+
+    t = std::move(m_items.front());
+    m_items.pop_front();
+    m_notFull.notify_one();
+
+    return true;
+}
+
+template<typename T>
+void Importer::Queue<T>::close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_closed = true;
+    m_notEmpty.notify_all();
+    m_notFull.notify_all();
+}
+
+Importer::Importer(std::shared_ptr<Database> const &db, unsigned jobs, std::size_t batchSize) :
+    m_db(db),
+    m_jobs(jobs ? jobs : 1),
+    m_batchSize(batchSize ? batchSize : 1),
+    m_paths(m_jobs * 16),
+    m_routers(m_batchSize),
+    m_activeWorkers(0),
+    m_files(0),
+    m_failed(0),
+    m_log(boost::log::keywords::channel = "IMP") {}
+
+uint64_t Importer::run(std::string const &dir)
+{
+    m_start = m_lastReport = std::chrono::steady_clock::now();
+
+    m_activeWorkers = m_jobs;
+
+    std::vector<std::thread> threads;
+    threads.emplace_back(&Importer::walk, this, dir);
+    for(unsigned i = 0; i < m_jobs; i++)
+        threads.emplace_back(&Importer::work, this);
+
+    try {
+        std::vector<RouterInfo> batch;
+        batch.reserve(m_batchSize);
+
+        std::unique_ptr<RouterInfo> ri;
+        while(m_routers.pop(ri)) {
+            batch.push_back(std::move(*ri));
+
+            if(batch.size() >= m_batchSize)
+                store(batch);
+        }
+
+        store(batch);
+    } catch(...) {
+        // Unblock the walker and the workers, so that they can be joined
+        m_paths.close();
+        m_routers.close();
+
+        for(auto& t: threads)
+            t.join();
+
+        throw;
+    }
+
+    for(auto& t: threads)
+        t.join();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start);
+    I2P_LOG(m_log, info) << "imported " << m_imported << " routers from " << m_files << " files (" << m_failed << " failed) in " << elapsed.count() << "ms, " << (m_imported * 1000 / (elapsed.count() + 1)) << " routers/s";
+
+    return m_imported;
+}
+
+void Importer::walk(std::string const &dir)
+{
+    namespace fs = boost::filesystem;
+
+    try {
+        fs::recursive_directory_iterator itr(dir), end;
+        while(itr != end) {
+            if(is_regular_file(*itr)) {
+                m_files++;
+                if(!m_paths.push(itr->path().string()))
+                    break;
+            }
+
+            if(fs::is_symlink(*itr)) itr.no_push();
+
+            try {
+                ++itr;
+            } catch(std::exception &e) {
+                itr.no_push();
+                continue;
+            }
+        }
+    } catch(std::exception &e) {
+        I2P_LOG(m_log, error) << "error walking " << dir << ": " << e.what();
+    }
+
+    m_paths.close();
+}
+
+void Importer::work()
+{
+    std::string path;
+    while(m_paths.pop(path)) {
+        std::ifstream f(path, std::ios::binary);
+        if(!f.is_open()) {
+            I2P_LOG(m_log, error) << "failed to import " << path << ": could not open file";
+            m_failed++;
+            continue;
+        }
+
+        ByteArray info = ByteArray((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+        f.close();
+        I2P_LOG(m_log, debug) << "importing " << path;
+
+        try {
+            auto begin = info.cbegin();
+            auto ri = std::make_unique<RouterInfo>(begin, info.cend());
+
+            if(!ri->verifySignature()) {
+                I2P_LOG(m_log, error) << "failed to import " << path << ": bad signature";
+                m_failed++;
+                continue;
+            }
+
+            if(!m_routers.push(std::move(ri)))
+                break;
+        } catch(std::exception &e) {
+            I2P_LOG(m_log, error) << "failed to import " << path << ": " << e.what();
+            m_failed++;
+        }
+    }
+
+    // The last worker out tells the writer that no more routers will come
+    if(--m_activeWorkers == 0)
+        m_routers.close();
+}
+
+void Importer::store(std::vector<RouterInfo> &batch)
+{
+    if(!batch.empty()) {
+        try {
+            m_db->setRouterInfo(batch);
+            m_imported += batch.size();
+        } catch(std::exception &e) {
+            I2P_LOG(m_log, error) << "failed to store " << batch.size() << " routers: " << e.what();
+            m_failed += batch.size();
+        }
+
+        batch.clear();
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if(now - m_lastReport < std::chrono::seconds(1))
+        return;
+
+    m_lastReport = now;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_start);
+    I2P_LOG(m_log, info) << "imported " << m_imported << " routers, " << m_files << " files found, " << m_failed << " failed, " << (m_imported * 1000 / (elapsed.count() + 1)) << " routers/s";
+}
@@ -0,0 +1,106 @@
+#ifndef IMPORTER_H
+#define IMPORTER_H
+
+#include "Logger.h"
+
+#include <i2pcpp/datatypes/RouterInfo.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace i2pcpp { class Database; }
+
+/**
+ * Imports a directory of RouterInfo files (such as a netDb) in to the
+ * database. One thread walks the directory, a pool of workers reads,
+ * parses and verifies the files, and the calling thread stores the
+ * results in batches. The stages are connected by bounded queues, so the
+ * memory used does not depend on the size of the directory.
+ */
+class Importer {
+    public:
+        /**
+         * @param jobs the number of parse/verify workers
+         * @param batchSize the number of RouterInfos queued before waiting
+         *  for them to be written. The transactions themselves are sized by
+         *  the db_write_batch setting of the database.
+         */
+        Importer(std::shared_ptr<i2pcpp::Database> const &db, unsigned jobs, std::size_t batchSize);
+        Importer(const Importer &) = delete;
+        Importer& operator=(Importer &) = delete;
+
+        /**
+         * Imports all files in \a dir recursively. Progress is logged about
+         * once per second.
+         * @return the number of routers imported
+         */
+        uint64_t run(std::string const &dir);
+
+    private:
+        /**
+         * A FIFO which blocks producers while it is full and consumers
+         * while it is empty, until it is closed.
+         */
+        template<typename T>
+        class Queue {
+            public:
+                Queue(std::size_t capacity) :
+                    m_capacity(capacity) {}
+
+                /**
+                 * @return false if the queue was closed, in which case \a t
+                 *  is dropped
+                 */
+                bool push(T t);
+
+                /**
+                 * @return false if the queue is closed and empty
+                 */
+                bool pop(T &t);
+
+                void close();
+
+            private:
+                std::size_t m_capacity;
+                std::deque<T> m_items;
+                bool m_closed = false;
+
+                std::mutex m_mutex;
+                std::condition_variable m_notEmpty;
+                std::condition_variable m_notFull;
+        };
+
+        void walk(std::string const &dir);
+        void work();
+
+        /**
+         * Stores \a batch and logs the progress if a second has passed
+         * since it was last logged.
+         */
+        void store(std::vector<i2pcpp::RouterInfo> &batch);
+
+        std::shared_ptr<i2pcpp::Database> m_db;
+        unsigned m_jobs;
+        std::size_t m_batchSize;
+
+        Queue<std::string> m_paths;
+        Queue<std::unique_ptr<i2pcpp::RouterInfo>> m_routers;
+        std::atomic<unsigned> m_activeWorkers;
+
+        std::atomic<uint64_t> m_files;
+        std::atomic<uint64_t> m_failed;
+        uint64_t m_imported = 0;
+
+        std::chrono::steady_clock::time_point m_start;
+        std::chrono::steady_clock::time_point m_lastReport;
+
+        i2p_logger_mt m_log;
+};
+
+#endif
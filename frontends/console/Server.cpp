@@ -81,12 +81,25 @@ void Server::broadcastStats(uint64_t bytesSent, uint64_t bytesReceived)
     }
 }
 
+void Server::broadcastTunnelUsage(std::string const &usage)
+{
+    std::lock_guard<std::mutex> lock(m_connectionsMutex);
+
+    for(auto& c: m_controlClients) {
+        m_server.send(c, "{\"tunnels\":" + usage + "}", wspp::frame::opcode::text);
+    }
+}
+
 void Server::timerCallback(const boost::system::error_code &e)
 {
     if(!e) {
         auto stats = m_stats->getBytesAndReset();
         broadcastStats(stats.first, stats.second);
 
+        std::string usage = m_stats->takeTunnelUsage();
+        if(!usage.empty())
+            broadcastTunnelUsage(usage);
+
         m_statsTimer.expires_at(m_statsTimer.expires_at() + boost::posix_time::time_duration(0, 0, 1));
         m_statsTimer.async_wait(boost::bind(&Server::timerCallback, this, boost::asio::placeholders::error));
     }
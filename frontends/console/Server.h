@@ -31,6 +31,7 @@ class Server {
         void on_close(wspp::connection_hdl handle);
 
         void broadcastStats(uint64_t bytesSent, uint64_t bytesReceived);
+        void broadcastTunnelUsage(std::string const &usage);
         void timerCallback(const boost::system::error_code &e);
 
         i2pcpp::Endpoint m_endpoint;
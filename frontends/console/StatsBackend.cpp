@@ -10,6 +10,8 @@ void StatsBackend::consume(boost::log::record_view const& rec)
         m_sentBytes += boost::log::extract<uint64_t>("sent", rec).get();
     } else if(rec.attribute_values().count("received")) {
         m_receivedBytes += boost::log::extract<uint64_t>("received", rec).get();
+    } else if(rec.attribute_values().count("tunnel_usage")) {
+        m_tunnelUsage = boost::log::extract<std::string>("tunnel_usage", rec).get();
     }
 }
 
@@ -21,3 +23,12 @@ std::pair<uint64_t, uint64_t> StatsBackend::getBytesAndReset()
     m_sentBytes = m_receivedBytes = 0;
     return p;
 }
+
+std::string StatsBackend::takeTunnelUsage()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::string usage;
+    usage.swap(m_tunnelUsage);
+    return usage;
+}
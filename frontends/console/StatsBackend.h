@@ -5,6 +5,7 @@
 #include <boost/log/sinks/frontend_requirements.hpp>
 
 #include <mutex>
+#include <string>
 
 namespace sinks = boost::log::sinks;
 
@@ -19,11 +20,19 @@ class StatsBackend : public sinks::basic_sink_backend<
 
         std::pair<uint64_t, uint64_t> getBytesAndReset();
 
+        /**
+         * @return the latest usage report of the heaviest participating
+         * tunnels, or an empty string if there was none since the last call
+         */
+        std::string takeTunnelUsage();
+
     private:
         mutable std::mutex m_mutex;
 
         uint64_t m_receivedBytes = 0;
         uint64_t m_sentBytes = 0;
+
+        std::string m_tunnelUsage;
 };
 
 #endif
@@ -2,6 +2,7 @@
  * @file main.cpp
  * @brief Contains the starting point, main.
  */
+#include "Importer.h"
 #include "Logger.h"
 #include "Server.h"
 
@@ -30,6 +31,7 @@
 #include <string>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
 
 static volatile bool quit = false;
 static std::condition_variable cv;
@@ -69,6 +71,8 @@ int main(int argc, char **argv)
             ("import", po::value<string>(), "Import a single routerInfo file")
             ("export", po::value<string>(), "Export your routerInfo file")
             ("importdir", po::value<string>(), "Import all files in the given directory recursively")
+            ("importjobs", po::value<unsigned>()->default_value(std::max(1u, thread::hardware_concurrency())), "Number of threads parsing and verifying files for --importdir")
+            ("importbatch", po::value<size_t>()->default_value(1000), "Number of routers --importdir queues before it waits for them to be written")
             ("wipe", "Delete all stored routers and profiles");
 
         po::options_description config("Configuration manipulation");
@@ -168,37 +172,9 @@ int main(int argc, char **argv)
                 return EXIT_FAILURE;
             }
 
-            vector<RouterInfo> routers;
-            fs::recursive_directory_iterator itr(dir), end;
-            while(itr != end) {
-                if(is_regular_file(*itr)) {
-                    ifstream f(itr->path().string(), ios::binary);
-                    if(!f.is_open()) continue;
-
-                    ByteArray info = ByteArray((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
-                    f.close();
-                    I2P_LOG(lg, debug) << "importing " << itr->path().string();
-                    auto begin = info.cbegin();
-                    auto ri = RouterInfo(begin, info.cend());
-
-                    if(ri.verifySignature())
-                        routers.push_back(ri);
-                    else
-                        I2P_LOG(lg, error) << "failed to import " << itr->path().string() << ": bad signature";
-                }
-
-                if(fs::is_symlink(*itr)) itr.no_push();
-
-                try {
-                    ++itr;
-                } catch(exception &e) {
-                    itr.no_push();
-                    continue;
-                }
-            }
-
-            db->setRouterInfo(routers);
-            I2P_LOG(lg, info) << "successfully imported " << routers.size() << " routers";
+            Importer importer(db, vm["importjobs"].as<unsigned>(), vm["importbatch"].as<size_t>());
+            uint64_t imported = importer.run(dir);
+            I2P_LOG(lg, info) << "successfully imported " << imported << " routers";
 
             return EXIT_SUCCESS;
         }
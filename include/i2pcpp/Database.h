@@ -10,6 +10,7 @@
 
 #include <boost/shared_ptr.hpp>
 
+#include <memory>
 #include <string>
 #include <forward_list>
 #include <unordered_map>
@@ -26,6 +27,9 @@ namespace sqlite {
 
 namespace i2pcpp {
     class RouterInfo;
+    class RouterInfoCache;
+    class DatabaseWriter;
+    class RouterDirectory;
 
     /**
      * An utility wrapper for the sqlite3 functionality.
@@ -34,12 +38,33 @@ namespace i2pcpp {
         public:
             /**
              * Constructs from a database file given by its name.
+             * A database with an older schema is migrated to the current
+             *  one first.
+             * Recently used i2pcpp::RouterInfo objects are cached in memory,
+             *  up to the number of KiB given by the router_info_cache_size
+             *  configuration value.
+             * i2pcpp::RouterInfo objects are written by a thread of their
+             *  own, in batches of up to db_write_batch objects, at most
+             *  db_write_interval milliseconds after they were queued.
+             * The hashes and capabilities of all known routers are read in to
+             *  an in-memory i2pcpp::RouterDirectory.
              * @param file the name of the database file
              */
             Database(std::string const &file);
             Database(const Database &) = delete;
             Database& operator=(Database &) = delete;
 
+            /**
+             * Version of the schema in share/schema.sql. Stored in the
+             *  user_version of the database file.
+             * Version 0 stored each i2pcpp::RouterInfo across separate
+             *  tables for the router, its options, its addresses and their
+             *  options. Version 1 stores the signed, serialized
+             *  i2pcpp::RouterInfo as a single blob, next to a few indexed
+             *  columns.
+             */
+            static const int SCHEMA_VERSION = 1;
+
             /**
              * Creates a new database file.
              * @param file the name of the database file to be created
@@ -51,6 +76,12 @@ namespace i2pcpp {
              */
             std::string getConfigValue(std::string const &name);
 
+            /**
+             * @return the value of the configuration field \a name, or
+             *  \a defaultValue if the field has not been set
+             */
+            std::string getConfigValue(std::string const &name, std::string const &defaultValue);
+
             /**
              * Sets the value of the configuration field \a name to \a value.
              */
@@ -62,9 +93,10 @@ namespace i2pcpp {
             ByteArray getConfigBlob(std::string const &name);
 
             /**
-             * @return the i2pcpp::RouterHash of a randomly selected router
+             * @return the in-memory index of the known routers by
+             *  capability, kept in sync with the database
              */
-            RouterHash getRandomRouter();
+            RouterDirectory& getDirectory();
 
             /**
              * @return true if we know the router with i2pcpp::RouterHash
@@ -72,15 +104,25 @@ namespace i2pcpp {
              */
             bool routerExists(RouterHash const &routerHash);
 
+            /**
+             * @return the i2pcpp::RouterInfo associated with a router given
+             *  by its i2pcpp::RouterHash \a routerHash, shared with the cache
+             *  so that it need not be copied, or a null pointer if the router
+             *  is not known
+             */
+            std::shared_ptr<const RouterInfo> getRouterInfoPtr(RouterHash const &routerHash);
+
             /**
              * @return the i2pcpp::RouterInfo associated with a router given
              *  by its a routerHash given as a std::string.
+             * @throw std::runtime_error if the router is not known
              */
             RouterInfo getRouterInfo(std::string const &routerHash);
 
             /**
              * @return the i2pcpp::RouterInfo associated with a router given
              *  by its i2pcpp::RouterHash \a routerHash.
+             * @throw std::runtime_error if the router is not known
              */
             RouterInfo getRouterInfo(RouterHash const &routerHash);
 
@@ -95,23 +137,73 @@ namespace i2pcpp {
             void deleteAllRouters();
 
             /**
-             * Inserts or replaces a std::vector of i2pcpp::RouterInfo objects.
+             * Inserts or replaces a std::vector of i2pcpp::RouterInfo objects
+             *  and waits until they have been written.
+             * @throw std::runtime_error if they could not be written
              */
             void setRouterInfo(std::vector<RouterInfo> const &routers);
 
             /**
-             * Inserts or replaces an i2pcpp::RouterInfo object \a info.
+             * Inserts or replaces an i2pcpp::RouterInfo object \a info and
+             *  waits until it has been written.
+             * @throw std::runtime_error if it could not be written
              */
             void setRouterInfo(RouterInfo const &info);
 
+            /**
+             * Inserts or replaces an i2pcpp::RouterInfo object \a info
+             *  without waiting for the writer thread. It is visible to
+             *  routerExists and getRouterInfo right away, until the write
+             *  fails. A copy published later than \a info is kept instead.
+             */
+            void queueRouterInfo(RouterInfo const &info);
+
             /**
              * @return a list of the i2pcpp::RouterHash objects of all known
              *  routers
              */
             std::forward_list<RouterHash> getAllHashes();
 
+            /**
+             * Counters of the cache in front of getRouterInfo.
+             */
+            struct CacheStats {
+                uint64_t hits;
+                uint64_t misses;
+                uint64_t evictions;
+                std::size_t entries;
+                std::size_t bytes;
+            };
+
+            CacheStats getCacheStats() const;
+
         private:
+            /**
+             * Brings the schema of the database up to SCHEMA_VERSION, in a
+             *  single transaction.
+             * @throw std::runtime_error if the schema is newer than
+             *  SCHEMA_VERSION
+             */
+            void migrate();
+
+            /**
+             * Fills the i2pcpp::RouterDirectory from a single scan of the
+             *  routers table.
+             */
+            void loadDirectory();
+
+            /**
+             * Reads the i2pcpp::RouterInfo of \a routerHash from the
+             *  database, bypassing the cache.
+             * @return the i2pcpp::RouterInfo, or a null pointer if the
+             *  router is not in the database
+             */
+            std::shared_ptr<const RouterInfo> loadRouterInfo(std::string const &routerHash);
+
             std::shared_ptr<sqlite::connection> m_conn;
+            std::shared_ptr<RouterInfoCache> m_cache;
+            std::shared_ptr<RouterDirectory> m_directory;
+            std::shared_ptr<DatabaseWriter> m_writer;
 
             static std::unordered_map<std::string, boost::shared_ptr<sqlite::command>> commands;
             static std::unordered_map<std::string, boost::shared_ptr<sqlite::query>> queries;
@@ -18,7 +18,12 @@ namespace i2pcpp {
     class Transport {
         public:
             typedef boost::signals2::signal<void(const RouterHash, bool)> EstablishedSignal;
-            typedef boost::signals2::signal<void(const RouterHash, const uint32_t, const ByteArray)> ReceivedSignal;
+
+            /**
+             * The data is passed by reference so that it can be taken over by
+             *  the handler instead of being copied. Handlers may leave it empty.
+             */
+            typedef boost::signals2::signal<void(const RouterHash, const uint32_t, ByteArray &)> ReceivedSignal;
             typedef boost::signals2::signal<void(const RouterHash)> FailureSignal;
             typedef boost::signals2::signal<void(const RouterHash)> DisconnectedSignal;
 
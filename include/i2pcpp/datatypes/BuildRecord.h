@@ -12,7 +12,7 @@
 #include <bitset>
 #include <memory>
 
-namespace Botan { class ElGamal_PrivateKey; }
+namespace Botan { class ElGamal_PrivateKey; class PK_Decryptor; class BigInt; }
 
 namespace i2pcpp {
     /**
@@ -42,12 +42,30 @@ namespace i2pcpp {
              */
             void encrypt(ByteArray const &encryptionKey);
 
+            /**
+             * Preforms ElGamal encryption on the build record data type using
+             *  a precomputed ephemeral pair, so that only the exponentiation
+             *  involving the recipient's key is left to do.
+             * @param encryptionKey the public key to be used for ElGamal encryption
+             * @param k the ephemeral exponent, which must never be reused
+             * @param gk g^k mod p for the ElGamal group
+             */
+            void encrypt(ByteArray const &encryptionKey, Botan::BigInt const &k, Botan::BigInt const &gk);
+
             /**
              * Preforms ElGamal decryption on the build record data type.
              * @param key the private key to be used for ElGamal decryption
              */
             void decrypt(std::shared_ptr<const Botan::ElGamal_PrivateKey> key);
 
+            /**
+             * Preforms ElGamal decryption on the build record data type using
+             *  an existing decryptor. This avoids the setup cost of a new
+             *  decryptor when many records are decrypted with the same key.
+             * @param pkd a raw ElGamal decryptor for our private key
+             */
+            void decrypt(Botan::PK_Decryptor const &pkd);
+
             /**
              * Preforms AES encryption on the build record data.
              * @param iv the 16 byte initialization vector for AES
@@ -0,0 +1,48 @@
+#ifndef BUFFEREDRNG_H
+#define BUFFEREDRNG_H
+
+#include <botan/auto_rng.h>
+
+#include <array>
+#include <mutex>
+
+namespace i2pcpp {
+    /**
+     * Hands out random bytes from a buffer which is refilled in large
+     * blocks from a single, long lived Botan::AutoSeeded_RNG. Meant for
+     * bulk, non-secret randomness such as padding. Thread safe.
+     */
+    class BufferedRNG {
+        public:
+            BufferedRNG() = default;
+            BufferedRNG(const BufferedRNG &) = delete;
+            BufferedRNG& operator=(BufferedRNG &) = delete;
+
+            /**
+             * Fills \a n bytes at \a out with random bytes.
+             */
+            void randomize(unsigned char *out, std::size_t n);
+
+            /**
+             * Fills \a n bytes at \a out with random nonzero bytes. Zero bytes
+             * are discarded rather than replaced, so the result is uniform
+             * over 1-255.
+             */
+            void randomizeNonzero(unsigned char *out, std::size_t n);
+
+        private:
+            /**
+             * Refills the buffer. Must be called with m_mutex held.
+             */
+            void refill();
+
+            Botan::AutoSeeded_RNG m_rng;
+
+            std::array<unsigned char, 4096> m_buffer;
+            std::size_t m_pos = 4096;
+
+            std::mutex m_mutex;
+    };
+}
+
+#endif
@@ -9,6 +9,9 @@
 #include <botan/pk_filts.h>
 #include <botan/lookup.h>
 #include <botan/elgamal.h>
+#include <botan/numthry.h>
+#include <botan/reducer.h>
+#include <botan/workfactor.h>
 
 namespace i2pcpp {
     BuildRecord::BuildRecord(ByteArrayConstItr &begin, ByteArrayConstItr end)
@@ -31,6 +34,18 @@ namespace i2pcpp {
 
     void BuildRecord::encrypt(ByteArray const &encryptionKey)
     {
+        static const Botan::DL_Group group("modp/ietf/2048");
+
+        Botan::AutoSeeded_RNG rng;
+        Botan::BigInt k(rng, 2 * Botan::dl_work_factor(group.get_p().bits()));
+        encrypt(encryptionKey, k, Botan::power_mod(group.get_g(), k, group.get_p()));
+    }
+
+    void BuildRecord::encrypt(ByteArray const &encryptionKey, Botan::BigInt const &k, Botan::BigInt const &gk)
+    {
+        static const Botan::DL_Group group("modp/ietf/2048");
+        static const Botan::Modular_Reducer modP(group.get_p());
+
         // First hash the data
         Botan::Pipe hashPipe(new Botan::Hash_Filter("SHA-256"));
         hashPipe.start_msg();
@@ -45,20 +60,30 @@ namespace i2pcpp {
         toEncrypt.insert(toEncrypt.end(), hash.cbegin(), hash.cend());
         toEncrypt.insert(toEncrypt.end(), m_data.cbegin(), m_data.cbegin() + 222);
 
-        // Perform the encryption
-        Botan::AutoSeeded_RNG rng;
-        Botan::DL_Group group("modp/ietf/2048");
-        Botan::ElGamal_PublicKey elgKey(group, Botan::BigInt(encryptionKey.data(), encryptionKey.size()));
-        Botan::PK_Encryptor *pke = new Botan::PK_Encryptor_EME(elgKey, "Raw");
-        m_data = toStaticByteArray<512>(pke->encrypt(toEncrypt, rng));
+        // Perform the encryption: (a, b) = (g^k, m * y^k), as Botan's raw ElGamal does
+        const Botan::BigInt &p = group.get_p();
+        Botan::BigInt m(toEncrypt.data(), toEncrypt.size());
+        Botan::BigInt y(encryptionKey.data(), encryptionKey.size());
+        Botan::BigInt b = modP.multiply(m, Botan::power_mod(y, k, p));
+
+        Botan::secure_vector<Botan::byte> encA = Botan::BigInt::encode_1363(gk, 256);
+        Botan::secure_vector<Botan::byte> encB = Botan::BigInt::encode_1363(b, 256);
+        std::copy(encA.cbegin(), encA.cend(), m_data.begin());
+        std::copy(encB.cbegin(), encB.cend(), m_data.begin() + 256);
     }
 
     void BuildRecord::decrypt(std::shared_ptr<const Botan::ElGamal_PrivateKey> key)
+    {
+        Botan::PK_Decryptor_EME pkd(*key, "Raw");
+        decrypt(pkd);
+    }
+
+    void BuildRecord::decrypt(Botan::PK_Decryptor const &pkd)
     {
         // Decrypt
-        Botan::DL_Group group("modp/ietf/2048");
-        Botan::PK_Decryptor *pkd = new Botan::PK_Decryptor_EME(*key, "Raw");
-        Botan::secure_vector<Botan::byte> decrypted = pkd->decrypt(m_data.data(), 512);
+        Botan::secure_vector<Botan::byte> decrypted = pkd.decrypt(m_data.data(), 512);
+        if(decrypted.size() < 1 + 32 + 222)
+            throw std::runtime_error("malformed ElGamal block in BuildRecord");
 
         // Parse
         auto dataItr = decrypted.cbegin();
@@ -4,6 +4,9 @@
  */
 #include "../../include/i2pcpp/Database.h"
 
+#include "DatabaseWriter.h"
+#include "RouterDirectory.h"
+#include "RouterInfoCache.h"
 #include "sqlite3cc.h"
 #include "statement_guard.h"
 
@@ -11,6 +14,8 @@
 #include <i2pcpp/util/I2PDH.h>
 #include <i2pcpp/util/make_unique.h>
 
+#include <i2pcpp/Log.h>
+
 #include <i2pcpp/datatypes/RouterInfo.h>
 
 #include <botan/auto_rng.h>
@@ -24,6 +29,23 @@ extern uint8_t _binary_schema_sql_start[];
 extern uintptr_t _binary_schema_sql_size[];
 
 namespace i2pcpp {
+    /**
+     * Runs the statements in share/schema.sql on \a conn.
+     */
+    static void createTables(sqlite::connection &conn)
+    {
+        std::string schema((char *)_binary_schema_sql_start, (uintptr_t)_binary_schema_sql_size);
+
+        boost::char_separator<char> sep(";");
+        boost::tokenizer<boost::char_separator<char>> tok(schema, sep);
+
+        for(auto s: tok) {
+            if(s == "\n" || s.size() < 2) continue;
+
+            conn.exec(s);
+        }
+    }
+
     std::unordered_map<std::string, boost::shared_ptr<sqlite::command>> Database::commands;
     std::unordered_map<std::string, boost::shared_ptr<sqlite::query>> Database::queries;
 
@@ -34,33 +56,42 @@ namespace i2pcpp {
             m_conn->exec("PRAGMA foreign_keys=ON");
             m_conn->exec("PRAGMA synchronous=OFF");
             m_conn->exec("PRAGMA temp_store=MEMORY");
+            m_conn->exec("PRAGMA busy_timeout=5000");
         } catch(sqlite::sqlite_error &e) {
             throw std::runtime_error("could not open database");
         }
 
+        migrate();
+
         Database::queries["get_config"] = m_conn->make_query("SELECT value FROM config WHERE name = ?");
-        Database::queries["get_random_router"] = m_conn->make_query("SELECT id FROM routers ORDER BY RANDOM() LIMIT 1");
         Database::queries["router_exists"] = m_conn->make_query("SELECT COUNT(id) AS count FROM routers WHERE id = ?");
-        Database::queries["get_router"] = m_conn->make_query("SELECT encryption_key, signing_key, certificate, published, signature FROM routers WHERE id = ?");
-        Database::queries["get_router_options"] = m_conn->make_query("SELECT name, value FROM router_options WHERE router_id = ?");
-        Database::queries["get_router_addresses"] = m_conn->make_query("SELECT \"index\", cost, expiration, transport FROM router_addresses WHERE router_id = ?");
-        Database::queries["router_address_options"] = m_conn->make_query("SELECT name, value FROM router_address_options WHERE router_id = ? AND \"index\" = ? ORDER BY name ASC");
+        Database::queries["get_router"] = m_conn->make_query("SELECT data FROM routers WHERE id = ?");
 
         Database::commands["set_config"] = m_conn->make_command("INSERT OR REPLACE INTO config (name, value) VALUES (?, ?)");
         Database::commands["delete_profile"] = m_conn->make_command("DELETE FROM profiles WHERE router_id = ?");
-        Database::commands["delete_router_address_options"] = m_conn->make_command("DELETE FROM router_address_options WHERE router_id = ?");
-        Database::commands["delete_router_addresses"] = m_conn->make_command("DELETE FROM router_addresses WHERE router_id = ?");
-        Database::commands["delete_router_options"] = m_conn->make_command("DELETE FROM router_options WHERE router_id = ?");
         Database::commands["delete_router"] = m_conn->make_command("DELETE FROM routers WHERE id = ?");
         Database::commands["truncate_profiles"] = m_conn->make_command("DELETE FROM profiles");
-        Database::commands["truncate_router_address_options"] = m_conn->make_command("DELETE FROM router_address_options");
-        Database::commands["truncate_router_addresses"] = m_conn->make_command("DELETE FROM router_addresses");
-        Database::commands["truncate_router_options"] = m_conn->make_command("DELETE FROM router_options");
-        Database::commands["truncate_router_options"] = m_conn->make_command("DELETE FROM routers");
-        Database::commands["insert_router"] = m_conn->make_command("INSERT OR REPLACE INTO routers(id, encryption_key, signing_key, certificate, published, signature) VALUES(?, ?, ?, ?, ?, ?)");
-        Database::commands["insert_router_address"] = m_conn->make_command("INSERT OR REPLACE INTO router_addresses(router_id, \"index\", cost, expiration, transport) VALUES(?, ?, ?, ?, ?)");
-        Database::commands["insert_router_address_option"] = m_conn->make_command("INSERT OR REPLACE INTO router_address_options(router_id, \"index\", name, value) VALUES(?, ?, ?, ?)");
-        Database::commands["insert_router_option"] = m_conn->make_command("INSERT OR REPLACE INTO router_options(router_id, name, value) VALUES(?, ?, ?)");
+        Database::commands["truncate_routers"] = m_conn->make_command("DELETE FROM routers");
+
+        m_directory = std::make_shared<RouterDirectory>();
+        loadDirectory();
+
+        m_cache = std::make_shared<RouterInfoCache>(std::stoul(getConfigValue("router_info_cache_size", "16384")) * 1024);
+
+        /* Readers no longer block the writer thread and the other way
+         * around. The mode is persistent, so it only needs to be set once.
+         */
+        m_conn->exec("PRAGMA journal_mode=WAL");
+
+        m_writer = std::make_shared<DatabaseWriter>(file,
+                std::chrono::milliseconds(std::stoul(getConfigValue("db_write_interval", "100"))),
+                std::stoul(getConfigValue("db_write_batch", "500")));
+
+        // What could not be written must not be served as if it had been
+        m_writer->registerFailed([this](RouterHash const rh) {
+            m_cache->invalidate(rh);
+            m_directory->remove(rh);
+        });
     }
 
     void Database::createDb(std::string const &file)
@@ -73,17 +104,8 @@ namespace i2pcpp {
             {
                 sqlite::transaction_guard<> t(conn);
 
-                std::string schema((char *)_binary_schema_sql_start, (uintptr_t)_binary_schema_sql_size);
-
-                boost::char_separator<char> sep(";");
-                boost::tokenizer<boost::char_separator<char>> tok(schema, sep);
-
-                auto itr = tok.begin();
-                for(auto s: tok) {
-                    if(s == "\n" || s.size() < 2) continue;
-
-                    conn.exec(s);
-                }
+                createTables(conn);
+                conn.exec("PRAGMA user_version = " + std::to_string(SCHEMA_VERSION));
 
                 Botan::AutoSeeded_RNG rng;
                 Botan::DSA_PrivateKey dsa_key(rng, DH::getGroup());
@@ -116,28 +138,35 @@ namespace i2pcpp {
         return value;
     }
 
+    std::string Database::getConfigValue(std::string const &name, std::string const &defaultValue)
+    {
+        auto q = Database::queries["get_config"];
+        statement_guard sg(q, name);
+
+        sqlite::row r = q->step();
+        if(!r)
+            return defaultValue;
+
+        std::string value;
+        r >> value;
+        return value;
+    }
+
     void Database::setConfigValue(std::string const &name, std::string const &value)
     {
         statement_guard sg(Database::commands["set_config"], name, value, sqlite::exec);
     }
 
-    RouterHash Database::getRandomRouter()
+    RouterDirectory& Database::getDirectory()
     {
-        // SELECT router_id FROM router_options WHERE router_options.name='caps' AND router_options.value LIKE '%f%' ORDER BY RANDOM() LIMIT 1;
-        auto q = Database::queries["get_random_router"];
-        statement_guard sg(q);
-
-        sqlite::row r = q->step();
-        if(!r)
-            throw std::runtime_error("couldn't fetch random router");
-
-        std::string rhStr;
-        r >> rhStr;
-        return toRouterHash(Base64::decode(rhStr));
+        return *m_directory;
     }
 
     bool Database::routerExists(RouterHash const &routerHash)
     {
+        if(m_cache->contains(routerHash) || m_writer->get(routerHash))
+            return true;
+
         auto q = Database::queries["router_exists"];
         statement_guard sg(q, Base64::encode(routerHash));
 
@@ -148,153 +177,245 @@ namespace i2pcpp {
 
     RouterInfo Database::getRouterInfo(RouterHash const &routerHash)
     {
-        return getRouterInfo(Base64::encode(routerHash));
+        std::shared_ptr<const RouterInfo> ri = getRouterInfoPtr(routerHash);
+        if(!ri)
+            throw std::runtime_error("router not found");
+
+        return *ri;
     }
 
     RouterInfo Database::getRouterInfo(std::string const &routerHash)
     {
-        sqlite::transaction_guard<> t(*m_conn);
+        return getRouterInfo(toRouterHash(Base64::decode(routerHash)));
+    }
 
-        // *** First query
-        auto q1 = Database::queries["get_router"];
-        statement_guard sg1(q1, routerHash);
+    std::shared_ptr<const RouterInfo> Database::getRouterInfoPtr(RouterHash const &routerHash)
+    {
+        std::shared_ptr<const RouterInfo> ri = m_cache->get(routerHash);
+        if(ri)
+            return ri;
 
-        sqlite::row r1 = q1->step();
-        if(!r1)
-            throw std::runtime_error("router not found");
+        // Evicted from the cache before the writer thread got to it
+        ri = m_writer->get(routerHash);
+        if(ri)
+            return ri;
+
+        ri = loadRouterInfo(Base64::encode(routerHash));
+        if(ri)
+            m_cache->put(ri);
+
+        return ri;
+    }
+
+    Database::CacheStats Database::getCacheStats() const
+    {
+        RouterInfoCache::Stats s = m_cache->getStats();
 
-        std::string encryptionKeyStr, signingKeyStr, certificateStr, publishedStr, signatureStr;
-        r1 >> encryptionKeyStr >> signingKeyStr >> certificateStr >> publishedStr >> signatureStr;
-        ByteArray encryptionKey, signingKey, certificate, published, signature;
-
-        std::istringstream(encryptionKeyStr) >> encryptionKey;
-        std::istringstream(signingKeyStr) >> signingKey;
-        std::istringstream(certificateStr) >> certificate;
-        std::istringstream(publishedStr) >> published;
-        std::istringstream(signatureStr) >> signature;
-
-        // *** Second query
-        auto q2 = Database::queries["get_router_options"];
-        statement_guard sg2(q2, routerHash);
-
-        Mapping router_options;
-        while(auto r2 = q2->step()) {
-            std::string name, value;
-            r2 >> name >> value;
-            router_options.setValue(name, value);
+        return {s.hits, s.misses, s.evictions, s.entries, s.bytes};
+    }
+
+    std::shared_ptr<const RouterInfo> Database::loadRouterInfo(std::string const &routerHash)
+    {
+        auto q = Database::queries["get_router"];
+        statement_guard sg(q, routerHash);
+
+        sqlite::row r = q->step();
+        if(!r)
+            return std::shared_ptr<const RouterInfo>();
+
+        ByteArray data;
+        r >> data;
+
+        auto begin = data.cbegin();
+        return std::make_shared<const RouterInfo>(begin, data.cend());
+    }
+
+    void Database::loadDirectory()
+    {
+        auto q = m_conn->make_query("SELECT id, data FROM routers");
+
+        while(auto r = q->step()) {
+            std::string rhStr;
+            ByteArray data;
+            r >> rhStr >> data;
+
+            auto begin = data.cbegin();
+            m_directory->add(toRouterHash(Base64::decode(rhStr)), RouterInfo(begin, data.cend()));
         }
+    }
 
-        auto pubItr = published.cbegin();
-        auto pubEndItr = published.cend();
-        auto certItr = certificate.cbegin();
-        auto certEndItr = certificate.cend();
-        RouterInfo ri(RouterIdentity(encryptionKey, signingKey, Certificate(certItr, certEndItr)), Date(pubItr, pubEndItr), router_options, signature);
+    void Database::migrate()
+    {
+        int version;
+        {
+            auto q = m_conn->make_query("PRAGMA user_version");
+            q->step() >> version;
+        }
 
-        // *** Third query
-        auto q3 = Database::queries["get_router_addresses"];
-        statement_guard sg3(q3, routerHash);
+        if(version == SCHEMA_VERSION)
+            return;
 
-        while(auto r3 = q3->step()) {
-            int index, cost;
-            std::string expirationStr, transport;
+        if(version > SCHEMA_VERSION)
+            throw std::runtime_error("unsupported database schema version " + std::to_string(version));
 
-            r3 >> index >> cost >> expirationStr >> transport;
+        /* The tables are replaced rather than altered, so the foreign keys of
+         * the profiles must not cascade while the old routers table is gone.
+         */
+        m_conn->exec("PRAGMA foreign_keys=OFF");
 
-            ByteArray expiration;
-            std::istringstream(expirationStr) >> expiration;
+        try {
+            sqlite::transaction_guard<> t(*m_conn);
 
-            // *** Fourth query
-            auto q4 = Database::queries["router_address_options"];
-            statement_guard sg4(q4, routerHash, index);
+            i2p_logger_mt log(boost::log::keywords::channel = "DB");
 
-            Mapping address_options;
-            while(auto r4 = q4->step()) {
-                std::string name, value;
-                r4 >> name >> value;
-                address_options.setValue(name, value);
+            // Version 0 to 1: the RouterInfos are read in full before their tables are dropped
+            std::vector<RouterInfo> routers;
+            {
+                auto q1 = m_conn->make_query("SELECT id, encryption_key, signing_key, certificate, published, signature FROM routers");
+                auto q2 = m_conn->make_query("SELECT name, value FROM router_options WHERE router_id = ?");
+                auto q3 = m_conn->make_query("SELECT \"index\", cost, expiration, transport FROM router_addresses WHERE router_id = ?");
+                auto q4 = m_conn->make_query("SELECT name, value FROM router_address_options WHERE router_id = ? AND \"index\" = ? ORDER BY name ASC");
+
+                while(auto r1 = q1->step()) {
+                    std::string routerHash;
+
+                    // A router that cannot be read back is dropped, not the whole migration
+                    try {
+                        // Version 0 bound these as blobs, so they are read back as such
+                        ByteArray encryptionKey, signingKey, certificate, published, signature;
+                        r1 >> routerHash >> encryptionKey >> signingKey >> certificate >> published >> signature;
+
+                        statement_guard sg2(q2, routerHash);
+
+                        Mapping router_options;
+                        while(auto r2 = q2->step()) {
+                            std::string name, value;
+                            r2 >> name >> value;
+                            router_options.setValue(name, value);
+                        }
+
+                        auto pubItr = published.cbegin();
+                        auto certItr = certificate.cbegin();
+                        RouterInfo ri(RouterIdentity(encryptionKey, signingKey, Certificate(certItr, certificate.cend())), Date(pubItr, published.cend()), router_options, signature);
+
+                        statement_guard sg3(q3, routerHash);
+
+                        while(auto r3 = q3->step()) {
+                            int index, cost;
+                            ByteArray expiration;
+                            std::string transport;
+
+                            r3 >> index >> cost >> expiration >> transport;
+
+                            statement_guard sg4(q4, routerHash, index);
+
+                            Mapping address_options;
+                            while(auto r4 = q4->step()) {
+                                std::string name, value;
+                                r4 >> name >> value;
+                                address_options.setValue(name, value);
+                            }
+
+                            auto expItr = expiration.cbegin();
+                            ri.addAddress(RouterAddress(cost, Date(expItr, expiration.cend()), transport, address_options));
+                        }
+
+                        routers.push_back(ri);
+                    } catch(std::exception &e) {
+                        I2P_LOG(log, warning) << "skipping router " << routerHash << " which could not be migrated: " << e.what();
+                    }
+                }
             }
 
-            auto expItr = expiration.cbegin();
-            auto expEndItr = expiration.cend();
-            RouterAddress ra(cost, Date(expItr, expEndItr), transport, address_options);
-            ri.addAddress(ra);
-        }
+            m_conn->exec("DROP TABLE IF EXISTS router_address_options");
+            m_conn->exec("DROP TABLE IF EXISTS router_addresses");
+            m_conn->exec("DROP TABLE IF EXISTS router_options");
+            m_conn->exec("DROP TABLE IF EXISTS routers");
 
-        t.commit();
+            createTables(*m_conn);
 
-        return ri;
+            auto insert = DatabaseWriter::prepareInsert(*m_conn);
+            for(auto& r: routers)
+                DatabaseWriter::insert(insert, r);
+
+            m_conn->exec("DELETE FROM profiles WHERE router_id NOT IN (SELECT id FROM routers)");
+            m_conn->exec("PRAGMA user_version = " + std::to_string(SCHEMA_VERSION));
+
+            t.commit();
+        } catch(...) {
+            m_conn->exec("PRAGMA foreign_keys=ON");
+            throw;
+        }
+
+        m_conn->exec("PRAGMA foreign_keys=ON");
     }
 
     void Database::deleteRouter(RouterHash const &rh)
     {
+        m_writer->cancel(rh);
+        m_writer->flush();
+
         sqlite::transaction_guard<> t(*m_conn);
 
-        statement_guard sg1(Database::commands["delete_profile"], rh, sqlite::exec);
-        statement_guard sg2(Database::commands["delete_router_address_options"], rh, sqlite::exec);
-        statement_guard sg3(Database::commands["delete_router_addresses"], rh, sqlite::exec);
-        statement_guard sg4(Database::commands["delete_router_options"], rh, sqlite::exec);
-        statement_guard sg5(Database::commands["delete_router"], rh, sqlite::exec);
+        std::string id = Base64::encode(rh);
+
+        statement_guard sg1(Database::commands["delete_profile"], id, sqlite::exec);
+        statement_guard sg2(Database::commands["delete_router"], id, sqlite::exec);
 
         t.commit();
+
+        m_cache->invalidate(rh);
+        m_directory->remove(rh);
     }
 
     void Database::deleteAllRouters()
     {
+        m_writer->flush();
+
         sqlite::transaction_guard<> t(*m_conn);
 
         statement_guard sg1(Database::commands["truncate_profiles"], sqlite::exec);
-        statement_guard sg2(Database::commands["truncate_router_address_options"], sqlite::exec);
-        statement_guard sg3(Database::commands["truncate_router_addresses"], sqlite::exec);
-        statement_guard sg4(Database::commands["truncate_router_options"], sqlite::exec);
-        statement_guard sg5(Database::commands["truncate_router_options"], sqlite::exec);
+        statement_guard sg2(Database::commands["truncate_routers"], sqlite::exec);
 
         t.commit();
+
+        m_cache->clear();
+        m_directory->clear();
     }
 
     void Database::setRouterInfo(std::vector<RouterInfo> const &routers)
     {
-        sqlite::transaction_guard<> t(*m_conn);
-
         for(auto& r: routers)
-            setRouterInfo(r);
+            queueRouterInfo(r);
 
-        t.commit();
+        if(!m_writer->flush())
+            throw std::runtime_error("could not write RouterInfos");
     }
 
     void Database::setRouterInfo(RouterInfo const &info)
     {
-        sqlite::recursive_transaction t(*m_conn);
-
-        t.begin();
-
-        std::string rh = Base64::encode(info.getIdentity().getHash());
-
-        const ByteArray& encKey = info.getIdentity().getEncryptionKey();
-        const ByteArray& sigKey = info.getIdentity().getSigningKey();
-        const ByteArray& cert   = info.getIdentity().getCertificate().serialize();
-        const ByteArray& pub    = info.getPublished().serialize();
-        const ByteArray& sig    = info.getSignature();
-
-        statement_guard sg1(Database::commands["insert_router"], rh, encKey, sigKey, cert, pub, sig, sqlite::exec);
+        queueRouterInfo(info);
 
-        int i = 0;
-        for(auto& a: info) {
-            std::string istr = std::to_string(i);
-            statement_guard sg2(Database::commands["insert_router_address"], rh, istr, (int)a.getCost(), a.getExpiration().serialize(), a.getTransport(), sqlite::exec);
+        if(!m_writer->flush())
+            throw std::runtime_error("could not write RouterInfo");
+    }
 
-            for(auto& o: a.getOptions())
-                statement_guard sg3(Database::commands["insert_router_address_option"], rh, istr, o.first, o.second, sqlite::exec);
-            i++;
-        }
+    void Database::queueRouterInfo(RouterInfo const &info)
+    {
+        // Every stored router is in the directory, which refuses older copies
+        if(!m_directory->add(info.getIdentity().getHash(), info))
+            return;
 
-        for(auto& o: info.getOptions())
-            statement_guard sg4(Database::commands["insert_router_option"], rh, o.first, o.second, sqlite::exec);
+        auto ri = std::make_shared<const RouterInfo>(info);
 
-        t.commit();
+        m_cache->put(ri);
+        m_writer->queue(ri);
     }
 
     std::forward_list<RouterHash> Database::getAllHashes()
     {
+        m_writer->flush();
+
         std::forward_list<RouterHash> hashes;
 
         auto q = m_conn->make_query("SELECT id FROM routers");
@@ -0,0 +1,237 @@
+/**
+ * @file DatabaseWriter.cpp
+ * @brief Implements DatabaseWriter.h
+ */
+#include "DatabaseWriter.h"
+
+#include "sqlite3cc.h"
+#include "statement_guard.h"
+
+#include <i2pcpp/util/Base64.h>
+#include <i2pcpp/util/make_unique.h>
+
+#include <i2pcpp/datatypes/RouterInfo.h>
+
+#include <algorithm>
+
+namespace i2pcpp {
+    DatabaseWriter::DatabaseWriter(std::string const &file, std::chrono::milliseconds interval, std::size_t batchSize) :
+        m_interval(interval),
+        m_batchSize(batchSize),
+        m_log(boost::log::keywords::channel = "DBW")
+    {
+        try {
+            m_conn = std::make_unique<sqlite::connection>(file);
+            m_conn->exec("PRAGMA foreign_keys=ON");
+            m_conn->exec("PRAGMA synchronous=OFF");
+            m_conn->exec("PRAGMA busy_timeout=5000");
+        } catch(sqlite::sqlite_error &e) {
+            throw std::runtime_error("could not open database");
+        }
+
+        m_insert = prepareInsert(*m_conn);
+
+        m_thread = std::thread(&DatabaseWriter::run, this);
+    }
+
+    DatabaseWriter::~DatabaseWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+
+        m_queuedCondition.notify_one();
+        m_thread.join();
+    }
+
+    void DatabaseWriter::queue(RouterInfoPtr const &ri)
+    {
+        const RouterHash rh = ri->getIdentity().getHash();
+        ByteArray published = ri->getPublished().serialize();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            ++m_numQueued;
+
+            if(m_queued.empty())
+                m_oldest = std::chrono::steady_clock::now();
+
+            auto itr = m_queued.find(rh);
+            if(itr != m_queued.end()) {
+                if(itr->second.published < published)
+                    itr->second = {ri, std::move(published)};
+
+                return;
+            }
+
+            m_queued[rh] = {ri, std::move(published)};
+
+            if(m_queued.size() < m_batchSize)
+                return;
+        }
+
+        m_queuedCondition.notify_one();
+    }
+
+    DatabaseWriter::RouterInfoPtr DatabaseWriter::get(RouterHash const &rh) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto itr = m_queued.find(rh);
+        if(itr != m_queued.end())
+            return itr->second.info;
+
+        itr = m_writing.find(rh);
+        if(itr != m_writing.end())
+            return itr->second.info;
+
+        return RouterInfoPtr();
+    }
+
+    void DatabaseWriter::cancel(RouterHash const &rh)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_queued.erase(rh);
+    }
+
+    bool DatabaseWriter::flush()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        const uint64_t written = m_numWritten;
+        const uint64_t target = m_numQueued;
+        if(target > m_flushTarget)
+            m_flushTarget = target;
+
+        ++m_numFlushing;
+
+        m_queuedCondition.notify_one();
+        m_writtenCondition.wait(lock, [this, target]() { return m_numWritten >= target; });
+
+        // Only the batches between the two counters held what we waited for
+        bool success = std::none_of(m_failedBatches.cbegin(), m_failedBatches.cend(), [written, target](std::pair<uint64_t, uint64_t> const &b) {
+            return b.first < target && b.second > written;
+        });
+
+        if(--m_numFlushing == 0)
+            m_failedBatches.clear();
+
+        return success;
+    }
+
+    boost::signals2::connection DatabaseWriter::registerFailed(Failed::slot_type const &handler)
+    {
+        return m_failed.connect(handler);
+    }
+
+    boost::shared_ptr<sqlite::command> DatabaseWriter::prepareInsert(sqlite::connection &conn)
+    {
+        // Copies queued out of order by different threads must not replace a newer row
+        return conn.make_command("INSERT OR REPLACE INTO routers(id, published, caps, floodfill, reachable, data) "
+                "SELECT ?1, ?2, ?3, ?4, ?5, ?6 WHERE NOT EXISTS (SELECT 1 FROM routers WHERE id = ?1 AND published > ?2)");
+    }
+
+    void DatabaseWriter::insert(boost::shared_ptr<sqlite::command> const &insert, RouterInfo const &info)
+    {
+        const std::string caps = info.getOptions().getValue("caps");
+
+        // Dates are serialized as big endian milliseconds since the epoch
+        const ByteArray pub = info.getPublished().serialize();
+        int64_t published = 0;
+        for(auto b: pub)
+            published = (published << 8) | b;
+
+        statement_guard sg(insert,
+                Base64::encode(info.getIdentity().getHash()),
+                published,
+                caps,
+                (int)(caps.find('f') != std::string::npos),
+                (int)(caps.find('R') != std::string::npos),
+                info.serialize(),
+                sqlite::exec);
+    }
+
+    void DatabaseWriter::run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        while(true) {
+            if(m_queued.empty()) {
+                /* Everything queued was either written or cancelled, which
+                 * flush() must not wait for either.
+                 */
+                m_numWritten = m_numQueued;
+                m_writtenCondition.notify_all();
+
+                if(m_stop)
+                    break;
+
+                m_queuedCondition.wait(lock, [this]() { return m_stop || !m_queued.empty(); });
+                continue;
+            }
+
+            m_queuedCondition.wait_until(lock, m_oldest + m_interval, [this]() {
+                return m_stop || m_queued.size() >= m_batchSize || m_flushTarget > m_numWritten;
+            });
+
+            if(m_queued.empty())
+                continue;
+
+            const uint64_t numWritten = m_numWritten;
+            const uint64_t numQueued = m_numQueued;
+            m_writing.swap(m_queued);
+
+            lock.unlock();
+            const bool success = write(m_writing);
+            lock.lock();
+
+            std::vector<RouterHash> failed;
+            if(!success) {
+                for(auto& e: m_writing)
+                    if(!m_queued.count(e.first))
+                        failed.push_back(e.first);
+            }
+
+            m_writing.clear();
+
+            // Those waiting for the batch learn of the failure after the handlers ran
+            if(!failed.empty()) {
+                lock.unlock();
+                for(auto& rh: failed)
+                    m_failed(rh);
+                lock.lock();
+            }
+
+            if(!success && m_numFlushing)
+                m_failedBatches.emplace_back(numWritten, numQueued);
+
+            m_numWritten = numQueued;
+            m_writtenCondition.notify_all();
+        }
+    }
+
+    bool DatabaseWriter::write(std::unordered_map<RouterHash, Entry> const &batch)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        try {
+            sqlite::transaction_guard<> t(*m_conn);
+
+            for(auto& e: batch)
+                insert(m_insert, *e.second.info);
+
+            t.commit();
+        } catch(std::exception &e) {
+            I2P_LOG(m_log, error) << "failed to write " << batch.size() << " RouterInfos: " << e.what();
+            return false;
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        I2P_LOG(m_log, debug) << "wrote " << batch.size() << " RouterInfos in " << elapsed.count() << "ms";
+
+        return true;
+    }
+}
@@ -0,0 +1,152 @@
+/**
+ * @file DatabaseWriter.h
+ * @brief Defines the i2pcpp::DatabaseWriter class.
+ */
+#ifndef DATABASEWRITER_H
+#define DATABASEWRITER_H
+
+#include <i2pcpp/Log.h>
+
+#include <i2pcpp/datatypes/ByteArray.h>
+#include <i2pcpp/datatypes/RouterHash.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/signals2.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace sqlite {
+    class connection;
+    class command;
+}
+
+namespace i2pcpp {
+    class RouterInfo;
+
+    /**
+     * Writes i2pcpp::RouterInfo objects to the database on a thread of its
+     *  own, over a connection of its own. Queued objects are written in one
+     *  transaction once \a batchSize of them are queued or the oldest has
+     *  waited \a interval. Objects queued for a router that is still queued
+     *  replace it, if they were published later, and a stored object is
+     *  never replaced by one published earlier.
+     * @note the class is designed to be thread-safe
+     */
+    class DatabaseWriter {
+        public:
+            typedef std::shared_ptr<const RouterInfo> RouterInfoPtr;
+
+            /**
+             * Signal invoked, on the writer thread, for each router whose
+             *  i2pcpp::RouterInfo could not be written. Routers queued again
+             *  in the meantime are left out, as they will be written with the
+             *  next batch.
+             */
+            typedef boost::signals2::signal<void(const RouterHash)> Failed;
+
+            /**
+             * Opens a connection to the database \a file and starts the
+             *  writer thread.
+             */
+            DatabaseWriter(std::string const &file, std::chrono::milliseconds interval, std::size_t batchSize);
+            DatabaseWriter(const DatabaseWriter &) = delete;
+            DatabaseWriter& operator=(DatabaseWriter &) = delete;
+
+            /**
+             * Writes the remaining objects and stops the writer thread.
+             */
+            ~DatabaseWriter();
+
+            /**
+             * Queues \a ri to be written.
+             */
+            void queue(RouterInfoPtr const &ri);
+
+            /**
+             * @return the i2pcpp::RouterInfo of \a rh if it has been queued
+             *  but not yet written, or a null pointer
+             */
+            RouterInfoPtr get(RouterHash const &rh) const;
+
+            /**
+             * Removes \a rh from the queue. It may still be written if the
+             *  writer thread has already taken it; flush() waits for that.
+             */
+            void cancel(RouterHash const &rh);
+
+            /**
+             * Waits until everything queued so far has been written.
+             * @return false if any of it could not be written
+             */
+            bool flush();
+
+            /**
+             * Registers an i2pcpp::DatabaseWriter::Failed signal handler.
+             */
+            boost::signals2::connection registerFailed(Failed::slot_type const &handler);
+
+            /**
+             * Prepares the statement which stores an i2pcpp::RouterInfo on
+             *  \a conn.
+             */
+            static boost::shared_ptr<sqlite::command> prepareInsert(sqlite::connection &conn);
+
+            /**
+             * Stores \a info and the columns derived from it with \a insert,
+             *  a statement from prepareInsert, unless a copy published later
+             *  is stored.
+             */
+            static void insert(boost::shared_ptr<sqlite::command> const &insert, RouterInfo const &info);
+
+        private:
+            struct Entry {
+                RouterInfoPtr info;
+                ByteArray published; ///< Serialized i2pcpp::Date, compares chronologically
+            };
+
+            void run();
+
+            /**
+             * Writes \a batch in a single transaction.
+             * @return false if the transaction failed
+             */
+            bool write(std::unordered_map<RouterHash, Entry> const &batch);
+
+            std::chrono::milliseconds m_interval;
+            std::size_t m_batchSize;
+
+            std::shared_ptr<sqlite::connection> m_conn;
+            boost::shared_ptr<sqlite::command> m_insert;
+
+            std::unordered_map<RouterHash, Entry> m_queued;
+            std::unordered_map<RouterHash, Entry> m_writing; ///< Taken by the writer thread
+            std::chrono::steady_clock::time_point m_oldest; ///< When the oldest entry of m_queued was queued
+
+            uint64_t m_numQueued = 0; ///< Calls to queue() so far
+            uint64_t m_numWritten = 0; ///< Calls to queue() whose objects have been written
+            uint64_t m_flushTarget = 0; ///< m_numWritten that flush() waits for
+            unsigned m_numFlushing = 0; ///< Calls to flush() waiting
+
+            /// Batches that failed while flush() was waiting, as m_numWritten before and after them
+            std::vector<std::pair<uint64_t, uint64_t>> m_failedBatches;
+            bool m_stop = false;
+
+            mutable std::mutex m_mutex;
+            std::condition_variable m_queuedCondition;
+            std::condition_variable m_writtenCondition;
+
+            Failed m_failed;
+
+            i2p_logger_mt m_log;
+
+            std::thread m_thread;
+    };
+}
+
+#endif
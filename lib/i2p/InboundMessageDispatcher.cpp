@@ -7,16 +7,11 @@
 #include "RouterContext.h"
 
 #include "i2np/DeliveryStatus.h"
-#include "i2np/DatabaseStore.h"
-
-#include <i2pcpp/util/gzip.h>
-#include <i2pcpp/datatypes/RouterInfo.h>
 
 #include <boost/bind.hpp>
 #include <boost/asio.hpp>
 
 #include <botan/auto_rng.h>
-#include <botan/pipe.h>
 
 #include <iomanip>
 
@@ -26,6 +21,7 @@ namespace i2pcpp {
         m_ctx(ctx),
         m_deliveryStatusHandler(ctx),
         m_dbStoreHandler(ctx),
+        m_dbLookupHandler(ctx),
         m_dbSearchReplyHandler(ctx),
         m_variableTunnelBuildHandler(ctx),
         m_variableTunnelBuildReplyHandler(ctx),
@@ -33,56 +29,68 @@ namespace i2pcpp {
         m_tunnelGatewayHandler(ctx),
         m_log(boost::log::keywords::channel = "IMD") {}
 
-    void InboundMessageDispatcher::messageReceived(RouterHash const from, uint32_t const msgId, ByteArray data)
+    void InboundMessageDispatcher::messageReceived(RouterHash const from, uint32_t const msgId, ByteArray &data)
     {
         I2P_LOG_SCOPED_TAG(m_log, "RouterHash", from);
 
         I2P_LOG(m_log, debug) << "received data: " << data;
 
+        m_ctx.getProfileManager().dataReceived(from, data.size());
+
         I2NP::MessagePtr m;
         if(msgId)
-            m = I2NP::Message::fromBytes(msgId, data, false);
+            m = I2NP::Message::fromBytes(msgId, std::move(data), false);
         else
-            m = I2NP::Message::fromBytes(0, data);
-
-        if(m) {
-            switch(m->getType())
-            {
-                case I2NP::Message::Type::DELIVERY_STATUS:
-                    m_ios.post(boost::bind(&Handlers::Message::handleMessage, m_deliveryStatusHandler, from, m));
-                    break;
-
-                case I2NP::Message::Type::DB_STORE:
-                    m_ios.post(boost::bind(&Handlers::Message::handleMessage, m_dbStoreHandler, from, m));
-                    break;
-
-                case I2NP::Message::Type::DB_SEARCH_REPLY:
-                    m_ios.post(boost::bind(&Handlers::Message::handleMessage, m_dbSearchReplyHandler, from, m));
-                    break;
-
-                case I2NP::Message::Type::VARIABLE_TUNNEL_BUILD:
-                    m_ios.post(boost::bind(&Handlers::Message::handleMessage, m_variableTunnelBuildHandler, from, m));
-                    break;
-
-                case I2NP::Message::Type::VARIABLE_TUNNEL_BUILD_REPLY:
-                    m_ios.post(boost::bind(&Handlers::Message::handleMessage, m_variableTunnelBuildReplyHandler, from, m));
-                    break;
-
-                case I2NP::Message::Type::TUNNEL_DATA:
-                    m_ios.post(boost::bind(&Handlers::Message::handleMessage, m_tunnelDataHandler, from, m));
-                    break;
-
-                case I2NP::Message::Type::TUNNEL_GATEWAY:
-                    m_ios.post(boost::bind(&Handlers::Message::handleMessage, m_tunnelGatewayHandler, from, m));
-                    break;
-
-                case I2NP::Message::Type::GARLIC:
-                    break;
-
-                default:
-                    I2P_LOG(m_log, error) << "dropping unhandled message of type " << (int)m->getType();
-                    break;
-            }
+            m = I2NP::Message::fromBytes(0, std::move(data));
+
+        if(m)
+            dispatch(from, m);
+    }
+
+    void InboundMessageDispatcher::dispatch(RouterHash const from, I2NP::MessagePtr const &m)
+    {
+        I2P_LOG_SCOPED_TAG(m_log, "RouterHash", from);
+
+        switch(m->getType())
+        {
+            case I2NP::Message::Type::DELIVERY_STATUS:
+                m_ios.post(boost::bind(&Handlers::Message::handleMessage, m_deliveryStatusHandler, from, m));
+                break;
+
+            case I2NP::Message::Type::DB_STORE:
+                m_ios.post(boost::bind(&Handlers::Message::handleMessage, m_dbStoreHandler, from, m));
+                break;
+
+            case I2NP::Message::Type::DB_LOOKUP:
+                m_ios.post(boost::bind(&Handlers::Message::handleMessage, m_dbLookupHandler, from, m));
+                break;
+
+            case I2NP::Message::Type::DB_SEARCH_REPLY:
+                m_ios.post(boost::bind(&Handlers::Message::handleMessage, m_dbSearchReplyHandler, from, m));
+                break;
+
+            case I2NP::Message::Type::VARIABLE_TUNNEL_BUILD:
+                m_ios.post(boost::bind(&Handlers::Message::handleMessage, m_variableTunnelBuildHandler, from, m));
+                break;
+
+            case I2NP::Message::Type::VARIABLE_TUNNEL_BUILD_REPLY:
+                m_ios.post(boost::bind(&Handlers::Message::handleMessage, m_variableTunnelBuildReplyHandler, from, m));
+                break;
+
+            case I2NP::Message::Type::TUNNEL_DATA:
+                m_ios.post(boost::bind(&Handlers::Message::handleMessage, m_tunnelDataHandler, from, m));
+                break;
+
+            case I2NP::Message::Type::TUNNEL_GATEWAY:
+                m_ios.post(boost::bind(&Handlers::Message::handleMessage, m_tunnelGatewayHandler, from, m));
+                break;
+
+            case I2NP::Message::Type::GARLIC:
+                break;
+
+            default:
+                I2P_LOG(m_log, error) << "dropping unhandled message of type " << (int)m->getType();
+                break;
         }
     }
 
@@ -99,35 +107,7 @@ namespace i2pcpp {
             I2NP::MessagePtr m(new I2NP::DeliveryStatus(msgId, Date(2)));
             m_ctx.getOutMsgDisp().sendMessage(rh, m);
 
-            // TODO Get this out of here
-            Mapping am;
-            am.setValue("caps", "BC");
-            am.setValue("host", m_ctx.getDatabase()->getConfigValue("ssu_external_ip"));
-            am.setValue("key", Base64::encode(m_ctx.getIdentity()->getHash()));
-            am.setValue("port", m_ctx.getDatabase()->getConfigValue("ssu_external_port"));
-            RouterAddress a(5, Date(0), "SSU", am);
-
-            Mapping rm;
-            rm.setValue("coreVersion", "0.9.11");
-            rm.setValue("netId", "2");
-            rm.setValue("router.version", "0.9.11");
-            rm.setValue("stat_uptime", "90m");
-            rm.setValue("caps", "OR");
-            RouterInfo myInfo(*m_ctx.getIdentity(), Date(), rm);
-            myInfo.addAddress(a);
-            myInfo.sign(m_ctx.getSigningKey());
-
-            Botan::Pipe gzPipe(new Gzip_Compression);
-            gzPipe.start_msg();
-            gzPipe.write(myInfo.serialize());
-            gzPipe.end_msg();
-
-            unsigned int size = gzPipe.remaining();
-            ByteArray gzInfoBytes(size);
-            gzPipe.read(gzInfoBytes.data(), size);
-
-            auto mydsm = std::make_shared<I2NP::DatabaseStore>(myInfo.getIdentity().getHash(), I2NP::DatabaseStore::DataType::ROUTER_INFO, 0, gzInfoBytes);
-            m_ctx.getOutMsgDisp().sendMessage(rh, mydsm);
+            m_ctx.getOutMsgDisp().sendMessage(rh, m_ctx.createRouterInfoStore());
         }
 
         m_ctx.getSignals().invokePeerConnected(rh);
@@ -7,6 +7,7 @@
 
 #include "handlers/DeliveryStatus.h"
 #include "handlers/DatabaseStore.h"
+#include "handlers/DatabaseLookup.h"
 #include "handlers/DatabaseSearchReply.h"
 #include "handlers/VariableTunnelBuild.h"
 #include "handlers/VariableTunnelBuildReply.h"
@@ -37,9 +38,17 @@ namespace i2pcpp {
              * Called whenever an i2pcpp::Transport receives a message.
              * @param from the i2pcpp::RouterHash of the sending router
              * @param msgId the ID of the original outbound message
-             * @param data the actual received data
+             * @param data the actual received data, which may be moved from
              */
-            void messageReceived(RouterHash const from, uint32_t const msgId, ByteArray data);
+            void messageReceived(RouterHash const from, uint32_t const msgId, ByteArray &data);
+
+            /**
+             * Dispatches a message which has already been parsed, such as one
+             *  delivered to us through one of our own tunnels.
+             * @param from the i2pcpp::RouterHash of the router the message came from
+             * @param msg the message
+             */
+            void dispatch(RouterHash const from, I2NP::MessagePtr const &msg);
 
             /**
              * Called when a connection with a router has been established.
@@ -61,6 +70,7 @@ namespace i2pcpp {
 
             Handlers::DeliveryStatus m_deliveryStatusHandler;
             Handlers::DatabaseStore m_dbStoreHandler;
+            Handlers::DatabaseLookup m_dbLookupHandler;
             Handlers::DatabaseSearchReply m_dbSearchReplyHandler;
             Handlers::VariableTunnelBuild m_variableTunnelBuildHandler;
             Handlers::VariableTunnelBuildReply m_variableTunnelBuildReplyHandler;
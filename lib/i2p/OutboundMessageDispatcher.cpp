@@ -21,7 +21,7 @@ namespace i2pcpp {
 
         if(to == m_ctx.getIdentity()->getHash()) {
             I2P_LOG(m_log, debug) << "message is for myself, sending to IMD";
-            m_ctx.getInMsgDisp().messageReceived(to, msg->getMsgId(), msg->toBytes(false));
+            m_ctx.getInMsgDisp().dispatch(to, msg);
             return;
         }
 
@@ -33,10 +33,15 @@ namespace i2pcpp {
             I2P_LOG(m_log, debug) << "not connected, queueing message";
 
             std::lock_guard<std::mutex> lock(m_mutex);
+            bool attempting = m_pending.count(to) > 0;
             m_pending.insert(MapType::value_type(to, msg));
 
-            if(m_ctx.getDatabase()->routerExists(to))
-                m_transport->connect(m_ctx.getDatabase()->getRouterInfo(to));
+            if(attempting)
+                return;
+
+            auto ri = m_ctx.getDatabase()->getRouterInfoPtr(to);
+            if(ri)
+                m_transport->connect(*ri);
             else {
                 I2P_LOG(m_log, debug) << "RouterInfo not in DB, creating search job";
                 bool result = m_ctx.getDHT()->lookup(to);
@@ -69,6 +74,20 @@ namespace i2pcpp {
             // Short header, as above
             m_transport->send(itr->first, itr->second->getMsgId(), itr->second->toBytes(false));
         }
+
+        m_pending.erase(bucket.first, bucket.second);
+    }
+
+    void OutboundMessageDispatcher::connectionFailure(RouterHash const rh)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if(m_pending.count(rh)) {
+            I2P_LOG_SCOPED_TAG(m_log, "RouterHash", rh);
+            I2P_LOG(m_log, debug) << "connection failed, tossing queued messages";
+
+            m_pending.erase(rh);
+        }
     }
 
     void OutboundMessageDispatcher::dhtSuccess(DHT::Kademlia::key_type const k, DHT::Kademlia::value_type const v)
@@ -79,7 +98,9 @@ namespace i2pcpp {
             I2P_LOG_SCOPED_TAG(m_log, "RouterHash", v);
             I2P_LOG(m_log, debug) << "DHT lookup succeeded, connecting to peer";
 
-            m_transport->connect(m_ctx.getDatabase()->getRouterInfo(v));
+            auto ri = m_ctx.getDatabase()->getRouterInfoPtr(v);
+            if(ri)
+                m_transport->connect(*ri);
         }
     }
 
@@ -39,6 +39,8 @@ namespace i2pcpp {
              * Sends (dispatches) a message to the transport object.
              * If there is currently no connection with the router given by
              *  \a to, queues the message for sending and preforms a DHT lookup.
+             *  Only the first message queued for a router starts a connection
+             *  attempt or lookup; later ones wait for its outcome.
              * @param to the i2pcpp::RouterHash of the router to send the
              *  message to
              * @param msg pointer the i2pcpp::I2NP::Message to send
@@ -65,6 +67,12 @@ namespace i2pcpp {
              */
             void connected(RouterHash const rh);
 
+            /**
+             * Called when connecting to the router given by \a rh failed.
+             * Removes all of the pending (queued) messages for that router.
+             */
+            void connectionFailure(RouterHash const rh);
+
             /**
              * Called when the DHT lookup was succesful.
              * Tries to connect to the value that was extracted from the DHT.
@@ -5,6 +5,7 @@
 #include "PeerManager.h"
 
 #include "RouterContext.h"
+#include "RouterDirectory.h"
 
 #include "i2np/DeliveryStatus.h"
 
@@ -24,16 +25,17 @@ namespace i2pcpp {
 
     void PeerManager::connected(const RouterHash rh)
     {
-        // TODO Ding the peer's profile
+        m_ctx.getProfileManager().connected(rh);
     }
 
     void PeerManager::failure(const RouterHash rh)
     {
-        // TODO Ding the peer's profile
+        m_ctx.getProfileManager().connectionFailed(rh);
     }
 
     void PeerManager::disconnected(const RouterHash rh)
     {
+        m_ctx.getProfileManager().disconnected(rh);
     }
 
     void PeerManager::callback(const boost::system::error_code &e)
@@ -44,9 +46,26 @@ namespace i2pcpp {
 
             I2P_LOG(m_log, debug) << "current number of peers: " << numPeers;
 
+            Database::CacheStats cs = m_ctx.getDatabase()->getCacheStats();
+            I2P_LOG(m_log, debug) << "RouterInfo cache: " << cs.entries << " entries (" << cs.bytes << " bytes), "
+                                  << cs.hits << " hits, " << cs.misses << " misses, " << cs.evictions << " evictions";
+
+            // Only routers with an SSU address can be connected to
+            const RouterHash self = m_ctx.getIdentity()->getHash();
+            std::unordered_set<RouterHash> picked = {self};
+            RouterDirectory &dir = m_ctx.getDatabase()->getDirectory();
+
+            // We may be in the index ourselves, but are never picked
+            const std::size_t available = dir.size(RouterDirectory::SSU) - dir.contains(self, RouterDirectory::SSU);
+
             int32_t gap = minPeers - numPeers;
-            for(int32_t i = 0; i < gap; i++)
-                m_ctx.getOutMsgDisp().getTransport()->connect(m_ctx.getProfileManager().getPeer());
+            for(int32_t i = 0; i < gap && (std::size_t)i < available; i++) {
+                RouterHash rh = dir.pickWeighted(RouterDirectory::SSU, picked);
+                picked.insert(rh);
+
+                if(!m_ctx.getOutMsgDisp().getTransport()->isConnected(rh))
+                    m_ctx.getOutMsgDisp().getTransport()->connect(m_ctx.getDatabase()->getRouterInfo(rh));
+            }
 
         } catch(std::exception &e) {
                 I2P_LOG(m_log, error) << "exception in PeerManager: " << e.what();
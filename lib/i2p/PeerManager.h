@@ -57,7 +57,8 @@ namespace i2pcpp {
             /**
              * Called when the deadline timer expires.
              * Logs the number of peers.
-             * Tries to connect to \a n random known peers, where \a n is the
+             * Tries to connect to \a n random known peers with an SSU
+             *  address, favouring higher bandwidth classes, where \a n is the
              *  difference between the maximum amount of peers and the current
              *  amount.
              * The deadline duration is set to 10 seconds.
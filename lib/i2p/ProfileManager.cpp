@@ -5,15 +5,406 @@
 #include "ProfileManager.h"
 
 #include "RouterContext.h"
+#include "RouterDirectory.h"
 
+#include <i2pcpp/util/BufferedRNG.h>
 #include <i2pcpp/datatypes/RouterInfo.h>
 
+#include <algorithm>
+
 namespace i2pcpp {
-    ProfileManager::ProfileManager(RouterContext &ctx) :
-        m_ctx(ctx) {}
+    /**
+     * Shared by all selections. Constructed on first use, after Botan has
+     * been initialized.
+     */
+    static BufferedRNG& rng()
+    {
+        static BufferedRNG r;
+        return r;
+    }
+
+    ProfileManager::ProfileManager(boost::asio::io_service &ios, RouterContext &ctx) :
+        m_ctx(ctx),
+        m_fastTierSize(std::stoi(ctx.getDatabase()->getConfigValue("fast_tier_size", "30"))),
+        m_highCapacityTierSize(std::stoi(ctx.getDatabase()->getConfigValue("high_capacity_tier_size", "75"))),
+        m_timer(ios),
+        m_log(boost::log::keywords::channel = "PRM") {}
+
+    void ProfileManager::begin()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_receivedMutex);
+            m_receivedSince = clock::now();
+        }
+
+        RouterDirectory &dir = m_ctx.getDatabase()->getDirectory();
+
+        // Subscribed first, so that no router added meanwhile is missed
+        m_addedConnection = dir.registerAdded(
+            boost::bind(&ProfileManager::routerAdded, this, _1)
+        );
+        m_removedConnection = dir.registerRemoved(
+            boost::bind(&ProfileManager::routerRemoved, this, _1)
+        );
+
+        {
+            std::lock_guard<std::mutex> lock(m_profilesMutex);
+
+            for(auto& h: dir.getAll())
+                add(h);
+
+            I2P_LOG(m_log, debug) << "loaded " << m_profiles.size() << " peers";
+        }
+
+        reorganize();
+
+        m_timer.expires_from_now(boost::posix_time::seconds(45));
+        m_timer.async_wait(boost::bind(&ProfileManager::timerCallback, this, boost::asio::placeholders::error));
+    }
+
+    const RouterInfo ProfileManager::getPeer(Tier tier, bool preferConnected)
+    {
+        /* Picks are still weighted, so a connected peer is only favoured
+         * over peers of a similar score.
+         */
+        const std::size_t attempts = (preferConnected ? 8 : 1);
+
+        RouterHash peer;
+
+        {
+            std::lock_guard<std::mutex> lock(m_profilesMutex);
+
+            if(m_stale)
+                sort();
+
+            std::size_t t = (std::size_t)tier;
+            while(t < m_tiers.size() && m_tiers[t].peers.empty())
+                ++t;
+
+            // Every known peer is in one of the tiers
+            if(t == m_tiers.size())
+                throw std::runtime_error("no known peers");
+
+            std::array<uint64_t, 2 * 8> r;
+            rng().randomize((unsigned char *)r.data(), 2 * attempts * sizeof(uint64_t));
+
+            for(std::size_t i = 0; i < attempts; ++i) {
+                peer = m_tiers[t].pick(r[2 * i], r[2 * i + 1]);
+
+                if(m_profiles[peer].connected)
+                    break;
+            }
+        }
+
+        return m_ctx.getDatabase()->getRouterInfo(peer);
+    }
+
+    ProfileManager::Tier ProfileManager::getTier(RouterHash const &peer) const
+    {
+        std::lock_guard<std::mutex> lock(m_profilesMutex);
+
+        auto itr = m_profiles.find(peer);
+        if(itr == m_profiles.end())
+            return Tier::STANDARD;
+
+        return itr->second.tier;
+    }
+
+    void ProfileManager::connected(RouterHash const &peer)
+    {
+        std::lock_guard<std::mutex> lock(m_profilesMutex);
 
-    const RouterInfo ProfileManager::getPeer()
+        auto itr = m_profiles.find(peer);
+        if(itr == m_profiles.end())
+            return;
+
+        Profile &prof = itr->second;
+        if(!prof.connected) {
+            prof.connected = true;
+            prof.connectedSince = clock::now();
+        }
+    }
+
+    void ProfileManager::disconnected(RouterHash const &peer)
     {
-        return m_ctx.getDatabase()->getRouterInfo(m_ctx.getDatabase()->getRandomRouter());
+        std::lock_guard<std::mutex> lock(m_profilesMutex);
+
+        auto itr = m_profiles.find(peer);
+        if(itr == m_profiles.end())
+            return;
+
+        Profile &prof = itr->second;
+        if(prof.connected) {
+            prof.connected = false;
+            prof.uptime += clock::now() - prof.connectedSince;
+        }
+    }
+
+    void ProfileManager::connectionFailed(RouterHash const &peer)
+    {
+        std::lock_guard<std::mutex> lock(m_profilesMutex);
+
+        auto itr = m_profiles.find(peer);
+        if(itr != m_profiles.end())
+            ++itr->second.connectionFailures;
+    }
+
+    void ProfileManager::dataReceived(RouterHash const &peer, std::size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(m_receivedMutex);
+
+        m_received[peer] += bytes;
+    }
+
+    void ProfileManager::tunnelTestSucceeded(std::vector<RouterHash> const &peers, std::chrono::milliseconds latency)
+    {
+        std::lock_guard<std::mutex> lock(m_profilesMutex);
+
+        for(auto& p: peers) {
+            auto itr = m_profiles.find(p);
+            if(itr == m_profiles.end())
+                continue;
+
+            Profile &prof = itr->second;
+
+            // Exponentially weighted, so that recent tests count the most
+            if(prof.testsSucceeded)
+                prof.testLatency = (prof.testLatency * 3 + latency) / 4;
+            else
+                prof.testLatency = latency;
+
+            ++prof.testsSucceeded;
+        }
+    }
+
+    void ProfileManager::tunnelTestFailed(std::vector<RouterHash> const &peers)
+    {
+        std::lock_guard<std::mutex> lock(m_profilesMutex);
+
+        for(auto& p: peers) {
+            auto itr = m_profiles.find(p);
+            if(itr != m_profiles.end())
+                ++itr->second.testsFailed;
+        }
+    }
+
+    void ProfileManager::buildReplyReceived(RouterHash const &peer, bool accepted)
+    {
+        std::lock_guard<std::mutex> lock(m_profilesMutex);
+
+        auto itr = m_profiles.find(peer);
+        if(itr == m_profiles.end())
+            return;
+
+        Profile &prof = itr->second;
+        if(accepted)
+            ++prof.buildsAccepted;
+        else
+            ++prof.buildsRejected;
+    }
+
+    std::chrono::milliseconds ProfileManager::getTestLatency(RouterHash const &peer) const
+    {
+        std::lock_guard<std::mutex> lock(m_profilesMutex);
+
+        auto itr = m_profiles.find(peer);
+        if(itr == m_profiles.end())
+            return std::chrono::milliseconds(0);
+
+        return itr->second.testLatency;
+    }
+
+    void ProfileManager::routerAdded(RouterHash const peer)
+    {
+        std::lock_guard<std::mutex> lock(m_profilesMutex);
+        add(peer);
+    }
+
+    void ProfileManager::routerRemoved(RouterHash const peer)
+    {
+        std::lock_guard<std::mutex> lock(m_profilesMutex);
+
+        auto itr = m_profiles.find(peer);
+        if(itr == m_profiles.end())
+            return;
+
+        m_profiles.erase(itr);
+
+        // The tier tables are rebuilt before the next pick
+        m_stale = true;
+    }
+
+    void ProfileManager::add(RouterHash const &peer)
+    {
+        m_profiles[peer];
+    }
+
+    double ProfileManager::capacity(Profile const &p, clock::time_point now)
+    {
+        // Laplace smoothed, so that unknown peers start at one half
+        double builds = (p.buildsAccepted + 1.0) / (p.buildsAccepted + p.buildsRejected + 2.0);
+        double tests = (p.testsSucceeded + 1.0) / (p.testsSucceeded + p.testsFailed + 2.0);
+        double connections = 1.0 / (1.0 + p.connectionFailures);
+
+        clock::duration uptime = p.uptime;
+        if(p.connected)
+            uptime += now - p.connectedSince;
+        double hours = std::chrono::duration<double, std::ratio<3600>>(uptime).count();
+
+        return builds * tests * connections * (1.0 + std::min(hours, 1.0));
+    }
+
+    double ProfileManager::speed(Profile const &p)
+    {
+        double s = p.throughput / 1024.0;
+        if(p.testLatency.count())
+            s += 1000.0 / p.testLatency.count();
+
+        return s;
+    }
+
+    void ProfileManager::reorganize()
+    {
+        std::unordered_map<RouterHash, uint64_t> received;
+        std::chrono::duration<double> elapsed;
+
+        {
+            std::lock_guard<std::mutex> lock(m_receivedMutex);
+
+            const clock::time_point now = clock::now();
+            elapsed = now - m_receivedSince;
+            m_receivedSince = now;
+
+            received.swap(m_received);
+        }
+
+        std::lock_guard<std::mutex> lock(m_profilesMutex);
+
+        if(elapsed >= std::chrono::seconds(1)) {
+            for(auto& p: m_profiles) {
+                auto itr = received.find(p.first);
+                double rate = (itr != received.end() ? itr->second / elapsed.count() : 0);
+
+                Profile &prof = p.second;
+                prof.throughput = (prof.throughput ? (prof.throughput * 3 + rate) / 4 : rate);
+            }
+        }
+
+        sort();
+    }
+
+    void ProfileManager::sort()
+    {
+        const clock::time_point now = clock::now();
+
+        /* Only peers which have accepted at least one of our tunnels can be
+         * promoted. Of those, the ones with above median capacity are high
+         * capacity peers, and the fastest of them are fast peers.
+         */
+        std::vector<std::pair<double, RouterHash>> proven;
+        for(auto& p: m_profiles) {
+            p.second.tier = Tier::STANDARD;
+            if(p.second.buildsAccepted)
+                proven.push_back(std::make_pair(capacity(p.second, now), p.first));
+        }
+
+        auto byScore = [](std::pair<double, RouterHash> const &a, std::pair<double, RouterHash> const &b) { return a.first > b.first; };
+
+        std::sort(proven.begin(), proven.end(), byScore);
+        std::size_t numHigh = std::min((proven.size() + 1) / 2, m_highCapacityTierSize);
+
+        std::vector<std::pair<double, RouterHash>> high;
+        for(std::size_t i = 0; i < numHigh; ++i) {
+            Profile &prof = m_profiles[proven[i].second];
+            prof.tier = Tier::HIGH_CAPACITY;
+
+            double s = speed(prof);
+            if(s > 0)
+                high.push_back(std::make_pair(s, proven[i].second));
+        }
+
+        std::sort(high.begin(), high.end(), byScore);
+        std::size_t numFast = std::min((high.size() + 1) / 2, m_fastTierSize);
+        for(std::size_t i = 0; i < numFast; ++i)
+            m_profiles[high[i].second].tier = Tier::FAST;
+
+        /* Fast peers are weighted by speed, the others by capacity */
+        std::array<std::vector<double>, 3> weights;
+        for(auto& t: m_tiers)
+            t.peers.clear();
+
+        for(auto& p: m_profiles) {
+            Profile const &prof = p.second;
+            std::size_t t = (std::size_t)prof.tier;
+
+            m_tiers[t].peers.push_back(p.first);
+            weights[t].push_back(prof.tier == Tier::FAST ? speed(prof) : capacity(prof, now));
+        }
+
+        for(std::size_t t = 0; t < m_tiers.size(); ++t)
+            m_tiers[t].build(weights[t]);
+
+        m_stale = false;
+
+        I2P_LOG(m_log, debug) << "peer tiers: " << m_tiers[0].peers.size() << " fast, " << m_tiers[1].peers.size() << " high capacity, " << m_tiers[2].peers.size() << " standard";
+    }
+
+    void ProfileManager::timerCallback(const boost::system::error_code &e)
+    {
+        if(e == boost::asio::error::operation_aborted)
+            return;
+
+        reorganize();
+
+        m_timer.expires_at(m_timer.expires_at() + boost::posix_time::seconds(45));
+        m_timer.async_wait(boost::bind(&ProfileManager::timerCallback, this, boost::asio::placeholders::error));
+    }
+
+    void ProfileManager::TierTable::build(std::vector<double> const &weights)
+    {
+        /* Vose's alias method: every column of the table holds one peer's
+         * probability mass, topped up with mass from a single other peer.
+         */
+        const std::size_t n = weights.size();
+        probability.assign(n, 1.0);
+        alias.resize(n);
+        for(std::size_t i = 0; i < n; ++i)
+            alias[i] = i;
+
+        double total = 0;
+        for(double w: weights)
+            total += w;
+
+        if(total <= 0)
+            return;
+
+        std::vector<double> scaled(n);
+        std::vector<uint32_t> small, large;
+        for(std::size_t i = 0; i < n; ++i) {
+            scaled[i] = weights[i] * n / total;
+            (scaled[i] < 1.0 ? small : large).push_back(i);
+        }
+
+        while(!small.empty() && !large.empty()) {
+            uint32_t s = small.back(), l = large.back();
+            small.pop_back();
+
+            probability[s] = scaled[s];
+            alias[s] = l;
+
+            scaled[l] -= 1.0 - scaled[s];
+            if(scaled[l] < 1.0) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+    }
+
+    RouterHash const &ProfileManager::TierTable::pick(uint64_t r1, uint64_t r2) const
+    {
+        std::size_t i = r1 % peers.size();
+        double u = (r2 >> 11) * (1.0 / 9007199254740992.0);
+
+        return peers[(u < probability[i]) ? i : alias[i]];
     }
 }
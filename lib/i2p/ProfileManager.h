@@ -5,30 +5,227 @@
 #ifndef PROFILEMANAGER_H
 #define PROFILEMANAGER_H
 
+#include <i2pcpp/Log.h>
+
+#include <i2pcpp/datatypes/RouterHash.h>
+
+#include <boost/asio.hpp>
+#include <boost/signals2.hpp>
+
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 namespace i2pcpp {
     class RouterContext;
     class RouterInfo;
 
     /**
-     * Manages peer profiles. Allows random peer selection.
+     * Manages peer profiles. Keeps an in-memory profile for every known
+     * router, recording how it answers our tunnel build requests, how fast
+     * the tunnels through it are, how much data it sends us and how long we
+     * stay connected to it.
+     *
+     * Peers are periodically sorted in to tiers. Within a tier, peers are
+     * picked at random in proportion to their score, using precomputed alias
+     * tables so that each pick takes constant time.
      */
     class ProfileManager {
         public:
+            /**
+             * Peer tiers, from best to worst.
+             */
+            enum class Tier {
+                FAST,          ///< High capacity peers with the best speed
+                HIGH_CAPACITY, ///< Peers which reliably accept and carry tunnels
+                STANDARD       ///< Everyone else
+            };
+
             /**
              * Constructs from a reference to the i2pcpp::RouterContext.
              */
-            ProfileManager(RouterContext &ctx);
+            ProfileManager(boost::asio::io_service &ios, RouterContext &ctx);
             ProfileManager(const ProfileManager &) = delete;
             ProfileManager& operator=(ProfileManager &) = delete;
 
             /**
-             * Randomly selects a peer and returns its RI.
+             * Loads the known routers from the i2pcpp::RouterDirectory, sorts
+             * them in to tiers and starts the timer which regularly sorts
+             * them again. Profiles are added and dropped as routers are added
+             * to and removed from the directory.
+             */
+            void begin();
+
+            /**
+             * Selects a peer from \a tier, weighted by its score, and returns
+             * its RI. If \a tier is empty, the next lower tier is used.
+             * @param preferConnected if true, a few picks are made and the
+             *  first peer we are connected to is taken, if any
              * @return the i2pcpp::RouterInfo structure of the peer
+             * @throw std::runtime_error if no peers are known
+             */
+            const RouterInfo getPeer(Tier tier, bool preferConnected = false);
+
+            /**
+             * @return the tier \a peer is currently in
+             */
+            Tier getTier(RouterHash const &peer) const;
+
+            /**
+             * Records that we are now connected to \a peer.
+             */
+            void connected(RouterHash const &peer);
+
+            /**
+             * Records that we are no longer connected to \a peer.
              */
-            const RouterInfo getPeer();
+            void disconnected(RouterHash const &peer);
+
+            /**
+             * Records a failed attempt to connect to \a peer.
+             */
+            void connectionFailed(RouterHash const &peer);
+
+            /**
+             * Records \a bytes of data received directly from \a peer. The
+             * bytes are only added up here, under a lock of their own, and
+             * turned in to throughput when the peers are next sorted.
+             */
+            void dataReceived(RouterHash const &peer, std::size_t bytes);
+
+            /**
+             * Records a successful test of a tunnel (or pair of tunnels)
+             * through \a peers, whose round trip took \a latency.
+             */
+            void tunnelTestSucceeded(std::vector<RouterHash> const &peers, std::chrono::milliseconds latency);
+
+            /**
+             * Records a failed test of a tunnel (or pair of tunnels) through
+             * \a peers.
+             */
+            void tunnelTestFailed(std::vector<RouterHash> const &peers);
+
+            /**
+             * Records the response of \a peer to one of our tunnel build
+             * requests.
+             * @param accepted true if \a peer agreed to participate
+             */
+            void buildReplyReceived(RouterHash const &peer, bool accepted);
+
+            /**
+             * @return the average round trip time of the tunnel tests
+             * \a peer took part in, or zero if there were none
+             */
+            std::chrono::milliseconds getTestLatency(RouterHash const &peer) const;
 
         private:
+            typedef std::chrono::steady_clock clock;
+
+            struct Profile {
+                uint32_t testsSucceeded = 0;
+                uint32_t testsFailed = 0;
+                std::chrono::milliseconds testLatency = std::chrono::milliseconds(0);
+
+                uint32_t buildsAccepted = 0;
+                uint32_t buildsRejected = 0;
+
+                /// Bytes per second received from the peer, averaged per reorganization
+                double throughput = 0;
+
+                uint32_t connectionFailures = 0;
+                bool connected = false;
+                clock::time_point connectedSince;
+                clock::duration uptime = clock::duration::zero();
+
+                Tier tier = Tier::STANDARD;
+            };
+
+            /**
+             * The peers of a tier and their alias table, for weighted
+             * selection in constant time.
+             */
+            struct TierTable {
+                std::vector<RouterHash> peers;
+                std::vector<double> probability;
+                std::vector<uint32_t> alias;
+
+                /**
+                 * Builds the alias table from the weights of the peers.
+                 */
+                void build(std::vector<double> const &weights);
+
+                /**
+                 * @return a peer, picked in proportion to its weight
+                 */
+                RouterHash const &pick(uint64_t r1, uint64_t r2) const;
+            };
+
+            /**
+             * Adds \a peer to the known peers. Must be called with
+             * m_profilesMutex held.
+             */
+            void add(RouterHash const &peer);
+
+            /**
+             * @return the share of build requests and tunnel tests \a p
+             * succeeded at, with a bonus for long connections
+             */
+            static double capacity(Profile const &p, clock::time_point now);
+
+            /**
+             * @return a measure of the speed of the tunnels through \a p
+             * and of its throughput
+             */
+            static double speed(Profile const &p);
+
+            /**
+             * Adds \a peer, which has been added to the
+             * i2pcpp::RouterDirectory, to the known peers.
+             */
+            void routerAdded(RouterHash const peer);
+
+            /**
+             * Forgets the profile of \a peer, which has been removed from
+             * the i2pcpp::RouterDirectory.
+             */
+            void routerRemoved(RouterHash const peer);
+
+            /**
+             * Updates the throughput of the peers from the bytes received
+             * since the last call, then sorts the peers in to tiers.
+             */
+            void reorganize();
+
+            /**
+             * Sorts the peers in to tiers and rebuilds the alias tables. Must
+             * be called with m_profilesMutex held.
+             */
+            void sort();
+
+            void timerCallback(const boost::system::error_code &e);
+
             RouterContext& m_ctx; ///< Reference to the router context
+
+            std::unordered_map<RouterHash, Profile> m_profiles;
+            std::array<TierTable, 3> m_tiers;
+            bool m_stale = false; ///< A peer in the tier tables has been removed
+            mutable std::mutex m_profilesMutex;
+
+            std::unordered_map<RouterHash, uint64_t> m_received;
+            clock::time_point m_receivedSince;
+            std::mutex m_receivedMutex;
+
+            boost::signals2::scoped_connection m_addedConnection;
+            boost::signals2::scoped_connection m_removedConnection;
+
+            std::size_t m_fastTierSize;
+            std::size_t m_highCapacityTierSize;
+
+            boost::asio::deadline_timer m_timer;
+
+            i2p_logger_mt m_log;
     };
 }
 
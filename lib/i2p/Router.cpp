@@ -99,15 +99,27 @@ namespace i2pcpp {
             &DHT::SearchManager::connected,
             boost::ref(m_impl->ctx.getDHT()->getSearchManager()), _1
         ));
+        m_impl->ctx.getSignals().registerPeerConnected(boost::bind(
+            &DHT::DHTFacade::connected,
+            boost::ref(*m_impl->ctx.getDHT()), _1
+        ));
 
         /* Connection failure */
         m_impl->ctx.getSignals().registerConnectionFailure(boost::bind(
             &DHT::SearchManager::connectionFailure,
             boost::ref(m_impl->ctx.getDHT()->getSearchManager()), _1
         ));
+        m_impl->ctx.getSignals().registerConnectionFailure(boost::bind(
+            &DHT::DHTFacade::connectionFailure,
+            boost::ref(*m_impl->ctx.getDHT()), _1
+        ));
         m_impl->ctx.getSignals().registerConnectionFailure(boost::bind(
             &PeerManager::failure, boost::ref(m_impl->ctx.getPeerManager()), _1
         ));
+        m_impl->ctx.getSignals().registerConnectionFailure(boost::bind(
+            &OutboundMessageDispatcher::connectionFailure,
+            boost::ref(m_impl->ctx.getOutMsgDisp()), _1
+        ));
 
         m_impl->ctx.getSignals().registerSearchReply(boost::bind(
             &DHT::SearchManager::searchReply,
@@ -117,11 +129,15 @@ namespace i2pcpp {
             &DHT::SearchManager::databaseStore,
             boost::ref(m_impl->ctx.getDHT()->getSearchManager()), _1, _2, _3
         ));
+        m_impl->ctx.getSignals().registerDatabaseStore(boost::bind(
+            &DHT::DHTFacade::databaseStore,
+            boost::ref(*m_impl->ctx.getDHT()), _1, _2, _3
+        ));
 
         /* Everything related to tunnels */
         m_impl->ctx.getSignals().registerTunnelRecordsReceived(boost::bind(
             &Tunnel::Manager::receiveRecords,
-            boost::ref(m_impl->ctx.getTunnelManager()), _1, _2
+            boost::ref(m_impl->ctx.getTunnelManager()), _1, _2, _3
         ));
         m_impl->ctx.getSignals().registerTunnelGatewayData(boost::bind(
             &Tunnel::Manager::receiveGatewayData,
@@ -129,7 +145,11 @@ namespace i2pcpp {
         ));
         m_impl->ctx.getSignals().registerTunnelData(boost::bind(
             &Tunnel::Manager::receiveData,
-            boost::ref(m_impl->ctx.getTunnelManager()), _1, _2, _3
+            boost::ref(m_impl->ctx.getTunnelManager()), _1, _2
+        ));
+        m_impl->ctx.getSignals().registerDeliveryStatus(boost::bind(
+            &Tunnel::Manager::receiveDeliveryStatus,
+            boost::ref(m_impl->ctx.getTunnelManager()), _1, _2
         ));
 
         /* Everything related to the DHT */
@@ -142,6 +162,8 @@ namespace i2pcpp {
             boost::ref(m_impl->ctx.getOutMsgDisp()), _1
         ));
 
+        m_impl->ctx.getProfileManager().begin();
+        m_impl->ctx.getDHT()->begin();
         m_impl->ctx.getPeerManager().begin();
         //m_impl->ctx.getTunnelManager().begin();
     }
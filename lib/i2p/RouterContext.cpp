@@ -4,13 +4,18 @@
  */
 #include "RouterContext.h"
 
+#include "i2np/DatabaseStore.h"
+
+#include <i2pcpp/util/gzip.h>
 #include <i2pcpp/datatypes/RouterIdentity.h>
+#include <i2pcpp/datatypes/RouterInfo.h>
 
 #include <boost/asio.hpp>
 
 #include <botan/elgamal.h>
 #include <botan/dsa.h>
 #include <botan/auto_rng.h>
+#include <botan/pipe.h>
 
 namespace i2pcpp {
     RouterContext::RouterContext(std::shared_ptr<Database> const &db, boost::asio::io_service &ios) :
@@ -20,7 +25,7 @@ namespace i2pcpp {
         m_outMsgDispatcher(*this),
         m_signals(ios),
         m_tunnelManager(ios, *this),
-        m_profileManager(*this),
+        m_profileManager(ios, *this),
         m_peerManager(ios, *this)
     {
         // Load the private keys from the database
@@ -41,7 +46,7 @@ namespace i2pcpp {
         ByteArray encryptionKeyBytes = Botan::BigInt::encode(encryptionKeyPublic), signingKeyBytes = Botan::BigInt::encode(signingKeyPublic);
         m_identity = std::make_shared<RouterIdentity>(encryptionKeyBytes, signingKeyBytes, Certificate());
 
-        m_dht = std::make_shared<DHT::DHTFacade>(ios, m_identity->getHash(), db->getAllHashes(), *this);
+        m_dht = std::make_shared<DHT::DHTFacade>(ios, m_identity->getHash(), *this);
     }
 
     std::shared_ptr<const Botan::ElGamal_PrivateKey> RouterContext::getEncryptionKey() const
@@ -103,4 +108,35 @@ namespace i2pcpp {
     {
         return m_ios;
     }
+
+    I2NP::MessagePtr RouterContext::createRouterInfoStore() const
+    {
+        Mapping am;
+        am.setValue("caps", "BC");
+        am.setValue("host", m_db->getConfigValue("ssu_external_ip"));
+        am.setValue("key", Base64::encode(m_identity->getHash()));
+        am.setValue("port", m_db->getConfigValue("ssu_external_port"));
+        RouterAddress a(5, Date(0), "SSU", am);
+
+        Mapping rm;
+        rm.setValue("coreVersion", "0.9.11");
+        rm.setValue("netId", "2");
+        rm.setValue("router.version", "0.9.11");
+        rm.setValue("stat_uptime", "90m");
+        rm.setValue("caps", m_dht->getFloodfill().isEnabled() ? "OfR" : "OR");
+        RouterInfo myInfo(*m_identity, Date(), rm);
+        myInfo.addAddress(a);
+        myInfo.sign(m_signingKey);
+
+        Botan::Pipe gzPipe(new Gzip_Compression);
+        gzPipe.start_msg();
+        gzPipe.write(myInfo.serialize());
+        gzPipe.end_msg();
+
+        unsigned int size = gzPipe.remaining();
+        ByteArray gzInfoBytes(size);
+        gzPipe.read(gzInfoBytes.data(), size);
+
+        return std::make_shared<I2NP::DatabaseStore>(myInfo.getIdentity().getHash(), I2NP::DatabaseStore::DataType::ROUTER_INFO, 0, gzInfoBytes);
+    }
 }
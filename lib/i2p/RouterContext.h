@@ -101,6 +101,14 @@ namespace i2pcpp {
              */
             boost::asio::io_service& getIoService();
 
+            /**
+             * Builds and signs our own i2pcpp::RouterInfo, with the
+             *  capabilities we currently have, the floodfill flag among
+             *  them.
+             * @return a DatabaseStore message carrying it
+             */
+            I2NP::MessagePtr createRouterInfoStore() const;
+
         private:
             boost::asio::io_service& m_ios;
 
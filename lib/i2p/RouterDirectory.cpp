@@ -0,0 +1,268 @@
+/**
+ * @file RouterDirectory.cpp
+ * @brief Implements RouterDirectory.h
+ */
+#include "RouterDirectory.h"
+
+#include <i2pcpp/util/BufferedRNG.h>
+#include <i2pcpp/datatypes/RouterInfo.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+/// Random picks tried before the candidates are searched for exhaustively
+#define ROUTERDIRECTORY_ATTEMPTS 32
+
+namespace i2pcpp {
+    const std::string RouterDirectory::CLASSES = "KLMNOPX";
+
+    /**
+     * Shared by all directories. Constructed on first use, after Botan has
+     * been initialized.
+     */
+    static BufferedRNG& rng()
+    {
+        static BufferedRNG r;
+        return r;
+    }
+
+    static uint64_t randomWord()
+    {
+        uint64_t r;
+        rng().randomize((unsigned char *)&r, sizeof(r));
+        return r;
+    }
+
+    bool RouterDirectory::add(RouterHash const &rh, RouterInfo const &info)
+    {
+        const std::string caps = info.getOptions().getValue("caps");
+
+        Entry e;
+        e.published = info.getPublished().serialize();
+        e.bandwidth = NUM_CLASSES - 1;
+        e.position.fill(-1);
+
+        // Routers may advertise several classes for compatibility, the highest counts
+        for(auto c: caps) {
+            std::size_t b = CLASSES.find(c);
+            if(b != std::string::npos && (e.bandwidth == NUM_CLASSES - 1 || b > e.bandwidth))
+                e.bandwidth = b;
+        }
+
+        std::array<bool, NUM_INDICES> member = {};
+        member[ALL] = true;
+        member[FLOODFILL] = (caps.find('f') != std::string::npos);
+        member[REACHABLE] = (caps.find('R') != std::string::npos);
+        member[SSU] = std::any_of(info.begin(), info.end(), [](RouterAddress const &a) { return a.getTransport() == "SSU"; });
+        if(e.bandwidth != NUM_CLASSES - 1)
+            member[BANDWIDTH_K + e.bandwidth] = true;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            auto itr = m_entries.find(rh);
+            if(itr != m_entries.end()) {
+                if(e.published < itr->second.published)
+                    return false;
+
+                erase(itr);
+            }
+
+            for(std::size_t i = 0; i < NUM_INDICES; ++i) {
+                if(!member[i]) continue;
+
+                e.position[i] = m_indices[i].size();
+                m_indices[i].push_back(rh);
+                m_classCounts[i][e.bandwidth]++;
+            }
+
+            m_entries[rh] = std::move(e);
+        }
+
+        m_added(rh, info);
+
+        return true;
+    }
+
+    void RouterDirectory::remove(RouterHash const &rh)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            auto itr = m_entries.find(rh);
+            if(itr == m_entries.end())
+                return;
+
+            erase(itr);
+        }
+
+        m_removed(rh);
+    }
+
+    void RouterDirectory::clear()
+    {
+        std::vector<RouterHash> removed;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            removed.swap(m_indices[ALL]);
+
+            m_entries.clear();
+            for(auto& i: m_indices)
+                i.clear();
+            for(auto& c: m_classCounts)
+                c.fill(0);
+        }
+
+        for(auto& rh: removed)
+            m_removed(rh);
+    }
+
+    std::size_t RouterDirectory::size(Index index) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        return m_indices[index].size();
+    }
+
+    std::size_t RouterDirectory::size(Index index, char bandwidth) const
+    {
+        std::size_t b = CLASSES.find(bandwidth);
+        if(b == std::string::npos)
+            return 0;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        return m_classCounts[index][b];
+    }
+
+    bool RouterDirectory::contains(RouterHash const &rh, Index index) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto itr = m_entries.find(rh);
+        return itr != m_entries.end() && itr->second.position[index] >= 0;
+    }
+
+    std::vector<RouterHash> RouterDirectory::getAll(Index index) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        return m_indices[index];
+    }
+
+    RouterHash RouterDirectory::pick(Index index, std::unordered_set<RouterHash> const &excluded) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        std::vector<RouterHash> const &routers = m_indices[index];
+        if(routers.empty())
+            throw std::runtime_error("no routers in directory index");
+
+        for(int i = 0; i < ROUTERDIRECTORY_ATTEMPTS; ++i) {
+            RouterHash const &rh = routers[randomWord() % routers.size()];
+            if(!excluded.count(rh))
+                return rh;
+        }
+
+        // Most of the index is excluded
+        std::vector<RouterHash const *> candidates;
+        for(auto& rh: routers)
+            if(!excluded.count(rh))
+                candidates.push_back(&rh);
+
+        if(candidates.empty())
+            throw std::runtime_error("all routers in directory index are excluded");
+
+        return *candidates[randomWord() % candidates.size()];
+    }
+
+    RouterHash RouterDirectory::pickWeighted(Index index, std::unordered_set<RouterHash> const &excluded) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        std::vector<RouterHash> const &routers = m_indices[index];
+        if(routers.empty())
+            throw std::runtime_error("no routers in directory index");
+
+        uint32_t maxWeight = 0;
+        for(std::size_t b = 0; b < NUM_CLASSES; ++b)
+            if(m_classCounts[index][b])
+                maxWeight = std::max(maxWeight, weight(b));
+
+        /* A uniform pick is accepted with a probability of its weight over
+         * the largest weight in the index, so that it takes the largest over
+         * the average weight tries on average, no more than 16.
+         */
+        for(int i = 0; i < ROUTERDIRECTORY_ATTEMPTS; ++i) {
+            RouterHash const &rh = routers[randomWord() % routers.size()];
+            if(excluded.count(rh))
+                continue;
+
+            if(randomWord() % maxWeight < weight(m_entries.at(rh).bandwidth))
+                return rh;
+        }
+
+        uint64_t total = 0;
+        for(auto& rh: routers)
+            if(!excluded.count(rh))
+                total += weight(m_entries.at(rh).bandwidth);
+
+        if(!total)
+            throw std::runtime_error("all routers in directory index are excluded");
+
+        uint64_t r = randomWord() % total;
+        for(auto& rh: routers) {
+            if(excluded.count(rh)) continue;
+
+            uint32_t w = weight(m_entries.at(rh).bandwidth);
+            if(r < w)
+                return rh;
+
+            r -= w;
+        }
+
+        throw std::logic_error("weighted pick out of range");
+    }
+
+    boost::signals2::connection RouterDirectory::registerAdded(Added::slot_type const &ah)
+    {
+        return m_added.connect(ah);
+    }
+
+    boost::signals2::connection RouterDirectory::registerRemoved(Removed::slot_type const &rh)
+    {
+        return m_removed.connect(rh);
+    }
+
+    void RouterDirectory::erase(std::unordered_map<RouterHash, Entry>::iterator itr)
+    {
+        Entry const &e = itr->second;
+
+        for(std::size_t i = 0; i < NUM_INDICES; ++i) {
+            if(e.position[i] < 0) continue;
+
+            std::vector<RouterHash> &routers = m_indices[i];
+
+            // The last member takes the place of the removed one
+            if((std::size_t)e.position[i] != routers.size() - 1) {
+                routers[e.position[i]] = routers.back();
+                m_entries[routers.back()].position[i] = e.position[i];
+            }
+
+            routers.pop_back();
+            m_classCounts[i][e.bandwidth]--;
+        }
+
+        m_entries.erase(itr);
+    }
+
+    uint32_t RouterDirectory::weight(uint8_t bandwidth)
+    {
+        // Roughly in proportion to the shared bandwidth of the classes K to X
+        static const std::array<uint32_t, NUM_CLASSES> weights = {{1, 2, 4, 6, 8, 12, 16, 1}};
+
+        return weights[bandwidth];
+    }
+}
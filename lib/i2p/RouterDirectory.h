@@ -0,0 +1,174 @@
+/**
+ * @file RouterDirectory.h
+ * @brief Defines the i2pcpp::RouterDirectory class.
+ */
+#ifndef ROUTERDIRECTORY_H
+#define ROUTERDIRECTORY_H
+
+#include <i2pcpp/datatypes/ByteArray.h>
+#include <i2pcpp/datatypes/RouterHash.h>
+
+#include <boost/signals2.hpp>
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace i2pcpp {
+    class RouterInfo;
+
+    /**
+     * Keeps the hashes of all known routers in memory, together with an
+     *  index per capability and the date each was published, so that random
+     *  routers can be selected and newer copies told apart without querying
+     *  the database.
+     * Each index is a vector in which every member remembers its position,
+     *  so that routers are added, removed and picked in constant time.
+     * @note the class is designed to be thread-safe
+     */
+    class RouterDirectory {
+        public:
+            /**
+             * Signal invoked, without the directory locked, once a router
+             *  has been added or its entry replaced, with the
+             *  i2pcpp::RouterInfo it was filed by.
+             */
+            typedef boost::signals2::signal<void(const RouterHash, RouterInfo const &)> Added;
+
+            /**
+             * Signal invoked, without the directory locked, once a router
+             *  has been removed.
+             */
+            typedef boost::signals2::signal<void(const RouterHash)> Removed;
+
+            /**
+             * The indices routers are filed under. A router is in ALL, in
+             *  the index of its bandwidth class, if it advertises one, and
+             *  in any of the others that apply.
+             */
+            enum Index {
+                ALL,
+                FLOODFILL,   ///< The caps contain 'f'
+                REACHABLE,   ///< The caps contain 'R'
+                SSU,         ///< There is an SSU address
+                BANDWIDTH_K, ///< Shared bandwidth class, from lowest to highest
+                BANDWIDTH_L,
+                BANDWIDTH_M,
+                BANDWIDTH_N,
+                BANDWIDTH_O,
+                BANDWIDTH_P,
+                BANDWIDTH_X,
+                NUM_INDICES
+            };
+
+            RouterDirectory() = default;
+            RouterDirectory(const RouterDirectory &) = delete;
+            RouterDirectory& operator=(RouterDirectory &) = delete;
+
+            /**
+             * Files the router \a rh under the indices \a info qualifies
+             *  for, replacing any previous entry for it unless that was
+             *  published later.
+             * @return false if a copy published later is filed, and \a info
+             *  was not
+             */
+            bool add(RouterHash const &rh, RouterInfo const &info);
+
+            /**
+             * Removes the router \a rh from all indices.
+             */
+            void remove(RouterHash const &rh);
+
+            /**
+             * Removes all routers.
+             */
+            void clear();
+
+            /**
+             * @return the number of routers in \a index
+             */
+            std::size_t size(Index index = ALL) const;
+
+            /**
+             * @return the number of routers in \a index which advertise the
+             *  bandwidth class \a bandwidth, one of K, L, M, N, O, P and X
+             */
+            std::size_t size(Index index, char bandwidth) const;
+
+            /**
+             * @return true if the router \a rh is in \a index
+             */
+            bool contains(RouterHash const &rh, Index index = ALL) const;
+
+            /**
+             * @return the routers in \a index
+             */
+            std::vector<RouterHash> getAll(Index index = ALL) const;
+
+            /**
+             * Picks a router from \a index with uniform probability.
+             * @param excluded routers which must not be picked
+             * @throw std::runtime_error if every router in \a index is
+             *  excluded
+             */
+            RouterHash pick(Index index, std::unordered_set<RouterHash> const &excluded = {}) const;
+
+            /**
+             * Picks a router from \a index with a probability proportional
+             *  to the weight of its bandwidth class.
+             * @param excluded routers which must not be picked
+             * @throw std::runtime_error if every router in \a index is
+             *  excluded
+             */
+            RouterHash pickWeighted(Index index, std::unordered_set<RouterHash> const &excluded = {}) const;
+
+            /**
+             * Registers an i2pcpp::RouterDirectory::Added signal handler.
+             */
+            boost::signals2::connection registerAdded(Added::slot_type const &ah);
+
+            /**
+             * Registers an i2pcpp::RouterDirectory::Removed signal handler.
+             */
+            boost::signals2::connection registerRemoved(Removed::slot_type const &rh);
+
+        private:
+            /// Bandwidth classes K to X, and one for routers without a class
+            static const std::size_t NUM_CLASSES = 8;
+
+            /// The bandwidth classes, in the order of their indices
+            static const std::string CLASSES;
+
+            struct Entry {
+                ByteArray published; ///< Serialized i2pcpp::Date, compares chronologically
+                uint8_t bandwidth; ///< Bandwidth class, NUM_CLASSES - 1 if none
+                std::array<int32_t, NUM_INDICES> position; ///< In each index, -1 if not a member
+            };
+
+            /**
+             * Removes the entry at \a itr. Must be called with m_mutex held.
+             */
+            void erase(std::unordered_map<RouterHash, Entry>::iterator itr);
+
+            /**
+             * @return the weight of the bandwidth class \a bandwidth
+             */
+            static uint32_t weight(uint8_t bandwidth);
+
+            std::unordered_map<RouterHash, Entry> m_entries;
+            std::array<std::vector<RouterHash>, NUM_INDICES> m_indices;
+
+            /// The number of members of each index per bandwidth class
+            std::array<std::array<std::size_t, NUM_CLASSES>, NUM_INDICES> m_classCounts = {};
+
+            mutable std::mutex m_mutex;
+
+            Added m_added;
+            Removed m_removed;
+    };
+}
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ * @file RouterInfoCache.cpp
+ * @brief Implements RouterInfoCache.h
+ */
+#include "RouterInfoCache.h"
+
+#include <i2pcpp/datatypes/RouterInfo.h>
+
+namespace i2pcpp {
+    RouterInfoCache::RouterInfoCache(std::size_t capacity) :
+        m_shardCapacity(capacity / NUM_SHARDS),
+        m_hits(0),
+        m_misses(0),
+        m_evictions(0) {}
+
+    RouterInfoCache::RouterInfoPtr RouterInfoCache::get(RouterHash const &rh)
+    {
+        Shard &s = getShard(rh);
+
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        auto itr = s.index.find(rh);
+        if(itr == s.index.end()) {
+            ++m_misses;
+            return RouterInfoPtr();
+        }
+
+        ++m_hits;
+        s.lru.splice(s.lru.begin(), s.lru, itr->second);
+
+        return itr->second->info;
+    }
+
+    bool RouterInfoCache::contains(RouterHash const &rh) const
+    {
+        const Shard &s = getShard(rh);
+
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        return s.index.count(rh);
+    }
+
+    void RouterInfoCache::put(RouterInfoPtr const &ri)
+    {
+        const RouterHash rh = ri->getIdentity().getHash();
+        const std::size_t size = estimateSize(*ri);
+
+        Shard &s = getShard(rh);
+
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        auto itr = s.index.find(rh);
+        if(itr != s.index.end()) {
+            // Dates serialize big endian, so the bytes compare as the dates do
+            if(ri->getPublished().serialize() < itr->second->info->getPublished().serialize())
+                return;
+
+            s.bytes -= itr->second->size;
+            s.lru.erase(itr->second);
+            s.index.erase(itr);
+        }
+
+        if(size > m_shardCapacity)
+            return;
+
+        s.lru.push_front({rh, ri, size});
+        s.index[rh] = s.lru.begin();
+        s.bytes += size;
+
+        while(s.bytes > m_shardCapacity) {
+            Entry &e = s.lru.back();
+            s.bytes -= e.size;
+            s.index.erase(e.hash);
+            s.lru.pop_back();
+
+            ++m_evictions;
+        }
+    }
+
+    void RouterInfoCache::invalidate(RouterHash const &rh)
+    {
+        Shard &s = getShard(rh);
+
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        auto itr = s.index.find(rh);
+        if(itr != s.index.end()) {
+            s.bytes -= itr->second->size;
+            s.lru.erase(itr->second);
+            s.index.erase(itr);
+        }
+    }
+
+    void RouterInfoCache::clear()
+    {
+        for(auto& s: m_shards) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+
+            s.lru.clear();
+            s.index.clear();
+            s.bytes = 0;
+        }
+    }
+
+    RouterInfoCache::Stats RouterInfoCache::getStats() const
+    {
+        Stats stats = {m_hits, m_misses, m_evictions, 0, 0};
+
+        for(auto& s: m_shards) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+
+            stats.entries += s.index.size();
+            stats.bytes += s.bytes;
+        }
+
+        return stats;
+    }
+
+    RouterInfoCache::Shard& RouterInfoCache::getShard(RouterHash const &rh)
+    {
+        // Router hashes are SHA-256 hashes, so any byte spreads them evenly
+        return m_shards[rh[0] % NUM_SHARDS];
+    }
+
+    const RouterInfoCache::Shard& RouterInfoCache::getShard(RouterHash const &rh) const
+    {
+        return m_shards[rh[0] % NUM_SHARDS];
+    }
+
+    std::size_t RouterInfoCache::estimateSize(RouterInfo const &ri)
+    {
+        /* The serialized form is close to the size of the keys, options and
+         * addresses held; the rest is the overhead of the containers.
+         */
+        const std::size_t perOption = 2 * sizeof(std::string) + 32;
+
+        std::size_t size = sizeof(RouterInfo) + sizeof(Entry) + ri.serialize().size();
+        size += std::distance(ri.getOptions().begin(), ri.getOptions().end()) * perOption;
+
+        for(auto& a: ri)
+            size += sizeof(RouterAddress) + std::distance(a.getOptions().begin(), a.getOptions().end()) * perOption;
+
+        return size;
+    }
+}
@@ -0,0 +1,116 @@
+/**
+ * @file RouterInfoCache.h
+ * @brief Defines the i2pcpp::RouterInfoCache class.
+ */
+#ifndef ROUTERINFOCACHE_H
+#define ROUTERINFOCACHE_H
+
+#include <i2pcpp/datatypes/RouterHash.h>
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace i2pcpp {
+    class RouterInfo;
+
+    /**
+     * Keeps the most recently used i2pcpp::RouterInfo objects in memory, so
+     *  that the i2pcpp::Database does not have to query and parse them again.
+     * Entries are immutable and shared, and are spread over a number of
+     *  shards, each with its own lock and least recently used list, so that
+     *  threads looking up different routers rarely contend.
+     * @note the class is designed to be thread-safe
+     */
+    class RouterInfoCache {
+        public:
+            typedef std::shared_ptr<const RouterInfo> RouterInfoPtr;
+
+            /**
+             * Counters for reporting. Hits, misses and evictions are counted
+             *  since construction.
+             */
+            struct Stats {
+                uint64_t hits;
+                uint64_t misses;
+                uint64_t evictions;
+                std::size_t entries;
+                std::size_t bytes;
+            };
+
+            /**
+             * @param capacity the approximate number of bytes the cached
+             *  objects may take
+             */
+            RouterInfoCache(std::size_t capacity);
+            RouterInfoCache(const RouterInfoCache &) = delete;
+            RouterInfoCache& operator=(RouterInfoCache &) = delete;
+
+            /**
+             * @return the cached i2pcpp::RouterInfo of \a rh, or a null
+             *  pointer if it is not cached
+             */
+            RouterInfoPtr get(RouterHash const &rh);
+
+            /**
+             * @return true if the i2pcpp::RouterInfo of \a rh is cached. Does
+             *  not count as a hit or miss.
+             */
+            bool contains(RouterHash const &rh) const;
+
+            /**
+             * Caches \a ri, replacing a copy published at the same time or
+             *  earlier, and evicts the least recently used objects until the
+             *  shard fits its capacity. A newer cached copy is kept instead.
+             */
+            void put(RouterInfoPtr const &ri);
+
+            /**
+             * Removes the i2pcpp::RouterInfo of \a rh, if it is cached.
+             */
+            void invalidate(RouterHash const &rh);
+
+            /**
+             * Removes all objects.
+             */
+            void clear();
+
+            Stats getStats() const;
+
+        private:
+            struct Entry {
+                RouterHash hash;
+                RouterInfoPtr info;
+                std::size_t size;
+            };
+
+            struct Shard {
+                std::list<Entry> lru; ///< Most recently used first
+                std::unordered_map<RouterHash, std::list<Entry>::iterator> index;
+                std::size_t bytes = 0;
+                mutable std::mutex mutex;
+            };
+
+            static const std::size_t NUM_SHARDS = 16;
+
+            Shard& getShard(RouterHash const &rh);
+            const Shard& getShard(RouterHash const &rh) const;
+
+            /**
+             * @return the approximate number of bytes \a ri takes in memory
+             */
+            static std::size_t estimateSize(RouterInfo const &ri);
+
+            std::array<Shard, NUM_SHARDS> m_shards;
+            std::size_t m_shardCapacity;
+
+            std::atomic<uint64_t> m_hits;
+            std::atomic<uint64_t> m_misses;
+            std::atomic<uint64_t> m_evictions;
+    };
+}
+
+#endif
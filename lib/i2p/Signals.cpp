@@ -17,9 +17,9 @@ namespace i2pcpp {
         return m_databaseStore.connect(dbsh);
     }
 
-    void Signals::invokeTunnelRecordsReceived(const uint32_t msgId, const std::list<BuildRecordPtr> &records)
+    void Signals::invokeTunnelRecordsReceived(RouterHash const &from, const uint32_t msgId, const std::list<BuildRecordPtr> &records)
     {
-        m_ios.post(boost::bind(boost::ref(m_buildTunnelRequest), msgId, records));
+        m_ios.post(boost::bind(boost::ref(m_buildTunnelRequest), from, msgId, records));
     }
 
     boost::signals2::connection Signals::registerTunnelRecordsReceived(BuildTunnelRequest::slot_type const &btrh)
@@ -67,13 +67,23 @@ namespace i2pcpp {
         return m_tunnelGatewayData.connect(tgdh);
     }
 
-    void Signals::invokeTunnelData(RouterHash const &from, uint32_t const tunnelId, StaticByteArray<1024> const &data)
+    void Signals::invokeTunnelData(RouterHash const &from, std::shared_ptr<I2NP::TunnelData> const &td)
     {
-        m_ios.post(boost::bind(boost::ref(m_tunnelData), from, tunnelId, data));
+        m_ios.post(boost::bind(boost::ref(m_tunnelData), from, td));
     }
 
     boost::signals2::connection Signals::registerTunnelData(TunnelData::slot_type const &tdh)
     {
         return m_tunnelData.connect(tdh);
     }
+
+    void Signals::invokeDeliveryStatus(RouterHash const &from, uint32_t const msgId)
+    {
+        m_ios.post(boost::bind(boost::ref(m_deliveryStatus), from, msgId));
+    }
+
+    boost::signals2::connection Signals::registerDeliveryStatus(DeliveryStatus::slot_type const &dsh)
+    {
+        return m_deliveryStatus.connect(dsh);
+    }
 }
@@ -13,6 +13,8 @@
 namespace boost { namespace asio { class io_service; } }
 
 namespace i2pcpp {
+    namespace I2NP { class TunnelData; }
+
     class Signals {
         public:
             /**
@@ -23,7 +25,7 @@ namespace i2pcpp {
             /**
              * Signal invoked upon receival of a tunnel build request.
              */
-            typedef boost::signals2::signal<void(const uint32_t, std::list<BuildRecordPtr>)> BuildTunnelRequest;
+            typedef boost::signals2::signal<void(const RouterHash, const uint32_t, std::list<BuildRecordPtr>)> BuildTunnelRequest;
 
             /**
              * Signal invoked upon connection of a peer.
@@ -48,7 +50,12 @@ namespace i2pcpp {
             /**
              * Signal invoked upon receival of tunnel data.
              */
-            typedef boost::signals2::signal<void(const RouterHash, const uint32_t, const StaticByteArray<1024>)> TunnelData;
+            typedef boost::signals2::signal<void(const RouterHash, const std::shared_ptr<I2NP::TunnelData>)> TunnelData;
+
+            /**
+             * Signal invoked upon receival of a delivery status message.
+             */
+            typedef boost::signals2::signal<void(const RouterHash, const uint32_t)> DeliveryStatus;
 
             /**
              * Constructs from a reference to an I/O service.
@@ -72,10 +79,11 @@ namespace i2pcpp {
 
             /**
              * Invokes the tunnel records received event.
+             * @param from the i2pcpp::RouterHash of the router that sent the records
              * @param msgId the message identifier of the original outbound message
              * @param records a list of pointers to i2pcpp::BuildRecord objects
              */
-            void invokeTunnelRecordsReceived(uint32_t const msgId, std::list<BuildRecordPtr> const &records);
+            void invokeTunnelRecordsReceived(RouterHash const &from, uint32_t const msgId, std::list<BuildRecordPtr> const &records);
 
             /**
              * Registers an i2pcpp::Signals::TunnelRecordsReceived signal handler.
@@ -133,16 +141,28 @@ namespace i2pcpp {
             /**
              * Invokes the tunnel data signal.
              * @param from the i2pcpp::RouterHash of the router that sent the data
-             * @param tunnelId the ID of the associated tunnel
-             * @param data the 1024 bytes of received data
+             * @param td the received message, which handlers may decrypt and
+             *  forward in place
              */
-            void invokeTunnelData(RouterHash const &from, uint32_t const tunnelId, StaticByteArray<1024> const &data);
+            void invokeTunnelData(RouterHash const &from, std::shared_ptr<I2NP::TunnelData> const &td);
 
             /**
              * Registers an i2pcpp::Signals::TunnelData signal handler.
              */
             boost::signals2::connection registerTunnelData(TunnelData::slot_type const &tdh);
 
+            /**
+             * Invokes the delivery status signal.
+             * @param from the i2pcpp::RouterHash of the router that sent the message
+             * @param msgId the identifier of the message whose delivery is confirmed
+             */
+            void invokeDeliveryStatus(RouterHash const &from, uint32_t const msgId);
+
+            /**
+             * Registers an i2pcpp::Signals::DeliveryStatus signal handler.
+             */
+            boost::signals2::connection registerDeliveryStatus(DeliveryStatus::slot_type const &dsh);
+
         private:
             boost::asio::io_service& m_ios;
 
@@ -153,6 +173,7 @@ namespace i2pcpp {
             SearchReply m_searchReply;
             TunnelGatewayData m_tunnelGatewayData;
             TunnelData m_tunnelData;
+            DeliveryStatus m_deliveryStatus;
     };
 }
 
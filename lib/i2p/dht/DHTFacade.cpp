@@ -5,38 +5,266 @@
 #include "DHTFacade.h"
 
 #include "RouterContext.h"
+#include "RouterDirectory.h"
 #include <i2pcpp/datatypes/RouterIdentity.h>
+#include <i2pcpp/datatypes/RouterInfo.h>
 
 #include <i2pcpp/util/make_unique.h>
 
+#include <boost/date_time/gregorian/gregorian.hpp>
+
+#include <atomic>
+
 namespace i2pcpp {
     namespace DHT {
 
         DHTFacade::DHTFacade(boost::asio::io_service &ios,
                 RouterHash const &local,
-                std::forward_list<RouterHash> const &hashes,
                 RouterContext &ctx) :
-            m_dht(local),
-            m_searchManager(ios, ctx)
+            m_ctx(ctx),
+            m_local(local),
+            m_precomputeTimer(ios),
+            m_rotateTimer(ios),
+            m_searchManager(ios, ctx),
+            m_floodfill(ctx),
+            m_log(boost::log::keywords::channel = "DHT")
         {
-            // Populate the DHT
-            for(const auto& h: hashes)
-                m_dht.insert(DHT::Kademlia::makeKey(h), h);
+            std::string today = boost::gregorian::to_iso_string(boost::posix_time::second_clock::universal_time().date());
+            GenerationPtr g = build(today, m_ctx.getDatabase()->getDirectory().getAll());
+            std::atomic_store(&m_current, g);
+
+            // Seed the routing table, nobody is pinged until we are running
+            m_table = std::make_unique<Kad::RoutingTable>(Kademlia::makeKey(m_local, today));
+
+            RouterHash questionable;
+            for(auto& k: g->keys)
+                m_table->update(k.first, k.second, false, questionable);
+
+            I2P_LOG(m_log, debug) << "routing table seeded with " << m_table->size() << " of " << g->keys.size() << " routers";
         }
 
+        DHTFacade::~DHTFacade()
+        {
+            if(m_worker.joinable())
+                m_worker.join();
+        }
+
+        void DHTFacade::begin()
+        {
+            // Nobody is pinged before the transport is up, so routers are only followed from now on
+            RouterDirectory &dir = m_ctx.getDatabase()->getDirectory();
+            m_addedConnection = dir.registerAdded(boost::bind(&DHTFacade::routerAdded, this, _1));
+            m_removedConnection = dir.registerRemoved(boost::bind(&DHTFacade::routerRemoved, this, _1));
+
+            schedule();
+
+            m_floodfill.begin();
+        }
 
         bool DHTFacade::lookup(const RouterHash& hash)
         {
-            auto results = m_dht.find(DHT::Kademlia::makeKey(hash));
-            if(std::distance(results.first, results.second) < 1)
+            auto results = m_table->closest(getRoutingKey(hash), K_VALUE);
+            if(results.empty())
                 return false;
 
             m_searchManager.createSearch(hash, results);
+            return true;
+        }
+
+        Kademlia::key_type DHTFacade::getRoutingKey(RouterHash const &hash) const
+        {
+            GenerationPtr g = std::atomic_load(&m_current);
+
+            {
+                std::lock_guard<std::mutex> lock(g->mutex);
+
+                auto itr = g->keys.find(hash);
+                if(itr != g->keys.end())
+                    return itr->second;
+            }
+
+            return Kademlia::makeKey(hash, g->date);
+        }
+
+        void DHTFacade::connected(RouterHash const rh)
+        {
+            update(rh, true);
+        }
+
+        void DHTFacade::connectionFailure(RouterHash const rh)
+        {
+            m_table->failed(rh);
+        }
+
+        void DHTFacade::databaseStore(RouterHash const from, StaticByteArray<32> const k, bool isRouterInfo)
+        {
+            update(from, true);
+        }
+
+        void DHTFacade::routerAdded(RouterHash const rh)
+        {
+            update(rh, false);
+        }
+
+        void DHTFacade::routerRemoved(RouterHash const rh)
+        {
+            GenerationPtr g = std::atomic_load(&m_current);
+
+            {
+                std::lock_guard<std::mutex> lock(g->mutex);
+                g->keys.erase(rh);
+            }
+
+            m_table->failed(rh);
+        }
+
+        void DHTFacade::update(RouterHash const &rh, bool seen)
+        {
+            if(rh == m_local)
+                return;
+
+            RouterHash questionable;
+            if(!m_table->update(rh, learn(rh), seen, questionable))
+                return;
+
+            // A live connection answers for the peer, otherwise we try to connect
+            if(m_ctx.getOutMsgDisp().getTransport()->isConnected(questionable)) {
+                update(questionable, true);
+                return;
+            }
+
+            auto ri = m_ctx.getDatabase()->getRouterInfoPtr(questionable);
+            if(!ri) {
+                m_table->failed(questionable);
+                return;
+            }
+
+            I2P_LOG_SCOPED_TAG(m_log, "RouterHash", questionable);
+            I2P_LOG(m_log, debug) << "pinging least recently seen router";
+
+            m_table->pinging(questionable);
+            m_ctx.getOutMsgDisp().getTransport()->connect(*ri);
         }
 
         SearchManager& DHTFacade::getSearchManager()
         {
             return m_searchManager;
         }
+
+        Floodfill& DHTFacade::getFloodfill()
+        {
+            return m_floodfill;
+        }
+
+        DHTFacade::GenerationPtr DHTFacade::build(std::string const &date, std::vector<RouterHash> const &hashes)
+        {
+            auto g = std::make_shared<Generation>();
+            g->date = date;
+
+            g->keys.reserve(hashes.size());
+            for(auto& h: hashes)
+                g->keys[h] = Kademlia::makeKey(h, date);
+
+            return g;
+        }
+
+        Kademlia::key_type DHTFacade::learn(RouterHash const &rh)
+        {
+            GenerationPtr g = std::atomic_load(&m_current);
+
+            {
+                std::lock_guard<std::mutex> lock(g->mutex);
+
+                auto itr = g->keys.find(rh);
+                if(itr != g->keys.end())
+                    return itr->second;
+            }
+
+            Kademlia::key_type k = Kademlia::makeKey(rh, g->date);
+
+            std::lock_guard<std::mutex> lock(g->mutex);
+            g->keys[rh] = k;
+
+            return k;
+        }
+
+        std::vector<RouterHash> DHTFacade::knownRouters() const
+        {
+            GenerationPtr g = std::atomic_load(&m_current);
+
+            std::lock_guard<std::mutex> lock(g->mutex);
+
+            std::vector<RouterHash> hashes;
+            hashes.reserve(g->keys.size());
+            for(auto& k: g->keys)
+                hashes.push_back(k.first);
+
+            return hashes;
+        }
+
+        void DHTFacade::schedule()
+        {
+            const boost::posix_time::ptime midnight(boost::posix_time::second_clock::universal_time().date() + boost::gregorian::days(1));
+            const std::string date = boost::gregorian::to_iso_string(midnight.date());
+
+            m_precomputeTimer.expires_at(midnight - boost::posix_time::minutes(5));
+            m_precomputeTimer.async_wait(boost::bind(&DHTFacade::precomputeCallback, this, boost::asio::placeholders::error, date));
+
+            m_rotateTimer.expires_at(midnight);
+            m_rotateTimer.async_wait(boost::bind(&DHTFacade::rotateCallback, this, boost::asio::placeholders::error, date));
+        }
+
+        void DHTFacade::precomputeCallback(const boost::system::error_code &e, std::string const date)
+        {
+            if(e == boost::asio::error::operation_aborted)
+                return;
+
+            if(m_worker.joinable())
+                m_worker.join();
+
+            // The routers known by now, including those learned today
+            std::vector<RouterHash> hashes = knownRouters();
+
+            I2P_LOG(m_log, debug) << "computing routing keys for " << date << " for " << hashes.size() << " routers";
+
+            m_worker = std::thread([this, date, hashes]() {
+                GenerationPtr g = build(date, hashes);
+
+                std::lock_guard<std::mutex> lock(m_nextMutex);
+                m_next = std::move(g);
+            });
+        }
+
+        void DHTFacade::rotateCallback(const boost::system::error_code &e, std::string const date)
+        {
+            if(e == boost::asio::error::operation_aborted)
+                return;
+
+            if(m_worker.joinable())
+                m_worker.join();
+
+            GenerationPtr g;
+            {
+                std::lock_guard<std::mutex> lock(m_nextMutex);
+                g = std::move(m_next);
+            }
+
+            // The timers may have been armed late, e.g. after the clock jumped
+            if(!g || g->date != date) {
+                I2P_LOG(m_log, debug) << "routing keys for " << date << " were not precomputed, computing now";
+                g = build(date, knownRouters());
+            }
+
+            std::atomic_store(&m_current, g);
+
+            // Routers learned since the keys were precomputed are cached now
+            m_table->rekey(Kademlia::makeKey(m_local, date), [this](RouterHash const &rh) -> Kademlia::key_type {
+                return learn(rh);
+            });
+
+            I2P_LOG(m_log, debug) << "rotated routing keys to " << date << ", " << m_table->size() << " routers in the routing table";
+
+            schedule();
+        }
     }
 }
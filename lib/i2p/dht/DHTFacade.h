@@ -5,34 +5,70 @@
 #ifndef _DHTFACADE_H_INCLUDE_GUARD
 #define _DHTFACADE_H_INCLUDE_GUARD
 
-#include <forward_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
+#include <i2pcpp/Log.h>
+
+#include <boost/signals2.hpp>
+
+#include "Floodfill.h"
 #include "Kademlia.h"
 #include "SearchManager.h"
 
+#include "../kad/RoutingTable.h"
+
 namespace i2pcpp {
     class RouterContext;
+    class RouterInfo;
 
     namespace DHT {
 
         /**
          * Facade class for easy use of the DHT functionality.
+         *
+         * Lookups start from the closest routers in a bounded
+         *  i2pcpp::Kad::RoutingTable. The table is seeded from the
+         *  i2pcpp::RouterDirectory and follows it as routers are added to and
+         *  removed from it. Routers we connect to or receive DatabaseStore
+         *  messages from are marked as seen. When a bucket is full, its least
+         *  recently seen router is pinged by connecting to it.
+         *
+         * Routing keys change every UTC day. The keys of the known routers
+         *  are cached per day. The next day's keys are computed in the
+         *  background a few minutes before midnight, for the routers known
+         *  then, and replace the cache at midnight, when the routing table is
+         *  rekeyed in place under its own mutex. The key of a router learned
+         *  later is computed and cached when it is first seen.
          */
         class DHTFacade {
 
         public:
             /**
-             * Constructs from a boost::asio::io_service, local router hash (where
-             * lookups are relative to), and forward_list of initial RouterHashes.
+             * Constructs from a boost::asio::io_service and the local router
+             * hash (where lookups are relative to). The routing table is
+             * seeded with the routers in the i2pcpp::RouterDirectory.
              */
             DHTFacade(boost::asio::io_service &ios,
                     RouterHash const &local,
-                    std::forward_list<RouterHash> const &hashes,
                     RouterContext &ctx);
 
             DHTFacade(const DHTFacade&) = delete;
             DHTFacade& operator=(DHTFacade&) = delete;
 
+            ~DHTFacade();
+
+            /**
+             * Starts the timers which rotate the routing keys at midnight,
+             *  subscribes to the changes of the i2pcpp::RouterDirectory and
+             *  loads the floodfill index.
+             */
+            void begin();
+
             /**
              * Starts a lookup operation for a given i2pcpp::RouterHash.
              * @param hash the hash of the router to lookup
@@ -40,11 +76,119 @@ namespace i2pcpp {
              */
             bool lookup(const RouterHash& hash);
 
+            /**
+             * @return the routing key of \a hash for the current day, from
+             *  the cache if \a hash is a known router
+             */
+            Kademlia::key_type getRoutingKey(RouterHash const &hash) const;
+
+            /**
+             * Called when a connection to \a rh has been established. Marks
+             *  \a rh as seen in the routing table.
+             */
+            void connected(RouterHash const rh);
+
+            /**
+             * Called when a connection to \a rh could not be established.
+             *  Replaces \a rh in the routing table.
+             */
+            void connectionFailure(RouterHash const rh);
+
+            /**
+             * Called when a DatabaseStore message about \a k was received
+             *  from \a from. Marks \a from as seen.
+             */
+            void databaseStore(RouterHash const from, StaticByteArray<32> const k, bool isRouterInfo);
+
             SearchManager& getSearchManager();
 
+            Floodfill& getFloodfill();
+
         private:
-            Kademlia m_dht;
+            /**
+             * The routing keys of the known routers for one day.
+             */
+            struct Generation {
+                std::string date; ///< yyyyMMdd
+                std::unordered_map<RouterHash, Kademlia::key_type> keys;
+                mutable std::mutex mutex; ///< Guards keys, to which learned routers are added
+            };
+
+            typedef std::shared_ptr<Generation> GenerationPtr;
+
+            /**
+             * Computes the keys of \a hashes for \a date.
+             */
+            static GenerationPtr build(std::string const &date, std::vector<RouterHash> const &hashes);
+
+            /**
+             * @return the routing key of \a rh for the current day, which
+             *  is cached from now on
+             */
+            Kademlia::key_type learn(RouterHash const &rh);
+
+            /**
+             * @return the routers whose keys are cached for the current day
+             */
+            std::vector<RouterHash> knownRouters() const;
+
+            /**
+             * Adds \a rh, which has been added to the
+             *  i2pcpp::RouterDirectory, to the routing table.
+             */
+            void routerAdded(RouterHash const rh);
+
+            /**
+             * Drops the cached keys of \a rh, which has been removed from
+             *  the i2pcpp::RouterDirectory, and replaces it in the routing
+             *  table.
+             */
+            void routerRemoved(RouterHash const rh);
+
+            /**
+             * Adds \a rh to the routing table and pings the entry it
+             *  contends with, if that is questionable.
+             */
+            void update(RouterHash const &rh, bool seen);
+
+            /**
+             * Arms the timers for the next midnight.
+             */
+            void schedule();
+
+            /**
+             * Starts computing the next day's keys on a worker thread.
+             */
+            void precomputeCallback(const boost::system::error_code &e, std::string const date);
+
+            /**
+             * Swaps in the keys computed for the new day.
+             */
+            void rotateCallback(const boost::system::error_code &e, std::string const date);
+
+            RouterContext &m_ctx;
+
+            RouterHash m_local;
+
+            GenerationPtr m_current; ///< Only accessed with std::atomic_load and std::atomic_store
+
+            std::unique_ptr<Kad::RoutingTable> m_table;
+
+            GenerationPtr m_next;
+            std::thread m_worker;
+            std::mutex m_nextMutex;
+
+            boost::asio::deadline_timer m_precomputeTimer;
+            boost::asio::deadline_timer m_rotateTimer;
+
             SearchManager m_searchManager;
+
+            Floodfill m_floodfill;
+
+            boost::signals2::scoped_connection m_addedConnection;
+            boost::signals2::scoped_connection m_removedConnection;
+
+            i2p_logger_mt m_log;
         };
     }
 }
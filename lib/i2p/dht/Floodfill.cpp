@@ -0,0 +1,254 @@
+/**
+ * @file Floodfill.cpp
+ * @brief Implements Floodfill.h
+ */
+#include "Floodfill.h"
+
+#include "../RouterContext.h"
+#include "../RouterDirectory.h"
+
+#include "../i2np/DatabaseLookup.h"
+#include "../i2np/DatabaseSearchReply.h"
+#include "../i2np/DatabaseStore.h"
+#include "../i2np/DeliveryStatus.h"
+#include "../i2np/TunnelGateway.h"
+
+#include <i2pcpp/util/gzip.h>
+#include <i2pcpp/datatypes/RouterInfo.h>
+
+#include <botan/pipe.h>
+
+#include <algorithm>
+#include <queue>
+
+namespace i2pcpp {
+    namespace DHT {
+        Floodfill::Floodfill(RouterContext &ctx) :
+            m_ctx(ctx),
+            m_enabled(ctx.getDatabase()->getConfigValue("floodfill", "0") == "1"),
+            m_log(boost::log::keywords::channel = "FF") {}
+
+        bool Floodfill::isEnabled() const
+        {
+            return m_enabled;
+        }
+
+        void Floodfill::begin()
+        {
+            if(!m_enabled)
+                return;
+
+            RouterDirectory &dir = m_ctx.getDatabase()->getDirectory();
+
+            // Subscribed first, so that no router added meanwhile is missed
+            m_addedConnection = dir.registerAdded(boost::bind(&Floodfill::routerAdded, this, _1, _2));
+            m_removedConnection = dir.registerRemoved(boost::bind(&Floodfill::routerRemoved, this, _1));
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            for(auto& h: dir.getAll()) {
+                auto ri = m_ctx.getDatabase()->getRouterInfoPtr(h);
+                if(ri && !isKnown(*ri))
+                    add(*ri, compress(*ri));
+            }
+
+            I2P_LOG(m_log, info) << "floodfill mode enabled, serving " << m_routers.size() << " routers of which " << m_floodfills.size() << " are floodfills";
+        }
+
+        void Floodfill::lookup(RouterHash const &from, I2NP::DatabaseLookup const &dl)
+        {
+            I2P_LOG_SCOPED_TAG(m_log, "RouterHash", from);
+
+            // We cannot encrypt the reply, and must not answer in plaintext
+            if(dl.isReplyEncrypted()) {
+                I2P_LOG(m_log, debug) << "dropping lookup asking for an encrypted reply";
+                return;
+            }
+
+            I2NP::MessagePtr msg;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                auto itr = m_routers.find(dl.getKey());
+                if(itr != m_routers.end()) {
+                    I2P_LOG(m_log, debug) << "answering lookup with DatabaseStore";
+
+                    msg = std::make_shared<I2NP::DatabaseStore>(dl.getKey(), I2NP::DatabaseStore::DataType::ROUTER_INFO, 0, itr->second.data);
+                } else {
+                    std::unordered_set<RouterHash> excluded(dl.getExcludedPeers().cbegin(), dl.getExcludedPeers().cend());
+
+                    // An all-zero hash marks an exploratory lookup, which asks for non-floodfills
+                    bool exploratory = excluded.count(RouterHash());
+
+                    excluded.insert(dl.getFrom());
+                    excluded.insert(m_ctx.getIdentity()->getHash());
+
+                    auto hashes = closest(dl.getKey(), FLOODFILL_REPLY_COUNT, excluded, !exploratory);
+
+                    I2P_LOG(m_log, debug) << "answering lookup with DatabaseSearchReply of " << hashes.size() << " peers";
+
+                    msg = std::make_shared<I2NP::DatabaseSearchReply>(dl.getKey(), hashes, m_ctx.getIdentity()->getHash());
+                }
+            }
+
+            reply(dl.getFrom(), dl.getSendReplyTo(), msg);
+        }
+
+        void Floodfill::store(RouterHash const &from, I2NP::DatabaseStore const &dsm, RouterInfo const &ri)
+        {
+            if(!m_enabled)
+                return;
+
+            I2P_LOG_SCOPED_TAG(m_log, "RouterHash", from);
+
+            const RouterHash rh = ri.getIdentity().getHash();
+
+            bool added;
+            std::list<RouterHash> peers;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                added = add(ri, dsm.getData());
+
+                /* Stores are only flooded if they carry a reply token, and we
+                 * flood without one, so that floods do not bounce around.
+                 */
+                if(added && dsm.getReplyToken()) {
+                    std::unordered_set<RouterHash> excluded = { from, rh, m_ctx.getIdentity()->getHash() };
+                    peers = closest(rh, FLOODFILL_FLOOD_COUNT, excluded, true);
+                }
+            }
+
+            if(dsm.getReplyToken()) {
+                I2NP::MessagePtr ds(new I2NP::DeliveryStatus(dsm.getReplyToken(), Date()));
+                reply(dsm.getReplyGateway(), dsm.getReplyTunnelId(), ds);
+            }
+
+            if(peers.empty())
+                return;
+
+            I2P_LOG(m_log, debug) << "flooding RouterInfo to " << peers.size() << " floodfills";
+
+            for(auto& p: peers) {
+                I2NP::MessagePtr flood(new I2NP::DatabaseStore(rh, I2NP::DatabaseStore::DataType::ROUTER_INFO, 0, dsm.getData()));
+                m_ctx.getOutMsgDisp().sendMessage(p, flood);
+            }
+        }
+
+        bool Floodfill::add(RouterInfo const &ri, ByteArray const &data)
+        {
+            if(isKnown(ri))
+                return false;
+
+            const RouterHash rh = ri.getIdentity().getHash();
+
+            Entry &e = m_routers[rh];
+            e.published = ri.getPublished().serialize();
+            e.data = data;
+            e.floodfill = (ri.getOptions().getValue("caps").find('f') != std::string::npos);
+
+            if(e.floodfill)
+                m_floodfills.insert(rh);
+            else
+                m_floodfills.erase(rh);
+
+            return true;
+        }
+
+        bool Floodfill::isKnown(RouterInfo const &ri) const
+        {
+            auto itr = m_routers.find(ri.getIdentity().getHash());
+
+            return itr != m_routers.end() && !(itr->second.published < ri.getPublished().serialize());
+        }
+
+        void Floodfill::routerAdded(RouterHash const rh, RouterInfo const &ri)
+        {
+            // Routers we were sent are indexed by store(), compressed as received
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if(isKnown(ri))
+                    return;
+            }
+
+            ByteArray data = compress(ri);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            add(ri, data);
+        }
+
+        void Floodfill::routerRemoved(RouterHash const rh)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            m_routers.erase(rh);
+            m_floodfills.erase(rh);
+        }
+
+        ByteArray Floodfill::compress(RouterInfo const &ri)
+        {
+            Botan::Pipe gzPipe(new Gzip_Compression);
+            gzPipe.start_msg();
+            gzPipe.write(ri.serialize());
+            gzPipe.end_msg();
+
+            ByteArray data(gzPipe.remaining());
+            gzPipe.read(data.data(), data.size());
+
+            return data;
+        }
+
+        std::list<RouterHash> Floodfill::closest(StaticByteArray<32> const &key, std::size_t count, std::unordered_set<RouterHash> const &excluded, bool floodfill) const
+        {
+            auto dht = m_ctx.getDHT();
+            const Kademlia::key_type target = dht->getRoutingKey(key);
+
+            typedef std::pair<Kademlia::key_type, RouterHash> Candidate;
+            std::priority_queue<Candidate> heap; // Furthest of the closest on top
+
+            auto consider = [&](RouterHash const &rh) {
+                if(excluded.count(rh))
+                    return;
+
+                Kademlia::key_type d = dht->getRoutingKey(rh);
+                std::transform(d.cbegin(), d.cend(), target.cbegin(), d.begin(), std::bit_xor<unsigned char>());
+
+                if(heap.size() < count)
+                    heap.emplace(d, rh);
+                else if(d < heap.top().first) {
+                    heap.pop();
+                    heap.emplace(d, rh);
+                }
+            };
+
+            if(floodfill) {
+                for(auto& rh: m_floodfills)
+                    consider(rh);
+            } else {
+                for(auto& r: m_routers)
+                    if(!r.second.floodfill)
+                        consider(r.first);
+            }
+
+            std::list<RouterHash> result;
+            while(!heap.empty()) {
+                result.push_front(heap.top().second);
+                heap.pop();
+            }
+
+            return result;
+        }
+
+        void Floodfill::reply(RouterHash const &to, uint32_t tunnelId, I2NP::MessagePtr const &msg)
+        {
+            if(tunnelId) {
+                I2NP::MessagePtr tg(new I2NP::TunnelGateway(tunnelId, msg->toBytes()));
+                m_ctx.getOutMsgDisp().sendMessage(to, tg);
+            } else
+                m_ctx.getOutMsgDisp().sendMessage(to, msg);
+        }
+    }
+}
@@ -0,0 +1,146 @@
+/**
+ * @file Floodfill.h
+ * @brief Defines the i2pcpp::DHT::Floodfill class.
+ */
+#ifndef DHTFLOODFILL_H
+#define DHTFLOODFILL_H
+
+#include "Kademlia.h"
+
+#include "../i2np/Message.h"
+
+#include <i2pcpp/Log.h>
+
+#include <i2pcpp/datatypes/ByteArray.h>
+#include <i2pcpp/datatypes/RouterHash.h>
+
+#include <boost/signals2.hpp>
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#define FLOODFILL_REPLY_COUNT 3
+#define FLOODFILL_FLOOD_COUNT 3
+
+namespace i2pcpp {
+    class RouterContext;
+    class RouterInfo;
+
+    namespace I2NP { class DatabaseLookup; class DatabaseStore; }
+
+    namespace DHT {
+        /**
+         * Serves the netDb to other routers when floodfill mode is enabled.
+         * The RouterInfos we know of are kept in memory, compressed as they
+         *  are sent in an i2pcpp::I2NP::DatabaseStore, together with the set
+         *  of floodfill routers. Lookups are answered from this index only,
+         *  so that answering never waits for the i2pcpp::Database. The index
+         *  follows the i2pcpp::RouterDirectory as routers are added to and
+         *  removed from it.
+         * @note LeaseSets are not stored, as they cannot be verified yet
+         */
+        class Floodfill {
+            public:
+                Floodfill(RouterContext &ctx);
+                Floodfill(const Floodfill &) = delete;
+                Floodfill& operator=(Floodfill &) = delete;
+
+                /**
+                 * @return true if the router is a floodfill
+                 */
+                bool isEnabled() const;
+
+                /**
+                 * Loads the RouterInfos in the i2pcpp::RouterDirectory in to
+                 *  the index and subscribes to its changes, if floodfill mode
+                 *  is enabled.
+                 */
+                void begin();
+
+                /**
+                 * Answers \a dl with an i2pcpp::I2NP::DatabaseStore if we
+                 *  hold its key, otherwise with an
+                 *  i2pcpp::I2NP::DatabaseSearchReply listing the floodfills
+                 *  closest to the key (or, for exploratory lookups, the closest
+                 *  other routers) that are not excluded by \a dl.
+                 */
+                void lookup(RouterHash const &from, I2NP::DatabaseLookup const &dl);
+
+                /**
+                 * Adds \a ri, received in \a dsm and already verified, to the
+                 *  index. If \a dsm asks for it, its receipt is acknowledged
+                 *  and, if \a ri is newer than the copy we had, it is flooded to
+                 *  the floodfills closest to its key.
+                 */
+                void store(RouterHash const &from, I2NP::DatabaseStore const &dsm, RouterInfo const &ri);
+
+            private:
+                struct Entry {
+                    ByteArray published; ///< Serialized i2pcpp::Date, compares chronologically
+                    ByteArray data; ///< Compressed i2pcpp::RouterInfo
+                    bool floodfill;
+                };
+
+                /**
+                 * Adds \a ri to the index unless we have a copy at least as
+                 *  new. Must be called with m_mutex held.
+                 * @return true if \a ri was added
+                 */
+                bool add(RouterInfo const &ri, ByteArray const &data);
+
+                /**
+                 * @return true if the index holds a copy of \a ri at least
+                 *  as new. Must be called with m_mutex held.
+                 */
+                bool isKnown(RouterInfo const &ri) const;
+
+                /**
+                 * Adds \a ri, which has been added to the
+                 *  i2pcpp::RouterDirectory, unless we already have it.
+                 */
+                void routerAdded(RouterHash const rh, RouterInfo const &ri);
+
+                /**
+                 * Drops \a rh, which has been removed from the
+                 *  i2pcpp::RouterDirectory.
+                 */
+                void routerRemoved(RouterHash const rh);
+
+                /**
+                 * @return \a ri serialized and compressed, as sent in an
+                 *  i2pcpp::I2NP::DatabaseStore
+                 */
+                static ByteArray compress(RouterInfo const &ri);
+
+                /**
+                 * @return up to \a count floodfills (or non-floodfills, if
+                 *  \a floodfill is false) closest to \a key, excluding
+                 *  \a excluded. Must be called with m_mutex held.
+                 */
+                std::list<RouterHash> closest(StaticByteArray<32> const &key, std::size_t count, std::unordered_set<RouterHash> const &excluded, bool floodfill) const;
+
+                /**
+                 * Sends \a msg to \a to, through the tunnel \a tunnelId at
+                 *  gateway \a to if \a tunnelId is not 0.
+                 */
+                void reply(RouterHash const &to, uint32_t tunnelId, I2NP::MessagePtr const &msg);
+
+                RouterContext &m_ctx;
+                bool m_enabled;
+
+                std::unordered_map<RouterHash, Entry> m_routers;
+                std::unordered_set<RouterHash> m_floodfills;
+                mutable std::mutex m_mutex;
+
+                boost::signals2::scoped_connection m_addedConnection;
+                boost::signals2::scoped_connection m_removedConnection;
+
+                i2p_logger_mt m_log;
+        };
+    }
+}
+
+#endif
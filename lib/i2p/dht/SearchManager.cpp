@@ -18,6 +18,8 @@ namespace i2pcpp {
             m_ios(ios),
             m_ctx(ctx),
             m_nlc(m_ios, boost::posix_time::time_duration(5, 0, 0)),
+            m_alpha(std::stoi(ctx.getDatabase()->getConfigValue("dht_alpha", "3"))),
+            m_queryTimeout(std::stoi(ctx.getDatabase()->getConfigValue("dht_query_timeout", "5000"))),
             m_log(boost::log::keywords::channel = "SM") {}
 
         boost::signals2::connection SearchManager::registerSuccess(SuccessSignal::slot_type const &sh)
@@ -30,7 +32,7 @@ namespace i2pcpp {
             return m_failureSignal.connect(fh);
         }
 
-        void SearchManager::createSearch(Kademlia::key_type const &k, Kademlia::result_type const &startingPoints)
+        void SearchManager::createSearch(Kademlia::key_type const &k, std::vector<Kademlia::value_type> const &startingPoints)
         {
             // If the key is in the NLC, immediately trigger failure
             if(m_nlc.contains(k)) {
@@ -41,31 +43,29 @@ namespace i2pcpp {
             std::lock_guard<std::mutex> lock(m_searchesMutex);
             
             // If we're already searching for this key, don't start
-            if(m_searches.get<0>().count(k))
+            if(m_searches.count(k))
                 return;
 
-            SearchState ss(k, startingPoints.first->second);
+            Search &s = m_searches.emplace(k, Search(SearchState(k, startingPoints.front()))).first->second;
+            s.routingKey = m_ctx.getDHT()->getRoutingKey(k);
 
-            for(auto it = std::next(startingPoints.first); it != startingPoints.second; ++it)
-                ss.addAlternate(it->second);
+            for(auto it = std::next(startingPoints.cbegin()); it != startingPoints.cend(); ++it)
+                addAlternate(s, *it, RouterHash());
 
-            m_searches.insert(ss);
-
-            // Start the timeout-timer (2min)
-            m_timers[k] = std::make_unique<boost::asio::deadline_timer>(
+            // Start the timeout-timer (1min)
+            s.timer = std::make_unique<boost::asio::deadline_timer>(
                 m_ios, boost::posix_time::time_duration(0, 1, 0)
             );
-            m_timers[k]->async_wait(boost::bind(
+            s.timer->async_wait(boost::bind(
                 &SearchManager::timeout, this, boost::asio::placeholders::error, k
             ));
 
             I2P_LOG(m_log, debug) << "created SearchState for "
                                   << Base64::encode(ByteArray(k.cbegin(), k.cend()))
-                                  << " starting with " << ss.current;
+                                  << " starting with " << s.state.current;
 
-            m_ctx.getOutMsgDisp().getTransport()->connect(
-                m_ctx.getDatabase()->getRouterInfo(ss.current)
-            );
+            query(s, s.state.current);
+            fill(k);
         }
 
         void SearchManager::timeout(const boost::system::error_code& e, Kademlia::key_type const k)
@@ -79,93 +79,187 @@ namespace i2pcpp {
             cancel(k);
         }
 
+        void SearchManager::queryTimeout(const boost::system::error_code& e, Kademlia::key_type const k, RouterHash const peer)
+        {
+            if(e)
+                return;
+
+            std::lock_guard<std::mutex> lock(m_searchesMutex);
+
+            auto itr = m_searches.find(k);
+            if(itr == m_searches.end() || !itr->second.queries.erase(peer))
+                return;
+
+            I2P_LOG_SCOPED_TAG(m_log, "RouterHash", peer);
+            I2P_LOG(m_log, debug) << "query timed out, trying the next closest peer";
+
+            itr->second.state.exclude(peer);
+            fill(k);
+        }
+
         void SearchManager::cancel(Kademlia::key_type const &k)
         {
             I2P_LOG(m_log, debug) << "cancelling " << Base64::encode(ByteArray(k.cbegin(), k.cend()));
-            SearchStateByGoal::iterator itr = m_searches.get<0>().find(k);
+            auto itr = m_searches.find(k);
             
-            if(itr != m_searches.get<0>().end()) {
+            if(itr != m_searches.end()) {
                 m_ios.post(boost::bind(boost::ref(m_failureSignal), k));
 
-                m_searches.get<0>().erase(itr);
-                m_timers.erase(k);
+                m_searches.erase(itr);
 
                 m_nlc.insert(k);
             }
         }
 
-        void SearchManager::connected(RouterHash const rh)
+        void SearchManager::addAlternate(Search &s, RouterHash const &rh, RouterHash const &referrer)
         {
-            I2P_LOG_SCOPED_TAG(m_log, "RouterHash", rh);
-            I2P_LOG(m_log, debug) << "connection established";
+            if(rh == m_ctx.getIdentity()->getHash())
+                return;
 
-            std::lock_guard<std::mutex> lock(m_searchesMutex);
+            Kademlia::key_type distance = m_ctx.getDHT()->getRoutingKey(rh);
+            std::transform(distance.cbegin(), distance.cend(), s.routingKey.cbegin(), distance.begin(), std::bit_xor<unsigned char>());
 
-            if(m_searches.get<1>().count(rh)) {
-                I2P_LOG(m_log, debug) << "found RouterHash in pending search table (after connected)";
+            s.state.addAlternate(rh, distance);
+            if(referrer != RouterHash())
+                s.referrers.insert(std::make_pair(rh, referrer));
+        }
 
-                SearchStateByCurrent::iterator itr = m_searches.get<1>().find(rh);
-                const SearchState& ss = *itr;
+        bool SearchManager::fill(Kademlia::key_type const &k)
+        {
+            auto itr = m_searches.find(k);
+            if(itr == m_searches.end())
+                return false;
+
+            Search &s = itr->second;
+            TransportPtr t = m_ctx.getOutMsgDisp().getTransport();
+
+            while(s.queries.size() < m_alpha && s.state.countAlternates()) {
+                /* Among the closest few, a peer we are connected to saves
+                 * establishing a session.
+                 */
+                RouterHash next = s.state.getNext();
+                for(auto& a: s.state.getAlternates(m_alpha * 2)) {
+                    if(t->isConnected(a)) {
+                        next = a;
+                        break;
+                    }
+                }
 
-                if(ss.state == SearchState::CurrentState::CONNECTING) {
-                    I2P_LOG(m_log, debug) << "found good SearchState, sending DatabaseLookup";
+                s.state.takeAlternate(next);
+                query(s, next);
+            }
 
-                    m_searches.get<1>().modify(
-                        itr, ModifyState(SearchState::CurrentState::LOOKUP_SENT)
-                    );
+            if(s.queries.empty()) {
+                I2P_LOG(m_log, debug) << "no more alternates left, search failed";
+                cancel(k);
+                return false;
+            }
 
-                    I2NP::MessagePtr dbl(new I2NP::DatabaseLookup(
-                        ss.goal, m_ctx.getIdentity()->getHash(), 0, ss.getExcluded()
-                    ));
-                    m_ctx.getOutMsgDisp().sendMessage(rh, dbl);
+            return true;
+        }
+
+        void SearchManager::query(Search &s, RouterHash const &peer)
+        {
+            TransportPtr t = m_ctx.getOutMsgDisp().getTransport();
+
+            I2P_LOG_SCOPED_TAG(m_log, "RouterHash", peer);
+
+            Query::State state;
+            RouterHash referrer;
+            auto ri = m_ctx.getDatabase()->getRouterInfoPtr(peer);
+            if(ri)
+                state = (t->isConnected(peer) ? Query::State::LOOKUP_SENT : Query::State::CONNECTING);
+            else {
+                /* We only know the hash of the peer, so ask the peer which
+                 * told us about it for its RouterInfo.
+                 */
+                auto r = s.referrers.find(peer);
+                if(r == s.referrers.end() || !t->isConnected(r->second)) {
+                    I2P_LOG(m_log, debug) << "could not try alternate because it doesn't exist";
+                    return;
                 }
+
+                referrer = r->second;
+                state = Query::State::FETCHING_INFO;
+            }
+
+            Query &q = s.queries[peer];
+            q.timer = std::make_unique<boost::asio::deadline_timer>(
+                m_ios, boost::posix_time::milliseconds(m_queryTimeout)
+            );
+            q.timer->async_wait(boost::bind(
+                &SearchManager::queryTimeout, this, boost::asio::placeholders::error, s.state.goal, peer
+            ));
+
+            switch(state) {
+                case Query::State::LOOKUP_SENT:
+                    sendLookup(s, peer, q);
+                    break;
+
+                case Query::State::CONNECTING:
+                    I2P_LOG(m_log, debug) << "connecting to alternate";
+                    q.state = state;
+                    t->connect(*ri);
+                    break;
+
+                case Query::State::FETCHING_INFO:
+                    {
+                        I2P_LOG(m_log, debug) << "received unknown peer hash, asking for its RouterInfo";
+                        q.state = state;
+
+                        I2NP::MessagePtr dbl(new I2NP::DatabaseLookup(
+                            peer, m_ctx.getIdentity()->getHash(), 0
+                        ));
+                        m_ctx.getOutMsgDisp().sendMessage(referrer, dbl);
+                    }
+                    break;
             }
         }
 
-        void SearchManager::connectionFailure(RouterHash const rh)
+        void SearchManager::sendLookup(Search &s, RouterHash const &peer, Query &q)
         {
-            I2P_LOG_SCOPED_TAG(m_log, "RouterHash", rh);
-            I2P_LOG(m_log, debug) << "connection failed";
+            I2P_LOG(m_log, debug) << "sending DatabaseLookup to " << peer;
 
+            q.state = Query::State::LOOKUP_SENT;
 
-            std::lock_guard<std::mutex> lock(m_searchesMutex);
+            I2NP::MessagePtr dbl(new I2NP::DatabaseLookup(
+                s.state.goal, m_ctx.getIdentity()->getHash(), 0, s.state.getExcluded()
+            ));
+            m_ctx.getOutMsgDisp().sendMessage(peer, dbl);
+        }
 
-            if(!m_searches.get<1>().count(rh))
-                return; // Not looking for this router hash
+        void SearchManager::connected(RouterHash const rh)
+        {
+            I2P_LOG_SCOPED_TAG(m_log, "RouterHash", rh);
+            I2P_LOG(m_log, debug) << "connection established";
 
-            SearchStateByCurrent::iterator itr = m_searches.get<1>().find(rh);
-            const SearchState& ss = *itr;
+            std::lock_guard<std::mutex> lock(m_searchesMutex);
 
-            if(!ss.countAlternates()) {
-                I2P_LOG(m_log, debug) << "connection failed and there are no more alternates,"
-                                         "search failed";
-                return cancel(ss.goal);
+            for(auto& s: m_searches) {
+                auto q = s.second.queries.find(rh);
+                if(q != s.second.queries.end() && q->second.state == Query::State::CONNECTING)
+                    sendLookup(s.second, rh, q->second);
             }
+        }
 
-            m_searches.get<1>().modify(itr, PopAlternates());
-            while(!m_ctx.getDatabase()->routerExists(ss.current)) {
-                I2P_LOG(m_log, debug) << "could not try alternate " << ss.current
-                                      << " because it doesn't exist";
+        void SearchManager::connectionFailure(RouterHash const rh)
+        {
+            I2P_LOG_SCOPED_TAG(m_log, "RouterHash", rh);
+            I2P_LOG(m_log, debug) << "connection failed";
 
-                // Skip this bad alternate
-                // If no alternates are left, stop the lookup
-                if(ss.countAlternates())
-                    m_searches.get<1>().modify(itr, PopAlternates());
-                else {
-                    I2P_LOG(m_log, debug) << "no more alternates left, search failed";
+            std::lock_guard<std::mutex> lock(m_searchesMutex);
 
-                    return cancel(ss.goal);
+            // fill() may cancel searches, so they are collected first
+            std::vector<Kademlia::key_type> affected;
+            for(auto& s: m_searches) {
+                if(s.second.queries.erase(rh)) {
+                    s.second.state.exclude(rh);
+                    affected.push_back(s.first);
                 }
             }
 
-            // Exclude bad router and start new connection
-            m_searches.get<1>().modify(itr, ModifyState(rh));
-            I2P_LOG(m_log, debug) << "connecting to alternate " << ss.current;
-
-            m_ctx.getOutMsgDisp().getTransport()->connect(
-                m_ctx.getDatabase()->getRouterInfo(ss.current)
-            );
-           
+            for(auto& k: affected)
+                fill(k);
         }
 
         void SearchManager::searchReply(RouterHash const from, StaticByteArray<32> const query, std::list<RouterHash> const hashes)
@@ -175,45 +269,22 @@ namespace i2pcpp {
 
             std::lock_guard<std::mutex> lock(m_searchesMutex);
 
-            if(!m_searches.get<0>().count(query))
+            auto itr = m_searches.find(query);
+            if(itr == m_searches.end())
                 return; // Not looking for this router hash
 
             I2P_LOG(m_log, debug) << "found RouterHash in pending search table (after search reply)";
 
-            SearchStateByGoal::iterator itr = m_searches.get<0>().find(query);
-            const SearchState& ss = *itr;
-            
-            if(ss.state == SearchState::CurrentState::LOOKUP_SENT) {
-                for(const auto& h: hashes) // Add new alternates
-                    m_searches.get<0>().modify(itr, PushAlternates(h));
+            Search &s = itr->second;
 
-                if(!ss.countAlternates()) {
-                    I2P_LOG(m_log, debug) << "no more alternates left, search failed";
-                    return cancel(ss.goal);
-                }
-                
-                // Select the next alternate
-                m_searches.get<0>().modify(itr, PopAlternates());
-                m_searches.get<0>().modify(itr, ModifyState(from));
+            // Late replies, from peers whose query timed out, still help
+            for(const auto& h: hashes)
+                addAlternate(s, h, from);
 
-                if(!m_ctx.getDatabase()->routerExists(ss.current)) {
-                    I2P_LOG(m_log, debug) << "received unknown peer hash " << ss.current
-                                          << ", asking for its RouterInfo";
+            s.queries.erase(from);
+            s.state.exclude(from);
 
-                    I2NP::MessagePtr dbl(new I2NP::DatabaseLookup(
-                        ss.current, m_ctx.getIdentity()->getHash(), 0, ss.getExcluded()
-                    ));
-                    m_ctx.getOutMsgDisp().sendMessage(from, dbl);
-                } else {
-                    I2P_LOG(m_log, debug) << "received known peer hash " << ss.current
-                                          << ", connecting";
-                    m_ctx.getOutMsgDisp().getTransport()->connect(
-                        m_ctx.getDatabase()->getRouterInfo(ss.current)
-                    );
-                }
-                
-            }
-            
+            fill(query);
         }
 
         void SearchManager::databaseStore(RouterHash const from, StaticByteArray<32> const k, bool isRouterInfo)
@@ -223,21 +294,18 @@ namespace i2pcpp {
 
             std::lock_guard<std::mutex> lock(m_searchesMutex);
 
-            if(m_searches.get<0>().count(k)) {
+            auto itr = m_searches.find(k);
+            if(itr != m_searches.end()) {
                 I2P_LOG(m_log, debug) << "received DatabaseStore for our goal, terminating search";
 
-                SearchStateByGoal::iterator itr = m_searches.get<0>().find(k);
-                const SearchState& ss = *itr;
-
                 if(isRouterInfo)
                     m_ios.post(boost::bind(
                         boost::ref(m_successSignal),
-                        ss.goal,
-                        m_ctx.getDatabase()->getRouterInfo(k).getIdentity().getHash()
+                        itr->second.state.goal,
+                        k
                     ));
 
-                m_searches.get<0>().erase(itr);
-                m_timers.erase(k);
+                m_searches.erase(itr);
 
                 return;
             }
@@ -245,24 +313,22 @@ namespace i2pcpp {
             if(!isRouterInfo)
                 return; // don't handle LS (yet)
 
-            if(m_searches.get<1>().count(from)) {
-                I2P_LOG(m_log, debug) << "found Routerhash in pending search table"
-                                         "(after DatabaseStore)";
+            TransportPtr t = m_ctx.getOutMsgDisp().getTransport();
 
-                SearchStateByCurrent::iterator itr = m_searches.get<1>().find(from);
-                const SearchState& ss = *itr;
+            for(auto& s: m_searches) {
+                auto q = s.second.queries.find(k);
+                if(q == s.second.queries.end() || q->second.state != Query::State::FETCHING_INFO)
+                    continue;
 
-                if(ss.current == k) {
-                    I2P_LOG(m_log, debug) << "stored hash is one we're waiting for, connecting";
+                I2P_LOG(m_log, debug) << "stored hash is one we're waiting for, connecting";
 
-                    m_ctx.getOutMsgDisp().getTransport()->connect(
-                        m_ctx.getDatabase()->getRouterInfo(k)
-                    );
-                } else {
-                    I2P_LOG(m_log, debug) << "stored hash is not one we're waiting for";
+                if(t->isConnected(k))
+                    sendLookup(s.second, k, q->second);
+                else if(auto ri = m_ctx.getDatabase()->getRouterInfoPtr(k)) {
+                    q->second.state = Query::State::CONNECTING;
+                    t->connect(*ri);
                 }
             }
-            
         }
     }
 }
@@ -14,41 +14,29 @@
 #include <i2pcpp/datatypes/RouterHash.h>
 
 #include <boost/asio.hpp>
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/hashed_index.hpp>
-#include <boost/multi_index/member.hpp>
 #include <boost/signals2.hpp>
 
+#include <map>
+#include <memory>
 #include <mutex>
 
-namespace bmi = boost::multi_index;
-
 namespace i2pcpp {
     class RouterContext;
 
     namespace DHT {
             /**
              * Helper class used to manage netDB search operations.
+             * Searches are iterative and parallel, as in Kademlia: up to
+             *  alpha peers are queried at once, closest to the goal first,
+             *  preferring peers we are already connected to. Every query
+             *  has its own timeout, much shorter than that of the search, so
+             *  that a slow peer only holds up one of the alpha slots.
              */
             class SearchManager {
                 private:
                     typedef boost::signals2::signal<void(const Kademlia::key_type, const Kademlia::value_type)> SuccessSignal;
                     typedef boost::signals2::signal<void(const Kademlia::key_type)> FailureSignal;
 
-                    typedef boost::multi_index_container<
-                        SearchState,
-                        bmi::indexed_by<
-                            bmi::hashed_unique<
-                                BOOST_MULTI_INDEX_MEMBER(SearchState, Kademlia::key_type, goal)
-                            >,
-                            bmi::hashed_non_unique<
-                                BOOST_MULTI_INDEX_MEMBER(SearchState, RouterHash, current)
-                            >
-                        >
-                    > SearchStateContainer;
-                    typedef SearchStateContainer::nth_index<0>::type SearchStateByGoal;
-                    typedef SearchStateContainer::nth_index<1>::type SearchStateByCurrent;
-
                 public:
                     /**
                      * Constructs from a reference to the i2pcpp::RouterContext.
@@ -84,16 +72,15 @@ namespace i2pcpp {
 
                     /**
                      * Creates a new i2pcpp::DHT::SearchState to track the status.
-                     * Starts connecting to the first closest peer. If the
-                     *  connection is successful, this will result in a call to
-                     *  SearchManager::connected. Times out after 2 minutes.
+                     * Starts querying the closest peers, up to alpha at once.
+                     *  Queries to peers we are not connected to are sent once
+                     *  SearchManager::connected is called. Times out after 1 minute.
                      * @param k the key to lookup
-                     * @param startingPoints the closest peers, that will be
-                     *  contacted in order until the key is found
+                     * @param startingPoints the closest peers, closest first
                      * @note if the key is already being searched for, a new
                      *  search operation will not be started
                      */
-                    void createSearch(Kademlia::key_type const &k, Kademlia::result_type const &startingPoints);
+                    void createSearch(Kademlia::key_type const &k, std::vector<Kademlia::value_type> const &startingPoints);
 
                     /**
                      * Called when we have established a connection with a node.
@@ -104,8 +91,8 @@ namespace i2pcpp {
 
                     /**
                      * Called when a connection with a router has failed.
-                     * Tries to connect to the next router in the given list of
-                     *  closest nodes.
+                     * Queries the next closest peers of the searches that were
+                     *  waiting for it.
                      * @param rh the i2pcpp::RouterHash of the router we
                      *  connected to
                      */
@@ -131,6 +118,34 @@ namespace i2pcpp {
                     void databaseStore(RouterHash const from, StaticByteArray<32> const k, bool isRouterInfo);
 
                 private:
+                    /**
+                     * A query sent (or about to be sent) to one peer.
+                     */
+                    struct Query {
+                        enum class State {
+                            FETCHING_INFO, ///< Waiting for the peer's RouterInfo
+                            CONNECTING,
+                            LOOKUP_SENT
+                        };
+
+                        State state = State::CONNECTING;
+                        std::unique_ptr<boost::asio::deadline_timer> timer;
+                    };
+
+                    struct Search {
+                        Search(SearchState const &ss) : state(ss) {}
+
+                        SearchState state;
+                        Kademlia::key_type routingKey;
+                        std::unique_ptr<boost::asio::deadline_timer> timer;
+
+                        /// Outstanding queries, by peer
+                        std::map<RouterHash, Query> queries;
+
+                        /// The peer which told us about each alternate
+                        std::map<RouterHash, RouterHash> referrers;
+                    };
+
                     /**
                      * Called when a lookup operation times out.
                      * Cancels the search operation for \a k.
@@ -138,6 +153,12 @@ namespace i2pcpp {
                      */
                     void timeout(const boost::system::error_code& e, Kademlia::key_type const k);
 
+                    /**
+                     * Called when the query to \a peer for \a k times out.
+                     * Gives up on the peer and queries the next closest one.
+                     */
+                    void queryTimeout(const boost::system::error_code& e, Kademlia::key_type const k, RouterHash const peer);
+
                     /**
                      * Cancels the search operation for a key \a k.
                      * This is done when the search failed.
@@ -145,16 +166,43 @@ namespace i2pcpp {
                      */
                     void cancel(Kademlia::key_type const &k);
 
+                    /**
+                     * Adds \a rh, which \a referrer told us about, to the
+                     *  alternates of \a s, ordered by routing key distance.
+                     */
+                    void addAlternate(Search &s, RouterHash const &rh, RouterHash const &referrer);
+
+                    /**
+                     * Queries alternates of the search for \a k until alpha
+                     *  queries are outstanding. Cancels the search if there are
+                     *  none outstanding and no alternates left.
+                     * @return false if the search was cancelled
+                     */
+                    bool fill(Kademlia::key_type const &k);
+
+                    /**
+                     * Starts a query to \a peer. Must be called with
+                     *  m_searchesMutex held.
+                     */
+                    void query(Search &s, RouterHash const &peer);
+
+                    /**
+                     * Sends the DatabaseLookup of \a s to \a peer, which we
+                     *  must be connected to.
+                     */
+                    void sendLookup(Search &s, RouterHash const &peer, Query &q);
+
                     boost::asio::io_service& m_ios;
                     RouterContext& m_ctx;
                     NegativeLookupCache m_nlc;
 
-                    std::map<Kademlia::key_type, std::unique_ptr<boost::asio::deadline_timer>> m_timers;
+                    std::size_t m_alpha;
+                    uint32_t m_queryTimeout;
 
                     SuccessSignal m_successSignal;
                     FailureSignal m_failureSignal;
 
-                    SearchStateContainer m_searches;
+                    std::map<Kademlia::key_type, Search> m_searches;
                     mutable std::mutex m_searchesMutex;
 
                     i2p_logger_mt m_log;
@@ -4,109 +4,96 @@
  */
 #include "SearchState.h"
 
+#include <algorithm>
+
 namespace i2pcpp {
     namespace DHT {
 
         SearchState::SearchState(const Kademlia::key_type& goal, const RouterHash& start)
-            : state(CurrentState::CONNECTING), goal(goal), current(start), m_excluded(),
-              m_alternates(), m_current() 
-        {
-            m_alternates.push_back(start);
-            m_current = m_alternates.begin();
-        }
-        
-        SearchState::SearchState(const SearchState& ss)
-            : state(ss.state), goal(ss.goal), current(ss.current),
-              m_excluded(ss.m_excluded), m_alternates(ss.m_alternates)
+            : current(start), goal(goal)
         {
-            m_current = std::find(m_alternates.begin(), m_alternates.end(), current); 
+            m_tried.insert(start);
         }
 
-        SearchState& SearchState::operator=(const SearchState& ss)
-        {
-            state = ss.state;
-            goal = ss.goal;
-            current = ss.current;
-            m_excluded = ss.m_excluded;
-            m_alternates = ss.m_alternates;
-            m_current = std::find(m_alternates.begin(), m_alternates.end(), current); 
-            return *this;
-        }
         bool SearchState::isAlternate(const RouterHash& rh) const
         {
-            return std::find(std::next(m_current), m_alternates.end(), rh) != m_alternates.end();
+            return std::find_if(m_alternates.cbegin(), m_alternates.cend(), [&rh](std::pair<const Kademlia::key_type, RouterHash> const &a) {
+                return a.second == rh;
+            }) != m_alternates.cend();
         }
 
         bool SearchState::isTried(const RouterHash& rh) const
         {
-            return std::find(
-                m_alternates.begin(), m_current, rh
-            ) != m_alternates.end();
+            return m_tried.count(rh) > 0;
         }
 
         std::size_t SearchState::countAlternates() const
         {
-            return std::distance(std::next(m_current), m_alternates.end());
+            return m_alternates.size();
         }
 
         void SearchState::addAlternate(const RouterHash& rh)
         {
-            const auto it = std::find(m_alternates.begin(), m_alternates.end(), rh);
-            if(it == m_alternates.end())
-                m_alternates.push_back(rh);
-        }
+            Kademlia::key_type distance;
+            std::transform(rh.cbegin(), rh.cend(), goal.cbegin(), distance.begin(), std::bit_xor<unsigned char>());
 
-        void SearchState::popAlternate()
-        {
-            if(countAlternates()) {
-                ++m_current;
-                current = *m_current;
-            }
+            addAlternate(rh, distance);
         }
 
-        RouterHash SearchState::getNext() const
+        void SearchState::addAlternate(const RouterHash& rh, const Kademlia::key_type& distance)
         {
-            return *std::next(m_current);
+            if(isTried(rh) || isAlternate(rh))
+                return;
+
+            m_alternates.insert(std::make_pair(distance, rh));
         }
 
-        std::list<RouterHash> SearchState::getExcluded() const
+        void SearchState::popAlternate()
         {
-            return m_excluded;
+            if(m_alternates.empty())
+                return;
+
+            current = m_alternates.begin()->second;
+            m_tried.insert(current);
+            m_alternates.erase(m_alternates.begin());
         }
 
-        void PopAlternates::operator()(SearchState &ss)
+        void SearchState::takeAlternate(const RouterHash& rh)
         {
-            ss.popAlternate();
-        }
+            for(auto itr = m_alternates.begin(); itr != m_alternates.end(); ++itr) {
+                if(itr->second == rh) {
+                    m_alternates.erase(itr);
+                    break;
+                }
+            }
 
-        PushAlternates::PushAlternates(RouterHash const &alt) :
-            m_alt(alt) {}
+            current = rh;
+            m_tried.insert(rh);
+        }
 
-        void PushAlternates::operator()(SearchState &ss)
+        RouterHash SearchState::getNext() const
         {
-            ss.addAlternate(m_alt);
+            return m_alternates.begin()->second;
         }
 
-        ModifyState::ModifyState(SearchState::CurrentState const state) :
-            m_state(state),
-            m_type(UpdateType::STATE) {}
+        std::vector<RouterHash> SearchState::getAlternates(std::size_t n) const
+        {
+            std::vector<RouterHash> alternates;
+            for(auto itr = m_alternates.cbegin(); itr != m_alternates.cend() && alternates.size() < n; ++itr)
+                alternates.push_back(itr->second);
 
-        ModifyState::ModifyState(RouterHash const &exclude) :
-            m_exclude(exclude),
-            m_type(UpdateType::NEW_CONNECTION) {}
+            return alternates;
+        }
 
-        void ModifyState::operator()(SearchState &ss)
+        void SearchState::exclude(const RouterHash& rh)
         {
-            switch(m_type) {
-                case UpdateType::STATE:
-                    ss.state = m_state;
-                    break;
+            if(std::find(m_excluded.cbegin(), m_excluded.cend(), rh) == m_excluded.cend())
+                m_excluded.push_back(rh);
+        }
 
-                case UpdateType::NEW_CONNECTION:
-                    ss.state = SearchState::CurrentState::CONNECTING;
-                    ss.m_excluded.push_back(m_exclude);
-                    break;
-            }
+        std::list<RouterHash> SearchState::getExcluded() const
+        {
+            return m_excluded;
         }
     }
 }
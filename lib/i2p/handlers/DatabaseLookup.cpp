@@ -0,0 +1,33 @@
+/**
+ * @file DatabaseLookup.cpp
+ * @brief Implements DatabaseLookup.h
+ */
+#include "DatabaseLookup.h"
+
+#include "../RouterContext.h"
+
+#include "../i2np/DatabaseLookup.h"
+
+namespace i2pcpp {
+    namespace Handlers {
+        DatabaseLookup::DatabaseLookup(RouterContext &ctx) :
+            Message(ctx),
+            m_log(boost::log::keywords::channel = "H[DL]") {}
+
+        void DatabaseLookup::handleMessage(RouterHash const from, I2NP::MessagePtr const msg)
+        {
+            std::shared_ptr<I2NP::DatabaseLookup> dl = std::dynamic_pointer_cast<I2NP::DatabaseLookup>(msg);
+
+            I2P_LOG_SCOPED_TAG(m_log, "RouterHash", from);
+            I2P_LOG(m_log, debug) << "received DatabaseLookup message";
+
+            DHT::Floodfill &ff = m_ctx.getDHT()->getFloodfill();
+            if(!ff.isEnabled()) {
+                I2P_LOG(m_log, debug) << "not a floodfill, dropping lookup";
+                return;
+            }
+
+            ff.lookup(from, *dl);
+        }
+    }
+}
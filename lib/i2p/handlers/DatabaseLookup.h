@@ -0,0 +1,39 @@
+/**
+ * @file DatabaseLookup.h
+ * @brief Defines the i2pcpp::Handlers::DatabaseLookup handler.
+ */
+#ifndef HANDLERSDATABASELOOKUP_H
+#define HANDLERSDATABASELOOKUP_H
+
+#include "Message.h"
+
+namespace i2pcpp {
+    namespace Handlers {
+
+        /**
+         * Handles database lookup messages.
+         */
+        class DatabaseLookup : public Message {
+            public:
+                /**
+                 * Constructs from a reference to the i2pcpp::RouterContext
+                 *  object.
+                 */
+                DatabaseLookup(RouterContext &ctx);
+
+                /**
+                 * Handles the database lookup message by passing it to the
+                 *  i2pcpp::DHT::Floodfill, if we are a floodfill. Otherwise
+                 *  the message is dropped.
+                 * @param from the sending router
+                 * @param msg the actual i2pcpp::I2NP::Message object
+                 */
+                void handleMessage(RouterHash const from, I2NP::MessagePtr const msg);
+
+            private:
+                i2p_logger_mt m_log; ///< Logging object
+        };
+    }
+}
+
+#endif
@@ -44,7 +44,10 @@ namespace i2pcpp {
                             RouterInfo ri(begin, inflatedData.cend());
 
                             if(ri.verifySignature()) {
-                                m_ctx.getDatabase()->setRouterInfo(ri);
+                                // Before the database, so that the floodfill indexes the data as received
+                                m_ctx.getDHT()->getFloodfill().store(from, *dsm, ri);
+
+                                m_ctx.getDatabase()->queueRouterInfo(ri);
                                 I2P_LOG(m_log, debug) << "added RouterInfo to DB";
 
                                 m_ctx.getSignals().invokeDatabaseStore(from, ri.getIdentity().getHash(), true);
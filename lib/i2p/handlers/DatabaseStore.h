@@ -24,7 +24,8 @@ namespace i2pcpp {
                  * Handles the database store message.
                  * If the data to be stored is a (gzip) commpressed i2pcpp::RouterInfo
                  *  object, it is decommpressed and, if the signature if correct,
-                 *  it is added to the i2pcpp::Database of the router.
+                 *  it is added to the i2pcpp::Database of the router and, in
+                 *  floodfill mode, to the i2pcpp::DHT::Floodfill.
                  * If the data is an uncompressed i2pcpp::LeaseSet, the associated
                  *  signal is invoked (currently unimplemented).
                  * @param from the sending router
@@ -6,12 +6,7 @@
 
 #include "../RouterContext.h"
 
-#include "../i2np/DatabaseStore.h"
-
-#include <i2pcpp/util/gzip.h>
-#include <i2pcpp/datatypes/RouterInfo.h>
-
-#include <botan/pipe.h>
+#include "../i2np/DeliveryStatus.h"
 
 namespace i2pcpp {
     namespace Handlers {
@@ -21,38 +16,26 @@ namespace i2pcpp {
 
         void DeliveryStatus::handleMessage(RouterHash const from, I2NP::MessagePtr const msg)
         {
+            std::shared_ptr<I2NP::DeliveryStatus> ds = std::dynamic_pointer_cast<I2NP::DeliveryStatus>(msg);
+            if(!ds)
+                return;
+
             I2P_LOG_SCOPED_TAG(m_log, "RouterHash", from);
+
+            // Tunnel tests come back through our own tunnels and need no reply
+            const uint32_t msgId = ds->getStatusMsgId();
+            const bool tunnelTest = m_ctx.getTunnelManager().isTunnelTest(msgId);
+
+            m_ctx.getSignals().invokeDeliveryStatus(from, msgId);
+
+            if(tunnelTest) {
+                I2P_LOG(m_log, debug) << "received DeliveryStatus message for tunnel test " << msgId;
+                return;
+            }
+
             I2P_LOG(m_log, debug) << "received DeliveryStatus message, replying with DatabaseStore message";
 
-            // TODO Get this out of here
-            Mapping am;
-            am.setValue("caps", "BC");
-            am.setValue("host", m_ctx.getDatabase()->getConfigValue("ssu_external_ip"));
-            am.setValue("key", Base64::encode(m_ctx.getIdentity()->getHash()));
-            am.setValue("port", m_ctx.getDatabase()->getConfigValue("ssu_external_port"));
-            RouterAddress a(5, Date(0), "SSU", am);
-
-            Mapping rm;
-            rm.setValue("coreVersion", "0.9.11");
-            rm.setValue("netId", "2");
-            rm.setValue("router.version", "0.9.11");
-            rm.setValue("stat_uptime", "90m");
-            rm.setValue("caps", "OR");
-            RouterInfo myInfo(*m_ctx.getIdentity(), Date(), rm);
-            myInfo.addAddress(a);
-            myInfo.sign(m_ctx.getSigningKey());
-
-            Botan::Pipe gzPipe(new Gzip_Compression);
-            gzPipe.start_msg();
-            gzPipe.write(myInfo.serialize());
-            gzPipe.end_msg();
-
-            unsigned int size = gzPipe.remaining();
-            ByteArray gzInfoBytes(size);
-            gzPipe.read(gzInfoBytes.data(), size);
-
-            auto mydsm = std::make_shared<I2NP::DatabaseStore>(myInfo.getIdentity().getHash(), I2NP::DatabaseStore::DataType::ROUTER_INFO, 0, gzInfoBytes);
-            m_ctx.getOutMsgDisp().sendMessage(from, mydsm);
+            m_ctx.getOutMsgDisp().sendMessage(from, m_ctx.createRouterInfoStore());
         }
     }
 }
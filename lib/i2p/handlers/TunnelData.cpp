@@ -21,7 +21,7 @@ namespace i2pcpp {
             I2P_LOG_SCOPED_TAG(m_log, "RouterHash", from);
             I2P_LOG(m_log, debug) << "received TunnelData message";
 
-            m_ctx.getSignals().invokeTunnelData(from, td->getTunnelId(), td->getData());
+            m_ctx.getSignals().invokeTunnelData(from, td);
         }
     }
 }
@@ -22,7 +22,7 @@ namespace i2pcpp {
             I2P_LOG_SCOPED_TAG(m_log, "RouterHash", from);
             I2P_LOG(m_log, debug) << "received VariableTunnelBuildReply message";
 
-            m_ctx.getSignals().invokeTunnelRecordsReceived(vtbr->getMsgId(), vtbr->getRecords());
+            m_ctx.getSignals().invokeTunnelRecordsReceived(from, vtbr->getMsgId(), vtbr->getRecords());
         }
     }
 }
@@ -12,6 +12,31 @@ namespace i2pcpp {
             m_sendReplyTo(sendReplyTo),
             m_excludedPeers(excludedPeers) {}
 
+        const StaticByteArray<32>& DatabaseLookup::getKey() const
+        {
+            return m_key;
+        }
+
+        const RouterHash& DatabaseLookup::getFrom() const
+        {
+            return m_from;
+        }
+
+        uint32_t DatabaseLookup::getSendReplyTo() const
+        {
+            return m_sendReplyTo;
+        }
+
+        const std::list<RouterHash>& DatabaseLookup::getExcludedPeers() const
+        {
+            return m_excludedPeers;
+        }
+
+        bool DatabaseLookup::isReplyEncrypted() const
+        {
+            return m_encryptReply;
+        }
+
         ByteArray DatabaseLookup::compile() const
         {
             ByteArray b;
@@ -41,7 +66,46 @@ namespace i2pcpp {
 
         DatabaseLookup DatabaseLookup::parse(ByteArrayConstItr &begin, ByteArrayConstItr end)
         {
-            return DatabaseLookup();
+            DatabaseLookup dl;
+
+            if(end - begin < 65)
+                throw std::runtime_error("error parsing DatabaseLookup");
+
+            std::copy(begin, begin + 32, dl.m_key.begin()), begin += 32;
+            std::copy(begin, begin + 32, dl.m_from.begin()), begin += 32;
+
+            unsigned char flags = *(begin++);
+
+            if(end - begin < ((flags & 0x01) ? 6 : 2))
+                throw std::runtime_error("error parsing DatabaseLookup");
+
+            dl.m_sendReplyTo = (flags & 0x01) ? parseUint32(begin) : 0;
+
+            uint16_t size = parseUint16(begin);
+            if(end - begin < size * 32)
+                throw std::runtime_error("error parsing DatabaseLookup");
+
+            while(size--) {
+                dl.m_excludedPeers.emplace_back();
+                std::copy(begin, begin + 32, dl.m_excludedPeers.back().begin()), begin += 32;
+            }
+
+            // The session key and tags for an encrypted reply are skipped
+            dl.m_encryptReply = flags & 0x02;
+            if(dl.m_encryptReply) {
+                if(end - begin < 33)
+                    throw std::runtime_error("error parsing DatabaseLookup");
+
+                begin += 32;
+                unsigned char tags = *(begin++);
+
+                if(end - begin < tags * 32)
+                    throw std::runtime_error("error parsing DatabaseLookup");
+
+                begin += tags * 32;
+            }
+
+            return dl;
         }
     }
 }
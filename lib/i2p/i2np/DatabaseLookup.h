@@ -38,6 +38,35 @@ namespace i2pcpp {
                  */
                DatabaseLookup(StaticByteArray<32> const &key, RouterHash const &from, uint32_t sendReplyTo, std::list<RouterHash> excludedPeers = std::list<RouterHash>());
 
+                /**
+                 * @return the key of the object that is looked up
+                 */
+                const StaticByteArray<32>& getKey() const;
+
+                /**
+                 * @return the i2pcpp::RouterHash of the router to send the
+                 *  reply to, or of the gateway of the reply tunnel
+                 */
+                const RouterHash& getFrom() const;
+
+                /**
+                 * @return the ID of the tunnel to send the reply to, or 0 if
+                 *  the reply is to be sent directly
+                 */
+                uint32_t getSendReplyTo() const;
+
+                /**
+                 * @return the peers not to be included in a
+                 *  i2pcpp::I2NP::DatabaseSearchReply
+                 */
+                const std::list<RouterHash>& getExcludedPeers() const;
+
+                /**
+                 * @return true if the sender asked for the reply to be
+                 *  encrypted with a session key it supplied
+                 */
+                bool isReplyEncrypted() const;
+
                 /**
                  * Converts an i2pcpp::ByteArray to an i2pcpp::I2NP::DatabaseLookup object.
                  * The format to be parsed is 32B key, followed by the 32B
@@ -47,7 +76,9 @@ namespace i2pcpp {
                  * If the encryption flag is specified, this is followed by a 32B
                  *  session key for AES-256, a 1B size integer, followed by \a size
                  *  session tags.
-                 * @todo implement this (needed for floodfill mode)
+                 * @todo keep the session key and tags, so that the reply can
+                 *  be encrypted, for now only the flag is kept
+                 * @throw std::runtime_error if the data is truncated
                  */
                static DatabaseLookup parse(ByteArrayConstItr &begin, ByteArrayConstItr end);
 
@@ -67,6 +98,7 @@ namespace i2pcpp {
                 RouterHash m_from;
                 uint32_t m_sendReplyTo;
                 std::list<RouterHash> m_excludedPeers;
+                bool m_encryptReply = false;
         };
     }
 }
@@ -6,6 +6,11 @@
 
 namespace i2pcpp {
     namespace I2NP {
+        DatabaseSearchReply::DatabaseSearchReply(StaticByteArray<32> const &key, std::list<RouterHash> const &hashes, RouterHash const &from) :
+            m_key(key),
+            m_hashes(hashes),
+            m_from(from) {}
+
         const StaticByteArray<32>& DatabaseSearchReply::getKey() const
         {
             return m_key;
@@ -23,8 +28,17 @@ namespace i2pcpp {
 
         ByteArray DatabaseSearchReply::compile() const
         {
-            // TODO
-            return ByteArray();
+            ByteArray b;
+
+            b.insert(b.end(), m_key.cbegin(), m_key.cend());
+
+            b.insert(b.end(), (unsigned char)m_hashes.size());
+            for(auto& h: m_hashes)
+                b.insert(b.end(), h.cbegin(), h.cend());
+
+            b.insert(b.end(), m_from.cbegin(), m_from.cend());
+
+            return b;
         }
 
         DatabaseSearchReply DatabaseSearchReply::parse(ByteArrayConstItr &begin, ByteArrayConstItr end)
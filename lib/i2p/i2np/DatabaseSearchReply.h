@@ -22,6 +22,13 @@ namespace i2pcpp {
          */
         class DatabaseSearchReply : public Message {
             public:
+                /**
+                 * Constructs from the \a key that was looked up, the peers
+                 *  closest to it that we know of and our own
+                 *  i2pcpp::RouterHash.
+                 */
+                DatabaseSearchReply(StaticByteArray<32> const &key, std::list<RouterHash> const &hashes, RouterHash const &from);
+
                 /**
                  * @return the key of the object that was searched for
                  */
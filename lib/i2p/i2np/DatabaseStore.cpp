@@ -13,6 +13,11 @@ namespace i2pcpp {
             m_replyToken(replyToken),
             m_data(data) {}
 
+        const StaticByteArray<32>& DatabaseStore::getKey() const
+        {
+            return m_key;
+        }
+
         DatabaseStore::DataType DatabaseStore::getDataType() const
         {
             return m_type;
@@ -23,6 +28,16 @@ namespace i2pcpp {
             return m_replyToken;
         }
 
+        uint32_t DatabaseStore::getReplyTunnelId() const
+        {
+            return m_replyTunnelId;
+        }
+
+        const RouterHash& DatabaseStore::getReplyGateway() const
+        {
+            return m_replyGateway;
+        }
+
         const ByteArray& DatabaseStore::getData() const
         {
             return m_data;
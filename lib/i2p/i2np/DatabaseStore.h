@@ -49,6 +49,11 @@ namespace i2pcpp {
                  */
                 DatabaseStore(StaticByteArray<32> const &key, DataType type, uint32_t replyToken, ByteArray const &data);
 
+                /**
+                 * @return the SHA256 hash of the RI or i2pcpp::Destination
+                 */
+                const StaticByteArray<32>& getKey() const;
+
                 /**
                  * @return the data type contained in this message (RI or LS)
                  */
@@ -59,6 +64,21 @@ namespace i2pcpp {
                  */
                 uint32_t getReplyToken() const;
 
+                /**
+                 * @return the ID of the tunnel to send the
+                 *  i2pcpp::I2NP::DeliveryStatus to, or 0 if it is to be sent
+                 *  to the reply gateway directly
+                 * @note only valid if the reply token is greater than 0
+                 */
+                uint32_t getReplyTunnelId() const;
+
+                /**
+                 * @return the i2pcpp::RouterHash of the router to send the
+                 *  i2pcpp::I2NP::DeliveryStatus to
+                 * @note only valid if the reply token is greater than 0
+                 */
+                const RouterHash& getReplyGateway() const;
+
                 /**
                  * @return the underlying data
                  */
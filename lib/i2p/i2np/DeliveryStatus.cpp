@@ -10,6 +10,16 @@ namespace i2pcpp {
             m_msgId(msgId),
             m_timestamp(timestamp) {}
 
+        uint32_t DeliveryStatus::getStatusMsgId() const
+        {
+            return m_msgId;
+        }
+
+        const Date& DeliveryStatus::getTimestamp() const
+        {
+            return m_timestamp;
+        }
+
         ByteArray DeliveryStatus::compile() const
         {
             ByteArray b;
@@ -28,6 +28,18 @@ namespace i2pcpp {
                  */
                 DeliveryStatus(uint32_t msgId, Date timestamp);
 
+                /**
+                 * @return the identifier of the message whose delivery is
+                 *  confirmed. This is not the identifier of the
+                 *  i2pcpp::I2NP::DeliveryStatus message itself.
+                 */
+                uint32_t getStatusMsgId() const;
+
+                /**
+                 * @return the time the message was created or delivered
+                 */
+                const Date& getTimestamp() const;
+
                 /**
                  * Converts an i2pcpp::ByteArray to an i2pcpp::I2NP::DeliveryStatus
                  *  object.
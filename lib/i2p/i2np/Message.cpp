@@ -14,52 +14,57 @@
 #include "TunnelGateway.h"
 #include "Garlic.h"
 
-#include <botan/pipe.h>
 #include <botan/lookup.h>
+#include <botan/hash.h>
 #include <botan/auto_rng.h>
 
 namespace i2pcpp {
     namespace I2NP {
         ByteArray Message::toBytes(bool standardHeader) const
         {
-            ByteArray b(compile());
+            ByteArray body(compile());
 
-            if(standardHeader) {
-                Botan::Pipe hashPipe(new Botan::Hash_Filter("SHA-256"));
-                hashPipe.start_msg();
+            ByteArray b(headerSize(standardHeader) + body.size());
+            std::copy(body.cbegin(), body.cend(), writeHeader(b.data(), body.data(), body.size(), standardHeader));
 
-                hashPipe.write(b);
+            return b;
+        }
 
-                hashPipe.end_msg();
+        std::size_t Message::headerSize(bool standardHeader)
+        {
+            return standardHeader ? 16 : 5;
+        }
 
-                unsigned char checksum;
-                hashPipe.read(&checksum, 1);
-                uint16_t size = b.size();
+        unsigned char *Message::writeHeader(unsigned char *dst, const unsigned char *body, uint16_t size, bool standardHeader) const
+        {
+            *dst++ = (unsigned char)getType();
 
-                b.insert(b.begin(), checksum);
-                b.insert(b.begin(), size);
-                b.insert(b.begin(), size >> 8);
+            if(standardHeader) {
+                *dst++ = m_msgId >> 24;
+                *dst++ = m_msgId >> 16;
+                *dst++ = m_msgId >> 8;
+                *dst++ = m_msgId;
 
                 ByteArray d(Date().serialize());
-                b.insert(b.begin(), d.cbegin(), d.cend());
+                dst = std::copy(d.cbegin(), d.cend(), dst);
+
+                *dst++ = size >> 8;
+                *dst++ = size;
 
-                b.insert(b.begin(), m_msgId);
-                b.insert(b.begin(), m_msgId >> 8);
-                b.insert(b.begin(), m_msgId >> 16);
-                b.insert(b.begin(), m_msgId >> 24);
+                std::unique_ptr<Botan::HashFunction> sha(Botan::get_hash("SHA-256"));
+                sha->update(body, size);
+                *dst++ = sha->final()[0];
             } else {
                 // m_expiration?
                 uint32_t expiration = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count() + 60;
 
-                b.insert(b.begin(), expiration);
-                b.insert(b.begin(), expiration >> 8);
-                b.insert(b.begin(), expiration >> 16);
-                b.insert(b.begin(), expiration >> 24);
+                *dst++ = expiration >> 24;
+                *dst++ = expiration >> 16;
+                *dst++ = expiration >> 8;
+                *dst++ = expiration;
             }
 
-            b.insert(b.begin(), (unsigned char)getType());
-
-            return b;
+            return dst;
         }
 
         uint32_t Message::getMsgId() const
@@ -101,30 +106,41 @@ namespace i2pcpp {
             throw std::runtime_error("couldn't identify myself");
         }
 
-        MessagePtr Message::fromBytes(uint32_t msgId, ByteArray const &data, bool standardHeader)
+        Message::Type Message::parseHeader(ByteArrayConstItr &begin, ByteArrayConstItr end, bool standardHeader, uint32_t &msgId, Date &longExpiration, uint32_t &expiration)
         {
-            MessagePtr m;
+            if(std::distance(begin, end) < (std::ptrdiff_t)headerSize(standardHeader))
+                throw std::runtime_error("error parsing I2NP message");
 
-            auto dataItr = data.cbegin();
-            auto end = data.cend();
-
-            Type mtype = (Type)*(dataItr++);
-            Date longExpiration;
-            uint32_t expiration;
+            Type mtype = (Type)*(begin++);
 
             if(standardHeader) {
-                msgId = parseUint32(dataItr);
+                msgId = parseUint32(begin);
 
-                longExpiration = Date(dataItr, end);
+                longExpiration = Date(begin, end);
 
-                uint16_t size = parseUint16(dataItr);
+                uint16_t size = parseUint16(begin);
 
-                uint8_t checksum = *dataItr++; // TODO verify this
+                uint8_t checksum = *begin++; // TODO verify this
 
-                if(end - dataItr != size)
+                if(end - begin != size)
                     throw std::runtime_error("error parsing I2NP message");
             } else
-                expiration = parseUint32(dataItr);
+                expiration = parseUint32(begin);
+
+            return mtype;
+        }
+
+        MessagePtr Message::fromBytes(uint32_t msgId, ByteArray const &data, bool standardHeader)
+        {
+            MessagePtr m;
+
+            auto dataItr = data.cbegin();
+            auto end = data.cend();
+
+            Date longExpiration;
+            uint32_t expiration;
+
+            Type mtype = parseHeader(dataItr, end, standardHeader, msgId, longExpiration, expiration);
 
             switch(mtype)
             {
@@ -175,6 +191,28 @@ namespace i2pcpp {
             return m;
         }
 
+        MessagePtr Message::fromBytes(uint32_t msgId, ByteArray &&data, bool standardHeader)
+        {
+            if(data.empty() || (Type)data[0] != Type::TUNNEL_DATA)
+                return fromBytes(msgId, static_cast<ByteArray const &>(data), standardHeader);
+
+            auto dataItr = data.cbegin();
+
+            Date longExpiration;
+            uint32_t expiration;
+
+            parseHeader(dataItr, data.cend(), standardHeader, msgId, longExpiration, expiration);
+
+            std::size_t offset = dataItr - data.cbegin();
+            MessagePtr m = std::make_shared<TunnelData>(TunnelData::parse(std::move(data), offset));
+
+            m->m_msgId = msgId;
+            m->m_longExpiration = longExpiration;
+            m->m_expiration = expiration;
+
+            return m;
+        }
+
         Message::Message()
         {
             Botan::AutoSeeded_RNG rng;
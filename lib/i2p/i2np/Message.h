@@ -51,7 +51,7 @@ namespace i2pcpp {
                  * @param standardHeader if set to true, the long standard header is used, otherwise
                  *  the short header is used (as is the case for SSU)
                  */
-                ByteArray toBytes(bool standardHeader = true) const;
+                virtual ByteArray toBytes(bool standardHeader = true) const;
 
                 /**
                  * @return the 4 byte message identifier
@@ -76,6 +76,13 @@ namespace i2pcpp {
                  */
                 static std::shared_ptr<Message> fromBytes(uint32_t msgId, ByteArray const &data, bool standardHeader = true);
 
+                /**
+                 * Same as above, but may take over \a data instead of copying
+                 *  out of it. This is done for i2pcpp::I2NP::TunnelData messages,
+                 *  so that they can be decrypted and forwarded in place.
+                 */
+                static std::shared_ptr<Message> fromBytes(uint32_t msgId, ByteArray &&data, bool standardHeader = true);
+
             protected:
                 /**
                  * Default constructs. Generates a random message identifier.
@@ -94,9 +101,31 @@ namespace i2pcpp {
                  */
                 virtual ByteArray compile() const = 0;
 
+                /**
+                 * @return the size of the header written by
+                 *  i2pcpp::I2NP::Message::writeHeader
+                 */
+                static std::size_t headerSize(bool standardHeader);
+
+                /**
+                 * Writes the header for a message whose serialized body is the
+                 *  \a size bytes at \a body.
+                 * @param dst where to write the header, must have room for
+                 *  i2pcpp::I2NP::Message::headerSize bytes
+                 * @return a pointer to the first byte after the header
+                 */
+                unsigned char *writeHeader(unsigned char *dst, const unsigned char *body, uint16_t size, bool standardHeader) const;
+
                 uint32_t m_msgId; ///< The message identifier
                 uint32_t m_expiration; ///< Short expiration data in seconds
                 Date m_longExpiration; ///< Long expiration date in miliseconds
+
+            private:
+                /**
+                 * Parses the header of a serialized message.
+                 * @return the type of the message
+                 */
+                static Type parseHeader(ByteArrayConstItr &begin, ByteArrayConstItr end, bool standardHeader, uint32_t &msgId, Date &longExpiration, uint32_t &expiration);
         };
 
         typedef std::shared_ptr<Message> MessagePtr;
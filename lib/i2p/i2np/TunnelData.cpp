@@ -4,48 +4,98 @@
  */
 #include "TunnelData.h"
 
+#include <i2pcpp/util/BufferedRNG.h>
+
+#include <stdexcept>
+
 namespace i2pcpp {
     namespace I2NP {
+        /**
+         * Used for the message identifiers of rerouted messages, which are
+         * far too frequent to seed a new RNG for each one.
+         */
+        static BufferedRNG& rng()
+        {
+            static BufferedRNG r;
+            return r;
+        }
+
         TunnelData::TunnelData(uint32_t const tunnelId, StaticByteArray<1024> const &data) :
-            m_tunnelId(tunnelId),
-            m_data(data) {}
+            m_buffer(4 + 1024)
+        {
+            m_buffer[0] = tunnelId >> 24;
+            m_buffer[1] = tunnelId >> 16;
+            m_buffer[2] = tunnelId >> 8;
+            m_buffer[3] = tunnelId;
+
+            std::copy(data.cbegin(), data.cend(), m_buffer.begin() + 4);
+        }
+
+        TunnelData::TunnelData(ByteArray &&buffer, std::size_t offset) :
+            Message(0),
+            m_buffer(std::move(buffer)),
+            m_offset(offset) {}
 
         uint32_t TunnelData::getTunnelId() const
         {
-            return m_tunnelId;
+            auto begin = m_buffer.cbegin() + m_offset;
+            return parseUint32(begin);
         }
 
-        const StaticByteArray<1024>& TunnelData::getData() const
+        void TunnelData::reroute(uint32_t const tunnelId)
         {
-            return m_data;
+            unsigned char *p = m_buffer.data() + m_offset;
+
+            p[0] = tunnelId >> 24;
+            p[1] = tunnelId >> 16;
+            p[2] = tunnelId >> 8;
+            p[3] = tunnelId;
+
+            rng().randomize((unsigned char *)&m_msgId, sizeof(m_msgId));
         }
 
-        ByteArray TunnelData::compile() const
+        unsigned char *TunnelData::getData()
+        {
+            return m_buffer.data() + m_offset + 4;
+        }
+
+        const unsigned char *TunnelData::getData() const
         {
-            ByteArray b;
+            return m_buffer.data() + m_offset + 4;
+        }
 
-            b.insert(b.end(), m_tunnelId >> 24);
-            b.insert(b.end(), m_tunnelId >> 16);
-            b.insert(b.end(), m_tunnelId >> 8);
-            b.insert(b.end(), m_tunnelId);
+        ByteArray TunnelData::toBytes(bool standardHeader) const
+        {
+            const unsigned char *body = m_buffer.data() + m_offset;
 
-            b.insert(b.end(), m_data.cbegin(), m_data.cend());
+            ByteArray b(headerSize(standardHeader) + 4 + 1024);
+            std::copy(body, body + 4 + 1024, writeHeader(b.data(), body, 4 + 1024, standardHeader));
 
             return b;
         }
 
-        TunnelData TunnelData::parse(ByteArrayConstItr &begin, ByteArrayConstItr end)
+        ByteArray TunnelData::compile() const
         {
-            TunnelData td;
+            return ByteArray(m_buffer.cbegin() + m_offset, m_buffer.cbegin() + m_offset + 4 + 1024);
+        }
 
+        TunnelData TunnelData::parse(ByteArrayConstItr &begin, ByteArrayConstItr end)
+        {
             if(std::distance(begin,end) < (4 + 1024))
                 throw std::runtime_error("invalid tunnel data message");
 
-            td.m_tunnelId = parseUint32(begin);
-
-            std::copy(begin, begin + 1024, td.m_data.begin());
+            TunnelData td(ByteArray(begin, begin + 4 + 1024), 0);
+            begin += 4 + 1024;
 
             return td;
         }
+
+        TunnelData TunnelData::parse(ByteArray &&buffer, std::size_t offset)
+        {
+            if(buffer.size() < offset + 4 + 1024)
+                throw std::runtime_error("invalid tunnel data message");
+
+            return TunnelData(std::move(buffer), offset);
+        }
     }
 }
@@ -32,17 +32,39 @@ namespace i2pcpp {
                 uint32_t getTunnelId() const;
 
                 /**
-                 * @return the actual 1024 bytes of tunnel data
+                 * Rewrites the tunnel identifier in place, as a participant does
+                 *  before passing the message on to the next hop. The message
+                 *  also gets a new message identifier, since it is sent over a
+                 *  different link.
                  */
-                const StaticByteArray<1024>& getData() const;
+                void reroute(uint32_t const tunnelId);
+
+                /**
+                 * @return a pointer to the actual 1024 bytes of tunnel data,
+                 *  which may be decrypted in place
+                 */
+                unsigned char *getData();
+                const unsigned char *getData() const;
+
+                /**
+                 * Writes the header and the message in to a single buffer,
+                 *  without compiling the message first.
+                 */
+                ByteArray toBytes(bool standardHeader = true) const;
 
                 /**
                  * Converts an i2pcpp::ByteArray to an i2pcpp::I2NP::TunnelData object.
                  * The format to be parsed is a 4B tunnel id and 1024B of data.
                  */
                 static TunnelData parse(ByteArrayConstItr &begin, ByteArrayConstItr end);
+
+                /**
+                 * Takes over \a buffer, which holds a 4B tunnel id starting at
+                 *  \a offset followed by 1024B of data. Nothing is copied.
+                 */
+                static TunnelData parse(ByteArray &&buffer, std::size_t offset);
+
             protected:
-                TunnelData() = default;
 
                 /**
                  * Puts the 4B tunnel identifier, followed by 1024B of data in
@@ -51,8 +73,13 @@ namespace i2pcpp {
                 ByteArray compile() const;
 
             private:
-                uint32_t m_tunnelId; ///< The 4 byte tunnel id
-                StaticByteArray<1024> m_data; ///< 1024 bytes of data
+                /**
+                 * Takes over \a buffer without generating a message identifier.
+                 */
+                TunnelData(ByteArray &&buffer, std::size_t offset);
+
+                ByteArray m_buffer; ///< Holds the 4 byte tunnel id and 1024 bytes of data
+                std::size_t m_offset = 0; ///< Position of the tunnel id in m_buffer
         };
     }
 }
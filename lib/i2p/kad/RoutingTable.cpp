@@ -1,10 +1,383 @@
+/**
+ * @file RoutingTable.cpp
+ * @brief Implements RoutingTable.h
+ */
 #include "RoutingTable.h"
 
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace i2pcpp {
     namespace Kad {
-        bool RoutingTable::Entry::operator<(const Entry& e) const
+        /**
+         * @return the 8 bytes at \a p as a big endian integer, so that
+         *  integer comparison of words matches the byte order of keys
+         */
+        static uint64_t loadWord(unsigned char const *p)
         {
+            uint64_t w = 0;
+            for(int i = 0; i < 8; ++i)
+                w = (w << 8) | p[i];
+
+            return w;
+        }
+
+        /**
+         * Stores \a keys[i] ^ \a target in \a out[i], for \a n words.
+         */
+        static void xorWords(uint64_t const *keys, std::size_t n, uint64_t target, uint64_t *out)
+        {
+            std::size_t i = 0;
+
+#if defined(__AVX2__)
+            const __m256i t = _mm256_set1_epi64x(target);
+            for(; i + 4 <= n; i += 4) {
+                __m256i k = _mm256_loadu_si256((__m256i const *)(keys + i));
+                _mm256_storeu_si256((__m256i *)(out + i), _mm256_xor_si256(k, t));
+            }
+#elif defined(__SSE2__)
+            const __m128i t = _mm_set1_epi64x(target);
+            for(; i + 2 <= n; i += 2) {
+                __m128i k = _mm_loadu_si128((__m128i const *)(keys + i));
+                _mm_storeu_si128((__m128i *)(out + i), _mm_xor_si128(k, t));
+            }
+#endif
+
+            for(; i < n; ++i)
+                out[i] = keys[i] ^ target;
+        }
+
+        /**
+         * @return the iterator to the entry for \a rh in \a l, or l.end()
+         */
+        template<typename List>
+        static typename List::iterator findEntry(List &l, RouterHash const &rh)
+        {
+            return std::find_if(l.begin(), l.end(), [&rh](typename List::value_type const &e) { return e.hash == rh; });
+        }
+
+        /**
+         * Inserts \a e in to \a l, which is ordered least recently seen
+         *  first, after the entries seen at the same time.
+         */
+        template<typename List>
+        static void insertOrdered(List &l, typename List::value_type const &e)
+        {
+            auto pos = std::find_if(l.rbegin(), l.rend(), [&e](typename List::value_type const &x) { return x.lastSeen <= e.lastSeen; });
+            l.insert(pos.base(), e);
+        }
+
+        RoutingTable::RoutingTable(key_type const &reference) :
+            m_ref(reference) {}
+
+        bool RoutingTable::update(RouterHash const &rh, key_type const &k, bool seen, RouterHash &questionable)
+        {
+            const clock::time_point now = clock::now();
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            const std::size_t b = getBucket(k);
+            if(b == NUM_BUCKETS)
+                return false;
+
+            Bucket &bk = m_buckets[b];
+
+            auto itr = findEntry(bk.entries, rh);
+            if(itr != bk.entries.end()) {
+                if(seen) {
+                    itr->lastSeen = now;
+                    itr->pinged = clock::time_point();
+                    bk.entries.splice(bk.entries.end(), bk.entries, itr);
+                }
+
+                return false;
+            }
+
+            Entry e = {rh, k, clock::time_point(), clock::time_point()};
+
+            auto ritr = findEntry(bk.replacements, rh);
+            if(ritr != bk.replacements.end()) {
+                e.lastSeen = ritr->lastSeen;
+                bk.replacements.erase(ritr);
+                m_index.erase(rh);
+            }
+
+            if(seen)
+                e.lastSeen = now;
+
+            if(bk.entries.size() >= K_VALUE) {
+                // A pinged entry which did not answer in time makes room
+                Entry const &lrs = bk.entries.front();
+                if(lrs.pinged != clock::time_point() && now - lrs.pinged > KAD_PING_TIMEOUT) {
+                    m_index.erase(lrs.hash);
+                    untrack(lrs.hash);
+                    bk.entries.pop_front();
+                }
+            }
+
+            if(bk.entries.size() < K_VALUE) {
+                insertOrdered(bk.entries, e);
+                m_index[rh] = b;
+                track(e);
+
+                return false;
+            }
+
+            Entry const &lrs = bk.entries.front();
+
+            insertOrdered(bk.replacements, e);
+            m_index[rh] = b;
+            if(bk.replacements.size() > K_VALUE) {
+                m_index.erase(bk.replacements.front().hash);
+                bk.replacements.pop_front();
+            }
+
+            // Entries which have never been seen are always questionable
+            const bool neverSeen = (lrs.lastSeen == clock::time_point());
+            if(lrs.pinged == clock::time_point() && (neverSeen || now - lrs.lastSeen > KAD_QUESTIONABLE_AGE)) {
+                questionable = lrs.hash;
+                return true;
+            }
+
             return false;
         }
+
+        void RoutingTable::pinging(RouterHash const &rh)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            auto b = m_index.find(rh);
+            if(b == m_index.end())
+                return;
+
+            Bucket &bk = m_buckets[b->second];
+
+            auto itr = findEntry(bk.entries, rh);
+            if(itr != bk.entries.end())
+                itr->pinged = clock::now();
+        }
+
+        void RoutingTable::failed(RouterHash const &rh)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            auto b = m_index.find(rh);
+            if(b == m_index.end())
+                return;
+
+            Bucket &bk = m_buckets[b->second];
+            m_index.erase(b);
+
+            auto ritr = findEntry(bk.replacements, rh);
+            if(ritr != bk.replacements.end()) {
+                bk.replacements.erase(ritr);
+                return;
+            }
+
+            auto itr = findEntry(bk.entries, rh);
+            if(itr == bk.entries.end())
+                return;
+
+            bk.entries.erase(itr);
+            untrack(rh);
+
+            if(!bk.replacements.empty()) {
+                insertOrdered(bk.entries, bk.replacements.back());
+                track(bk.replacements.back());
+                bk.replacements.pop_back();
+            }
+        }
+
+        std::vector<RouterHash> RoutingTable::closest(key_type const &k, std::size_t count) const
+        {
+            std::vector<RouterHash> results;
+
+            std::array<uint64_t, KEY_SIZE / 8> target;
+            for(std::size_t w = 0; w < target.size(); ++w)
+                target[w] = loadWord(k.data() + 8 * w);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if(!count || m_hashes.empty())
+                return results;
+
+            /* Candidates are the first word of their distance and their
+             * position. The first word almost always decides, the others
+             * are only looked at to break ties.
+             */
+            typedef std::pair<uint64_t, std::size_t> Candidate;
+            auto closer = [this, &target](Candidate const &a, Candidate const &b) {
+                if(a.first != b.first)
+                    return a.first < b.first;
+
+                for(std::size_t w = 1; w < target.size(); ++w) {
+                    uint64_t da = m_keys[w][a.second] ^ target[w];
+                    uint64_t db = m_keys[w][b.second] ^ target[w];
+                    if(da != db)
+                        return da < db;
+                }
+
+                return false;
+            };
+
+            /* The closest seen so far are kept in a max-heap, so that the
+             * furthest of them is at the front and is what every other
+             * distance is compared against.
+             */
+            std::vector<Candidate> heap;
+            heap.reserve(count);
+            uint64_t furthest = ~uint64_t(0);
+
+            std::array<uint64_t, 256> block;
+            const std::size_t n = m_hashes.size();
+            for(std::size_t base = 0; base < n; base += block.size()) {
+                const std::size_t len = std::min(block.size(), n - base);
+                xorWords(m_keys[0].data() + base, len, target[0], block.data());
+
+                for(std::size_t i = 0; i < len; ++i) {
+                    if(block[i] > furthest)
+                        continue;
+
+                    Candidate c(block[i], base + i);
+                    if(heap.size() < count) {
+                        heap.push_back(c);
+                        std::push_heap(heap.begin(), heap.end(), closer);
+                    } else if(closer(c, heap.front())) {
+                        std::pop_heap(heap.begin(), heap.end(), closer);
+                        heap.back() = c;
+                        std::push_heap(heap.begin(), heap.end(), closer);
+                    } else
+                        continue;
+
+                    if(heap.size() == count)
+                        furthest = heap.front().first;
+                }
+            }
+
+            std::sort_heap(heap.begin(), heap.end(), closer);
+
+            results.reserve(heap.size());
+            for(auto& c: heap)
+                results.push_back(m_hashes[c.second]);
+
+            return results;
+        }
+
+        std::size_t RoutingTable::size() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            return m_hashes.size();
+        }
+
+        void RoutingTable::rekey(key_type const &reference, std::function<key_type(RouterHash const &)> const &makeKey)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            std::vector<Entry> all;
+            all.reserve(m_index.size());
+            for(auto& bk: m_buckets) {
+                all.insert(all.end(), bk.entries.begin(), bk.entries.end());
+                all.insert(all.end(), bk.replacements.begin(), bk.replacements.end());
+
+                bk.entries.clear();
+                bk.replacements.clear();
+            }
+
+            m_index.clear();
+            m_hashes.clear();
+            m_positions.clear();
+            for(auto& w: m_keys)
+                w.clear();
+            m_ref = reference;
+
+            // The most recently seen routers get the places in the buckets
+            std::stable_sort(all.begin(), all.end(), [](Entry const &a, Entry const &b) { return a.lastSeen > b.lastSeen; });
+
+            for(auto& e: all) {
+                e.key = makeKey(e.hash);
+                e.pinged = clock::time_point();
+                place(e);
+            }
+
+            // Each bucket must be ordered least recently seen first again
+            for(auto& bk: m_buckets) {
+                bk.entries.reverse();
+                bk.replacements.reverse();
+            }
+        }
+
+        std::size_t RoutingTable::getBucket(key_type const &k) const
+        {
+            for(std::size_t i = 0; i < KEY_SIZE; ++i) {
+                unsigned char d = k[i] ^ m_ref[i];
+                if(!d) continue;
+
+                std::size_t bit = 0;
+                while(!(d & 0x80)) {
+                    d <<= 1;
+                    ++bit;
+                }
+
+                return 8 * i + bit;
+            }
+
+            return NUM_BUCKETS;
+        }
+
+        void RoutingTable::place(Entry const &e)
+        {
+            const std::size_t b = getBucket(e.key);
+            if(b == NUM_BUCKETS)
+                return;
+
+            Bucket &bk = m_buckets[b];
+
+            if(bk.entries.size() < K_VALUE) {
+                bk.entries.push_back(e);
+                track(e);
+            } else if(bk.replacements.size() < K_VALUE)
+                bk.replacements.push_back(e);
+            else
+                return;
+
+            m_index[e.hash] = b;
+        }
+
+        void RoutingTable::track(Entry const &e)
+        {
+            m_positions[e.hash] = m_hashes.size();
+            m_hashes.push_back(e.hash);
+
+            for(std::size_t w = 0; w < m_keys.size(); ++w)
+                m_keys[w].push_back(loadWord(e.key.data() + 8 * w));
+        }
+
+        void RoutingTable::untrack(RouterHash const &rh)
+        {
+            auto p = m_positions.find(rh);
+            if(p == m_positions.end())
+                return;
+
+            /* Move the last entry in to the hole to keep the arrays dense */
+            const std::size_t pos = p->second;
+            m_positions.erase(p);
+
+            if(pos != m_hashes.size() - 1) {
+                m_hashes[pos] = m_hashes.back();
+                for(auto& w: m_keys)
+                    w[pos] = w.back();
+                m_positions[m_hashes[pos]] = pos;
+            }
+
+            m_hashes.pop_back();
+            for(auto& w: m_keys)
+                w.pop_back();
+        }
     }
 }
@@ -6,27 +6,156 @@
 #ifndef KADROUTINGTABLE_H
 #define KADROUTINGTABLE_H
 
-#include <i2pcpp/datatypes/RouterInfo.h>
+#include <i2pcpp/datatypes/RouterHash.h>
 
-#include <set>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #define KEY_SIZE 32
 #define NUM_BUCKETS (KEY_SIZE * 8)
 #define K_VALUE 20
 
+/// Entries not seen for this long are pinged before they are kept over a newcomer
+#define KAD_QUESTIONABLE_AGE std::chrono::minutes(15)
+
+/// A pinged entry which has not answered after this long is evicted
+#define KAD_PING_TIMEOUT std::chrono::seconds(30)
+
 namespace i2pcpp {
     namespace Kad {
+        /**
+         * A Kademlia routing table of at most \a K_VALUE routers per bucket,
+         *  where bucket \a i holds the routers whose routing key shares
+         *  exactly \a i leading bits with the reference key.
+         * Each bucket is ordered from least to most recently seen. A router
+         *  is only let in to a full bucket if the least recently seen entry
+         *  fails to answer a ping; until then it waits in the replacement
+         *  cache of the bucket, which is also bounded by \a K_VALUE and
+         *  from which failed entries are replaced.
+         * Entries only reference routers by i2pcpp::RouterHash, so the
+         *  memory used is bounded regardless of the size of the netDb.
+         * Next to the buckets, the routing keys of the entries are kept in
+         *  a flat structure-of-arrays, one array per 64 bit word of the key,
+         *  so that the closest entries to any key are found with a single
+         *  linear scan. The scan uses AVX2 or SSE2 when the compiler targets
+         *  them.
+         * @note the class is designed to be thread-safe
+         */
         class RoutingTable {
+            public:
+                typedef StaticByteArray<KEY_SIZE> key_type;
+
+                /**
+                 * Constructs an empty table around \a reference, the
+                 *  routing key of this router.
+                 */
+                RoutingTable(key_type const &reference);
+                RoutingTable(const RoutingTable &) = delete;
+                RoutingTable& operator=(RoutingTable &) = delete;
+
+                /**
+                 * Adds the router \a rh with routing key \a k, or refreshes
+                 *  it if it is known.
+                 * @param seen true if \a rh was heard from directly, which
+                 *  makes it the most recently seen entry of its bucket
+                 * @param questionable set to the least recently seen entry
+                 *  of the bucket if \a rh could not be added because the
+                 *  bucket is full, and that entry should be pinged because
+                 *  it has never been seen or not for \a KAD_QUESTIONABLE_AGE
+                 * @return true if \a questionable was set
+                 */
+                bool update(RouterHash const &rh, key_type const &k, bool seen, RouterHash &questionable);
+
+                /**
+                 * Records that \a rh is being pinged. If it does not show up
+                 *  within \a KAD_PING_TIMEOUT, the next router which does
+                 *  not fit in its bucket takes its place.
+                 */
+                void pinging(RouterHash const &rh);
+
+                /**
+                 * Removes \a rh, after it failed to answer, and replaces it
+                 *  with the most recently seen router in the replacement
+                 *  cache of its bucket.
+                 */
+                void failed(RouterHash const &rh);
+
+                /**
+                 * @return the (at most) \a count routers whose keys are
+                 *  closest to \a k by XOR distance, closest first
+                 */
+                std::vector<RouterHash> closest(key_type const &k, std::size_t count) const;
+
+                /**
+                 * @return the number of routers in the buckets, not counting
+                 *  the replacement caches
+                 */
+                std::size_t size() const;
+
+                /**
+                 * Moves the table to the new reference key \a reference,
+                 *  when the routing keys change at midnight. The key of
+                 *  every router is recomputed with \a makeKey and the
+                 *  routers are sorted in to their new buckets, most recently
+                 *  seen first.
+                 */
+                void rekey(key_type const &reference, std::function<key_type(RouterHash const &)> const &makeKey);
+
             private:
+                typedef std::chrono::steady_clock clock;
+
                 struct Entry {
-                    StaticByteArray<32> key;
-                    RouterInfo value;
+                    RouterHash hash;
+                    key_type key;
+                    clock::time_point lastSeen; ///< Zero if never seen
+                    clock::time_point pinged; ///< Zero if no ping is outstanding
+                };
 
-                    bool operator<(const Entry& e) const;
+                struct Bucket {
+                    std::list<Entry> entries; ///< Least recently seen first
+                    std::list<Entry> replacements; ///< Least recently seen first
                 };
 
-                typedef std::set<Entry> bucket_t;
-                std::array<bucket_t, NUM_BUCKETS> m_buckets;
+                /**
+                 * @return the bucket of \a k, or \a NUM_BUCKETS if \a k is
+                 *  the reference key
+                 */
+                std::size_t getBucket(key_type const &k) const;
+
+                /**
+                 * Adds \a e to its bucket, or to the replacement cache if the
+                 *  bucket is full. Must be called with m_mutex held.
+                 */
+                void place(Entry const &e);
+
+                /**
+                 * Adds the key of \a e, which has been put in a bucket, to
+                 *  the key arrays. Must be called with m_mutex held.
+                 */
+                void track(Entry const &e);
+
+                /**
+                 * Removes the key of \a rh, which has been taken out of its
+                 *  bucket, from the key arrays. Must be called with m_mutex
+                 *  held.
+                 */
+                void untrack(RouterHash const &rh);
+
+                key_type m_ref;
+                std::array<Bucket, NUM_BUCKETS> m_buckets;
+                std::unordered_map<RouterHash, std::size_t> m_index; ///< Bucket of every entry and replacement
+
+                /// Word w of the key of m_hashes[i] is m_keys[w][i], most significant word first
+                std::array<std::vector<uint64_t>, KEY_SIZE / 8> m_keys;
+                std::vector<RouterHash> m_hashes;
+                std::unordered_map<RouterHash, std::size_t> m_positions;
+
+                mutable std::mutex m_mutex;
         };
     }
 }
@@ -78,6 +78,15 @@ int sqlite::detail::basic_statement::clear_bindings()
 }
 
 
+int sqlite::detail::basic_statement::bind(
+	unsigned int index,
+	const std::vector< unsigned char > &value )
+{
+	return sqlite3_bind_blob( _handle, index, value.data(), value.size(),
+		SQLITE_TRANSIENT );
+}
+
+
 int sqlite::detail::basic_statement::bind_static(
 	unsigned int index,
 	const char *value,
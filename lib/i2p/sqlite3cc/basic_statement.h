@@ -28,6 +28,7 @@
 #include <boost/utility.hpp>
 #include <boost/lexical_cast.hpp>
 #include <sqlite3cc/exception.h>
+#include <vector>
 
 
 namespace sqlite
@@ -131,6 +132,19 @@ public:
 			string_value.length(), SQLITE_TRANSIENT );
 	}
 
+	/**
+	 * Bind a byte vector to the SQL statement via it's index as a blob, rather
+	 * than converting it to text.
+	 *
+	 * @param index the index of the parameter to bind to
+	 * @param value the value to bind
+	 * @returns an sqlite error code
+	 * @see sqlite3_bind_blob()
+	 */
+	int bind(
+		unsigned int index,
+		const std::vector< unsigned char > &value );
+
 	/**
 	 * Bind a string value to the SQL statement via it's index where the value
 	 * of that string will not change for the duration of the statement.  This
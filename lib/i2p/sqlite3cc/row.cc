@@ -66,6 +66,18 @@ unsigned int sqlite::row::column_bytes(
 }
 
 
+void sqlite::row::column(
+	unsigned int index,
+	std::vector< unsigned char > &value )
+{
+	assert( index <
+		static_cast< unsigned int >( sqlite3_column_count( _handle ) ) );
+	const unsigned char *blob = static_cast< const unsigned char * >(
+		sqlite3_column_blob( _handle, index ) );
+	value.assign( blob, blob + sqlite3_column_bytes( _handle, index ) );
+}
+
+
 sqlite::row &sqlite::row::operator >>(
 	sqlite::detail::set_index_t t )
 {
@@ -30,6 +30,7 @@
 #include <boost/utility/value_init.hpp>
 #include <cassert>
 #include <iostream>
+#include <vector>
 
 
 namespace sqlite
@@ -135,6 +136,18 @@ public:
 			value = boost::get( boost::value_initialized< T >() );
 	}
 
+	/**
+	 * Get a blob value from the row as a byte vector, rather than converting
+	 * it from text.
+	 *
+	 * @param index column index
+	 * @param value reference to the vector to set with the value
+	 * @see sqlite3_column_blob()
+	 */
+	void column(
+		unsigned int index,
+		std::vector< unsigned char > &value );
+
 	/**
 	 * Get a value from the row and return it.
 	 *
@@ -24,7 +24,16 @@ namespace i2pcpp {
             statement_guard(boost::shared_ptr<sqlite::detail::basic_statement> s,
                     Params&&... p) : m_statement(s)
         {
-            bind(std::forward<Params>(p)...);
+            /* A statement that failed to execute must be reset before the
+             * transaction it is part of can be rolled back.
+             */
+            try {
+                bind(std::forward<Params>(p)...);
+            } catch(...) {
+                m_statement->clear_bindings();
+                m_statement->reset();
+                throw;
+            }
         }
 
         ~statement_guard()
@@ -0,0 +1,69 @@
+#include "AdmissionController.h"
+
+namespace i2pcpp {
+    namespace Tunnel {
+        AdmissionController::AdmissionController(std::size_t maxParticipating, uint32_t maxRequestsPerHop, uint32_t bandwidthShare, uint32_t tunnelBandwidth) :
+            m_maxParticipating(maxParticipating),
+            m_maxRequestsPerHop(maxRequestsPerHop),
+            m_bandwidthShare(bandwidthShare),
+            m_tunnelBandwidth(tunnelBandwidth),
+            m_lastExpiry(clock::now()) {}
+
+        bool AdmissionController::recordRequest(RouterHash const &from)
+        {
+            std::lock_guard<std::mutex> lock(m_requestsMutex);
+
+            auto now = clock::now();
+            expireWindows(now);
+
+            auto itr = m_requests.find(from);
+            if(itr == m_requests.end() || now - itr->second.start >= std::chrono::minutes(1)) {
+                m_requests[from] = { now, 1 };
+                return true;
+            }
+
+            ++itr->second.count;
+
+            /* Requests over the rate are still decrypted so that we can reply
+             * to them, but only up to a point.
+             */
+            return (itr->second.count <= 2 * m_maxRequestsPerHop);
+        }
+
+        BuildResponseRecord::Reply AdmissionController::admit(RouterHash const &from, std::size_t participating)
+        {
+            if(participating >= m_maxParticipating)
+                return BuildResponseRecord::Reply::TRANSIENT_OVERLOAD;
+
+            if((uint64_t)(participating + 1) * m_tunnelBandwidth > m_bandwidthShare)
+                return BuildResponseRecord::Reply::BANDWIDTH;
+
+            {
+                std::lock_guard<std::mutex> lock(m_requestsMutex);
+
+                auto itr = m_requests.find(from);
+                if(itr != m_requests.end() && itr->second.count > m_maxRequestsPerHop)
+                    return BuildResponseRecord::Reply::PROBABALISTIC_REJECT;
+            }
+
+            return BuildResponseRecord::Reply::SUCCESS;
+        }
+
+        void AdmissionController::expireWindows(clock::time_point now)
+        {
+            const auto window = std::chrono::minutes(1);
+
+            if(now - m_lastExpiry < window)
+                return;
+
+            for(auto itr = m_requests.begin(); itr != m_requests.end();) {
+                if(now - itr->second.start >= window)
+                    itr = m_requests.erase(itr);
+                else
+                    ++itr;
+            }
+
+            m_lastExpiry = now;
+        }
+    }
+}
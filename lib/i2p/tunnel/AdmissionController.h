@@ -0,0 +1,74 @@
+#ifndef TUNNELADMISSIONCONTROLLER_H
+#define TUNNELADMISSIONCONTROLLER_H
+
+#include <i2pcpp/datatypes/BuildResponseRecord.h>
+#include <i2pcpp/datatypes/RouterHash.h>
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+namespace i2pcpp {
+    namespace Tunnel {
+        /**
+         * Decides whether we accept a request to participate in a tunnel. The
+         * limits are the number of participating tunnels, the rate of requests
+         * from each previous hop, and the projected bandwidth of our
+         * participating tunnels against the configured share.
+         */
+        class AdmissionController {
+            public:
+                /**
+                 * @param maxParticipating the maximum number of participating tunnels
+                 * @param maxRequestsPerHop the maximum number of requests per minute from a single previous hop
+                 * @param bandwidthShare the bandwidth we share with participating tunnels, in KB/s
+                 * @param tunnelBandwidth the bandwidth we expect a single participating tunnel to use, in KB/s
+                 */
+                AdmissionController(std::size_t maxParticipating, uint32_t maxRequestsPerHop, uint32_t bandwidthShare, uint32_t tunnelBandwidth);
+                AdmissionController(const AdmissionController &) = delete;
+                AdmissionController& operator=(AdmissionController &) = delete;
+
+                /**
+                 * Counts a build request received from \a from. This is done
+                 * before any decryption takes place.
+                 * @return false if \a from is so far over its rate that the
+                 *  request should be dropped without decrypting it
+                 */
+                bool recordRequest(RouterHash const &from);
+
+                /**
+                 * Decides whether to accept a decrypted request received from
+                 * \a from while we participate in \a participating tunnels.
+                 * @return i2pcpp::BuildResponseRecord::Reply::SUCCESS or the
+                 *  reject code to reply with
+                 */
+                BuildResponseRecord::Reply admit(RouterHash const &from, std::size_t participating);
+
+            private:
+                typedef std::chrono::steady_clock clock;
+
+                struct RequestWindow {
+                    clock::time_point start;
+                    uint32_t count;
+                };
+
+                /**
+                 * Removes the request windows that have expired. Must be
+                 * called with m_requestsMutex held.
+                 */
+                void expireWindows(clock::time_point now);
+
+                std::size_t m_maxParticipating;
+                uint32_t m_maxRequestsPerHop;
+                uint32_t m_bandwidthShare;
+                uint32_t m_tunnelBandwidth;
+
+                std::unordered_map<RouterHash, RequestWindow> m_requests;
+                clock::time_point m_lastExpiry;
+
+                mutable std::mutex m_requestsMutex;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include "BandwidthLimiter.h"
+
+#include <algorithm>
+
+namespace i2pcpp {
+    namespace Tunnel {
+        BandwidthLimiter::BandwidthLimiter(uint32_t tunnelRate, uint32_t aggregateRate, double burst) :
+            m_tunnelRate(tunnelRate),
+            m_tunnelCapacity(tunnelRate * burst),
+            m_aggregateRate(aggregateRate),
+            m_aggregateCapacity(aggregateRate * burst),
+            m_aggregate({ m_aggregateCapacity, clock::now() }) {}
+
+        void BandwidthLimiter::add(uint32_t slot, uint32_t tunnelId)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if(slot >= m_accounts.size())
+                m_accounts.resize(slot + 1, { false, { 0, 0, 0, 0 }, { 0, clock::time_point() } });
+
+            Account &a = m_accounts[slot];
+            if(!a.open)
+                ++m_numOpen;
+
+            a = { true, { tunnelId, 0, 0, 0 }, { m_tunnelCapacity, clock::now() } };
+        }
+
+        void BandwidthLimiter::remove(uint32_t slot)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if(slot < m_accounts.size() && m_accounts[slot].open) {
+                m_accounts[slot].open = false;
+                --m_numOpen;
+            }
+        }
+
+        bool BandwidthLimiter::consume(uint32_t slot, std::size_t bytes)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if(slot >= m_accounts.size() || !m_accounts[slot].open)
+                return false;
+
+            Account &a = m_accounts[slot];
+            const clock::time_point now = clock::now();
+
+            a.bucket.refill(now, m_tunnelRate, m_tunnelCapacity);
+            m_aggregate.refill(now, m_aggregateRate, m_aggregateCapacity);
+
+            if(a.bucket.tokens < bytes || m_aggregate.tokens < bytes) {
+                ++a.usage.dropped;
+                ++m_dropped;
+                return false;
+            }
+
+            a.bucket.tokens -= bytes;
+            m_aggregate.tokens -= bytes;
+
+            a.usage.bytes += bytes;
+            ++a.usage.messages;
+
+            return true;
+        }
+
+        std::vector<BandwidthLimiter::Usage> BandwidthLimiter::getHeaviest(std::size_t n) const
+        {
+            std::vector<Usage> usage;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                usage.reserve(m_numOpen);
+                for(auto& a: m_accounts)
+                    if(a.open)
+                        usage.push_back(a.usage);
+            }
+
+            n = std::min(n, usage.size());
+            std::partial_sort(usage.begin(), usage.begin() + n, usage.end(), [](Usage const &a, Usage const &b) {
+                return a.bytes > b.bytes;
+            });
+            usage.resize(n);
+
+            return usage;
+        }
+
+        uint64_t BandwidthLimiter::getDropped() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_dropped;
+        }
+
+        void BandwidthLimiter::Bucket::refill(clock::time_point now, double rate, double capacity)
+        {
+            std::chrono::duration<double> elapsed = now - updated;
+            tokens = std::min(capacity, tokens + elapsed.count() * rate);
+            updated = now;
+        }
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef TUNNELBANDWIDTHLIMITER_H
+#define TUNNELBANDWIDTHLIMITER_H
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace i2pcpp {
+    namespace Tunnel {
+        /**
+         * Accounts for the traffic of the tunnels we participate in and
+         * enforces rate limits on them. Every tunnel has a token bucket, and
+         * all of them share an aggregate bucket the size of our bandwidth
+         * share. A message is only let through if both buckets hold enough
+         * tokens for it.
+         *
+         * The accounts live next to each other in a vector, indexed by the
+         * slot the i2pcpp::Tunnel::IdAllocator gave the tunnel, so that the
+         * per-message work touches a single, small entry.
+         */
+        class BandwidthLimiter {
+            public:
+                /**
+                 * Usage of a single tunnel.
+                 */
+                struct Usage {
+                    uint32_t tunnelId;
+                    uint64_t bytes;
+                    uint64_t messages;
+                    uint64_t dropped;
+                };
+
+                /**
+                 * @param tunnelRate the rate limit of each tunnel, in bytes per second
+                 * @param aggregateRate the rate limit of all tunnels together, in bytes per second
+                 * @param burst the number of seconds worth of traffic a bucket can hold
+                 */
+                BandwidthLimiter(uint32_t tunnelRate, uint32_t aggregateRate, double burst = 1.0);
+                BandwidthLimiter(const BandwidthLimiter &) = delete;
+                BandwidthLimiter& operator=(BandwidthLimiter &) = delete;
+
+                /**
+                 * Opens an account for \a tunnelId in \a slot, with a full
+                 * bucket.
+                 */
+                void add(uint32_t slot, uint32_t tunnelId);
+
+                /**
+                 * Closes the account in \a slot.
+                 */
+                void remove(uint32_t slot);
+
+                /**
+                 * Takes \a bytes from the bucket in \a slot and from the
+                 * aggregate bucket.
+                 * @return false if either of them is exhausted, or there is
+                 * no account in \a slot, in which case the message must be
+                 * dropped
+                 */
+                bool consume(uint32_t slot, std::size_t bytes);
+
+                /**
+                 * @return the usage of the \a n tunnels which transferred the
+                 * most bytes, heaviest first
+                 */
+                std::vector<Usage> getHeaviest(std::size_t n) const;
+
+                /**
+                 * @return the number of messages dropped for being over a limit
+                 */
+                uint64_t getDropped() const;
+
+            private:
+                typedef std::chrono::steady_clock clock;
+
+                struct Bucket {
+                    double tokens;
+                    clock::time_point updated;
+
+                    /**
+                     * Adds the tokens earned since the last update, up to
+                     * \a capacity.
+                     */
+                    void refill(clock::time_point now, double rate, double capacity);
+                };
+
+                struct Account {
+                    bool open;
+                    Usage usage;
+                    Bucket bucket;
+                };
+
+                double m_tunnelRate;
+                double m_tunnelCapacity;
+                double m_aggregateRate;
+                double m_aggregateCapacity;
+
+                std::vector<Account> m_accounts;
+                std::size_t m_numOpen = 0;
+                Bucket m_aggregate;
+                uint64_t m_dropped = 0;
+
+                mutable std::mutex m_mutex;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,144 @@
+#include "BuildReplyProcessor.h"
+
+#include <i2pcpp/util/xor_buf.h>
+
+#include <botan/block_cipher.h>
+#include <botan/lookup.h>
+
+#include <array>
+
+namespace i2pcpp {
+    namespace Tunnel {
+        typedef std::array<unsigned char, 528> RecordBuffer;
+
+        /**
+         * Undoes one layer of AES-256/CBC on \a record. The blocks are
+         * decrypted all at once and then chained, so that Botan can work on
+         * several of them in parallel.
+         */
+        static void decryptLayer(Botan::BlockCipher &cipher, StaticByteArray<16> const &iv, RecordBuffer &record)
+        {
+            RecordBuffer plain;
+            cipher.decrypt_n(record.data(), plain.data(), record.size() / 16);
+
+            Botan::xor_buf(plain.data(), iv.data(), 16);
+            Botan::xor_buf(plain.data() + 16, record.data(), record.size() - 16);
+
+            record = plain;
+        }
+
+        BuildReplyProcessor::BuildReplyProcessor(boost::asio::io_service &ios, CompletionHandler const &handler) :
+            m_ios(ios),
+            m_handler(handler),
+            m_log(boost::log::keywords::channel = "TBR")
+        {
+            m_worker = std::thread(&BuildReplyProcessor::run, this);
+        }
+
+        BuildReplyProcessor::~BuildReplyProcessor()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_queueMutex);
+                m_shutdown = true;
+            }
+
+            m_queueCondition.notify_all();
+
+            if(m_worker.joinable())
+                m_worker.join();
+        }
+
+        void BuildReplyProcessor::submit(TunnelPtr const &t, std::list<BuildRecordPtr> records)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_queueMutex);
+
+                Job j;
+                j.tunnel = t;
+                j.records = std::move(records);
+                m_queue.push_back(std::move(j));
+            }
+
+            m_queueCondition.notify_one();
+        }
+
+        void BuildReplyProcessor::run()
+        {
+            /* One cipher per hop position, kept between jobs so that only
+             * the key schedule is redone for each tunnel.
+             */
+            std::vector<std::unique_ptr<Botan::BlockCipher>> ciphers;
+
+            while(true) {
+                Job j;
+
+                {
+                    std::unique_lock<std::mutex> lock(m_queueMutex);
+                    m_queueCondition.wait(lock, [this]() { return m_shutdown || !m_queue.empty(); });
+                    if(m_shutdown)
+                        return;
+
+                    j = std::move(m_queue.front());
+                    m_queue.pop_front();
+                }
+
+                std::list<BuildRecordPtr> requests = j.tunnel->getRecords();
+                std::vector<BuildRequestRecordPtr> hops;
+                for(auto& r: requests)
+                    hops.push_back(std::static_pointer_cast<BuildRequestRecord>(r));
+
+                bool success = true;
+                std::vector<HopReply> replies;
+
+                if(j.records.size() < hops.size()) {
+                    I2P_LOG(m_log, debug) << "tunnel " << j.tunnel->getTunnelId() << ": expected " << hops.size() << " reply records, got " << j.records.size();
+                    m_ios.post(boost::bind(m_handler, j.tunnel, false, replies));
+                    continue;
+                }
+
+                // Records after the hops' (if any) are of no interest to us
+                std::vector<RecordBuffer> buffers(hops.size());
+                auto recordItr = j.records.cbegin();
+                for(auto& b: buffers) {
+                    ByteArray serialized = (*recordItr++)->serialize();
+                    std::copy(serialized.cbegin(), serialized.cend(), b.begin());
+                }
+
+                while(ciphers.size() < hops.size())
+                    ciphers.emplace_back(Botan::get_block_cipher("AES-256"));
+
+                for(std::size_t k = hops.size(); k-- > 0; ) {
+                    BuildRequestRecordPtr const &hop = hops[k];
+                    SessionKey const &key = hop->getReplyKey();
+
+                    Botan::BlockCipher &cipher = *ciphers[k];
+                    cipher.set_key(key.data(), key.size());
+
+                    for(std::size_t i = 0; i <= k; ++i)
+                        decryptLayer(cipher, hop->getReplyIV(), buffers[i]);
+
+                    // The record of hop k has no layers left
+                    ByteArray b(buffers[k].cbegin(), buffers[k].cend());
+                    ByteArrayConstItr begin = b.cbegin();
+                    BuildResponseRecord resp(BuildRecord(begin, b.cend()));
+
+                    try {
+                        resp.parse();
+                        replies.push_back({ hop->getLocalHash(), resp.getReply() });
+                    } catch(std::runtime_error &e) {
+                        I2P_LOG(m_log, debug) << "tunnel " << j.tunnel->getTunnelId() << ": invalid reply from hop " << k << ": " << e.what();
+                        replies.push_back({ hop->getLocalHash(), BuildResponseRecord::Reply::CRITICAL });
+                    }
+
+                    if(replies.back().reply != BuildResponseRecord::Reply::SUCCESS) {
+                        I2P_LOG(m_log, debug) << "tunnel " << j.tunnel->getTunnelId() << ": hop " << k << " rejected with " << (int)replies.back().reply;
+                        success = false;
+                        break;
+                    }
+                }
+
+                m_ios.post(boost::bind(m_handler, j.tunnel, success, replies));
+            }
+        }
+    }
+}
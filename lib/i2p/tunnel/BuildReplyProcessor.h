@@ -0,0 +1,86 @@
+#ifndef TUNNELBUILDREPLYPROCESSOR_H
+#define TUNNELBUILDREPLYPROCESSOR_H
+
+#include "Tunnel.h"
+
+#include <i2pcpp/Log.h>
+
+#include <i2pcpp/datatypes/BuildResponseRecord.h>
+
+#include <boost/asio.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace i2pcpp {
+    namespace Tunnel {
+        /**
+         * Processes the build replies for tunnels we created on a worker
+         * thread, so that the router thread never does the AES work.
+         *
+         * Every hop encrypts all the records with its reply key after putting
+         * its response in its own record, so the response of hop i is
+         * wrapped in the layers of hops i through n - 1. The layers are
+         * removed starting at the last hop, and the records of hops which
+         * have been fully unwrapped are not touched again. Each hop's
+         * response is checked as soon as it is clear, and processing stops
+         * at the first rejection.
+         */
+        class BuildReplyProcessor {
+            public:
+                /**
+                 * The response of a single hop.
+                 */
+                struct HopReply {
+                    RouterHash hop;
+                    BuildResponseRecord::Reply reply;
+                };
+
+                /**
+                 * Invoked on the I/O service once the replies for a tunnel
+                 * have been processed. The arguments are the tunnel, whether
+                 * every hop agreed to participate and the responses of the
+                 * hops that were examined, starting at the last hop.
+                 */
+                typedef std::function<void(TunnelPtr, bool, std::vector<HopReply>)> CompletionHandler;
+
+                BuildReplyProcessor(boost::asio::io_service &ios, CompletionHandler const &handler);
+                BuildReplyProcessor(const BuildReplyProcessor &) = delete;
+                BuildReplyProcessor& operator=(BuildReplyProcessor &) = delete;
+                ~BuildReplyProcessor();
+
+                /**
+                 * Queues the reply \a records for tunnel \a t.
+                 */
+                void submit(TunnelPtr const &t, std::list<BuildRecordPtr> records);
+
+            private:
+                struct Job {
+                    TunnelPtr tunnel;
+                    std::list<BuildRecordPtr> records;
+                };
+
+                void run();
+
+                boost::asio::io_service &m_ios;
+                CompletionHandler m_handler;
+
+                std::deque<Job> m_queue;
+                bool m_shutdown = false;
+
+                mutable std::mutex m_queueMutex;
+                std::condition_variable m_queueCondition;
+
+                std::thread m_worker;
+
+                i2p_logger_mt m_log;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,109 @@
+#include "BuildRequestPool.h"
+
+#include "../RouterContext.h"
+
+#include <i2pcpp/util/make_unique.h>
+
+#include <botan/pubkey.h>
+#include <botan/elgamal.h>
+
+namespace i2pcpp {
+    namespace Tunnel {
+        BuildRequestPool::BuildRequestPool(boost::asio::io_service &ios, RouterContext &ctx, CompletionHandler const &handler, unsigned int numWorkers, std::size_t queueLimit) :
+            m_ios(ios),
+            m_ctx(ctx),
+            m_handler(handler),
+            m_queueLimit(queueLimit),
+            m_log(boost::log::keywords::channel = "BRP")
+        {
+            if(!numWorkers)
+                numWorkers = 1;
+
+            for(unsigned int i = 0; i < numWorkers; ++i)
+                m_workers.emplace_back(&BuildRequestPool::run, this);
+        }
+
+        BuildRequestPool::~BuildRequestPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_queueMutex);
+                m_shutdown = true;
+            }
+
+            m_queueCondition.notify_all();
+
+            for(auto& t: m_workers)
+                if(t.joinable())
+                    t.join();
+        }
+
+        bool BuildRequestPool::submit(RouterHash const &from, std::list<BuildRecordPtr> records, std::size_t index)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_queueMutex);
+
+                std::size_t depth = m_queue.size();
+                if(depth >= 2 * m_queueLimit) {
+                    I2P_LOG(m_log, warning) << "build request queue full (" << depth << "), dropping request";
+                    return false;
+                }
+
+                Job j;
+                j.from = from;
+                j.records = std::move(records);
+                j.index = index;
+                j.overloaded = (depth >= m_queueLimit);
+                m_queue.push_back(std::move(j));
+            }
+
+            m_queueCondition.notify_one();
+
+            return true;
+        }
+
+        std::size_t BuildRequestPool::getQueueDepth() const
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            return m_queue.size();
+        }
+
+        void BuildRequestPool::run()
+        {
+            /* Each worker owns its decryptor, so none of them need to be shared
+             * between threads. It is created lazily because the router's keys
+             * may not have been loaded yet when the pool is constructed.
+             */
+            std::unique_ptr<Botan::PK_Decryptor> pkd;
+
+            while(true) {
+                Job j;
+
+                {
+                    std::unique_lock<std::mutex> lock(m_queueMutex);
+                    m_queueCondition.wait(lock, [this]() { return m_shutdown || !m_queue.empty(); });
+                    if(m_shutdown)
+                        return;
+
+                    j = std::move(m_queue.front());
+                    m_queue.pop_front();
+                }
+
+                try {
+                    if(!pkd)
+                        pkd = std::make_unique<Botan::PK_Decryptor_EME>(*m_ctx.getEncryptionKey(), "Raw");
+
+                    auto itr = j.records.cbegin();
+                    std::advance(itr, j.index);
+
+                    auto req = std::make_shared<BuildRequestRecord>(**itr);
+                    req->decrypt(*pkd);
+                    req->parse();
+
+                    m_ios.post(boost::bind(m_handler, j.from, j.records, j.index, req, j.overloaded));
+                } catch(std::exception &e) {
+                    I2P_LOG(m_log, error) << "could not decrypt build request record: " << e.what();
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef TUNNELBUILDREQUESTPOOL_H
+#define TUNNELBUILDREQUESTPOOL_H
+
+#include <i2pcpp/Log.h>
+
+#include <i2pcpp/datatypes/BuildRequestRecord.h>
+
+#include <boost/asio.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace i2pcpp {
+    class RouterContext;
+
+    namespace Tunnel {
+        /**
+         * Performs the ElGamal decryption of build request records addressed
+         * to us on a set of worker threads, so that the router thread never
+         * blocks on it. Each worker keeps its own decryptor for our private key.
+         */
+        class BuildRequestPool {
+            public:
+                /**
+                 * Invoked on the I/O service once our record has been decrypted
+                 * and parsed. The arguments are the previous hop, the full list
+                 * of records, the position of our record within it, the parsed
+                 * request and whether the request was queued while the pool was
+                 * overloaded.
+                 */
+                typedef std::function<void(RouterHash, std::list<BuildRecordPtr>, std::size_t, BuildRequestRecordPtr, bool)> CompletionHandler;
+
+                /**
+                 * Starts \a numWorkers threads. Requests queued beyond
+                 * \a queueLimit are flagged as overloaded, and requests beyond
+                 * twice that are dropped.
+                 */
+                BuildRequestPool(boost::asio::io_service &ios, RouterContext &ctx, CompletionHandler const &handler, unsigned int numWorkers, std::size_t queueLimit);
+                BuildRequestPool(const BuildRequestPool &) = delete;
+                BuildRequestPool& operator=(BuildRequestPool &) = delete;
+                ~BuildRequestPool();
+
+                /**
+                 * Queues the record at position \a index of \a records, received
+                 * from \a from, for decryption.
+                 * @return false if the queue was full and the request was dropped
+                 */
+                bool submit(RouterHash const &from, std::list<BuildRecordPtr> records, std::size_t index);
+
+                /**
+                 * @return the number of requests waiting for a worker
+                 */
+                std::size_t getQueueDepth() const;
+
+            private:
+                struct Job {
+                    RouterHash from;
+                    std::list<BuildRecordPtr> records;
+                    std::size_t index;
+                    bool overloaded;
+                };
+
+                void run();
+
+                boost::asio::io_service &m_ios;
+                RouterContext &m_ctx;
+                CompletionHandler m_handler;
+
+                std::size_t m_queueLimit;
+                std::deque<Job> m_queue;
+                bool m_shutdown = false;
+
+                mutable std::mutex m_queueMutex;
+                std::condition_variable m_queueCondition;
+
+                std::vector<std::thread> m_workers;
+
+                i2p_logger_mt m_log;
+        };
+    }
+}
+
+#endif
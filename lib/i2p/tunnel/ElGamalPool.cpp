@@ -0,0 +1,115 @@
+#include "ElGamalPool.h"
+
+#include <botan/auto_rng.h>
+#include <botan/dl_group.h>
+#include <botan/pow_mod.h>
+#include <botan/workfactor.h>
+
+namespace i2pcpp {
+    namespace Tunnel {
+        /**
+         * Generates a single ephemeral pair. The exponent size matches what
+         * Botan uses for its own ElGamal encryption.
+         */
+        static ElGamalPool::Pair generatePair(Botan::RandomNumberGenerator &rng)
+        {
+            static const Botan::DL_Group group("modp/ietf/2048");
+
+            /* Botan::Power_Mod keeps state between calls, so the generator
+             * thread and inline callers of take() each need their own.
+             */
+            thread_local const Botan::Fixed_Base_Power_Mod powerModG(group.get_g(), group.get_p());
+
+            ElGamalPool::Pair p;
+            p.k = Botan::BigInt(rng, 2 * Botan::dl_work_factor(group.get_p().bits()));
+            p.gk = powerModG(p.k);
+
+            return p;
+        }
+
+        ElGamalPool::ElGamalPool(std::size_t lowWater, std::size_t highWater) :
+            m_lowWater(lowWater),
+            m_highWater(std::max(lowWater, highWater)),
+            m_log(boost::log::keywords::channel = "EGP")
+        {
+            // A low water mark of zero disables the pool, every pair is generated inline
+            if(m_lowWater)
+                m_generator = std::thread(&ElGamalPool::run, this);
+        }
+
+        ElGamalPool::~ElGamalPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_pairsMutex);
+                m_shutdown = true;
+            }
+
+            m_refill.notify_all();
+
+            if(m_generator.joinable())
+                m_generator.join();
+        }
+
+        ElGamalPool::Pair ElGamalPool::take()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_pairsMutex);
+
+                if(!m_pairs.empty()) {
+                    Pair p = std::move(m_pairs.front());
+                    m_pairs.pop_front();
+
+                    if(m_pairs.size() < m_lowWater)
+                        m_refill.notify_one();
+
+                    return p;
+                }
+
+                if(m_lowWater) {
+                    ++m_misses;
+                    m_refill.notify_one();
+                }
+            }
+
+            I2P_LOG(m_log, debug) << "pool empty, generating ephemeral pair inline";
+
+            Botan::AutoSeeded_RNG rng;
+            return generatePair(rng);
+        }
+
+        std::size_t ElGamalPool::size() const
+        {
+            std::lock_guard<std::mutex> lock(m_pairsMutex);
+            return m_pairs.size();
+        }
+
+        uint64_t ElGamalPool::getMisses() const
+        {
+            std::lock_guard<std::mutex> lock(m_pairsMutex);
+            return m_misses;
+        }
+
+        void ElGamalPool::run()
+        {
+            Botan::AutoSeeded_RNG rng;
+
+            std::unique_lock<std::mutex> lock(m_pairsMutex);
+            while(true) {
+                m_refill.wait(lock, [this]() { return m_shutdown || m_pairs.size() < m_lowWater; });
+                if(m_shutdown)
+                    return;
+
+                /* Fill all the way up so that we don't wake up for every pair taken. */
+                while(!m_shutdown && m_pairs.size() < m_highWater) {
+                    lock.unlock();
+                    Pair p = generatePair(rng);
+                    lock.lock();
+
+                    m_pairs.push_back(std::move(p));
+                }
+
+                I2P_LOG(m_log, debug) << "pool refilled to " << m_pairs.size() << " pairs";
+            }
+        }
+    }
+}
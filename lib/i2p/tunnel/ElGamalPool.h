@@ -0,0 +1,76 @@
+#ifndef TUNNELELGAMALPOOL_H
+#define TUNNELELGAMALPOOL_H
+
+#include <i2pcpp/Log.h>
+
+#include <botan/bigint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace i2pcpp {
+    namespace Tunnel {
+        /**
+         * Keeps a pool of precomputed ElGamal ephemeral pairs (k, g^k mod p)
+         * for the 2048-bit group, refilled by a background thread. Encrypting
+         * a build record with one of these only needs the exponentiation of
+         * the recipient's public key.
+         */
+        class ElGamalPool {
+            public:
+                struct Pair {
+                    Botan::BigInt k;
+                    Botan::BigInt gk;
+                };
+
+                /**
+                 * Starts the generator thread. It refills the pool up to
+                 * \a highWater pairs whenever it drops below \a lowWater.
+                 * If \a lowWater is zero, the pool is disabled and no thread
+                 * is started.
+                 */
+                ElGamalPool(std::size_t lowWater, std::size_t highWater);
+                ElGamalPool(const ElGamalPool &) = delete;
+                ElGamalPool& operator=(ElGamalPool &) = delete;
+                ~ElGamalPool();
+
+                /**
+                 * Removes a pair from the pool. If the pool is empty, a pair
+                 * is generated on the calling thread instead. A pair is never
+                 * handed out twice.
+                 */
+                Pair take();
+
+                /**
+                 * @return the number of pairs currently in the pool
+                 */
+                std::size_t size() const;
+
+                /**
+                 * @return the number of times take() found the pool empty
+                 */
+                uint64_t getMisses() const;
+
+            private:
+                void run();
+
+                std::size_t m_lowWater;
+                std::size_t m_highWater;
+
+                std::deque<Pair> m_pairs;
+                uint64_t m_misses = 0;
+                bool m_shutdown = false;
+
+                mutable std::mutex m_pairsMutex;
+                std::condition_variable m_refill;
+
+                std::thread m_generator;
+
+                i2p_logger_mt m_log;
+        };
+    }
+}
+
+#endif
@@ -2,39 +2,41 @@
 
 namespace i2pcpp {
     namespace Tunnel {
-        ByteArray FirstFragment::compile() const
+        bool FirstFragment::isFirstFragment() const
         {
-            ByteArray output;
+            return true;
+        }
 
+        unsigned char *FirstFragment::write(unsigned char *dst) const
+        {
             unsigned char flag = 0x00;
 
             flag |= (unsigned char)m_mode << 5;
             flag |= (unsigned char)m_fragmented << 3;
-            output.insert(output.end(), flag);
+            *dst++ = flag;
 
             if(m_mode == DeliveryMode::TUNNEL) {
-                output.insert(output.end(), m_tunnelId >> 24);
-                output.insert(output.end(), m_tunnelId >> 16);
-                output.insert(output.end(), m_tunnelId >> 8);
-                output.insert(output.end(), m_tunnelId);
-
-                output.insert(output.end(), m_toHash.cbegin(), m_toHash.cend());
+                *dst++ = m_tunnelId >> 24;
+                *dst++ = m_tunnelId >> 16;
+                *dst++ = m_tunnelId >> 8;
+                *dst++ = m_tunnelId;
             }
 
+            if(m_mode == DeliveryMode::TUNNEL || m_mode == DeliveryMode::ROUTER)
+                dst = std::copy(m_toHash.cbegin(), m_toHash.cend(), dst);
+
             if(m_fragmented) {
-                output.insert(output.end(), m_msgId >> 24);
-                output.insert(output.end(), m_msgId >> 16);
-                output.insert(output.end(), m_msgId >> 8);
-                output.insert(output.end(), m_msgId);
+                *dst++ = m_msgId >> 24;
+                *dst++ = m_msgId >> 16;
+                *dst++ = m_msgId >> 8;
+                *dst++ = m_msgId;
             }
 
             uint16_t size = (uint16_t)m_payload.size();
-            output.insert(output.end(), size >> 8);
-            output.insert(output.end(), size);
-
-            output.insert(output.end(), m_payload.cbegin(), m_payload.cend());
+            *dst++ = size >> 8;
+            *dst++ = size;
 
-            return output;
+            return std::copy(m_payload.cbegin(), m_payload.cend(), dst);
         }
 
         bool FirstFragment::mustFragment(uint16_t desiredSize, uint16_t max) const
@@ -57,16 +59,31 @@ namespace i2pcpp {
             return m_tunnelId;
         }
 
+        void FirstFragment::setTunnelId(uint32_t tunnelId)
+        {
+            m_tunnelId = tunnelId;
+        }
+
         const RouterHash& FirstFragment::getToHash() const
         {
             return m_toHash;
         }
 
+        void FirstFragment::setToHash(RouterHash const &toHash)
+        {
+            m_toHash = toHash;
+        }
+
         FirstFragment::DeliveryMode FirstFragment::getDeliveryMode() const
         {
             return m_mode;
         }
 
+        void FirstFragment::setDeliveryMode(DeliveryMode mode)
+        {
+            m_mode = mode;
+        }
+
         FirstFragment FirstFragment::parse(ByteArrayConstItr &begin, ByteArrayConstItr end)
         {
             FirstFragment ff;
@@ -76,6 +93,9 @@ namespace i2pcpp {
             ff.m_fragmented = flag & (1 << 3);
 
             switch(ff.m_mode) {
+                case DeliveryMode::LOCAL:
+                    break;
+
                 case DeliveryMode::TUNNEL:
                     ff.m_tunnelId = parseUint32(begin);
                     std::copy(begin, begin + 32, ff.m_toHash.begin());
@@ -121,6 +141,12 @@ namespace i2pcpp {
                     else
                         return 43;
 
+                case DeliveryMode::ROUTER:
+                    if(!m_fragmented)
+                        return 35;
+                    else
+                        return 39;
+
                 default:
                     throw std::logic_error("Unimplemented FirstFragment delivery mode");
             }
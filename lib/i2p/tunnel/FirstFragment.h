@@ -19,10 +19,14 @@ namespace i2pcpp {
                     ROUTER = 0x02
                 };
 
+                bool isFirstFragment() const;
+
                 /**
-                 * @return a i2pcpp::ByteArray containing the compiled fragment.
+                 * Writes the compiled fragment to \a dst, which must have
+                 * room for size() bytes.
+                 * @return a pointer to the byte after the fragment
                  */
-                ByteArray compile() const;
+                unsigned char *write(unsigned char *dst) const;
 
                 /**
                  * @return true if headerSize() + \a desiredSize > \a max.
@@ -46,17 +50,34 @@ namespace i2pcpp {
                  */
                 uint32_t getTunnelId() const;
 
+                /**
+                 * Sets the tunnel ID the message is to be delivered to, for
+                 * i2pcpp::Tunnel::FirstFragment::DeliveryMode::TUNNEL.
+                 */
+                void setTunnelId(uint32_t tunnelId);
+
                 /**
                  * @return the toHash field in the first fragment.
                  */
                 const RouterHash& getToHash() const;
 
+                /**
+                 * Sets the router the message is to be delivered to.
+                 */
+                void setToHash(RouterHash const &toHash);
+
                 /**
                  * @return the i2pcpp::Tunnel::FirstFragment::DeliveryMode for
                  * this fragment.
                  */
                 DeliveryMode getDeliveryMode() const;
 
+                /**
+                 * Sets the delivery mode. This changes the size of the header,
+                 * so it must be done before the payload is set.
+                 */
+                void setDeliveryMode(DeliveryMode mode);
+
                 /**
                  * Constructs a i2pcpp::Tunnel::FirstFragment from a pair of
                  * const i2pcpp::ByteArray iterators.
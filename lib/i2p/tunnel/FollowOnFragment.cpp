@@ -28,28 +28,29 @@ namespace i2pcpp {
             return m_fragNum;
         }
 
-        ByteArray FollowOnFragment::compile() const
+        bool FollowOnFragment::isFirstFragment() const
         {
-            ByteArray output;
+            return false;
+        }
 
+        unsigned char *FollowOnFragment::write(unsigned char *dst) const
+        {
             unsigned char flag = 0x80;
 
             flag |= m_fragNum << 1;
             flag |= (unsigned char)m_isLast;
-            output.insert(output.end(), flag);
+            *dst++ = flag;
 
-            output.insert(output.end(), m_msgId >> 24);
-            output.insert(output.end(), m_msgId >> 16);
-            output.insert(output.end(), m_msgId >> 8);
-            output.insert(output.end(), m_msgId);
+            *dst++ = m_msgId >> 24;
+            *dst++ = m_msgId >> 16;
+            *dst++ = m_msgId >> 8;
+            *dst++ = m_msgId;
 
             uint16_t size = (uint16_t)m_payload.size();
-            output.insert(output.end(), size >> 8);
-            output.insert(output.end(), size);
-
-            output.insert(output.end(), m_payload.cbegin(), m_payload.cend());
+            *dst++ = size >> 8;
+            *dst++ = size;
 
-            return output;
+            return std::copy(m_payload.cbegin(), m_payload.cend(), dst);
         }
 
         FollowOnFragment FollowOnFragment::parse(ByteArrayConstItr &begin, ByteArrayConstItr end)
@@ -30,10 +30,14 @@ namespace i2pcpp {
                  */
                 uint8_t getFragNum() const;
 
+                bool isFirstFragment() const;
+
                 /**
-                 * Compiles the class to a i2pcpp::ByteArray.
+                 * Compiles the class to \a dst, which must have room for
+                 * size() bytes.
+                 * @return a pointer to the byte after the fragment
                  */
-                ByteArray compile() const;
+                unsigned char *write(unsigned char *dst) const;
 
                 /**
                  * Constructs a i2pcpp::Tunnel::FollowOnFragment from a pair of
@@ -46,14 +46,31 @@ namespace i2pcpp {
             return headerSize() + m_payload.size();
         }
 
+        ByteArray Fragment::compile() const
+        {
+            ByteArray output(size());
+            write(output.data());
+
+            return output;
+        }
+
         std::vector<FragmentPtr> Fragment::fragmentMessage(ByteArray const &data)
+        {
+            return fragmentMessage(data, 1003);
+        }
+
+        std::vector<FragmentPtr> Fragment::fragmentMessage(ByteArray const &data, uint16_t firstMaxSize)
+        {
+            return fragmentMessage(data, firstMaxSize, std::make_unique<FirstFragment>());
+        }
+
+        std::vector<FragmentPtr> Fragment::fragmentMessage(ByteArray const &data, uint16_t firstMaxSize, std::unique_ptr<FirstFragment> first)
         {
             constexpr uint16_t maxSize = 1003;
 
             std::vector<FragmentPtr> fragments;
 
-            std::unique_ptr<FirstFragment> first = std::make_unique<FirstFragment>();
-            if(first->mustFragment(data.size(), maxSize)) {
+            if(first->mustFragment(data.size(), firstMaxSize)) {
                 first->setFragmented(true);
 
                 uint32_t msgId = 0;
@@ -63,7 +80,7 @@ namespace i2pcpp {
 
                 auto pos = data.cbegin();
                 auto end = data.cend();
-                first->setPayload(pos, data.cend(), maxSize);
+                first->setPayload(pos, data.cend(), firstMaxSize);
                 fragments.push_back(std::move(first));
 
                 uint8_t fragNum = 1;
@@ -78,7 +95,7 @@ namespace i2pcpp {
                 }
             } else {
                 auto pos = data.cbegin();
-                first->setPayload(pos, data.cend(), maxSize);
+                first->setPayload(pos, data.cend(), firstMaxSize);
                 fragments.push_back(std::move(first));
             }
 
@@ -10,6 +10,8 @@
 
 namespace i2pcpp {
     namespace Tunnel {
+        class FirstFragment;
+
         class Fragment {
             public:
                 virtual ~Fragment() {}
@@ -40,7 +42,23 @@ namespace i2pcpp {
                  */
                 uint16_t size() const;
 
-                virtual ByteArray compile() const = 0;
+                /**
+                 * @return true if this is an i2pcpp::Tunnel::FirstFragment,
+                 * false if it is an i2pcpp::Tunnel::FollowOnFragment.
+                 */
+                virtual bool isFirstFragment() const = 0;
+
+                /**
+                 * @return a i2pcpp::ByteArray containing the compiled fragment.
+                 */
+                ByteArray compile() const;
+
+                /**
+                 * Serializes the fragment to \a dst, which must have room for
+                 * size() bytes.
+                 * @return a pointer to the byte after the fragment
+                 */
+                virtual unsigned char *write(unsigned char *dst) const = 0;
 
                 /**
                  * Fragments a complete array of \a data in to the corresponding
@@ -49,6 +67,19 @@ namespace i2pcpp {
                  */
                 static std::vector<std::unique_ptr<Fragment>> fragmentMessage(ByteArray const &data);
 
+                /**
+                 * Same as above, but the first fragment (including its header)
+                 * is limited to \a firstMaxSize bytes so that it fits in the
+                 * space left in a partially filled tunnel message.
+                 */
+                static std::vector<std::unique_ptr<Fragment>> fragmentMessage(ByteArray const &data, uint16_t firstMaxSize);
+
+                /**
+                 * Same as above, but uses \a first, which carries the delivery
+                 * instructions, as the first fragment.
+                 */
+                static std::vector<std::unique_ptr<Fragment>> fragmentMessage(ByteArray const &data, uint16_t firstMaxSize, std::unique_ptr<FirstFragment> first);
+
                 /**
                  * Parses the data at the iterator, creating a
                  * i2pcpp::Tunnel::FirstFragment or i2pcpp::Tunnel::FollowOnFragment
@@ -1,120 +1,405 @@
 #include "FragmentHandler.h"
 
-#include "FirstFragment.h"
-
 #include "../RouterContext.h"
 
 #include "../i2np/TunnelGateway.h"
 
 #include <i2pcpp/util/make_unique.h>
+#include <i2pcpp/datatypes/RouterIdentity.h>
 
 namespace i2pcpp {
     namespace Tunnel {
+        constexpr uint16_t FragmentHandler::chunkSize;
+        constexpr uint8_t FragmentHandler::maxFragments;
+        constexpr uint32_t FragmentHandler::noSlot;
+
         FragmentHandler::FragmentHandler(boost::asio::io_service &ios, RouterContext &ctx) :
             m_ios(ios),
             m_ctx(ctx),
-            m_log(boost::log::keywords::channel = "FH") {}
+            m_slots(std::stoi(ctx.getDatabase()->getConfigValue("fragment_slots", "256"))),
+            m_maxBytes(std::stoi(ctx.getDatabase()->getConfigValue("fragment_memory_cap", "2048")) * 1024),
+            m_timer(ios, boost::posix_time::time_duration(0, 0, 10)),
+            m_log(boost::log::keywords::channel = "FH")
+        {
+            m_index.reserve(m_slots.size());
+
+            m_freeSlots.reserve(m_slots.size());
+            for(uint32_t i = m_slots.size(); i > 0; --i)
+                m_freeSlots.push_back(i - 1);
 
-        void FragmentHandler::receiveFragments(std::list<FragmentPtr> fragments)
+            m_timer.async_wait(boost::bind(&FragmentHandler::timerCallback, this, boost::asio::placeholders::error));
+        }
+
+        void FragmentHandler::receiveFragments(RouterHash const &from, std::list<FragmentPtr> fragments)
         {
             I2P_LOG(m_log, debug) << "got " << fragments.size() << " fragments";
+
             for(auto& f: fragments) {
                 uint32_t msgId = f->getMsgId();
 
-                if(typeid(*f) == typeid(FirstFragment)) {
-                    I2P_LOG(m_log, debug) << "first fragment";
-
-                    auto ff = std::unique_ptr<FirstFragment>(dynamic_cast<FirstFragment *>(f.release()));
+                if(f->isFirstFragment()) {
+                    FirstFragment *ff = static_cast<FirstFragment *>(f.get());
                     if(!ff->isFragmented()) {
-                        I2P_LOG(m_log, debug) << "not fragmented";
+                        I2P_LOG(m_log, debug) << "first fragment, not fragmented";
 
                         // We received a first fragment with no further fragments -- send it right out
-                        I2NP::MessagePtr tg(new I2NP::TunnelGateway(ff->getTunnelId(), ff->getPayload()));
-                        m_ctx.getOutMsgDisp().sendMessage(ff->getToHash(), tg);
-                    } else {
-                        I2P_LOG(m_log, debug) << "fragmented";
+                        deliver(from, msgId, ff->getDeliveryMode(), ff->getTunnelId(), ff->getToHash(), ff->getPayload());
+                        continue;
+                    }
+                }
 
-                        std::lock_guard<std::mutex> lock(m_statesMutex);
+                FirstFragment::DeliveryMode mode;
+                uint32_t tunnelId;
+                RouterHash toHash;
+                ByteArray data;
 
-                        auto itr = m_states.find(msgId);
-                        if(itr != m_states.end())
-                            m_states[msgId].setFirstFragment(std::move(ff));
-                        else {
-                            FragmentState s;
-                            s.setFirstFragment(std::move(ff));
+                {
+                    std::lock_guard<std::mutex> lock(m_slotsMutex);
 
-                            auto timer = std::make_unique<boost::asio::deadline_timer>(m_ios, boost::posix_time::time_duration(0, 2, 0));
-                            timer->async_wait(boost::bind(&FragmentHandler::timerCallback, this, boost::asio::placeholders::error, msgId));
-                            s.setTimer(std::move(timer));
+                    uint32_t idx = store(std::move(f));
+                    if(idx == noSlot)
+                        continue;
 
-                            m_states[msgId] = std::move(s);
-                        }
-                    }
-                } else {
-                    I2P_LOG(m_log, debug) << "follow on fragment";
-
-                    auto fof = std::unique_ptr<FollowOnFragment>(dynamic_cast<FollowOnFragment *>(f.release()));
-
-                    std::lock_guard<std::mutex> lock(m_statesMutex);
-                    auto itr = m_states.find(msgId);
-                    if(itr != m_states.end())
-                        m_states[msgId].addFollowOnFragment(std::move(*fof));
-                    else {
-                        FragmentState s;
-                        s.addFollowOnFragment(std::move(*fof));
-                        m_states[msgId] = std::move(s);
+                    Slot &s = m_slots[idx];
+                    mode = s.mode;
+                    tunnelId = s.tunnelId;
+                    toHash = s.toHash;
+                    data = std::move(s.data);
+
+                    release(idx);
+                    ++m_completed;
+                }
+
+                I2P_LOG(m_log, debug) << "all fragments received for message " << msgId;
+                deliver(from, msgId, mode, tunnelId, toHash, data);
+            }
+        }
+
+        uint64_t FragmentHandler::getCompleted() const
+        {
+            std::lock_guard<std::mutex> lock(m_slotsMutex);
+            return m_completed;
+        }
+
+        uint64_t FragmentHandler::getExpired() const
+        {
+            std::lock_guard<std::mutex> lock(m_slotsMutex);
+            return m_expired;
+        }
+
+        uint64_t FragmentHandler::getEvicted() const
+        {
+            std::lock_guard<std::mutex> lock(m_slotsMutex);
+            return m_evicted;
+        }
+
+        void FragmentHandler::expire(std::chrono::steady_clock::time_point cutoff)
+        {
+            std::lock_guard<std::mutex> lock(m_slotsMutex);
+
+            /* The list is ordered by creation time, so we can stop at the
+             * first partial message which hasn't expired.
+             */
+            while(m_oldest != noSlot && m_slots[m_oldest].created < cutoff) {
+                release(m_oldest);
+                ++m_expired;
+            }
+        }
+
+        uint32_t FragmentHandler::store(FragmentPtr f)
+        {
+            uint8_t fragNum = 0;
+            bool last = false;
+
+            if(!f->isFirstFragment()) {
+                FollowOnFragment *fof = static_cast<FollowOnFragment *>(f.get());
+                fragNum = fof->getFragNum();
+                last = fof->isLast();
+            }
+
+            const ByteArray &payload = f->getPayload();
+            if(fragNum >= maxFragments || payload.size() > chunkSize) {
+                I2P_LOG(m_log, debug) << "malformed fragment, dropping";
+                return noSlot;
+            }
+
+            uint32_t idx = findOrCreate(f->getMsgId());
+            if(idx == noSlot)
+                return noSlot;
+
+            Slot &s = m_slots[idx];
+            if(s.received & (1ULL << fragNum)) {
+                I2P_LOG(m_log, debug) << "duplicate fragment " << (int)fragNum << " for message " << f->getMsgId();
+                return noSlot;
+            }
+
+            if(fragNum == s.contiguous) {
+                if(!append(idx, payload.data(), payload.size())) {
+                    I2P_LOG(m_log, debug) << "fragment memory exhausted, dropping fragment";
+                    if(!s.received)
+                        release(idx);
+
+                    return noSlot;
+                }
+
+                s.contiguous++;
+
+                // The fragments which arrived early can follow now
+                while(s.contiguous < maxFragments && s.chunks[s.contiguous]) {
+                    if(!append(idx, s.chunks[s.contiguous]->data(), s.lengths[s.contiguous])) {
+                        I2P_LOG(m_log, debug) << "fragment memory exhausted, evicting message " << s.msgId;
+                        release(idx);
+                        ++m_evicted;
+                        return noSlot;
                     }
+
+                    m_freeChunks.push_back(std::move(s.chunks[s.contiguous]));
+                    s.contiguous++;
                 }
+            } else {
+                std::unique_ptr<Chunk> chunk = allocateChunk(idx);
+                if(!chunk) {
+                    I2P_LOG(m_log, debug) << "fragment memory exhausted, dropping fragment";
+                    if(!s.received)
+                        release(idx);
+
+                    return noSlot;
+                }
+
+                std::copy(payload.cbegin(), payload.cend(), chunk->begin());
+                s.chunks[fragNum] = std::move(chunk);
+                s.lengths[fragNum] = payload.size();
+            }
+
+            s.received |= (1ULL << fragNum);
 
-                checkAndFlush(msgId);
+            if(!fragNum) {
+                FirstFragment *ff = static_cast<FirstFragment *>(f.get());
+                s.mode = ff->getDeliveryMode();
+                s.tunnelId = ff->getTunnelId();
+                s.toHash = ff->getToHash();
             }
+
+            if(last)
+                s.lastFragNum = fragNum;
+
+            if(s.lastFragNum < 0)
+                return noSlot;
+
+            uint64_t all = (s.lastFragNum == 63) ? ~0ULL : ((1ULL << (s.lastFragNum + 1)) - 1);
+            return (s.received == all) ? idx : noSlot;
         }
 
-        void FragmentHandler::checkAndFlush(uint32_t msgId)
+        uint32_t FragmentHandler::findOrCreate(uint32_t msgId)
         {
-            std::lock_guard<std::mutex> lock(m_statesMutex);
+            auto itr = m_index.find(msgId);
+            if(itr != m_index.end())
+                return itr->second;
 
-            if(m_states[msgId].isComplete()) {
-                I2P_LOG(m_log, debug) << "all fragments received";
+            if(m_freeSlots.empty()) {
+                if(m_oldest == noSlot)
+                    return noSlot;
 
-                auto& ff = m_states[msgId].getFirstFragment();
-                switch(ff->getDeliveryMode()) {
-                    case FirstFragment::DeliveryMode::TUNNEL:
-                        {
-                            I2P_LOG(m_log, debug) << "destination: tunnel";
+                I2P_LOG(m_log, debug) << "no free slots, evicting message " << m_slots[m_oldest].msgId;
+                release(m_oldest);
+                ++m_evicted;
+            }
 
-                            I2NP::MessagePtr tg(new I2NP::TunnelGateway(ff->getTunnelId(), m_states[msgId].compile()));
-                            m_ctx.getOutMsgDisp().sendMessage(ff->getToHash(), tg);
-                        }
+            uint32_t idx = m_freeSlots.back();
+            m_freeSlots.pop_back();
 
-                        break;
+            Slot &s = m_slots[idx];
+            s.used = true;
+            s.msgId = msgId;
+            s.created = std::chrono::steady_clock::now();
+            s.received = 0;
+            s.lastFragNum = -1;
+            s.contiguous = 0;
+            s.reserved = 0;
 
-                    case FirstFragment::DeliveryMode::ROUTER:
-                        {
-                            I2P_LOG(m_log, debug) << "destination: router";
+            // Newly created slots are always the newest
+            s.older = m_newest;
+            s.newer = noSlot;
+            if(m_newest != noSlot)
+                m_slots[m_newest].newer = idx;
+            else
+                m_oldest = idx;
+            m_newest = idx;
 
-                            I2NP::MessagePtr msg = I2NP::Message::fromBytes(msgId, m_states[msgId].compile());
-                            if(!msg)
-                                throw std::runtime_error("error sending router message as an endpoint");
+            m_index[msgId] = idx;
 
-                            m_ctx.getOutMsgDisp().sendMessage(ff->getToHash(), msg);
-                        }
+            return idx;
+        }
+
+        std::unique_ptr<FragmentHandler::Chunk> FragmentHandler::allocateChunk(uint32_t keep)
+        {
+            while(m_freeChunks.empty()) {
+                if((m_chunksAllocated + 1) * chunkSize + m_dataBytes <= m_maxBytes) {
+                    ++m_chunksAllocated;
+                    return std::make_unique<Chunk>();
+                }
 
-                        break;
+                uint32_t victim = m_oldest;
+                if(victim == keep)
+                    victim = m_slots[victim].newer;
 
-                    default:
-                        break;
+                if(victim == noSlot)
+                    return nullptr;
+
+                I2P_LOG(m_log, debug) << "fragment memory cap reached, evicting message " << m_slots[victim].msgId;
+                release(victim);
+                ++m_evicted;
+            }
+
+            std::unique_ptr<Chunk> c = std::move(m_freeChunks.back());
+            m_freeChunks.pop_back();
+
+            return c;
+        }
+
+        bool FragmentHandler::reserveBytes(std::size_t bytes, uint32_t keep)
+        {
+            while(m_chunksAllocated * chunkSize + m_dataBytes + bytes > m_maxBytes) {
+                // Pooled chunks are given back before anyone is evicted
+                if(!m_freeChunks.empty()) {
+                    m_freeChunks.pop_back();
+                    --m_chunksAllocated;
+                    continue;
                 }
 
-                m_states.erase(msgId);
+                uint32_t victim = m_oldest;
+                if(victim == keep)
+                    victim = m_slots[victim].newer;
+
+                if(victim == noSlot)
+                    return false;
+
+                I2P_LOG(m_log, debug) << "fragment memory cap reached, evicting message " << m_slots[victim].msgId;
+                release(victim);
+                ++m_evicted;
             }
+
+            return true;
+        }
+
+        bool FragmentHandler::append(uint32_t idx, unsigned char const *src, std::size_t length)
+        {
+            Slot &s = m_slots[idx];
+
+            std::size_t needed = s.data.size() + length;
+            if(needed > s.data.capacity()) {
+                /* The first fragment starts with the I2NP header, whose size
+                 * field gives the size of the whole message, so the buffer is
+                 * normally allocated once.
+                 */
+                if(s.data.empty() && length >= 16)
+                    needed = std::max(needed, 16 + (std::size_t)((src[13] << 8) | src[14]));
+
+                needed = std::min(needed, std::max<std::size_t>((std::size_t)chunkSize * maxFragments, s.data.size() + length));
+
+                if(!reserveBytes(needed - s.reserved, idx))
+                    return false;
+
+                s.data.reserve(needed);
+                m_dataBytes += s.data.capacity() - s.reserved;
+                s.reserved = s.data.capacity();
+            }
+
+            s.data.insert(s.data.end(), src, src + length);
+            return true;
         }
 
-        void FragmentHandler::timerCallback(const boost::system::error_code& e, const uint32_t msgId)
+        void FragmentHandler::release(uint32_t idx)
         {
-            std::lock_guard<std::mutex> lock(m_statesMutex);
+            Slot &s = m_slots[idx];
+
+            for(auto& c: s.chunks)
+                if(c)
+                    m_freeChunks.push_back(std::move(c));
+
+            m_dataBytes -= s.reserved;
+            s.reserved = 0;
+            s.data = ByteArray();
+
+            if(s.older != noSlot)
+                m_slots[s.older].newer = s.newer;
+            else
+                m_oldest = s.newer;
+
+            if(s.newer != noSlot)
+                m_slots[s.newer].older = s.older;
+            else
+                m_newest = s.older;
+
+            m_index.erase(s.msgId);
+            s.used = false;
+            m_freeSlots.push_back(idx);
+        }
+
+        void FragmentHandler::deliver(RouterHash const &from, uint32_t msgId, FirstFragment::DeliveryMode mode, uint32_t tunnelId, RouterHash const &toHash, ByteArray const &data)
+        {
+            const bool local = (mode == FirstFragment::DeliveryMode::LOCAL || toHash == m_ctx.getIdentity()->getHash());
+
+            switch(mode) {
+                case FirstFragment::DeliveryMode::TUNNEL:
+                    if(local) {
+                        I2P_LOG(m_log, debug) << "destination: one of our tunnels";
+
+                        m_ctx.getTunnelManager().receiveGatewayData(from, tunnelId, data);
+                    } else {
+                        I2P_LOG(m_log, debug) << "destination: tunnel";
+
+                        I2NP::MessagePtr tg(new I2NP::TunnelGateway(tunnelId, data));
+                        m_ctx.getOutMsgDisp().sendMessage(toHash, tg);
+                    }
+
+                    break;
+
+                case FirstFragment::DeliveryMode::LOCAL:
+                case FirstFragment::DeliveryMode::ROUTER:
+                    {
+                        I2NP::MessagePtr msg = I2NP::Message::fromBytes(msgId, data);
+                        if(!msg) {
+                            I2P_LOG(m_log, error) << "could not parse message as an endpoint, dropping";
+                            return;
+                        }
+
+                        if(local) {
+                            I2P_LOG(m_log, debug) << "destination: local";
+
+                            m_ctx.getInMsgDisp().dispatch(from, msg);
+                        } else {
+                            I2P_LOG(m_log, debug) << "destination: router";
+
+                            m_ctx.getOutMsgDisp().sendMessage(toHash, msg);
+                        }
+                    }
+
+                    break;
+
+                default:
+                    I2P_LOG(m_log, debug) << "unhandled delivery mode, dropping";
+                    break;
+            }
+        }
+
+        void FragmentHandler::timerCallback(const boost::system::error_code& e)
+        {
+            if(e == boost::asio::error::operation_aborted)
+                return;
+
+            expire(std::chrono::steady_clock::now() - std::chrono::minutes(2));
+
+            {
+                std::lock_guard<std::mutex> lock(m_slotsMutex);
+
+                I2P_LOG(m_log, debug) << "reassembly: " << m_index.size() << " partial messages, "
+                    << (m_chunksAllocated - m_freeChunks.size()) * chunkSize + m_dataBytes << " bytes buffered, "
+                    << m_completed << " completed, " << m_expired << " expired, " << m_evicted << " evicted";
+            }
 
-            m_states.erase(msgId);
+            m_timer.expires_at(m_timer.expires_at() + boost::posix_time::time_duration(0, 0, 10));
+            m_timer.async_wait(boost::bind(&FragmentHandler::timerCallback, this, boost::asio::placeholders::error));
         }
     }
 }
@@ -1,17 +1,36 @@
 #ifndef TUNNELFRAGMENTHANDLER_H
 #define TUNNELFRAGMENTHANDLER_H
 
-#include "FragmentState.h"
+#include "FirstFragment.h"
+#include "FollowOnFragment.h"
 
 #include <i2pcpp/Log.h>
 
-#include <unordered_map>
+#include <boost/asio.hpp>
+
+#include <array>
+#include <chrono>
+#include <list>
+#include <memory>
 #include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace i2pcpp {
     class RouterContext;
 
     namespace Tunnel {
+        /**
+         * Reassembles fragmented messages received at a tunnel endpoint.
+         * Partial messages live in a fixed size table of slots. Fragments
+         * which arrive in order are copied once, straight to the end of the
+         * message buffer of their slot, which is sized from the I2NP header
+         * in the first fragment. Fragments which arrive early wait in a
+         * pooled buffer chunk until the ones before them are in. The buffers
+         * and chunks of all slots are limited by a global memory cap; when
+         * it is reached, or when no slot is free, the oldest partial message
+         * is evicted.
+         */
         class FragmentHandler {
             public:
                 FragmentHandler(boost::asio::io_service &ios, RouterContext &ctx);
@@ -19,33 +38,153 @@ namespace i2pcpp {
                 FragmentHandler& operator=(FragmentHandler &) = delete;
 
                 /**
-                 * Collects a list of fragments we've received. All fragments go
-                 * in to a corresponding i2pcpp::Tunnel::FragmentState based on
-                 * message ID. FragmentStates are deleted after two minutes.
+                 * Collects a list of fragments we've received from \a from.
+                 * Fragments of the same message go in to the same slot, based
+                 * on message ID. Complete messages are sent to their
+                 * destination. Partial messages expire after two minutes.
+                 */
+                void receiveFragments(RouterHash const &from, std::list<FragmentPtr> fragments);
+
+                /**
+                 * @return the number of messages which were reassembled
+                 */
+                uint64_t getCompleted() const;
+
+                /**
+                 * @return the number of partial messages which timed out
+                 */
+                uint64_t getExpired() const;
+
+                /**
+                 * @return the number of partial messages which were evicted
+                 * to make room for others
+                 */
+                uint64_t getEvicted() const;
+
+                /**
+                 * Drops the partial messages whose first fragment arrived
+                 * before \a cutoff. Called by the timer with a cutoff of two
+                 * minutes ago.
                  */
-                void receiveFragments(std::list<FragmentPtr> fragments);
+                void expire(std::chrono::steady_clock::time_point cutoff);
 
             private:
+                /// Largest payload a fragment can carry in a tunnel message
+                static constexpr uint16_t chunkSize = 996;
+                static constexpr uint8_t maxFragments = 64;
+                static constexpr uint32_t noSlot = 0xffffffff;
+
+                typedef std::array<unsigned char, chunkSize> Chunk;
+
+                struct Slot {
+                    bool used = false;
+                    uint32_t msgId;
+                    std::chrono::steady_clock::time_point created;
+
+                    /// Bit n is set when fragment number n has been received
+                    uint64_t received;
+                    /// Fragment number of the last fragment, or -1 if unknown
+                    int lastFragNum;
+
+                    /// Delivery instructions, from the first fragment
+                    FirstFragment::DeliveryMode mode;
+                    uint32_t tunnelId;
+                    RouterHash toHash;
+
+                    /// The fragments received in order so far, concatenated
+                    ByteArray data;
+                    /// The number of fragments in data
+                    int contiguous;
+                    /// The capacity of data counted against the memory cap
+                    std::size_t reserved;
+
+                    /// Fragments which arrived before the ones preceding them
+                    std::array<std::unique_ptr<Chunk>, maxFragments> chunks;
+                    std::array<uint16_t, maxFragments> lengths;
+
+                    /// Neighbours in the oldest-first list
+                    uint32_t older;
+                    uint32_t newer;
+                };
+
+                /**
+                 * Stores \a f in the slot for its message. Must be called with
+                 * m_slotsMutex held.
+                 * @return the slot index if the message is now complete,
+                 * i2pcpp::Tunnel::FragmentHandler::noSlot otherwise
+                 */
+                uint32_t store(FragmentPtr f);
+
+                /**
+                 * @return the index of the slot for \a msgId, taking a free (or
+                 * evicted) slot if there isn't one. Must be called with
+                 * m_slotsMutex held.
+                 */
+                uint32_t findOrCreate(uint32_t msgId);
+
+                /**
+                 * @return a buffer chunk from the pool, evicting old partial
+                 * messages other than \a keep if the memory cap has been reached.
+                 * Must be called with m_slotsMutex held.
+                 */
+                std::unique_ptr<Chunk> allocateChunk(uint32_t keep);
+
+                /**
+                 * Makes room for \a bytes more of message buffers, evicting old
+                 * partial messages other than \a keep if the memory cap has
+                 * been reached. The caller accounts for the bytes it then
+                 * allocates. Must be called with m_slotsMutex held.
+                 * @return false if there is not enough memory
+                 */
+                bool reserveBytes(std::size_t bytes, uint32_t keep);
+
+                /**
+                 * Appends \a length bytes at \a src to the message buffer of
+                 * slot \a idx. Must be called with m_slotsMutex held.
+                 * @return false if there is not enough memory
+                 */
+                bool append(uint32_t idx, unsigned char const *src, std::size_t length);
+
                 /**
-                 * Checks whether all the fragments for a particular \a msgId have
-                 * been received. If so, the fragments are compiled in to a single
-                 * byte array, wrapped in an i2pcpp::I2NP::Message, and sent to the
-                 * intended destination.
+                 * Returns the chunks of slot \a idx to the pool and marks it as
+                 * free. Must be called with m_slotsMutex held.
                  */
-                void checkAndFlush(uint32_t msgId);
+                void release(uint32_t idx);
 
                 /**
-                 * Erases the i2pcpp::Tunnel::FragmentState for a given \a msgId.
+                 * Sends the reassembled message \a data according to the delivery
+                 * instructions in its first fragment. Messages for this router
+                 * are handed to the local handlers directly, without being
+                 * serialized again.
                  */
-                void timerCallback(const boost::system::error_code& e, const uint32_t msgId);
+                void deliver(RouterHash const &from, uint32_t msgId, FirstFragment::DeliveryMode mode, uint32_t tunnelId, RouterHash const &toHash, ByteArray const &data);
+
+                /**
+                 * Expires partial messages that are more than two minutes old.
+                 */
+                void timerCallback(const boost::system::error_code& e);
 
                 boost::asio::io_service &m_ios;
                 RouterContext &m_ctx;
 
-                /// A map of message IDs to fragment states.
-                std::unordered_map<uint32_t, FragmentState> m_states;
+                std::vector<Slot> m_slots;
+                std::unordered_map<uint32_t, uint32_t> m_index;
+                std::vector<uint32_t> m_freeSlots;
+                uint32_t m_oldest = noSlot;
+                uint32_t m_newest = noSlot;
+
+                std::vector<std::unique_ptr<Chunk>> m_freeChunks;
+                std::size_t m_chunksAllocated = 0;
+                std::size_t m_dataBytes = 0; ///< Capacity of the message buffers of all slots
+                std::size_t m_maxBytes;
+
+                uint64_t m_completed = 0;
+                uint64_t m_expired = 0;
+                uint64_t m_evicted = 0;
+
+                mutable std::mutex m_slotsMutex;
 
-                mutable std::mutex m_statesMutex;
+                boost::asio::deadline_timer m_timer;
 
                 i2p_logger_mt m_log;
         };
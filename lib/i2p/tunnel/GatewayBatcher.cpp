@@ -0,0 +1,120 @@
+#include "GatewayBatcher.h"
+
+namespace i2pcpp {
+    namespace Tunnel {
+        /// Space available for fragments in a tunnel message
+        constexpr uint16_t maxPayload = 1003;
+
+        /// A message with less free space than this is not worth filling
+        constexpr uint16_t minFragmentSize = 32;
+
+        GatewayBatcher::GatewayBatcher(boost::asio::io_service &ios, uint32_t delay, SendHandler const &handler) :
+            m_delay(delay),
+            m_handler(handler),
+            m_timer(ios),
+            m_totalDelay(0),
+            m_log(boost::log::keywords::channel = "GB") {}
+
+        void GatewayBatcher::queue(ByteArray const &data)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if(m_used && maxPayload - m_used < minFragmentSize)
+                send();
+
+            auto fragments = Fragment::fragmentMessage(data, maxPayload - m_used);
+            for(auto& f: fragments) {
+                if(m_used + f->size() > maxPayload)
+                    send();
+
+                if(m_current.empty())
+                    m_oldest = std::chrono::steady_clock::now();
+
+                m_used += f->size();
+                m_current.push_back(std::move(f));
+            }
+
+            if(!m_delay || maxPayload - m_used < minFragmentSize) {
+                send();
+                return;
+            }
+
+            if(!m_timerArmed) {
+                m_timer.expires_from_now(boost::posix_time::milliseconds(m_delay));
+                m_timer.async_wait(boost::bind(&GatewayBatcher::timerCallback, shared_from_this(), boost::asio::placeholders::error));
+                m_timerArmed = true;
+            }
+        }
+
+        void GatewayBatcher::flush()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            send();
+        }
+
+        void GatewayBatcher::close()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            m_timer.cancel();
+            m_timerArmed = false;
+
+            send();
+        }
+
+        double GatewayBatcher::getFillRatio() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if(!m_sentMessages)
+                return 0.0;
+
+            return (double)m_sentBytes / (m_sentMessages * maxPayload);
+        }
+
+        double GatewayBatcher::getAverageDelay() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if(!m_sentMessages)
+                return 0.0;
+
+            return (double)m_totalDelay.count() / m_sentMessages;
+        }
+
+        void GatewayBatcher::send()
+        {
+            if(m_current.empty())
+                return;
+
+            auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_oldest);
+
+            ++m_sentMessages;
+            m_sentBytes += m_used;
+            m_totalDelay += delay;
+
+            I2P_LOG(m_log, debug) << "sending tunnel message with " << m_current.size() << " fragments, " << m_used << " bytes, held for " << delay.count() << "ms"
+                << " (average fill " << (int)(100 * m_sentBytes / (m_sentMessages * maxPayload)) << "%, average delay " << (double)m_totalDelay.count() / m_sentMessages << "ms)";
+
+            m_handler(m_current);
+
+            m_current.clear();
+            m_used = 0;
+        }
+
+        void GatewayBatcher::timerCallback(const boost::system::error_code &e)
+        {
+            /* The handler holds a reference to the batcher, so it is still
+             * alive here even if the tunnel has expired in the meantime.
+             */
+            if(e == boost::asio::error::operation_aborted)
+                return;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            m_timerArmed = false;
+            send();
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef TUNNELGATEWAYBATCHER_H
+#define TUNNELGATEWAYBATCHER_H
+
+#include "Fragment.h"
+
+#include <i2pcpp/Log.h>
+
+#include <boost/asio.hpp>
+
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+
+namespace i2pcpp {
+    namespace Tunnel {
+        /**
+         * Packs the messages sent through a tunnel gateway in to as few
+         * tunnel messages as possible. Fragments are queued for at most
+         * the configured delay, or until a tunnel message is full.
+         * Must be owned by a std::shared_ptr, which the pending timer
+         * handler keeps alive.
+         * @note the class is designed to be thread-safe
+         */
+        class GatewayBatcher : public std::enable_shared_from_this<GatewayBatcher> {
+            public:
+                /**
+                 * Called with the fragments of one tunnel message, ready to
+                 * be compiled, encrypted and sent.
+                 */
+                typedef std::function<void(std::list<FragmentPtr> &)> SendHandler;
+
+                /**
+                 * @param delay the maximum time, in milliseconds, a fragment
+                 *  is held back. Zero disables batching.
+                 */
+                GatewayBatcher(boost::asio::io_service &ios, uint32_t delay, SendHandler const &handler);
+                GatewayBatcher(const GatewayBatcher &) = delete;
+                GatewayBatcher& operator=(GatewayBatcher &) = delete;
+
+                /**
+                 * Fragments \a data and queues the fragments. Any tunnel
+                 * messages that are filled up are sent immediately.
+                 */
+                void queue(ByteArray const &data);
+
+                /**
+                 * Sends the partially filled tunnel message, if any.
+                 */
+                void flush();
+
+                /**
+                 * Cancels the timer and sends what is still queued. Called
+                 * when the tunnel expires.
+                 */
+                void close();
+
+                /**
+                 * @return the average fraction of the tunnel message payload
+                 *  which was used by fragments, between 0 and 1
+                 */
+                double getFillRatio() const;
+
+                /**
+                 * @return the average time, in milliseconds, tunnel messages
+                 *  were held back
+                 */
+                double getAverageDelay() const;
+
+            private:
+                /**
+                 * Sends the current tunnel message. Must be called with
+                 * m_mutex held.
+                 */
+                void send();
+                void timerCallback(const boost::system::error_code &e);
+
+                uint32_t m_delay;
+                SendHandler m_handler;
+
+                std::list<FragmentPtr> m_current;
+                uint16_t m_used = 0;
+                std::chrono::steady_clock::time_point m_oldest;
+
+                boost::asio::deadline_timer m_timer;
+                bool m_timerArmed = false;
+
+                uint64_t m_sentMessages = 0;
+                uint64_t m_sentBytes = 0;
+                std::chrono::milliseconds m_totalDelay;
+
+                mutable std::mutex m_mutex;
+
+                i2p_logger_mt m_log;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,151 @@
+#include "IdAllocator.h"
+
+#include <i2pcpp/util/BufferedRNG.h>
+
+namespace i2pcpp {
+    namespace Tunnel {
+        static BufferedRNG& rng()
+        {
+            static BufferedRNG r;
+            return r;
+        }
+
+        const uint32_t IdAllocator::NO_SLOT;
+
+        IdAllocator::IdAllocator() :
+            m_table(64, { 0, 0 })
+        {
+            rng().randomize((unsigned char *)&m_salt, sizeof(m_salt));
+        }
+
+        uint32_t IdAllocator::allocate()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            uint32_t tunnelId;
+            do {
+                rng().randomize((unsigned char *)&tunnelId, sizeof(tunnelId));
+            } while(!tunnelId || !insert(tunnelId));
+
+            return tunnelId;
+        }
+
+        bool IdAllocator::reserve(uint32_t tunnelId)
+        {
+            if(!tunnelId)
+                return false;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return insert(tunnelId);
+        }
+
+        void IdAllocator::release(uint32_t tunnelId)
+        {
+            if(!tunnelId)
+                return;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            const std::size_t mask = m_table.size() - 1;
+
+            std::size_t i = home(tunnelId);
+            while(m_table[i].tunnelId != tunnelId) {
+                if(!m_table[i].tunnelId)
+                    return;
+                i = (i + 1) & mask;
+            }
+
+            m_freeSlots.push_back(m_table[i].slot);
+            --m_size;
+
+            /* Shift the following entries of the cluster back in to the hole,
+             * unless that would move them in front of their home position.
+             */
+            for(std::size_t j = (i + 1) & mask; m_table[j].tunnelId; j = (j + 1) & mask) {
+                std::size_t k = home(m_table[j].tunnelId);
+                if(((j - k) & mask) >= ((j - i) & mask)) {
+                    m_table[i] = m_table[j];
+                    i = j;
+                }
+            }
+
+            m_table[i].tunnelId = 0;
+        }
+
+        uint32_t IdAllocator::getSlot(uint32_t tunnelId) const
+        {
+            if(!tunnelId)
+                return NO_SLOT;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            const std::size_t mask = m_table.size() - 1;
+            for(std::size_t i = home(tunnelId); m_table[i].tunnelId; i = (i + 1) & mask)
+                if(m_table[i].tunnelId == tunnelId)
+                    return m_table[i].slot;
+
+            return NO_SLOT;
+        }
+
+        std::size_t IdAllocator::size() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_size;
+        }
+
+        std::size_t IdAllocator::home(uint32_t tunnelId) const
+        {
+            uint32_t h = (tunnelId ^ m_salt) * 0x9e3779b1;
+            h ^= h >> 16;
+            h *= 0x85ebca6b;
+            h ^= h >> 13;
+
+            return h & (m_table.size() - 1);
+        }
+
+        bool IdAllocator::insert(uint32_t tunnelId)
+        {
+            // Keep the table at most half full, so that probes stay short
+            if((m_size + 1) * 2 > m_table.size())
+                grow();
+
+            const std::size_t mask = m_table.size() - 1;
+
+            std::size_t i = home(tunnelId);
+            for(; m_table[i].tunnelId; i = (i + 1) & mask)
+                if(m_table[i].tunnelId == tunnelId)
+                    return false;
+
+            uint32_t slot;
+            if(m_freeSlots.empty())
+                slot = m_numSlots++;
+            else {
+                slot = m_freeSlots.back();
+                m_freeSlots.pop_back();
+            }
+
+            m_table[i] = { tunnelId, slot };
+            ++m_size;
+
+            return true;
+        }
+
+        void IdAllocator::grow()
+        {
+            std::vector<Entry> old(m_table.size() * 2, { 0, 0 });
+            old.swap(m_table);
+
+            const std::size_t mask = m_table.size() - 1;
+            for(auto& e: old) {
+                if(!e.tunnelId)
+                    continue;
+
+                std::size_t i = home(e.tunnelId);
+                while(m_table[i].tunnelId)
+                    i = (i + 1) & mask;
+
+                m_table[i] = e;
+            }
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef TUNNELIDALLOCATOR_H
+#define TUNNELIDALLOCATOR_H
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace i2pcpp {
+    namespace Tunnel {
+        /**
+         * Keeps track of every tunnel ID in use on this router, whether it
+         * was picked by us (for our own tunnels) or by the creator of a
+         * tunnel we participate in, so that no two local tunnels ever share
+         * an ID.
+         *
+         * Every ID in use is mapped to a small, dense slot number. Slots are
+         * reused once their ID is released, so they can index per-tunnel
+         * state kept in plain vectors. The map itself is an open addressed
+         * table, with a salted hash so that remote routers cannot choose IDs
+         * which collide in it.
+         */
+        class IdAllocator {
+            public:
+                /// Returned by getSlot for IDs which are not in use
+                static const uint32_t NO_SLOT = 0xffffffff;
+
+                IdAllocator();
+                IdAllocator(const IdAllocator &) = delete;
+                IdAllocator& operator=(IdAllocator &) = delete;
+
+                /**
+                 * Picks a random, unused tunnel ID and reserves it.
+                 * @return the reserved ID
+                 */
+                uint32_t allocate();
+
+                /**
+                 * Reserves \a tunnelId, which was chosen by another router.
+                 * @return false if the ID is already in use or invalid
+                 */
+                bool reserve(uint32_t tunnelId);
+
+                /**
+                 * Releases \a tunnelId and its slot, if it is in use.
+                 */
+                void release(uint32_t tunnelId);
+
+                /**
+                 * @return the slot of \a tunnelId, or NO_SLOT if it is not in use
+                 */
+                uint32_t getSlot(uint32_t tunnelId) const;
+
+                /**
+                 * @return the number of IDs in use
+                 */
+                std::size_t size() const;
+
+            private:
+                struct Entry {
+                    uint32_t tunnelId; ///< Zero if the entry is empty
+                    uint32_t slot;
+                };
+
+                /**
+                 * @return the position \a tunnelId hashes to in m_table
+                 */
+                std::size_t home(uint32_t tunnelId) const;
+
+                /**
+                 * Inserts \a tunnelId with a free slot. Must be called with
+                 * m_mutex held.
+                 * @return false if it is already in use
+                 */
+                bool insert(uint32_t tunnelId);
+
+                /**
+                 * Doubles the size of m_table. Must be called with m_mutex held.
+                 */
+                void grow();
+
+                std::vector<Entry> m_table;
+                std::size_t m_size = 0;
+                uint32_t m_salt;
+
+                std::vector<uint32_t> m_freeSlots;
+                uint32_t m_numSlots = 0;
+
+                mutable std::mutex m_mutex;
+        };
+    }
+}
+
+#endif
@@ -1,17 +1,18 @@
 #include "InboundTunnel.h"
 
-#include <botan/auto_rng.h>
+#include "Message.h"
 
 #include <i2pcpp/datatypes/RouterIdentity.h>
 
 namespace i2pcpp {
     namespace Tunnel {
-        InboundTunnel::InboundTunnel(RouterHash const &myHash, std::vector<RouterIdentity> const &hops)
+        InboundTunnel::InboundTunnel(RouterHash const &myHash, uint32_t const tunnelId, std::vector<RouterIdentity> const &hops, ElGamalPool *pool) :
+            m_gatewayHash(myHash)
         {
+            m_tunnelId = tunnelId;
+
             /* Zero hop tunnel */
             if(hops.empty()) {
-                Botan::AutoSeeded_RNG rng;
-                rng.randomize((unsigned char *)&m_tunnelId, sizeof(m_tunnelId));
                 m_state = State::OPERATIONAL;
                 return;
             }
@@ -22,8 +23,7 @@ namespace i2pcpp {
 
             for(int i = 0; i < hops.size(); i++) {
                 if(!i) {
-                    h = std::make_shared<BuildRequestRecord>(hops[i], myHash);
-                    m_tunnelId = h->getNextTunnelId();
+                    h = std::make_shared<BuildRequestRecord>(hops[i], myHash, tunnelId);
                     m_nextMsgId = h->getNextMsgId();
                 } else
                     h = std::make_shared<BuildRequestRecord>(hops[i], lastRouterHash, lastTunnelId);
@@ -35,13 +35,39 @@ namespace i2pcpp {
             }
 
             std::static_pointer_cast<BuildRequestRecord>(m_hops.front())->setType(BuildRequestRecord::Type::GATEWAY);
+            m_gatewayHash = getDownstream();
 
-            secureRecords();
+            secureRecords(pool);
         }
 
         Tunnel::Direction InboundTunnel::getDirection() const
         {
             return Direction::INBOUND;
         }
+
+        RouterHash InboundTunnel::getGatewayHash() const
+        {
+            return m_gatewayHash;
+        }
+
+        uint32_t InboundTunnel::getGatewayTunnelId() const
+        {
+            if(m_hops.empty())
+                return m_tunnelId;
+
+            return std::static_pointer_cast<BuildRequestRecord>(m_hops.front())->getTunnelId();
+        }
+
+        void InboundTunnel::removeLayers(Message &msg) const
+        {
+            // The gateway encrypts first, so its layer is removed last
+            for(auto h = m_hops.crbegin(); h != m_hops.crend(); ++h) {
+                BuildRequestRecordPtr r = std::static_pointer_cast<BuildRequestRecord>(*h);
+
+                SessionKey k1 = r->getTunnelIVKey();
+                SessionKey k2 = r->getTunnelLayerKey();
+                msg.decrypt(Botan::SymmetricKey(k1.data(), k1.size()), Botan::SymmetricKey(k2.data(), k2.size()));
+            }
+        }
     }
 }
@@ -7,19 +7,43 @@
 
 namespace i2pcpp {
     namespace Tunnel {
+        class Message;
+
         class InboundTunnel : public Tunnel {
             public:
                 /**
                  * Constructs an inbound tunnel given the current router
-                 * hash \a myHash and the router identities of the hops
-                 * for the tunnel.
+                 * hash \a myHash, the ID \a tunnelId messages will arrive
+                 * on and the router identities of the hops for the tunnel.
+                 * The build records are encrypted with ephemeral pairs from
+                 * \a pool, if given.
                  */
-                InboundTunnel(RouterHash const &myHash, std::vector<RouterIdentity> const &hops = {});
+                InboundTunnel(RouterHash const &myHash, uint32_t const tunnelId, std::vector<RouterIdentity> const &hops = {}, ElGamalPool *pool = nullptr);
 
                 /**
                  * Returns the direction of this tunnel (always inbound).
                  */
                 Tunnel::Direction getDirection() const;
+
+                /**
+                 * @return the i2pcpp::RouterHash of the gateway, which is our
+                 * own for a zero hop tunnel.
+                 */
+                RouterHash getGatewayHash() const;
+
+                /**
+                 * @return the tunnel ID messages must be sent to at the gateway.
+                 */
+                uint32_t getGatewayTunnelId() const;
+
+                /**
+                 * Removes the layers of encryption added to \a msg by the
+                 * hops of this tunnel, starting at the hop closest to us.
+                 */
+                void removeLayers(Message &msg) const;
+
+            private:
+                RouterHash m_gatewayHash;
         };
     }
 }
@@ -12,6 +12,7 @@
 #include "../i2np/VariableTunnelBuildReply.h"
 #include "../i2np/TunnelData.h"
 #include "../i2np/TunnelGateway.h"
+#include "../i2np/DeliveryStatus.h"
 
 #include <i2pcpp/util/make_unique.h>
 #include <i2pcpp/datatypes/RouterInfo.h>
@@ -23,16 +24,44 @@ namespace i2pcpp {
         Manager::Manager(boost::asio::io_service &ios, RouterContext &ctx) :
             m_ios(ios),
             m_ctx(ctx),
+            m_gatewayBatchDelay(std::stoi(ctx.getDatabase()->getConfigValue("gateway_batch_delay", "100"))),
             m_fragmentHandler(ios, ctx),
+            m_replayFilter(ios, std::chrono::minutes(10),
+                    std::stoi(ctx.getDatabase()->getConfigValue("replay_filter_messages", "300000")),
+                    std::stod(ctx.getDatabase()->getConfigValue("replay_filter_fp_rate", "0.0001"))),
+            m_bandwidth(
+                    std::stoi(ctx.getDatabase()->getConfigValue("tunnel_rate_limit", "32")) * 1024,
+                    std::stoi(ctx.getDatabase()->getConfigValue("bandwidth_share", "256")) * 1024),
+            m_usageReportSize(std::stoi(ctx.getDatabase()->getConfigValue("tunnel_usage_report_size", "10"))),
+            m_elGamalPool(std::stoi(ctx.getDatabase()->getConfigValue("elgamal_pool_low", "16")), std::stoi(ctx.getDatabase()->getConfigValue("elgamal_pool_high", "64"))),
+            m_admission(
+                    std::stoi(ctx.getDatabase()->getConfigValue("max_participating_tunnels", "128")),
+                    std::stoi(ctx.getDatabase()->getConfigValue("max_build_requests_per_hop", "10")),
+                    std::stoi(ctx.getDatabase()->getConfigValue("bandwidth_share", "256")),
+                    std::stoi(ctx.getDatabase()->getConfigValue("tunnel_bandwidth_estimate", "2"))),
+            m_tester(ctx,
+                    std::chrono::milliseconds(std::stoi(ctx.getDatabase()->getConfigValue("tunnel_test_timeout", "10000"))),
+                    std::chrono::milliseconds(std::stoi(ctx.getDatabase()->getConfigValue("tunnel_max_latency", "3000"))),
+                    std::stoi(ctx.getDatabase()->getConfigValue("tunnel_test_max_failures", "2"))),
             m_timer(m_ios, boost::posix_time::time_duration(0, 0, 1)),
-            m_log(boost::log::keywords::channel = "TM") {}
+            m_testTimer(m_ios),
+            m_testInterval(std::stoi(ctx.getDatabase()->getConfigValue("tunnel_test_interval", "30"))),
+            m_log(boost::log::keywords::channel = "TM"),
+            m_buildRequestPool(ios, ctx,
+                    boost::bind(&Manager::processRequest, this, _1, _2, _3, _4, _5),
+                    std::stoi(ctx.getDatabase()->getConfigValue("tunnel_build_workers", std::to_string(std::thread::hardware_concurrency()))),
+                    std::stoi(ctx.getDatabase()->getConfigValue("tunnel_build_queue_limit", "32"))),
+            m_buildReplyProcessor(ios, boost::bind(&Manager::processReply, this, _1, _2, _3)) {}
 
         void Manager::begin()
         {
             m_timer.async_wait(boost::bind(&Manager::callback, this, boost::asio::placeholders::error));
+
+            m_testTimer.expires_from_now(boost::posix_time::seconds(m_testInterval));
+            m_testTimer.async_wait(boost::bind(&Manager::testCallback, this, boost::asio::placeholders::error));
         }
 
-        void Manager::receiveRecords(uint32_t const msgId, std::list<BuildRecordPtr> records)
+        void Manager::receiveRecords(RouterHash const from, uint32_t const msgId, std::list<BuildRecordPtr> records)
         {
             /* First check to see if we have a pending tunnel for this msgId */
             {
@@ -47,15 +76,8 @@ namespace i2pcpp {
                         return;
                     }
 
-                    t->handleResponses(records);
-                    if(t->getState() == Tunnel::State::OPERATIONAL) {
-                        I2P_LOG(m_log, debug) << "tunnel is operational";
-
-                        std::lock_guard<std::mutex> lock(m_tunnelsMutex);
-                        m_tunnels[t->getTunnelId()] = std::move(t);
-                    } else {
-                        I2P_LOG(m_log, debug) << "failed to build tunnel";
-                    }
+                    I2P_LOG(m_log, debug) << "received build replies for one of our tunnels, queueing for processing";
+                    m_buildReplyProcessor.submit(t, std::move(records));
 
                     m_pending.erase(itr);
                     return;
@@ -71,50 +93,127 @@ namespace i2pcpp {
 
             auto itr = std::find_if(records.begin(), records.end(), [myTruncatedHash](BuildRecordPtr const &r) { return (myTruncatedHash == r->getHeader()); });
             if(itr != records.end()) {
-                I2P_LOG(m_log, debug) << "found BRR with our identity";
+                I2P_LOG(m_log, debug) << "found BRR with our identity, queueing for decryption";
+
+                if(!m_admission.recordRequest(from)) {
+                    I2P_LOG(m_log, debug) << "dropped tunnel participation request: previous hop is flooding us";
+                    return;
+                }
+
+                /* The ElGamal decryption is done by the worker pool, which calls
+                 * processRequest() when it's done.
+                 */
+                if(!m_buildRequestPool.submit(from, records, std::distance(records.begin(), itr)))
+                    I2P_LOG(m_log, debug) << "dropped tunnel participation request: build request queue full";
+            }
+        }
 
-                /* We found a record that belongs to us. Let's decrypt and parse it. */
-                auto req = std::make_shared<BuildRequestRecord>(**itr);
-                req->decrypt(m_ctx.getEncryptionKey());
-                req->parse();
+        void Manager::processRequest(RouterHash const from, std::list<BuildRecordPtr> records, std::size_t index, BuildRequestRecordPtr req, bool overloaded)
+        {
+            if(overloaded) {
+                I2P_LOG(m_log, debug) << "rejecting tunnel participation request: build request queue overloaded";
+                sendReply(std::move(records), index, req, BuildResponseRecord::Reply::TRANSIENT_OVERLOAD);
+                return;
+            }
+
+            BuildResponseRecord::Reply reply;
 
+            /* The reply is built and encrypted after the lock is released,
+             * so that other tunnels are not held up by it.
+             */
+            {
                 std::lock_guard<std::mutex> lock(m_participatingMutex);
-                if(m_participating.count(req->getTunnelId()) > 0) {
+
+                /* The ID must not clash with any local tunnel, including our
+                 * own, or one of them would receive the other's messages.
+                 */
+                const uint32_t tunnelId = req->getTunnelId();
+                if(!m_ids.reserve(tunnelId)) {
                     I2P_LOG(m_log, debug) << "rejecting tunnel participation request: tunnel ID in use";
-                    // reject
-                    return;
+                    reply = BuildResponseRecord::Reply::TRANSIENT_OVERLOAD;
+                } else {
+                    reply = m_admission.admit(from, m_numParticipating);
+                    if(reply != BuildResponseRecord::Reply::SUCCESS) {
+                        I2P_LOG(m_log, debug) << "rejecting tunnel participation request: admission control returned " << (int)reply;
+                        m_ids.release(tunnelId);
+                    } else {
+                        const uint32_t slot = m_ids.getSlot(tunnelId);
+                        if(slot >= m_participants.size())
+                            m_participants.resize(slot + 1);
+
+                        Participant &p = m_participants[slot];
+                        p.tunnelId = tunnelId;
+                        p.hop = req;
+                        p.timer = std::make_unique<boost::asio::deadline_timer>(m_ios, boost::posix_time::time_duration(0, 10, 0));
+                        p.timer->async_wait(boost::bind(&Manager::timerCallback, this, boost::asio::placeholders::error, true, tunnelId));
+
+                        m_bandwidth.add(slot, tunnelId);
+                        ++m_numParticipating;
+                    }
                 }
+            }
 
-                auto timer = std::make_unique<boost::asio::deadline_timer>(m_ios, boost::posix_time::time_duration(0, 10, 0));
-                timer->async_wait(boost::bind(&Manager::timerCallback, this, boost::asio::placeholders::error, true, req->getTunnelId()));
+            sendReply(std::move(records), index, req, reply);
+        }
 
-                auto p = std::make_pair(req, std::move(timer));
-                m_participating[req->getTunnelId()] = std::move(p);
+        void Manager::processReply(TunnelPtr t, bool success, std::vector<BuildReplyProcessor::HopReply> replies)
+        {
+            for(auto& r: replies)
+                m_ctx.getProfileManager().buildReplyReceived(r.hop, r.reply == BuildResponseRecord::Reply::SUCCESS);
 
-                /* Now we generate a SUCCESS reponse which will get sent to the next hop in the chain. */
-                BuildResponseRecordPtr resp;
-                resp = std::make_shared<BuildResponseRecord>(BuildResponseRecord::Reply::SUCCESS);
-                resp->compile();
-                *itr = std::move(resp); // This replaces our request record with the response in-place.
+            if(success) {
+                I2P_LOG(m_log, debug) << "tunnel " << t->getTunnelId() << " is operational";
 
-                for(auto& x: records)
-                    x->encrypt(req->getReplyIV(), req->getReplyKey());
+                t->setState(Tunnel::State::OPERATIONAL);
 
-                /* If we're the endpoint, wrap the records in a Tunnel Gateway message before
-                 * sending it to the next hop.
-                 */
-                if(req->getType() == BuildRequestRecord::Type::ENDPOINT) {
-                    I2P_LOG(m_log, debug) << "forwarding BRRs to IBGW: " << req->getNextHash() << ", tunnel ID: " << req->getNextTunnelId() << ", nextMsgId: " << req->getNextMsgId();
+                // The tunnel may have expired while its replies were processed
+                std::lock_guard<std::mutex> lock(m_tunnelsMutex);
+                if(m_tunnelTimers.count(t->getTunnelId()))
+                    m_tunnels[t->getTunnelId()] = std::move(t);
+            } else {
+                I2P_LOG(m_log, debug) << "failed to build tunnel " << t->getTunnelId();
 
-                    I2NP::MessagePtr vtbr(new I2NP::VariableTunnelBuildReply(req->getNextMsgId(), records));
-                    I2NP::MessagePtr tg(new I2NP::TunnelGateway(req->getNextTunnelId(), vtbr->toBytes()));
-                    m_ctx.getOutMsgDisp().sendMessage(req->getNextHash(), tg);
-                } else {
-                    I2P_LOG(m_log, debug) << "forwarding BRRs to next hop: " << req->getNextHash() << ", tunnel ID: " << req->getNextTunnelId() << ", nextMsgId: " << req->getNextMsgId();
+                t->setState(Tunnel::State::FAILED);
 
-                    I2NP::MessagePtr vtb(new I2NP::VariableTunnelBuild(req->getNextMsgId(), records));
-                    m_ctx.getOutMsgDisp().sendMessage(req->getNextHash(), vtb);
-                }
+                std::lock_guard<std::mutex> lock(m_tunnelsMutex);
+
+                // The reply tunnel was only built for this one
+                auto itr = m_replyTunnels.find(t->getTunnelId());
+                if(itr != m_replyTunnels.end())
+                    removeTunnel(itr->second);
+
+                removeTunnel(t->getTunnelId());
+            }
+        }
+
+        void Manager::sendReply(std::list<BuildRecordPtr> records, std::size_t index, BuildRequestRecordPtr req, BuildResponseRecord::Reply reply)
+        {
+            /* Generate a response which will get sent to the next hop in the chain. */
+            BuildResponseRecordPtr resp;
+            resp = std::make_shared<BuildResponseRecord>(reply);
+            resp->compile();
+
+            auto itr = records.begin();
+            std::advance(itr, index);
+            *itr = std::move(resp); // This replaces our request record with the response in-place.
+
+            for(auto& x: records)
+                x->encrypt(req->getReplyIV(), req->getReplyKey());
+
+            /* If we're the endpoint, wrap the records in a Tunnel Gateway message before
+             * sending it to the next hop.
+             */
+            if(req->getType() == BuildRequestRecord::Type::ENDPOINT) {
+                I2P_LOG(m_log, debug) << "forwarding BRRs to IBGW: " << req->getNextHash() << ", tunnel ID: " << req->getNextTunnelId() << ", nextMsgId: " << req->getNextMsgId();
+
+                I2NP::MessagePtr vtbr(new I2NP::VariableTunnelBuildReply(req->getNextMsgId(), records));
+                I2NP::MessagePtr tg(new I2NP::TunnelGateway(req->getNextTunnelId(), vtbr->toBytes()));
+                m_ctx.getOutMsgDisp().sendMessage(req->getNextHash(), tg);
+            } else {
+                I2P_LOG(m_log, debug) << "forwarding BRRs to next hop: " << req->getNextHash() << ", tunnel ID: " << req->getNextTunnelId() << ", nextMsgId: " << req->getNextMsgId();
+
+                I2NP::MessagePtr vtb(new I2NP::VariableTunnelBuild(req->getNextMsgId(), records));
+                m_ctx.getOutMsgDisp().sendMessage(req->getNextHash(), vtb);
             }
         }
 
@@ -123,39 +222,48 @@ namespace i2pcpp {
             I2P_LOG_SCOPED_TAG(m_log, "TunnelId", tunnelId);
             I2P_LOG(m_log, debug) << "received " << data.size() << " bytes of gateway data";
 
+            const uint32_t slot = m_ids.getSlot(tunnelId);
+            if(slot == IdAllocator::NO_SLOT) {
+                I2P_LOG(m_log, debug) << "data is for an unknown tunnel, dropping";
+                return;
+            }
+
             {
                 std::lock_guard<std::mutex> lock(m_participatingMutex);
-                auto itr = m_participating.find(tunnelId);
-                if(itr != m_participating.end()) {
-                    BuildRequestRecordPtr hop = itr->second.first;
+                if(isParticipant(slot, tunnelId)) {
+                    Participant &p = m_participants[slot];
+                    BuildRequestRecordPtr hop = p.hop;
 
                     if(hop->getType() != BuildRequestRecord::Type::GATEWAY) {
                         I2P_LOG(m_log, debug) << "data is for a tunnel which is not a gateway, dropping";
                         return;
                     }
 
-                    I2P_LOG(m_log, debug) << "data is for a known tunnel, encrypting and forwarding";
-                    SessionKey k1 = hop->getTunnelIVKey();
-                    Botan::SymmetricKey ivKey(k1.data(), k1.size());
-                    SessionKey k2 = hop->getTunnelLayerKey();
-                    Botan::SymmetricKey layerKey(k2.data(), k2.size());
-
-                    auto fragments = Fragment::fragmentMessage(data);
-                    I2P_LOG(m_log, debug) << "we have " << fragments.size() << " fragments";
+                    if(!m_bandwidth.consume(slot, data.size())) {
+                        I2P_LOG(m_log, debug) << "tunnel is over its rate limit, dropping";
+                        return;
+                    }
 
-                    for(auto& f: fragments) {
-                        I2P_LOG(m_log, debug) << "fragment: " << f->compile();
+                    I2P_LOG(m_log, debug) << "data is for a known tunnel, queueing for encryption and forwarding";
 
-                        std::list<FragmentPtr> x;
-                        x.push_back(std::move(f)); // This may or may not be unsafe
+                    auto& batcher = p.batcher;
+                    if(!batcher) {
+                        batcher = std::make_shared<GatewayBatcher>(m_ios, m_gatewayBatchDelay, [this, hop](std::list<FragmentPtr> &fragments) {
+                            SessionKey k1 = hop->getTunnelIVKey();
+                            Botan::SymmetricKey ivKey(k1.data(), k1.size());
+                            SessionKey k2 = hop->getTunnelLayerKey();
+                            Botan::SymmetricKey layerKey(k2.data(), k2.size());
 
-                        Message msg(x);
-                        msg.compile();
-                        msg.encrypt(ivKey, layerKey);
-                        I2NP::MessagePtr td(new I2NP::TunnelData(hop->getNextTunnelId(), msg.getEncryptedData()));
-                        m_ctx.getOutMsgDisp().sendMessage(hop->getNextHash(), td);
+                            Message msg(fragments);
+                            msg.compile();
+                            msg.encrypt(ivKey, layerKey);
+                            I2NP::MessagePtr td(new I2NP::TunnelData(hop->getNextTunnelId(), msg.getEncryptedData()));
+                            m_ctx.getOutMsgDisp().sendMessage(hop->getNextHash(), td);
+                        });
                     }
 
+                    batcher->queue(data);
+
                     return;
                 }
             }
@@ -167,78 +275,219 @@ namespace i2pcpp {
                     TunnelPtr t = itr->second;
 
                     if(t->getDirection() == Tunnel::Direction::INBOUND && t->getState() == Tunnel::State::OPERATIONAL) {
-                        I2P_LOG(m_log, debug) << "data is for one of our own tunnels, recirculating";
-                        std::shared_ptr<InboundTunnel> ibt = std::dynamic_pointer_cast<InboundTunnel>(t);
+                        I2P_LOG(m_log, debug) << "data is for one of our own tunnels, delivering locally";
 
-                        m_ios.post(boost::bind(&InboundMessageDispatcher::messageReceived, boost::ref(m_ctx.getInMsgDisp()), from, 0, data));
+                        I2NP::MessagePtr msg = I2NP::Message::fromBytes(0, data);
+                        if(msg)
+                            m_ctx.getInMsgDisp().dispatch(from, msg);
                     }
                 }
             }
         }
 
-        void Manager::receiveData(RouterHash const from, uint32_t const tunnelId, StaticByteArray<1024> const data)
+        void Manager::receiveData(RouterHash const from, std::shared_ptr<I2NP::TunnelData> const td)
         {
-            std::lock_guard<std::mutex> lock(m_participatingMutex);
-
+            uint32_t tunnelId = td->getTunnelId();
             I2P_LOG_SCOPED_TAG(m_log, "TunnelId", tunnelId);
-            I2P_LOG(m_log, debug) << "received " << data.size() << " bytes of tunnel data";
+            I2P_LOG(m_log, debug) << "received tunnel data";
 
-            auto itr = m_participating.find(tunnelId);
-            if(itr != m_participating.end()) {
-                I2P_LOG(m_log, debug) << "data is for a known tunnel";
+            /* A single probe of the ID table tells whether the tunnel is
+             * known at all, and gives the slot of its state.
+             */
+            const uint32_t slot = m_ids.getSlot(tunnelId);
+            if(slot == IdAllocator::NO_SLOT) {
+                I2P_LOG(m_log, debug) << "data is for an unknown tunnel, dropping";
+                return;
+            }
 
-                BuildRequestRecordPtr hop = itr->second.first;
+            BuildRequestRecordPtr hop;
 
-                SessionKey k1 = hop->getTunnelIVKey();
-                Botan::SymmetricKey ivKey(k1.data(), k1.size());
+            {
+                std::lock_guard<std::mutex> lock(m_participatingMutex);
 
-                SessionKey k2 = hop->getTunnelLayerKey();
-                Botan::SymmetricKey layerKey(k2.data(), k2.size());
+                if(isParticipant(slot, tunnelId))
+                    hop = m_participants[slot].hop;
+            }
 
-                Message msg(data);
-                msg.encrypt(ivKey, layerKey);
+            if(!hop) {
+                receiveEndpointData(from, td);
+                return;
+            }
 
-                switch(hop->getType()) {
-                    case BuildRequestRecord::Type::PARTICIPANT:
-                        {
-                            I2P_LOG(m_log, debug) << "we are a participant, forwarding";
+            I2P_LOG(m_log, debug) << "data is for a known tunnel";
 
-                            I2NP::MessagePtr td(new I2NP::TunnelData(hop->getNextTunnelId(), msg.getEncryptedData()));
-                            m_ctx.getOutMsgDisp().sendMessage(hop->getNextHash(), td);
-                        }
+            // Replays are dropped before they cost the tunnel any of its budget
+            if(m_replayFilter.isReplay(td->getData())) {
+                I2P_LOG(m_log, debug) << "tunnel message is a replay, dropping";
+                return;
+            }
 
-                        break;
+            {
+                std::lock_guard<std::mutex> lock(m_participatingMutex);
 
-                    case BuildRequestRecord::Type::ENDPOINT:
-                        {
-                            I2P_LOG(m_log, debug) << "we are an endpoint, sending to fragment handler";
+                // The slot may have been released and reused since it was looked up
+                if(!isParticipant(slot, tunnelId)) {
+                    I2P_LOG(m_log, debug) << "tunnel expired, dropping";
+                    return;
+                }
 
-                            m_fragmentHandler.receiveFragments(msg.parse());
-                        }
+                // Tunnel messages have a fixed size
+                if(!m_bandwidth.consume(slot, 1024)) {
+                    I2P_LOG(m_log, debug) << "tunnel is over its rate limit, dropping";
+                    return;
+                }
+            }
 
-                        break;
+            SessionKey k1 = hop->getTunnelIVKey();
+            Botan::SymmetricKey ivKey(k1.data(), k1.size());
 
-                    default:
-                        break;
-                }
-            } else
+            SessionKey k2 = hop->getTunnelLayerKey();
+            Botan::SymmetricKey layerKey(k2.data(), k2.size());
+
+            Message msg(td->getData());
+            msg.encrypt(ivKey, layerKey);
+
+            switch(hop->getType()) {
+                case BuildRequestRecord::Type::PARTICIPANT:
+                    {
+                        I2P_LOG(m_log, debug) << "we are a participant, forwarding";
+
+                        td->reroute(hop->getNextTunnelId());
+                        m_ctx.getOutMsgDisp().sendMessage(hop->getNextHash(), td);
+                    }
+
+                    break;
+
+                case BuildRequestRecord::Type::ENDPOINT:
+                    {
+                        I2P_LOG(m_log, debug) << "we are an endpoint, sending to fragment handler";
+
+                        m_fragmentHandler.receiveFragments(from, msg.parse());
+                    }
+
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        bool Manager::isParticipant(uint32_t slot, uint32_t tunnelId) const
+        {
+            return slot < m_participants.size() && m_participants[slot].tunnelId == tunnelId;
+        }
+
+        void Manager::receiveEndpointData(RouterHash const &from, std::shared_ptr<I2NP::TunnelData> const &td)
+        {
+            std::shared_ptr<InboundTunnel> ibt;
+
+            {
+                std::lock_guard<std::mutex> lock(m_tunnelsMutex);
+
+                auto itr = m_tunnels.find(td->getTunnelId());
+                if(itr != m_tunnels.end() && itr->second->getDirection() == Tunnel::Direction::INBOUND && itr->second->getState() == Tunnel::State::OPERATIONAL)
+                    ibt = std::static_pointer_cast<InboundTunnel>(itr->second);
+            }
+
+            if(!ibt) {
                 I2P_LOG(m_log, debug) << "data is for an unknown tunnel, dropping";
+                return;
+            }
+
+            if(m_replayFilter.isReplay(td->getData())) {
+                I2P_LOG(m_log, debug) << "tunnel message is a replay, dropping";
+                return;
+            }
+
+            I2P_LOG(m_log, debug) << "data is for one of our inbound tunnels, sending to fragment handler";
+
+            Message msg(td->getData());
+            ibt->removeLayers(msg);
+
+            m_fragmentHandler.receiveFragments(from, msg.parse());
+        }
+
+        void Manager::receiveDeliveryStatus(RouterHash const from, uint32_t const msgId)
+        {
+            if(m_tester.complete(msgId))
+                cullTunnels();
+        }
+
+        bool Manager::isTunnelTest(uint32_t const msgId) const
+        {
+            return m_tester.isPending(msgId);
         }
 
         void Manager::timerCallback(const boost::system::error_code &e, bool participating, uint32_t tunnelId)
         {
             if(participating) {
                 std::lock_guard<std::mutex> lock(m_participatingMutex);
-                m_participating.erase(tunnelId);
+
+                const uint32_t slot = m_ids.getSlot(tunnelId);
+                if(!isParticipant(slot, tunnelId))
+                    return;
+
+                // Sends the fragments still queued; a timer handler in flight keeps the batcher alive
+                if(m_participants[slot].batcher)
+                    m_participants[slot].batcher->close();
+
+                m_participants[slot] = Participant();
+                m_bandwidth.remove(slot);
+                m_ids.release(tunnelId);
+                --m_numParticipating;
             } else {
+                if(e == boost::asio::error::operation_aborted)
+                    return;
+
+                // A tunnel still being built has timed out
+                {
+                    std::lock_guard<std::mutex> lock(m_pendingMutex);
+                    for(auto itr = m_pending.begin(); itr != m_pending.end(); ) {
+                        if(itr->second->getTunnelId() == tunnelId)
+                            itr = m_pending.erase(itr);
+                        else
+                            ++itr;
+                    }
+                }
+
                 std::lock_guard<std::mutex> lock(m_tunnelsMutex);
-                m_tunnels.erase(tunnelId);
+                removeTunnel(tunnelId);
             }
         }
 
+        void Manager::expireTunnel(uint32_t tunnelId)
+        {
+            auto& timer = m_tunnelTimers[tunnelId];
+            timer = std::make_unique<boost::asio::deadline_timer>(m_ios, boost::posix_time::time_duration(0, 10, 0));
+            timer->async_wait(boost::bind(&Manager::timerCallback, this, boost::asio::placeholders::error, false, tunnelId));
+        }
+
+        void Manager::removeTunnel(uint32_t tunnelId)
+        {
+            /* The timer is the record of our ownership of the ID. Once it is
+             * gone, the ID may have been reserved by a participating tunnel.
+             */
+            auto timer = m_tunnelTimers.find(tunnelId);
+            if(timer == m_tunnelTimers.end())
+                return;
+
+            timer->second->cancel();
+            m_tunnelTimers.erase(timer);
+            m_replyTunnels.erase(tunnelId);
+
+            auto itr = m_tunnels.find(tunnelId);
+            if(itr != m_tunnels.end()) {
+                m_tester.forget(itr->second);
+                m_tunnels.erase(itr);
+            }
+
+            m_ids.release(tunnelId);
+        }
+
         void Manager::callback(const boost::system::error_code &e)
         {
             createTunnel();
+            reportUsage();
 
             m_timer.expires_at(m_timer.expires_at() + boost::posix_time::time_duration(0, 0, 5));
             m_timer.async_wait(boost::bind(&Manager::callback, this, boost::asio::placeholders::error));
@@ -247,16 +496,120 @@ namespace i2pcpp {
         void Manager::createTunnel()
         {
             I2P_LOG(m_log, debug) << "creating tunnel";
-            std::vector<RouterIdentity> hops = { m_ctx.getProfileManager().getPeer().getIdentity() };
+            // Building through a peer we already have a session with saves a connection
+            std::vector<RouterIdentity> hops = { m_ctx.getProfileManager().getPeer(ProfileManager::Tier::FAST, true).getIdentity() };
 
-            auto z = std::make_shared<InboundTunnel>(m_ctx.getIdentity()->getHash());
-            auto t = std::make_shared<OutboundTunnel>(hops, m_ctx.getIdentity()->getHash(), z->getTunnelId());
+            auto z = std::make_shared<InboundTunnel>(m_ctx.getIdentity()->getHash(), m_ids.allocate());
+            auto t = std::make_shared<OutboundTunnel>(hops, m_ids.allocate(), m_ctx.getIdentity()->getHash(), z->getTunnelId(), &m_elGamalPool);
             //auto t = std::make_shared<InboundTunnel>(m_ctx.getIdentity().getHash(), hops);
-            m_tunnels[t->getTunnelId()] = z;
-            m_pending[t->getNextMsgId()] = t;
+
+            {
+                std::lock_guard<std::mutex> lock(m_tunnelsMutex);
+                m_tunnels[z->getTunnelId()] = z;
+                m_replyTunnels[t->getTunnelId()] = z->getTunnelId();
+
+                expireTunnel(z->getTunnelId());
+                expireTunnel(t->getTunnelId());
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_pendingMutex);
+                m_pending[t->getNextMsgId()] = t;
+            }
 
             I2NP::MessagePtr vtb(new I2NP::VariableTunnelBuild(t->getRecords()));
             m_ctx.getOutMsgDisp().sendMessage(t->getDownstream(), vtb);
         }
+
+        void Manager::reportUsage()
+        {
+            std::string usage = "[";
+            for(auto& u: m_bandwidth.getHeaviest(m_usageReportSize)) {
+                if(usage.size() > 1)
+                    usage += ",";
+
+                usage += "[" + std::to_string(u.tunnelId) + "," + std::to_string(u.bytes) + "," + std::to_string(u.messages) + "," + std::to_string(u.dropped) + "]";
+            }
+            usage += "]";
+
+            I2P_LOG(m_log, debug) << boost::log::add_value("tunnel_usage", usage);
+        }
+
+        void Manager::testCallback(const boost::system::error_code &e)
+        {
+            if(e == boost::asio::error::operation_aborted)
+                return;
+
+            m_tester.expire();
+            cullTunnels();
+            testTunnels();
+
+            m_testTimer.expires_at(m_testTimer.expires_at() + boost::posix_time::seconds(m_testInterval));
+            m_testTimer.async_wait(boost::bind(&Manager::testCallback, this, boost::asio::placeholders::error));
+        }
+
+        void Manager::testTunnels()
+        {
+            std::vector<std::shared_ptr<OutboundTunnel>> outbound;
+            std::vector<std::shared_ptr<InboundTunnel>> inbound;
+
+            {
+                std::lock_guard<std::mutex> lock(m_tunnelsMutex);
+
+                for(auto& t: m_tunnels) {
+                    if(t.second->getState() != Tunnel::State::OPERATIONAL)
+                        continue;
+
+                    if(t.second->getDirection() == Tunnel::Direction::OUTBOUND)
+                        outbound.push_back(std::static_pointer_cast<OutboundTunnel>(t.second));
+                    else
+                        inbound.push_back(std::static_pointer_cast<InboundTunnel>(t.second));
+                }
+            }
+
+            if(outbound.empty() || inbound.empty())
+                return;
+
+            Botan::AutoSeeded_RNG rng;
+            auto pick = [&rng](std::size_t n) {
+                uint32_t r;
+                rng.randomize((unsigned char *)&r, sizeof(r));
+                return r % n;
+            };
+
+            std::vector<std::pair<std::shared_ptr<OutboundTunnel>, std::shared_ptr<InboundTunnel>>> tests;
+            for(auto& obt: outbound)
+                tests.push_back(std::make_pair(obt, inbound[pick(inbound.size())]));
+            for(auto& ibt: inbound)
+                if(!ibt->getPeers().empty())
+                    tests.push_back(std::make_pair(outbound[pick(outbound.size())], ibt));
+
+            I2P_LOG(m_log, debug) << "testing " << outbound.size() << " outbound and " << inbound.size() << " inbound tunnels";
+
+            for(auto& test: tests) {
+                uint32_t testId = m_tester.begin(test.first, test.second);
+
+                I2NP::DeliveryStatus ds(testId, Date());
+                for(auto& td: test.first->prepareMessages(ds.toBytes(), test.second->getGatewayHash(), test.second->getGatewayTunnelId()))
+                    m_ctx.getOutMsgDisp().sendMessage(test.first->getDownstream(), td);
+            }
+        }
+
+        void Manager::cullTunnels()
+        {
+            std::vector<TunnelPtr> culled = m_tester.takeCulled();
+            if(culled.empty())
+                return;
+
+            std::lock_guard<std::mutex> lock(m_tunnelsMutex);
+
+            for(auto& t: culled) {
+                auto itr = m_tunnels.find(t->getTunnelId());
+                if(itr != m_tunnels.end() && itr->second == t) {
+                    I2P_LOG(m_log, debug) << "tunnel " << t->getTunnelId() << " failed testing, removing";
+                    removeTunnel(t->getTunnelId());
+                }
+            }
+        }
     }
 }
@@ -3,6 +3,15 @@
 
 #include "Tunnel.h"
 #include "FragmentHandler.h"
+#include "BuildRequestPool.h"
+#include "BuildReplyProcessor.h"
+#include "ElGamalPool.h"
+#include "AdmissionController.h"
+#include "GatewayBatcher.h"
+#include "Tester.h"
+#include "ReplayFilter.h"
+#include "BandwidthLimiter.h"
+#include "IdAllocator.h"
 
 #include <i2pcpp/Log.h>
 
@@ -14,10 +23,13 @@
 
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
 namespace i2pcpp {
     class RouterContext;
 
+    namespace I2NP { class TunnelData; }
+
     namespace Tunnel {
         class Manager {
             public:
@@ -28,43 +40,154 @@ namespace i2pcpp {
                 void begin();
 
                 /**
-                 * Collects build records that are received. Automatically forwards
-                 * the records to the next hop, if necessary. If the records are a
-                 * result of a tunnel we created, the tunnel's status is set
-                 * accordingly.
+                 * Collects build records that are received from \a from. Automatically
+                 * forwards the records to the next hop, if necessary. If the records
+                 * are a result of a tunnel we created, they are handed to the
+                 * i2pcpp::Tunnel::BuildReplyProcessor.
                  */
-                void receiveRecords(uint32_t const msgId, std::list<BuildRecordPtr> records);
+                void receiveRecords(RouterHash const from, uint32_t const msgId, std::list<BuildRecordPtr> records);
 
                 /**
-                 * Checks to see if \a tunnelId is a valid, established tunnel. If so,
-                 * \a data is fragmented in to on first fragment and zero or more
-                 * follow on fragments. All the fragments are then sent one by one to
-                 * the next hop in the tunnel.
+                 * Checks to see if \a tunnelId is a valid, established tunnel
+                 * within its rate limit. If so, \a data is fragmented in to on
+                 * first fragment and zero or more follow on fragments. The
+                 * fragments are packed in to tunnel messages by the tunnel's
+                 * i2pcpp::Tunnel::GatewayBatcher and sent to the next hop in the
+                 * tunnel. Data for one of our zero hop inbound tunnels is parsed
+                 * and handed to the local handlers.
                  */
                 void receiveGatewayData(RouterHash const from, uint32_t const tunnelId, ByteArray const data);
 
                 /**
-                 * Checks to see if the \a tunnelId is valid. If we are a participatory
-                 * tunnel, the \a data is merely forwarded to the next hop. If we are
-                 * an endpoint, the \a data is sent to the i2pcpp::Tunnel::FragmentHandler
-                 * for further processing.
+                 * Checks to see if the tunnel ID of \a td is valid, and drops \a td
+                 * if the i2pcpp::Tunnel::ReplayFilter has seen it before. Only
+                 * then is it charged to the rate limit of the tunnel, and
+                 * dropped if the tunnel is over it. If we are a participatory
+                 * tunnel, the data is encrypted in place and \a td itself is
+                 * forwarded to the next hop. If we are an endpoint, of someone
+                 * else's outbound tunnel or of one of our inbound tunnels, the
+                 * data is sent to the i2pcpp::Tunnel::FragmentHandler for further
+                 * processing.
+                 */
+                void receiveData(RouterHash const from, std::shared_ptr<I2NP::TunnelData> const td);
+
+                /**
+                 * Completes the tunnel test identified by \a msgId, if there is
+                 * one, and takes tunnels which are now too slow out of service.
+                 */
+                void receiveDeliveryStatus(RouterHash const from, uint32_t const msgId);
+
+                /**
+                 * @return true if \a msgId identifies a tunnel test in progress
                  */
-                void receiveData(RouterHash const from, uint32_t const tunnelId, StaticByteArray<1024> const data);
+                bool isTunnelTest(uint32_t const msgId) const;
 
             private:
                 /**
-                 * Deletes the \a tunnelId.
+                 * State of a tunnel we participate in, kept in m_participants
+                 * at the slot the i2pcpp::Tunnel::IdAllocator gave its ID.
+                 */
+                struct Participant {
+                    uint32_t tunnelId = 0; ///< Zero if the slot is not used by a participating tunnel
+                    BuildRequestRecordPtr hop;
+                    std::unique_ptr<boost::asio::deadline_timer> timer;
+                    std::shared_ptr<GatewayBatcher> batcher;
+                };
+
+                /**
+                 * @return true if \a slot holds the participating tunnel
+                 * \a tunnelId. Must be called with m_participatingMutex held.
+                 */
+                bool isParticipant(uint32_t slot, uint32_t tunnelId) const;
+
+                /**
+                 * Handles \a td if it arrived at the endpoint of one of our
+                 * inbound tunnels: the layers added by the hops are removed and
+                 * the fragments are passed to the i2pcpp::Tunnel::FragmentHandler,
+                 * which hands messages for us to the local handlers.
+                 */
+                void receiveEndpointData(RouterHash const &from, std::shared_ptr<I2NP::TunnelData> const &td);
+
+                /**
+                 * Called by the i2pcpp::Tunnel::BuildRequestPool once our record in
+                 * \a records (at position \a index) has been decrypted. Accepts or
+                 * rejects participation according to the i2pcpp::Tunnel::AdmissionController
+                 * and forwards the records to the next hop.
+                 */
+                void processRequest(RouterHash const from, std::list<BuildRecordPtr> records, std::size_t index, BuildRequestRecordPtr req, bool overloaded);
+
+                /**
+                 * Called by the i2pcpp::Tunnel::BuildReplyProcessor once the
+                 * replies for \a t have been processed. Sets the state of the
+                 * tunnel and records the response of each hop in its profile.
+                 */
+                void processReply(TunnelPtr t, bool success, std::vector<BuildReplyProcessor::HopReply> replies);
+
+                /**
+                 * Replaces our record in \a records with a response containing
+                 * \a reply, encrypts all the records with the reply key and
+                 * sends them to the next hop given by \a req.
+                 */
+                void sendReply(std::list<BuildRecordPtr> records, std::size_t index, BuildRequestRecordPtr req, BuildResponseRecord::Reply reply);
+
+                /**
+                 * Deletes the \a tunnelId and releases the ID. Our own
+                 * tunnels are also removed if they are still being built.
                  */
                 void timerCallback(const boost::system::error_code &e, bool participating, uint32_t tunnelId);
+
+                /**
+                 * Arms the timer which expires our own tunnel \a tunnelId.
+                 * Must be called with m_tunnelsMutex held.
+                 */
+                void expireTunnel(uint32_t tunnelId);
+
+                /**
+                 * Forgets our own tunnel \a tunnelId, cancels its expiry and
+                 * releases its ID, unless that has been done already. Must be
+                 * called with m_tunnelsMutex held.
+                 */
+                void removeTunnel(uint32_t tunnelId);
                 void callback(const boost::system::error_code &e);
                 void createTunnel();
 
+                /**
+                 * Logs the usage of the heaviest participating tunnels, for
+                 * frontends to pick up.
+                 */
+                void reportUsage();
+
+                /**
+                 * Fails tunnel tests that timed out, takes failing tunnels out
+                 * of service and starts a new round of tests.
+                 */
+                void testCallback(const boost::system::error_code &e);
+
+                /**
+                 * Sends a test message through every operational outbound
+                 * tunnel and back through a random inbound tunnel, and through
+                 * every operational inbound tunnel with at least one hop from a
+                 * random outbound tunnel.
+                 */
+                void testTunnels();
+
+                /**
+                 * Removes the tunnels culled by the i2pcpp::Tunnel::Tester.
+                 */
+                void cullTunnels();
+
                 boost::asio::io_service &m_ios;
                 RouterContext &m_ctx;
 
+                IdAllocator m_ids;
+
                 std::unordered_map<uint32_t, TunnelPtr> m_pending;
                 std::unordered_map<uint32_t, TunnelPtr> m_tunnels;
-                std::unordered_map<uint32_t, std::pair<BuildRequestRecordPtr, std::unique_ptr<boost::asio::deadline_timer>>> m_participating;
+                std::unordered_map<uint32_t, std::unique_ptr<boost::asio::deadline_timer>> m_tunnelTimers; ///< One for each ID we allocated
+                std::unordered_map<uint32_t, uint32_t> m_replyTunnels; ///< The inbound tunnel each outbound tunnel is built through
+                std::vector<Participant> m_participants; ///< Indexed by slot
+                std::size_t m_numParticipating = 0;
+                uint32_t m_gatewayBatchDelay;
 
                 mutable std::mutex m_pendingMutex;
                 mutable std::mutex m_tunnelsMutex;
@@ -72,9 +195,26 @@ namespace i2pcpp {
 
                 FragmentHandler m_fragmentHandler;
 
+                ReplayFilter m_replayFilter;
+
+                BandwidthLimiter m_bandwidth;
+                std::size_t m_usageReportSize;
+
+                ElGamalPool m_elGamalPool;
+
+                AdmissionController m_admission;
+
+                Tester m_tester;
+
                 boost::asio::deadline_timer m_timer;
+                boost::asio::deadline_timer m_testTimer;
+                uint32_t m_testInterval;
 
                 i2p_logger_mt m_log;
+
+                /// Declared last so that the workers are stopped first
+                BuildRequestPool m_buildRequestPool;
+                BuildReplyProcessor m_buildReplyProcessor;
         };
     }
 }
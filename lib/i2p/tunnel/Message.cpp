@@ -1,36 +1,49 @@
 #include "Message.h"
 
 #include <i2pcpp/util/make_unique.h>
+#include <i2pcpp/util/BufferedRNG.h>
+#include <i2pcpp/util/xor_buf.h>
 
-#include <botan/pipe.h>
 #include <botan/lookup.h>
-#include <botan/auto_rng.h>
+#include <botan/hash.h>
+#include <botan/block_cipher.h>
 
 #include <stdexcept>
 #include <cmath>
 
 namespace i2pcpp {
     namespace Tunnel {
-        Message::Message(StaticByteArray<1024> const &data)
+        Message::Message(unsigned char *data) :
+            m_iv(data),
+            m_encrypted(data + 16) {}
+
+        /**
+         * Shared by all messages, so that padding doesn't need a new RNG each
+         * time. Constructed on first use, after Botan has been initialized.
+         */
+        static BufferedRNG& rng()
         {
-            auto pos = data.cbegin();
-
-            std::copy(pos, pos + 16, m_iv.begin()), pos += 16;
-            std::copy(pos, pos + 1008, m_encrypted.begin());
+            static BufferedRNG r;
+            return r;
         }
 
-        Message::Message(std::list<FragmentPtr> &fragments) :
-            m_fragments(std::move(fragments))
+        Message::Message(std::list<FragmentPtr> const &fragments) :
+            m_iv(m_storage.data()),
+            m_encrypted(m_storage.data() + 16)
         {
-            Botan::AutoSeeded_RNG rng;
-            rng.randomize(m_iv.data(), m_iv.size());
+            rng().randomize(m_iv, 16);
 
-            for(auto& f: m_fragments)
+            for(auto& f: fragments)
                 m_payloadSize += f->size();
 
             if(m_payloadSize > 1003)
                 throw std::runtime_error("total size of all fragments is too large for a tunnel message");
 
+            // The fragments go at the very end of the message, after the padding
+            unsigned char *pos = m_encrypted + (1008 - m_payloadSize);
+            for(auto& f: fragments)
+                pos = f->write(pos);
+
             calculateChecksum();
         }
 
@@ -39,7 +52,7 @@ namespace i2pcpp {
             if(!verifyChecksum())
                 throw std::runtime_error("invalid checksum in tunnel message");
 
-            ByteArray data = toByteArray(m_encrypted);
+            ByteArray data(m_encrypted, m_encrypted + 1008);
             auto pos = data.cbegin() + 4;
             auto end = data.cend();
 
@@ -56,48 +69,63 @@ namespace i2pcpp {
         StaticByteArray<1024> Message::getEncryptedData() const
         {
             StaticByteArray<1024> payload;
-            std::copy(m_iv.cbegin(), m_iv.cend(), payload.begin());
-            std::copy(m_encrypted.cbegin(), m_encrypted.cend(), payload.begin() + 16);
+            std::copy(m_iv, m_iv + 16, payload.begin());
+            std::copy(m_encrypted, m_encrypted + 1008, payload.begin() + 16);
 
             return payload;
         }
 
         void Message::encrypt(Botan::SymmetricKey const &ivKey, Botan::SymmetricKey const &layerKey)
         {
-            // Using the IV key from the BRR, encrypt the IV contained in the tunnel message.
-            Botan::Pipe ivCipherPipe(get_cipher("AES-256/ECB/NoPadding", ivKey, Botan::ENCRYPTION));
-
-            ivCipherPipe.process_msg(m_iv.data(), m_iv.size());
-
-            if(ivCipherPipe.remaining() != m_iv.size())
-                throw std::runtime_error("Did not get 16 bytes back");
+            std::unique_ptr<Botan::BlockCipher> ivCipher(Botan::get_block_cipher("AES-256"));
+            ivCipher->set_key(ivKey);
 
-            Botan::secure_vector<Botan::byte> v(16);
-            ivCipherPipe.read(v.data(), v.size());
+            std::unique_ptr<Botan::BlockCipher> layerCipher(Botan::get_block_cipher("AES-256"));
+            layerCipher->set_key(layerKey);
 
-            Botan::InitializationVector iv(v);
+            // Using the IV key from the BRR, encrypt the IV contained in the tunnel message.
+            ivCipher->encrypt(m_iv);
 
             /* We now have an encrypted IV that is used in conjunction with the layer key
-             * to encrypt the actual content of the message.
+             * to encrypt the actual content of the message. CBC is done by hand so that
+             * the data never leaves the buffer.
              */
-            Botan::Pipe dataCipherPipe(get_cipher("AES-256/CBC/NoPadding", layerKey, iv, Botan::ENCRYPTION));
+            const unsigned char *prev = m_iv;
+            for(unsigned char *block = m_encrypted; block != m_encrypted + 1008; block += 16) {
+                Botan::xor_buf(block, prev, 16);
+                layerCipher->encrypt(block);
+                prev = block;
+            }
+
+            // Now encrypt our current IV with the IV key again and overwrite the current IV.
+            ivCipher->encrypt(m_iv);
+        }
 
-            dataCipherPipe.process_msg(m_encrypted.data(), m_encrypted.size());
+        void Message::decrypt(Botan::SymmetricKey const &ivKey, Botan::SymmetricKey const &layerKey)
+        {
+            std::unique_ptr<Botan::BlockCipher> ivCipher(Botan::get_block_cipher("AES-256"));
+            ivCipher->set_key(ivKey);
 
-            if(dataCipherPipe.remaining() != m_encrypted.size())
-                throw std::runtime_error("Did not get 1008 bytes back");
+            std::unique_ptr<Botan::BlockCipher> layerCipher(Botan::get_block_cipher("AES-256"));
+            layerCipher->set_key(layerKey);
 
-            dataCipherPipe.read(m_encrypted.data(), m_encrypted.size());
+            ivCipher->decrypt(m_iv);
 
-            // Now encrypt our current IV with the IV key again and overwrite the current IV.
-            Botan::Pipe ivCipherPipe2(get_cipher("AES-256/ECB/NoPadding", ivKey, Botan::ENCRYPTION));
+            /* Walk backwards, so that the previous ciphertext block is still
+             * intact when each block is decrypted.
+             */
+            for(unsigned char *block = m_encrypted + 1008 - 16; ; block -= 16) {
+                layerCipher->decrypt(block);
 
-            ivCipherPipe2.process_msg(v);
+                if(block == m_encrypted) {
+                    Botan::xor_buf(block, m_iv, 16);
+                    break;
+                }
 
-            if(ivCipherPipe2.remaining() != m_iv.size())
-                throw std::runtime_error("Did not get 16 bytes back");
+                Botan::xor_buf(block, block - 16, 16);
+            }
 
-            ivCipherPipe2.read(m_iv.data(), m_iv.size());
+            ivCipher->decrypt(m_iv);
         }
 
         void Message::compile()
@@ -107,45 +135,28 @@ namespace i2pcpp {
             m_encrypted[2] = m_checksum >> 8;
             m_encrypted[3] = m_checksum;
 
-            // Pad the message
-            Botan::AutoSeeded_RNG rng;
-            auto padStart = m_encrypted.begin() + 4;
-            auto padEnd = padStart + (1008 - 4 - 1 - m_payloadSize);
-            rng.randomize((StaticByteArray<1008>::value_type *)padStart, padEnd - padStart);
-            std::replace_if(padStart, padEnd, [](const ByteArray::value_type &x) { return x == 0x00; }, 0xff);
-            *padEnd = 0x00; // last byte must be zero
-            auto pos = padEnd + 1;
-
-            // Copy the fragments
-            for(auto& f: m_fragments) {
-                ByteArray compiledFragment = f->compile();
-                std::copy(compiledFragment.cbegin(), compiledFragment.cend(), pos);
-                pos += compiledFragment.size();
-            }
+            // Pad the message, the fragments are already in place
+            const size_t padSize = 1008 - 4 - 1 - m_payloadSize;
+            rng().randomizeNonzero(m_encrypted + 4, padSize);
+            m_encrypted[4 + padSize] = 0x00; // last byte must be zero
         }
 
         void Message::calculateChecksum()
         {
-            Botan::Pipe hashPipe(new Botan::Hash_Filter("SHA-256"));
-            hashPipe.start_msg();
-
-            for(auto& f: m_fragments)
-                hashPipe.write(f->compile());
+            std::unique_ptr<Botan::HashFunction> sha(Botan::get_hash("SHA-256"));
 
-            hashPipe.write(m_iv.data(), m_iv.size());
+            sha->update(m_encrypted + (1008 - m_payloadSize), m_payloadSize);
+            sha->update(m_iv, 16);
 
-            hashPipe.end_msg();
-
-            std::array<unsigned char, 4> checksum;
-            hashPipe.read(checksum.data(), 4);
-            auto begin = checksum.cbegin();
+            Botan::secure_vector<Botan::byte> hash = sha->final();
+            auto begin = hash.cbegin();
             m_checksum = parseUint32(begin);
         }
 
         bool Message::verifyChecksum() const
         {
-            auto pos = m_encrypted.cbegin();
-            auto end = m_encrypted.cend();
+            const unsigned char *pos = m_encrypted;
+            const unsigned char *end = m_encrypted + 1008;
 
             std::array<unsigned char, 4> givenChecksum;
             std::copy(pos, pos + 4, givenChecksum.begin());
@@ -154,18 +165,14 @@ namespace i2pcpp {
             pos = std::find(pos, end, 0x00);
             ++pos; // 0x00 at the end
 
-            Botan::Pipe hashPipe(new Botan::Hash_Filter("SHA-256"));
-            hashPipe.start_msg();
-
-            hashPipe.write(m_encrypted.data() + (pos - m_encrypted.cbegin()), (end - pos));
-            hashPipe.write(m_iv.data(), m_iv.size());
+            std::unique_ptr<Botan::HashFunction> sha(Botan::get_hash("SHA-256"));
 
-            hashPipe.end_msg();
+            sha->update(pos, end - pos);
+            sha->update(m_iv, 16);
 
-            std::array<unsigned char, 4> calculatedChecksum;
-            hashPipe.read(calculatedChecksum.data(), 4);
+            Botan::secure_vector<Botan::byte> calculatedChecksum = sha->final();
 
-            return calculatedChecksum == givenChecksum;
+            return std::equal(givenChecksum.cbegin(), givenChecksum.cend(), calculatedChecksum.cbegin());
         }
     }
 }
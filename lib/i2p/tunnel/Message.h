@@ -18,15 +18,20 @@ namespace i2pcpp {
         class Message {
             public:
                 /**
-                 * Constructs a Message from 16 bytes of IV and 1008 bytes
-                 * of encrypted data.
+                 * Constructs a Message which works in place on \a data: 16
+                 * bytes of IV followed by 1008 bytes of encrypted data. The
+                 * buffer must outlive the Message.
                  */
-                Message(StaticByteArray<1024> const &data);
+                Message(unsigned char *data);
 
                 /**
                  * Constructs a Message from a list of unencrpyted fragments.
+                 * The fragments are serialized in to the message right away.
                  */
-                Message(std::list<FragmentPtr> &fragments);
+                Message(std::list<FragmentPtr> const &fragments);
+
+                Message(const Message &) = delete;
+                Message& operator=(Message &) = delete;
 
                 /**
                  * After the Message has been decrypted, this method will
@@ -41,10 +46,18 @@ namespace i2pcpp {
                 StaticByteArray<1024> getEncryptedData() const;
 
                 /**
-                 * Encrypts the compiled message.
+                 * Encrypts the compiled message in place. Each hop does
+                 * this to add (or remove) its layer of encryption.
                  */
                 void encrypt(Botan::SymmetricKey const &ivKey, Botan::SymmetricKey const &layerKey);
 
+                /**
+                 * Undoes i2pcpp::Tunnel::Message::encrypt in place. The gateway
+                 * of an outbound tunnel does this for each hop, so that the
+                 * message is in plain text once all hops have encrypted it.
+                 */
+                void decrypt(Botan::SymmetricKey const &ivKey, Botan::SymmetricKey const &layerKey);
+
                 /**
                  * Compiles the fragments together in preparation for
                  * encryption.
@@ -56,11 +69,13 @@ namespace i2pcpp {
                 bool verifyChecksum() const;
 
                 uint32_t m_checksum;
-                std::list<FragmentPtr> m_fragments;
                 uint16_t m_payloadSize = 0;
 
-                StaticByteArray<16> m_iv;
-                StaticByteArray<1008> m_encrypted;
+                /// Only used for messages built from fragments
+                StaticByteArray<1024> m_storage;
+
+                unsigned char *m_iv;
+                unsigned char *m_encrypted;
         };
     }
 }
@@ -1,10 +1,16 @@
 #include "OutboundTunnel.h"
 
+#include "FirstFragment.h"
+#include "Message.h"
+
+#include "../i2np/TunnelData.h"
+
+#include <i2pcpp/util/make_unique.h>
 #include <i2pcpp/datatypes/RouterIdentity.h>
 
 namespace i2pcpp {
     namespace Tunnel {
-        OutboundTunnel::OutboundTunnel(std::vector<RouterIdentity> const &hops, RouterHash const &replyHash, uint32_t const replyTunnelId)
+        OutboundTunnel::OutboundTunnel(std::vector<RouterIdentity> const &hops, uint32_t const tunnelId, RouterHash const &replyHash, uint32_t const replyTunnelId, ElGamalPool *pool)
         {
             uint32_t lastTunnelId;
             RouterHash lastRouterHash;
@@ -16,7 +22,6 @@ namespace i2pcpp {
                     h = std::make_shared<BuildRequestRecord>(hops[i], replyHash);
                     h->setType(BuildRequestRecord::Type::ENDPOINT);
                     h->setNextTunnelId(replyTunnelId);
-                    m_tunnelId = h->getNextTunnelId();
                     m_nextMsgId = h->getNextMsgId();
                 } else
                     h = std::make_shared<BuildRequestRecord>(hops[i], lastRouterHash, lastTunnelId);
@@ -27,12 +32,55 @@ namespace i2pcpp {
                 m_hops.push_front(h);
             }
 
-            secureRecords();
+            // We send in to the tunnel at the first hop; the endpoint's next tunnel ID belongs to the reply tunnel
+            m_tunnelId = tunnelId;
+            std::static_pointer_cast<BuildRequestRecord>(m_hops.front())->setTunnelId(tunnelId);
+
+            secureRecords(pool);
         }
 
         Tunnel::Direction OutboundTunnel::getDirection() const
         {
             return Direction::OUTBOUND;
         }
+
+        std::vector<I2NP::MessagePtr> OutboundTunnel::prepareMessages(ByteArray const &data, RouterHash const &toHash, uint32_t tunnelId) const
+        {
+            constexpr uint16_t maxPayload = 1003;
+
+            auto first = std::make_unique<FirstFragment>();
+            first->setDeliveryMode(FirstFragment::DeliveryMode::TUNNEL);
+            first->setToHash(toHash);
+            first->setTunnelId(tunnelId);
+
+            std::vector<FragmentPtr> fragments = Fragment::fragmentMessage(data, maxPayload, std::move(first));
+
+            std::vector<I2NP::MessagePtr> messages;
+            auto itr = fragments.begin();
+            while(itr != fragments.end()) {
+                std::list<FragmentPtr> batch;
+                uint16_t used = 0;
+                while(itr != fragments.end() && used + (*itr)->size() <= maxPayload) {
+                    used += (*itr)->size();
+                    batch.push_back(std::move(*itr++));
+                }
+
+                Message msg(batch);
+                msg.compile();
+
+                // The endpoint encrypts last, so its layer is removed first
+                for(auto h = m_hops.crbegin(); h != m_hops.crend(); ++h) {
+                    BuildRequestRecordPtr r = std::static_pointer_cast<BuildRequestRecord>(*h);
+
+                    SessionKey k1 = r->getTunnelIVKey();
+                    SessionKey k2 = r->getTunnelLayerKey();
+                    msg.decrypt(Botan::SymmetricKey(k1.data(), k1.size()), Botan::SymmetricKey(k2.data(), k2.size()));
+                }
+
+                messages.push_back(std::make_shared<I2NP::TunnelData>(m_tunnelId, msg.getEncryptedData()));
+            }
+
+            return messages;
+        }
     }
 }
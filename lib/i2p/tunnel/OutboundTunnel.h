@@ -3,6 +3,8 @@
 
 #include "Tunnel.h"
 
+#include "../i2np/Message.h"
+
 #include <vector>
 
 namespace i2pcpp {
@@ -11,13 +13,25 @@ namespace i2pcpp {
             public:
                 /**
                  * Constructs an outbound tunnel given a vector of RouterIdentities \a hops, a \a replyHash, and a \a replyTunnelId.
+                 * Messages are sent in to the tunnel at the first hop with \a tunnelId.
+                 * The build records are encrypted with ephemeral pairs from \a pool, if given.
                  */
-                OutboundTunnel(std::vector<RouterIdentity> const &hops, RouterHash const &replyHash, uint32_t const replyTunnelId);
+                OutboundTunnel(std::vector<RouterIdentity> const &hops, uint32_t const tunnelId, RouterHash const &replyHash, uint32_t const replyTunnelId, ElGamalPool *pool = nullptr);
 
                 /**
                  * Returns the direction of this tunnel (always outbound).
                  */
                 Tunnel::Direction getDirection() const;
+
+                /**
+                 * Builds the tunnel messages which carry \a data through this
+                 * tunnel. The endpoint hands it to tunnel \a tunnelId at
+                 * \a toHash. The layers of encryption the hops will add are
+                 * removed in advance.
+                 * @return i2pcpp::I2NP::TunnelData messages to be sent to
+                 * i2pcpp::Tunnel::Tunnel::getDownstream
+                 */
+                std::vector<I2NP::MessagePtr> prepareMessages(ByteArray const &data, RouterHash const &toHash, uint32_t tunnelId) const;
         };
     }
 }
@@ -0,0 +1,131 @@
+#include "ReplayFilter.h"
+
+#include <botan/auto_rng.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace i2pcpp {
+    namespace Tunnel {
+        /**
+         * The 64-bit finalizer of SplitMix64.
+         */
+        static inline uint64_t mix(uint64_t x)
+        {
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return x ^ (x >> 31);
+        }
+
+        static inline uint64_t load64(const unsigned char *p)
+        {
+            uint64_t x = 0;
+            for(int i = 0; i < 8; ++i)
+                x = (x << 8) | p[i];
+
+            return x;
+        }
+
+        ReplayFilter::ReplayFilter(boost::asio::io_service &ios, std::chrono::seconds window, std::size_t expected, double falsePositiveRate) :
+            m_timer(ios),
+            m_rotateInterval(boost::posix_time::seconds(window.count() / 2)),
+            m_log(boost::log::keywords::channel = "RF")
+        {
+            if(!expected || falsePositiveRate <= 0 || falsePositiveRate >= 1)
+                throw std::runtime_error("invalid replay filter parameters");
+
+            /* Lookups check both generations, so each one gets half of the
+             * false positive budget.
+             */
+            const double p = falsePositiveRate / 2;
+            const double ln2 = std::log(2.0);
+
+            m_bits = (std::size_t)std::ceil(-(double)expected * std::log(p) / (ln2 * ln2));
+            m_bits = (m_bits + 63) & ~(std::size_t)63;
+            m_hashes = std::max(1u, (unsigned int)std::round((double)m_bits / expected * ln2));
+
+            m_current.resize(m_bits / 64);
+            m_previous.resize(m_bits / 64);
+
+            Botan::AutoSeeded_RNG rng;
+            rng.randomize((unsigned char *)m_salt.data(), m_salt.size() * sizeof(uint64_t));
+
+            I2P_LOG(m_log, debug) << "replay filter: " << 2 * m_bits / 8 << " bytes, " << m_hashes << " hashes";
+
+            m_timer.expires_from_now(m_rotateInterval);
+            m_timer.async_wait(boost::bind(&ReplayFilter::timerCallback, this, boost::asio::placeholders::error));
+        }
+
+        bool ReplayFilter::isReplay(const unsigned char *data)
+        {
+            /* The key is the IV XORed with the first block of encrypted data.
+             * Bit positions are derived from it by double hashing.
+             */
+            const uint64_t hi = load64(data) ^ load64(data + 16);
+            const uint64_t lo = load64(data + 8) ^ load64(data + 24);
+
+            const uint64_t h1 = mix(hi ^ m_salt[0]) ^ lo;
+            const uint64_t h2 = mix(mix(lo ^ m_salt[1]) ^ hi) | 1;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            ++m_checked;
+
+            bool inCurrent = true, inPrevious = true;
+            uint64_t h = h1;
+            for(unsigned int i = 0; i < m_hashes; ++i, h += h2) {
+                const std::size_t bit = h % m_bits;
+                const uint64_t mask = 1ULL << (bit % 64);
+
+                inPrevious = inPrevious && (m_previous[bit / 64] & mask);
+                if(!(m_current[bit / 64] & mask)) {
+                    inCurrent = false;
+                    m_current[bit / 64] |= mask;
+                }
+            }
+
+            if(inCurrent || inPrevious) {
+                ++m_duplicates;
+                return true;
+            }
+
+            ++m_currentEntries;
+
+            return false;
+        }
+
+        uint64_t ReplayFilter::getChecked() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_checked;
+        }
+
+        uint64_t ReplayFilter::getDuplicates() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_duplicates;
+        }
+
+        void ReplayFilter::rotate()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            I2P_LOG(m_log, debug) << "rotating replay filter: " << m_currentEntries << " new messages, " << m_checked << " checked, " << m_duplicates << " duplicates dropped";
+
+            m_previous.swap(m_current);
+            std::fill(m_current.begin(), m_current.end(), 0);
+            m_currentEntries = 0;
+        }
+
+        void ReplayFilter::timerCallback(const boost::system::error_code &e)
+        {
+            if(e == boost::asio::error::operation_aborted)
+                return;
+
+            rotate();
+
+            m_timer.expires_at(m_timer.expires_at() + m_rotateInterval);
+            m_timer.async_wait(boost::bind(&ReplayFilter::timerCallback, this, boost::asio::placeholders::error));
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef TUNNELREPLAYFILTER_H
+#define TUNNELREPLAYFILTER_H
+
+#include <i2pcpp/Log.h>
+
+#include <boost/asio.hpp>
+
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace i2pcpp {
+    namespace Tunnel {
+        /**
+         * Detects tunnel messages which we have already seen, so that replays
+         * can be dropped before any decryption is done. The key of a message
+         * is its IV XORed with the first block of encrypted data.
+         *
+         * Keys are stored in a decaying Bloom filter made of two generations.
+         * New keys go in the current generation, lookups check both. Every
+         * half window the previous generation is discarded and the current
+         * one takes its place, so a key is remembered for between one half
+         * and one full window.
+         */
+        class ReplayFilter {
+            public:
+                /**
+                 * @param window the time for which messages are remembered
+                 * @param expected the peak number of messages expected per window
+                 * @param falsePositiveRate the acceptable probability of
+                 *  dropping a message that was not a replay
+                 */
+                ReplayFilter(boost::asio::io_service &ios, std::chrono::seconds window, std::size_t expected, double falsePositiveRate);
+                ReplayFilter(const ReplayFilter &) = delete;
+                ReplayFilter& operator=(ReplayFilter &) = delete;
+
+                /**
+                 * Checks whether the tunnel message in \a data (IV followed by
+                 * encrypted data) has been seen before, and remembers it.
+                 * @return true if the message is a replay and should be dropped
+                 */
+                bool isReplay(const unsigned char *data);
+
+                /**
+                 * @return the number of messages which were checked
+                 */
+                uint64_t getChecked() const;
+
+                /**
+                 * @return the number of messages which were found to be replays
+                 */
+                uint64_t getDuplicates() const;
+
+                /**
+                 * Discards the previous generation and starts a new one.
+                 * Called by the timer every half window.
+                 */
+                void rotate();
+
+            private:
+                typedef std::vector<uint64_t> Generation;
+
+                /**
+                 * Rotates the generations and rearms the timer.
+                 */
+                void timerCallback(const boost::system::error_code &e);
+
+                std::size_t m_bits;
+                unsigned int m_hashes;
+
+                /// Random values mixed in to the key so that others can't
+                /// craft messages which collide in the filter
+                std::array<uint64_t, 2> m_salt;
+
+                Generation m_current;
+                Generation m_previous;
+                std::size_t m_currentEntries = 0;
+
+                uint64_t m_checked = 0;
+                uint64_t m_duplicates = 0;
+
+                mutable std::mutex m_mutex;
+
+                boost::asio::deadline_timer m_timer;
+                boost::posix_time::time_duration m_rotateInterval;
+
+                i2p_logger_mt m_log;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,184 @@
+#include "Tester.h"
+
+#include "../RouterContext.h"
+
+#include <i2pcpp/datatypes/RouterIdentity.h>
+
+#include <botan/auto_rng.h>
+
+#include <algorithm>
+
+namespace i2pcpp {
+    namespace Tunnel {
+        Tester::Tester(RouterContext &ctx, std::chrono::milliseconds timeout, std::chrono::milliseconds maxLatency, uint32_t maxFailures) :
+            m_ctx(ctx),
+            m_timeout(timeout),
+            m_maxLatency(maxLatency),
+            m_maxFailures(maxFailures),
+            m_log(boost::log::keywords::channel = "TT") {}
+
+        uint32_t Tester::begin(std::shared_ptr<OutboundTunnel> const &outbound, std::shared_ptr<InboundTunnel> const &inbound)
+        {
+            Botan::AutoSeeded_RNG rng;
+            uint32_t msgId;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            do {
+                rng.randomize((unsigned char *)&msgId, sizeof(msgId));
+            } while(m_tests.count(msgId));
+
+            m_tests[msgId] = { outbound, inbound, clock::now() };
+
+            return msgId;
+        }
+
+        bool Tester::complete(uint32_t msgId)
+        {
+            std::vector<RouterHash> peers;
+            std::chrono::milliseconds rtt;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                auto itr = m_tests.find(msgId);
+                if(itr == m_tests.end())
+                    return false;
+
+                Test test = std::move(itr->second);
+                m_tests.erase(itr);
+
+                rtt = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - test.sent);
+
+                I2P_LOG(m_log, debug) << "tunnel test " << msgId << " through tunnels " << test.outbound->getTunnelId() << " and " << test.inbound->getTunnelId() << " succeeded in " << rtt.count() << "ms";
+
+                record(test.outbound, true, rtt);
+                record(test.inbound, true, rtt);
+
+                auto& pairLatency = m_hopPairs[hopPair(test)];
+                pairLatency = (pairLatency.count() ? (pairLatency * 3 + rtt) / 4 : rtt);
+
+                peers = test.outbound->getPeers();
+                std::vector<RouterHash> inboundPeers = test.inbound->getPeers();
+                peers.insert(peers.end(), inboundPeers.cbegin(), inboundPeers.cend());
+            }
+
+            m_ctx.getProfileManager().tunnelTestSucceeded(peers, rtt);
+
+            return true;
+        }
+
+        bool Tester::isPending(uint32_t msgId) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            return m_tests.count(msgId);
+        }
+
+        void Tester::expire()
+        {
+            std::vector<RouterHash> peers;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                const clock::time_point cutoff = clock::now() - m_timeout;
+                for(auto itr = m_tests.begin(); itr != m_tests.end(); ) {
+                    Test &test = itr->second;
+                    if(test.sent > cutoff) {
+                        ++itr;
+                        continue;
+                    }
+
+                    I2P_LOG(m_log, debug) << "tunnel test " << itr->first << " through tunnels " << test.outbound->getTunnelId() << " and " << test.inbound->getTunnelId() << " timed out";
+
+                    record(test.outbound, false, m_timeout);
+                    record(test.inbound, false, m_timeout);
+
+                    std::vector<RouterHash> testPeers = test.outbound->getPeers();
+                    peers.insert(peers.end(), testPeers.cbegin(), testPeers.cend());
+                    testPeers = test.inbound->getPeers();
+                    peers.insert(peers.end(), testPeers.cbegin(), testPeers.cend());
+
+                    itr = m_tests.erase(itr);
+                }
+            }
+
+            if(peers.size())
+                m_ctx.getProfileManager().tunnelTestFailed(peers);
+        }
+
+        std::vector<TunnelPtr> Tester::takeCulled()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            std::vector<TunnelPtr> culled;
+            culled.swap(m_culled);
+
+            for(auto& t: culled)
+                m_tunnels.erase(t);
+
+            return culled;
+        }
+
+        void Tester::forget(TunnelPtr const &t)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            m_tunnels.erase(t);
+        }
+
+        std::chrono::milliseconds Tester::getLatency(TunnelPtr const &t) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            auto itr = m_tunnels.find(t);
+            if(itr == m_tunnels.end())
+                return std::chrono::milliseconds(0);
+
+            return itr->second.latency;
+        }
+
+        std::chrono::milliseconds Tester::getLatency(RouterHash const &obep, RouterHash const &ibgw) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            auto itr = m_hopPairs.find(std::make_pair(obep, ibgw));
+            if(itr == m_hopPairs.end())
+                return std::chrono::milliseconds(0);
+
+            return itr->second;
+        }
+
+        void Tester::record(TunnelPtr const &t, bool success, std::chrono::milliseconds rtt)
+        {
+            // Zero hop tunnels can't fail, and are never culled
+            if(t->getPeers().empty())
+                return;
+
+            Stats &s = m_tunnels[t];
+
+            if(success) {
+                s.failures = 0;
+                s.latency = (s.latency.count() ? (s.latency * 3 + rtt) / 4 : rtt);
+            } else
+                ++s.failures;
+
+            if(s.failures >= m_maxFailures || s.latency > m_maxLatency) {
+                I2P_LOG(m_log, debug) << "culling tunnel " << t->getTunnelId() << ": " << s.failures << " failed tests, average latency " << s.latency.count() << "ms";
+
+                if(std::find(m_culled.cbegin(), m_culled.cend(), t) == m_culled.cend())
+                    m_culled.push_back(t);
+            }
+        }
+
+        std::pair<RouterHash, RouterHash> Tester::hopPair(Test const &test) const
+        {
+            // A zero hop outbound tunnel ends at ourselves
+            std::vector<RouterHash> peers = test.outbound->getPeers();
+            RouterHash obep = (peers.empty() ? m_ctx.getIdentity()->getHash() : peers.back());
+
+            return std::make_pair(obep, test.inbound->getGatewayHash());
+        }
+    }
+}
@@ -0,0 +1,130 @@
+#ifndef TUNNELTESTER_H
+#define TUNNELTESTER_H
+
+#include "InboundTunnel.h"
+#include "OutboundTunnel.h"
+
+#include <i2pcpp/Log.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace i2pcpp {
+    class RouterContext;
+
+    namespace Tunnel {
+        /**
+         * Keeps track of tunnel tests. A test is a delivery status message
+         * sent out through one of our outbound tunnels and back in through
+         * one of our inbound tunnels. The round trip time is recorded for
+         * both tunnels, for the pair of routers where the message leaves the
+         * outbound tunnel and enters the inbound tunnel, and in the profiles
+         * of all peers involved. Tunnels which fail too many tests in a row,
+         * or whose average round trip time is too high, are culled.
+         */
+        class Tester {
+            public:
+                /**
+                 * @param timeout the time after which a test fails
+                 * @param maxLatency the average round trip time above which a tunnel is culled
+                 * @param maxFailures the number of consecutive failed tests after which a tunnel is culled
+                 */
+                Tester(RouterContext &ctx, std::chrono::milliseconds timeout, std::chrono::milliseconds maxLatency, uint32_t maxFailures);
+                Tester(const Tester &) = delete;
+                Tester& operator=(Tester &) = delete;
+
+                /**
+                 * Starts a test that goes out through \a outbound and comes
+                 * back in through \a inbound.
+                 * @return the message ID to put in the delivery status message
+                 */
+                uint32_t begin(std::shared_ptr<OutboundTunnel> const &outbound, std::shared_ptr<InboundTunnel> const &inbound);
+
+                /**
+                 * Completes the test which \a msgId belongs to.
+                 * @return false if \a msgId does not belong to a test in progress
+                 */
+                bool complete(uint32_t msgId);
+
+                /**
+                 * @return true if \a msgId belongs to a test in progress
+                 */
+                bool isPending(uint32_t msgId) const;
+
+                /**
+                 * Fails the tests that have timed out.
+                 */
+                void expire();
+
+                /**
+                 * @return the tunnels which should be taken out of service.
+                 * They are forgotten about.
+                 */
+                std::vector<TunnelPtr> takeCulled();
+
+                /**
+                 * Forgets about \a t, which was taken out of service for
+                 * another reason.
+                 */
+                void forget(TunnelPtr const &t);
+
+                /**
+                 * @return the average round trip time of tests through \a t,
+                 * or zero if none succeeded
+                 */
+                std::chrono::milliseconds getLatency(TunnelPtr const &t) const;
+
+                /**
+                 * @return the average round trip time of tests that left an
+                 * outbound tunnel at \a obep and entered an inbound tunnel at
+                 * \a ibgw, or zero if none succeeded
+                 */
+                std::chrono::milliseconds getLatency(RouterHash const &obep, RouterHash const &ibgw) const;
+
+            private:
+                typedef std::chrono::steady_clock clock;
+
+                struct Test {
+                    std::shared_ptr<OutboundTunnel> outbound;
+                    std::shared_ptr<InboundTunnel> inbound;
+                    clock::time_point sent;
+                };
+
+                struct Stats {
+                    std::chrono::milliseconds latency = std::chrono::milliseconds(0);
+                    uint32_t failures = 0;
+                };
+
+                /**
+                 * Records the outcome of a test for \a t and culls it if
+                 * necessary. Must be called with m_mutex held.
+                 */
+                void record(TunnelPtr const &t, bool success, std::chrono::milliseconds rtt);
+
+                /**
+                 * @return the key for the hop pair of \a test
+                 */
+                std::pair<RouterHash, RouterHash> hopPair(Test const &test) const;
+
+                RouterContext &m_ctx;
+
+                std::chrono::milliseconds m_timeout;
+                std::chrono::milliseconds m_maxLatency;
+                uint32_t m_maxFailures;
+
+                std::unordered_map<uint32_t, Test> m_tests;
+                std::map<TunnelPtr, Stats> m_tunnels;
+                std::map<std::pair<RouterHash, RouterHash>, std::chrono::milliseconds> m_hopPairs;
+                std::vector<TunnelPtr> m_culled;
+
+                mutable std::mutex m_mutex;
+
+                i2p_logger_mt m_log;
+        };
+    }
+}
+
+#endif
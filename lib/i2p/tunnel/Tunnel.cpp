@@ -1,6 +1,6 @@
 #include "Tunnel.h"
 
-#include <i2pcpp/datatypes/BuildResponseRecord.h>
+#include "ElGamalPool.h"
 
 namespace i2pcpp {
     namespace Tunnel {
@@ -24,43 +24,26 @@ namespace i2pcpp {
             return std::static_pointer_cast<BuildRequestRecord>(m_hops.front())->getLocalHash();
         }
 
+        std::vector<RouterHash> Tunnel::getPeers() const
+        {
+            std::vector<RouterHash> peers;
+            for(auto& h: m_hops)
+                peers.push_back(std::static_pointer_cast<BuildRequestRecord>(h)->getLocalHash());
+
+            return peers;
+        }
+
         uint32_t Tunnel::getNextMsgId() const
         {
             return m_nextMsgId;
         }
 
-        void Tunnel::handleResponses(std::list<BuildRecordPtr> const &records)
+        void Tunnel::setState(State state)
         {
-            bool allgood = true;
-
-            auto itr = m_hops.crbegin();
-            ++itr;
-
-            for(; itr != m_hops.crend(); ++itr) {
-                BuildRequestRecordPtr h = std::static_pointer_cast<BuildRequestRecord>(*itr);
-
-                for(auto r: records)
-                    r->decrypt(h->getReplyIV(), h->getReplyKey());
-
-                for(auto r: records) {
-                    BuildResponseRecord resp = *r;
-                    resp.parse();
-                    if(resp.getReply() == BuildResponseRecord::Reply::SUCCESS) {
-                        // TODO Record the success in the router's profile.
-                    } else {
-                        // TODO Record the failure in the router's profile.
-                        allgood = false;
-                    }
-                }
-            }
-
-            if(allgood)
-                m_state = Tunnel::State::OPERATIONAL;
-            else
-                m_state = Tunnel::State::FAILED;
+            m_state = state;
         }
 
-        void Tunnel::secureRecords()
+        void Tunnel::secureRecords(ElGamalPool *pool)
         {
             for(auto itr = m_hops.cbegin(); itr != m_hops.cend(); ++itr) {
                 BuildRequestRecordPtr h = std::static_pointer_cast<BuildRequestRecord>(*itr);
@@ -71,7 +54,11 @@ namespace i2pcpp {
                 h->setHeader(truncatedHash);
 
                 h->compile();
-                h->encrypt(h->getEncryptionKey());
+                if(pool) {
+                    ElGamalPool::Pair p = pool->take();
+                    h->encrypt(h->getEncryptionKey(), p.k, p.gk);
+                } else
+                    h->encrypt(h->getEncryptionKey());
 
                 std::list<BuildRecordPtr>::const_reverse_iterator ritr(itr);
                 for(; ritr != m_hops.crend(); ++ritr) {
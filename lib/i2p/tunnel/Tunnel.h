@@ -8,9 +8,12 @@
 #include <boost/asio.hpp>
 
 #include <list>
+#include <vector>
 
 namespace i2pcpp {
     namespace Tunnel {
+        class ElGamalPool;
+
         class Tunnel {
             public:
                 /**
@@ -57,16 +60,22 @@ namespace i2pcpp {
                  */
                 RouterHash getDownstream() const;
 
+                /**
+                 * @return the hashes of the routers in this tunnel, starting at
+                 * the gateway end. Empty for a zero hop tunnel.
+                 */
+                std::vector<RouterHash> getPeers() const;
+
                 /**
                  * @return the next message ID of the tunnel.
                  */
                 uint32_t getNextMsgId() const;
 
                 /**
-                 * Attempts to decrypt the received build record replies and
-                 * set the tunnel state accordingly.
+                 * Sets the state of the tunnel, once the build replies have
+                 * been processed.
                  */
-                void handleResponses(std::list<BuildRecordPtr> const &records);
+                void setState(State state);
 
                 /**
                  * Sets a timer on the tunnel (for creation timeout).
@@ -78,8 +87,10 @@ namespace i2pcpp {
 
                 /**
                  * Encrypts this tunnel's build records according to the spec.
+                 * If \a pool is given, the ElGamal ephemeral pairs are taken
+                 * from it.
                  */
-                void secureRecords();
+                void secureRecords(ElGamalPool *pool = nullptr);
 
                 std::list<BuildRecordPtr> m_hops;
                 State m_state = State::REQUESTED;
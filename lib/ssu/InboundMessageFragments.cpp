@@ -12,6 +12,7 @@
 #include <botan/pipe.h>
 #include <botan/filters.h>
 
+#include <functional>
 #include <string>
 #include <bitset>
 #include <iomanip>
@@ -141,9 +142,10 @@ namespace i2pcpp {
         inline void InboundMessageFragments::checkAndPost(const uint32_t msgId, InboundMessageState const &ims)
         {
             if(ims.allFragmentsReceived()) {
-                const ByteArray& data = ims.assemble();
+                ByteArray data = ims.assemble();
                 if(data.size())
-                    m_context.ios.post(boost::bind(boost::ref(m_context.receivedSignal), ims.getRouterHash(), msgId, data));
+                    // std::bind moves the data in to the handler rather than copying it
+                    m_context.ios.post(std::bind(std::ref(m_context.receivedSignal), ims.getRouterHash(), msgId, std::move(data)));
             }
         }
 
@@ -0,0 +1,42 @@
+#include <i2pcpp/util/BufferedRNG.h>
+
+#include <algorithm>
+
+namespace i2pcpp {
+    void BufferedRNG::randomize(unsigned char *out, std::size_t n)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        while(n) {
+            if(m_pos == m_buffer.size())
+                refill();
+
+            std::size_t len = std::min(n, m_buffer.size() - m_pos);
+            out = std::copy(m_buffer.cbegin() + m_pos, m_buffer.cbegin() + m_pos + len, out);
+            m_pos += len;
+            n -= len;
+        }
+    }
+
+    void BufferedRNG::randomizeNonzero(unsigned char *out, std::size_t n)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        while(n) {
+            if(m_pos == m_buffer.size())
+                refill();
+
+            unsigned char c = m_buffer[m_pos++];
+            if(c) {
+                *out++ = c;
+                --n;
+            }
+        }
+    }
+
+    void BufferedRNG::refill()
+    {
+        m_rng.randomize(m_buffer.data(), m_buffer.size());
+        m_pos = 0;
+    }
+}
@@ -0,0 +1,545 @@
+#include <lib/i2p/DatabaseWriter.h>
+#include <lib/i2p/RouterDirectory.h>
+#include <lib/i2p/RouterInfoCache.h>
+#include <lib/i2p/sqlite3cc.h>
+#include <i2pcpp/Database.h>
+#include <i2pcpp/datatypes/RouterIdentity.h>
+#include <i2pcpp/datatypes/RouterInfo.h>
+#include <i2pcpp/util/Base64.h>
+#include <algorithm>
+#include <set>
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "SampleRI.inc"
+
+using namespace i2pcpp;
+
+static RouterInfo makeRouter(std::string const &caps, bool ssu = true)
+{
+    auto it = sample_routerInfo.begin();
+    RouterInfo sample(it, sample_routerInfo.end());
+
+    Mapping options;
+    options.setValue("caps", caps);
+    RouterInfo ri(sample.getIdentity(), Date(), options);
+    if(ssu)
+        ri.addAddress(RouterAddress(5, Date(0), "SSU", Mapping()));
+
+    return ri;
+}
+
+static RouterHash makeHash(unsigned char c)
+{
+    RouterHash rh;
+    rh.fill(c);
+    return rh;
+}
+
+static std::vector<RouterHash> sorted(std::vector<RouterHash> v)
+{
+    std::sort(v.begin(), v.end());
+    return v;
+}
+
+BOOST_AUTO_TEST_SUITE(RouterDirectoryTests)
+
+BOOST_AUTO_TEST_CASE(RemoveMovesLast)
+{
+    RouterDirectory dir;
+    for(unsigned char c = 1; c <= 4; ++c)
+        dir.add(makeHash(c), makeRouter("fOR"));
+
+    // 4 takes the place of 1, and must be found there when it is removed
+    dir.remove(makeHash(1));
+    dir.remove(makeHash(4));
+
+    const std::vector<RouterHash> expected = {makeHash(2), makeHash(3)};
+    for(auto i: {RouterDirectory::ALL, RouterDirectory::FLOODFILL, RouterDirectory::REACHABLE, RouterDirectory::SSU, RouterDirectory::BANDWIDTH_O}) {
+        BOOST_CHECK_EQUAL(dir.size(i), 2);
+        BOOST_CHECK(sorted(dir.getAll(i)) == expected);
+        BOOST_CHECK(!dir.contains(makeHash(1), i));
+        BOOST_CHECK(!dir.contains(makeHash(4), i));
+    }
+
+    dir.remove(makeHash(3));
+    dir.remove(makeHash(2));
+    dir.remove(makeHash(2));
+
+    for(std::size_t i = 0; i < RouterDirectory::NUM_INDICES; ++i)
+        BOOST_CHECK_EQUAL(dir.size((RouterDirectory::Index)i), 0);
+}
+
+BOOST_AUTO_TEST_CASE(ReplaceRefiles)
+{
+    RouterDirectory dir;
+    dir.add(makeHash(1), makeRouter("fOR"));
+    dir.add(makeHash(2), makeRouter("fOR"));
+    dir.add(makeHash(1), makeRouter("L", false));
+
+    BOOST_CHECK_EQUAL(dir.size(), 2);
+    BOOST_CHECK(dir.contains(makeHash(1)));
+    BOOST_CHECK(!dir.contains(makeHash(1), RouterDirectory::FLOODFILL));
+    BOOST_CHECK(!dir.contains(makeHash(1), RouterDirectory::SSU));
+    BOOST_CHECK(dir.contains(makeHash(1), RouterDirectory::BANDWIDTH_L));
+    BOOST_CHECK(dir.getAll(RouterDirectory::BANDWIDTH_O) == std::vector<RouterHash>{makeHash(2)});
+    BOOST_CHECK(dir.getAll(RouterDirectory::FLOODFILL) == std::vector<RouterHash>{makeHash(2)});
+}
+
+BOOST_AUTO_TEST_CASE(OlderNotFiled)
+{
+    RouterDirectory dir;
+    std::vector<RouterHash> added;
+    dir.registerAdded([&added](RouterHash const rh, RouterInfo const &) { added.push_back(rh); });
+
+    RouterInfo newer = makeRouter("fOR");
+    Mapping options;
+    options.setValue("caps", "L");
+    RouterInfo older(newer.getIdentity(), Date(0), options);
+
+    BOOST_CHECK(dir.add(makeHash(1), newer));
+    BOOST_CHECK(!dir.add(makeHash(1), older));
+
+    BOOST_CHECK(dir.contains(makeHash(1), RouterDirectory::FLOODFILL));
+    BOOST_CHECK(!dir.contains(makeHash(1), RouterDirectory::BANDWIDTH_L));
+    BOOST_CHECK_EQUAL(added.size(), 1);
+
+    // A copy published at the same time replaces the entry
+    BOOST_CHECK(dir.add(makeHash(1), newer));
+    BOOST_CHECK_EQUAL(added.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(ClassCounts)
+{
+    RouterDirectory dir;
+    dir.add(makeHash(1), makeRouter("KR"));
+    dir.add(makeHash(2), makeRouter("fOR"));
+    dir.add(makeHash(3), makeRouter("LOR"));
+    dir.add(makeHash(4), makeRouter("fX"));
+    dir.add(makeHash(5), makeRouter("R"));
+
+    BOOST_CHECK_EQUAL(dir.size(RouterDirectory::ALL, 'K'), 1);
+    BOOST_CHECK_EQUAL(dir.size(RouterDirectory::ALL, 'L'), 0);
+    BOOST_CHECK_EQUAL(dir.size(RouterDirectory::ALL, 'O'), 2);
+    BOOST_CHECK_EQUAL(dir.size(RouterDirectory::ALL, 'X'), 1);
+    BOOST_CHECK_EQUAL(dir.size(RouterDirectory::FLOODFILL, 'O'), 1);
+    BOOST_CHECK_EQUAL(dir.size(RouterDirectory::FLOODFILL, 'X'), 1);
+    BOOST_CHECK_EQUAL(dir.size(RouterDirectory::REACHABLE, 'O'), 2);
+    BOOST_CHECK_EQUAL(dir.size(RouterDirectory::REACHABLE, 'X'), 0);
+    BOOST_CHECK_EQUAL(dir.size(RouterDirectory::BANDWIDTH_O, 'O'), 2);
+
+    dir.remove(makeHash(2));
+    dir.add(makeHash(4), makeRouter("fK"));
+
+    BOOST_CHECK_EQUAL(dir.size(RouterDirectory::ALL, 'K'), 2);
+    BOOST_CHECK_EQUAL(dir.size(RouterDirectory::ALL, 'O'), 1);
+    BOOST_CHECK_EQUAL(dir.size(RouterDirectory::ALL, 'X'), 0);
+    BOOST_CHECK_EQUAL(dir.size(RouterDirectory::FLOODFILL, 'K'), 1);
+    BOOST_CHECK_EQUAL(dir.size(RouterDirectory::FLOODFILL, 'O'), 0);
+
+    dir.clear();
+
+    for(auto c: std::string("KLMNOPX"))
+        BOOST_CHECK_EQUAL(dir.size(RouterDirectory::ALL, c), 0);
+}
+
+BOOST_AUTO_TEST_CASE(PickExcluded)
+{
+    RouterDirectory dir;
+    std::unordered_set<RouterHash> excluded;
+    for(unsigned char c = 1; c <= 100; ++c) {
+        dir.add(makeHash(c), makeRouter(c % 2 ? "OR" : "KR"));
+        if(c != 42)
+            excluded.insert(makeHash(c));
+    }
+
+    BOOST_CHECK(dir.pick(RouterDirectory::ALL, excluded) == makeHash(42));
+    BOOST_CHECK(dir.pickWeighted(RouterDirectory::ALL, excluded) == makeHash(42));
+
+    excluded.insert(makeHash(42));
+    BOOST_CHECK_THROW(dir.pick(RouterDirectory::ALL, excluded), std::runtime_error);
+    BOOST_CHECK_THROW(dir.pickWeighted(RouterDirectory::ALL, excluded), std::runtime_error);
+    BOOST_CHECK_THROW(dir.pick(RouterDirectory::FLOODFILL), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(Signals)
+{
+    RouterDirectory dir;
+    std::vector<RouterHash> added, removed;
+    dir.registerAdded([&added](RouterHash const rh, RouterInfo const &) { added.push_back(rh); });
+    dir.registerRemoved([&removed](RouterHash const rh) { removed.push_back(rh); });
+
+    dir.add(makeHash(1), makeRouter("OR"));
+    dir.add(makeHash(2), makeRouter("OR"));
+    dir.remove(makeHash(1));
+    dir.remove(makeHash(3));
+    dir.clear();
+
+    BOOST_CHECK(added == (std::vector<RouterHash>{makeHash(1), makeHash(2)}));
+    BOOST_CHECK(removed == (std::vector<RouterHash>{makeHash(1), makeHash(2)}));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/**
+ * A new database in the temporary directory, removed with its WAL files
+ *  at the end of the test.
+ */
+struct TempDatabase {
+    TempDatabase() :
+        file((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string())
+    {
+        Database::createDb(file);
+    }
+
+    ~TempDatabase()
+    {
+        for(auto suffix: {"", "-wal", "-shm"})
+            boost::filesystem::remove(file + suffix);
+    }
+
+    /**
+     * Makes writes of routers with the capabilities "fail" abort.
+     */
+    void failWrites()
+    {
+        sqlite::connection conn(file);
+        conn.exec("CREATE TRIGGER fail BEFORE INSERT ON routers WHEN NEW.caps = 'fail' BEGIN SELECT RAISE(ABORT, 'write failed'); END");
+    }
+
+    /**
+     * @return the i2pcpp::RouterInfo stored for \a rh, read over a
+     *  connection of its own, or a null pointer if there is none
+     */
+    std::shared_ptr<const RouterInfo> read(RouterHash const &rh) const
+    {
+        sqlite::connection conn(file);
+        auto q = conn.make_query("SELECT data FROM routers WHERE id = ?");
+        *q << Base64::encode(rh);
+
+        sqlite::row r = q->step();
+        if(!r)
+            return std::shared_ptr<const RouterInfo>();
+
+        ByteArray data;
+        r >> data;
+
+        auto begin = data.cbegin();
+        return std::make_shared<const RouterInfo>(begin, data.cend());
+    }
+
+    std::string file;
+};
+
+/**
+ * @return a router with an identity of its own for each \a c
+ */
+static RouterInfo routerOf(unsigned char c, uint64_t published, std::string const &caps = "OR")
+{
+    Mapping options;
+    options.setValue("caps", caps);
+    return RouterInfo(RouterIdentity(ByteArray(256, c), ByteArray(128, c), Certificate()), Date(published), options);
+}
+
+static RouterHash hashOf(unsigned char c)
+{
+    return routerOf(c, 0).getIdentity().getHash();
+}
+
+static uint64_t publishedOf(std::shared_ptr<const RouterInfo> const &ri)
+{
+    BOOST_REQUIRE(ri);
+
+    const ByteArray b = ri->getPublished().serialize();
+    uint64_t published = 0;
+    for(auto c: b)
+        published = (published << 8) | c;
+
+    return published;
+}
+
+BOOST_AUTO_TEST_SUITE(RouterInfoCacheTests)
+
+/**
+ * @return the bytes the cache counts for a router made by routerOf
+ */
+static std::size_t entrySize()
+{
+    RouterInfoCache c(1 << 20);
+    c.put(std::make_shared<const RouterInfo>(routerOf(1, 1000)));
+    return c.getStats().bytes;
+}
+
+/**
+ * @return routers made by routerOf whose hashes fall in the same shard
+ *  (same first byte modulo 16) as the first one, \a same of them, or in
+ *  different shards if \a same is false
+ */
+static std::vector<unsigned char> routersIn(bool same, std::size_t n)
+{
+    std::vector<unsigned char> result;
+    std::set<unsigned> shards;
+
+    for(unsigned c = 1; c < 256 && result.size() < n; ++c) {
+        unsigned shard = hashOf(c)[0] % 16;
+        if(same ? (result.empty() || shard == hashOf(result[0])[0] % 16) : shards.insert(shard).second)
+            result.push_back(c);
+    }
+
+    BOOST_REQUIRE_EQUAL(result.size(), n);
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(NewerKept)
+{
+    RouterInfoCache c(1 << 20);
+
+    c.put(std::make_shared<const RouterInfo>(routerOf(1, 2000)));
+    c.put(std::make_shared<const RouterInfo>(routerOf(1, 1000)));
+    BOOST_CHECK_EQUAL(publishedOf(c.get(hashOf(1))), 2000);
+
+    c.put(std::make_shared<const RouterInfo>(routerOf(1, 3000)));
+    BOOST_CHECK_EQUAL(publishedOf(c.get(hashOf(1))), 3000);
+    BOOST_CHECK_EQUAL(c.getStats().entries, 1);
+}
+
+BOOST_AUTO_TEST_CASE(Counters)
+{
+    RouterInfoCache c(1 << 20);
+
+    BOOST_CHECK(!c.get(hashOf(1)));
+    c.put(std::make_shared<const RouterInfo>(routerOf(1, 1000)));
+    BOOST_CHECK(c.get(hashOf(1)));
+    BOOST_CHECK(c.get(hashOf(1)));
+    BOOST_CHECK(c.contains(hashOf(1)));
+    BOOST_CHECK(!c.contains(hashOf(2)));
+
+    RouterInfoCache::Stats s = c.getStats();
+    BOOST_CHECK_EQUAL(s.hits, 2);
+    BOOST_CHECK_EQUAL(s.misses, 1);
+    BOOST_CHECK_EQUAL(s.evictions, 0);
+    BOOST_CHECK_EQUAL(s.entries, 1);
+    BOOST_CHECK_EQUAL(s.bytes, entrySize());
+
+    c.invalidate(hashOf(1));
+    s = c.getStats();
+    BOOST_CHECK_EQUAL(s.evictions, 0);
+    BOOST_CHECK_EQUAL(s.entries, 0);
+    BOOST_CHECK_EQUAL(s.bytes, 0);
+}
+
+BOOST_AUTO_TEST_CASE(EvictsWithinShard)
+{
+    // Room for one router in each of the 16 shards
+    const std::size_t size = entrySize();
+    RouterInfoCache c(16 * size);
+
+    auto spread = routersIn(false, 16);
+    for(auto r: spread)
+        c.put(std::make_shared<const RouterInfo>(routerOf(r, 1000)));
+
+    RouterInfoCache::Stats s = c.getStats();
+    BOOST_CHECK_EQUAL(s.entries, 16);
+    BOOST_CHECK_EQUAL(s.evictions, 0);
+    BOOST_CHECK_EQUAL(s.bytes, 16 * size);
+
+    // A second router in a shard takes the place of the first
+    auto same = routersIn(true, 2);
+    c.clear();
+    c.put(std::make_shared<const RouterInfo>(routerOf(same[0], 1000)));
+    c.get(hashOf(same[0]));
+    c.put(std::make_shared<const RouterInfo>(routerOf(same[1], 1000)));
+
+    BOOST_CHECK(!c.contains(hashOf(same[0])));
+    BOOST_CHECK(c.contains(hashOf(same[1])));
+    s = c.getStats();
+    BOOST_CHECK_EQUAL(s.evictions, 1);
+    BOOST_CHECK_EQUAL(s.bytes, size);
+}
+
+BOOST_AUTO_TEST_CASE(BytesCapped)
+{
+    const std::size_t capacity = 40 * entrySize();
+    RouterInfoCache c(capacity);
+
+    for(unsigned r = 1; r <= 200; ++r) {
+        c.put(std::make_shared<const RouterInfo>(routerOf(r, 1000)));
+        BOOST_CHECK_LE(c.getStats().bytes, capacity);
+    }
+
+    RouterInfoCache::Stats s = c.getStats();
+    BOOST_CHECK_LT(s.entries, 200);
+    BOOST_CHECK_EQUAL(s.evictions, 200 - s.entries);
+    BOOST_CHECK_EQUAL(s.bytes, s.entries * entrySize());
+    BOOST_CHECK(c.contains(hashOf(200)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(DatabaseWriterTests)
+
+BOOST_AUTO_TEST_CASE(FlushWritesRows)
+{
+    TempDatabase tmp;
+    DatabaseWriter w(tmp.file, std::chrono::hours(1), 1000);
+
+    for(unsigned char c = 1; c <= 10; ++c)
+        w.queue(std::make_shared<const RouterInfo>(routerOf(c, 1000 + c)));
+
+    // Nothing is due before the interval, so only flush() gets them written
+    BOOST_CHECK(w.flush());
+
+    for(unsigned char c = 1; c <= 10; ++c) {
+        BOOST_CHECK_EQUAL(publishedOf(tmp.read(hashOf(c))), 1000 + c);
+        BOOST_CHECK(!w.get(hashOf(c)));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(OlderCopyNotWritten)
+{
+    TempDatabase tmp;
+    DatabaseWriter w(tmp.file, std::chrono::hours(1), 1000);
+
+    w.queue(std::make_shared<const RouterInfo>(routerOf(1, 2000)));
+    w.queue(std::make_shared<const RouterInfo>(routerOf(1, 1000)));
+    BOOST_CHECK_EQUAL(publishedOf(w.get(hashOf(1))), 2000);
+
+    BOOST_CHECK(w.flush());
+    BOOST_CHECK_EQUAL(publishedOf(tmp.read(hashOf(1))), 2000);
+}
+
+BOOST_AUTO_TEST_CASE(OlderCopyAfterWriteNotWritten)
+{
+    TempDatabase tmp;
+    DatabaseWriter w(tmp.file, std::chrono::hours(1), 1000);
+
+    w.queue(std::make_shared<const RouterInfo>(routerOf(1, 2000)));
+    BOOST_CHECK(w.flush());
+
+    w.queue(std::make_shared<const RouterInfo>(routerOf(1, 1000)));
+    BOOST_CHECK(w.flush());
+    BOOST_CHECK_EQUAL(publishedOf(tmp.read(hashOf(1))), 2000);
+
+    w.queue(std::make_shared<const RouterInfo>(routerOf(1, 3000)));
+    BOOST_CHECK(w.flush());
+    BOOST_CHECK_EQUAL(publishedOf(tmp.read(hashOf(1))), 3000);
+}
+
+BOOST_AUTO_TEST_CASE(FailureSignalled)
+{
+    TempDatabase tmp;
+    tmp.failWrites();
+
+    DatabaseWriter w(tmp.file, std::chrono::hours(1), 1000);
+
+    std::set<RouterHash> failed;
+    w.registerFailed([&failed](RouterHash const rh) { failed.insert(rh); });
+
+    // The batch is written in one transaction, and fails as a whole
+    w.queue(std::make_shared<const RouterInfo>(routerOf(1, 1000, "fail")));
+    w.queue(std::make_shared<const RouterInfo>(routerOf(2, 1000)));
+    BOOST_CHECK(!w.flush());
+
+    BOOST_CHECK(failed == (std::set<RouterHash>{hashOf(1), hashOf(2)}));
+    BOOST_CHECK(!tmp.read(hashOf(1)));
+    BOOST_CHECK(!tmp.read(hashOf(2)));
+
+    // A failure is not reported to later flushes
+    w.queue(std::make_shared<const RouterInfo>(routerOf(2, 1000)));
+    BOOST_CHECK(w.flush());
+    BOOST_CHECK(tmp.read(hashOf(2)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(DatabaseTests)
+
+BOOST_AUTO_TEST_CASE(FailedWriteInvalidates)
+{
+    TempDatabase tmp;
+    tmp.failWrites();
+
+    Database db(tmp.file);
+
+    db.setRouterInfo(routerOf(1, 1000));
+    BOOST_CHECK_THROW(db.setRouterInfo(routerOf(2, 1000, "fail")), std::runtime_error);
+
+    // What could not be written is neither cached nor listed
+    BOOST_CHECK(!db.getRouterInfoPtr(hashOf(2)));
+    BOOST_CHECK(!db.routerExists(hashOf(2)));
+    BOOST_CHECK(!db.getDirectory().contains(hashOf(2)));
+
+    BOOST_CHECK(db.getRouterInfoPtr(hashOf(1)));
+    BOOST_CHECK(db.getDirectory().contains(hashOf(1)));
+}
+
+BOOST_AUTO_TEST_CASE(QueueKeepsNewer)
+{
+    TempDatabase tmp;
+    Database db(tmp.file);
+
+    db.setRouterInfo(routerOf(1, 2000, "fOR"));
+    const uint64_t misses = db.getCacheStats().misses;
+
+    // Told apart in memory, without looking the router up
+    db.queueRouterInfo(routerOf(1, 1000, "L"));
+    BOOST_CHECK_EQUAL(db.getCacheStats().misses, misses);
+    BOOST_CHECK(db.getDirectory().contains(hashOf(1), RouterDirectory::FLOODFILL));
+    BOOST_CHECK_EQUAL(publishedOf(db.getRouterInfoPtr(hashOf(1))), 2000);
+
+    db.setRouterInfo(routerOf(2, 1000));
+    BOOST_CHECK_EQUAL(publishedOf(tmp.read(hashOf(1))), 2000);
+
+    db.queueRouterInfo(routerOf(1, 3000, "L"));
+    BOOST_CHECK(!db.getDirectory().contains(hashOf(1), RouterDirectory::FLOODFILL));
+    BOOST_CHECK_EQUAL(publishedOf(db.getRouterInfoPtr(hashOf(1))), 3000);
+}
+
+BOOST_AUTO_TEST_CASE(MigrateVersion0)
+{
+    TempDatabase tmp;
+    boost::filesystem::remove(tmp.file);
+
+    RouterInfo ri = routerOf(1, 1000, "fOR");
+    ri.addAddress(RouterAddress(5, Date(0), "SSU", Mapping()));
+    const std::string rh = Base64::encode(ri.getIdentity().getHash());
+
+    // Stored the way version 0 stored them, with a second router that cannot be read back
+    {
+        sqlite::connection conn(tmp.file);
+        conn.exec("CREATE TABLE config (name TEXT PRIMARY KEY NOT NULL, value TEXT)");
+        conn.exec("CREATE TABLE routers (id BLOB PRIMARY KEY, encryption_key BLOB NOT NULL, signing_key BLOB NOT NULL, certificate BLOB NOT NULL, published BLOB NOT NULL, signature BLOB NOT NULL)");
+        conn.exec("CREATE TABLE router_addresses (router_id BLOB NOT NULL, \"index\" INTEGER NOT NULL, cost INTEGER NOT NULL, expiration BLOB NOT NULL, transport TEXT NOT NULL, PRIMARY KEY(router_id, \"index\"))");
+        conn.exec("CREATE TABLE router_options (router_id BLOB NOT NULL, name TEXT NOT NULL, value TEXT NOT NULL, PRIMARY KEY(router_id, name))");
+        conn.exec("CREATE TABLE router_address_options (router_id BLOB NOT NULL, \"index\" INTEGER NOT NULL, name TEXT NOT NULL, value TEXT NOT NULL, PRIMARY KEY(router_id, \"index\", name))");
+        conn.exec("CREATE TABLE profiles (router_id BLOB NOT NULL, last_seen INTEGER, PRIMARY KEY(router_id))");
+
+        auto insertRouter = conn.make_command("INSERT INTO routers(id, encryption_key, signing_key, certificate, published, signature) VALUES(?, ?, ?, ?, ?, ?)");
+        *insertRouter << rh << ri.getIdentity().getEncryptionKey() << ri.getIdentity().getSigningKey() << ri.getIdentity().getCertificate().serialize() << ri.getPublished().serialize() << ri.getSignature() << sqlite::exec;
+        insertRouter->reset();
+        insertRouter->clear_bindings();
+        *insertRouter << "broken" << ByteArray(256) << ByteArray(128) << ByteArray(3) << ByteArray(2) << ByteArray(40) << sqlite::exec;
+
+        *conn.make_command("INSERT INTO router_options(router_id, name, value) VALUES(?, 'caps', 'fOR')") << rh << sqlite::exec;
+        *conn.make_command("INSERT INTO router_addresses(router_id, \"index\", cost, expiration, transport) VALUES(?, 0, 5, ?, 'SSU')") << rh << Date(0).serialize() << sqlite::exec;
+        *conn.make_command("INSERT INTO profiles(router_id, last_seen) VALUES('broken', 0)") << sqlite::exec;
+    }
+
+    Database db(tmp.file);
+
+    auto migrated = db.getRouterInfoPtr(ri.getIdentity().getHash());
+    BOOST_REQUIRE(migrated);
+    BOOST_CHECK(migrated->serialize() == ri.serialize());
+    BOOST_CHECK(db.getDirectory().contains(ri.getIdentity().getHash(), RouterDirectory::FLOODFILL));
+    BOOST_CHECK(db.getDirectory().contains(ri.getIdentity().getHash(), RouterDirectory::SSU));
+    BOOST_CHECK_EQUAL(db.getDirectory().size(), 1);
+
+    sqlite::connection conn(tmp.file);
+    int version, profiles;
+    conn.make_query("PRAGMA user_version")->step() >> version;
+    conn.make_query("SELECT COUNT(*) FROM profiles")->step() >> profiles;
+    BOOST_CHECK(version == Database::SCHEMA_VERSION);
+    BOOST_CHECK_EQUAL(profiles, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
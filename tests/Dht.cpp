@@ -1,5 +1,18 @@
+#include <lib/i2p/RouterContext.h>
+#include <lib/i2p/RouterDirectory.h>
+#include <lib/i2p/dht/Floodfill.h>
 #include <lib/i2p/dht/SearchState.h>
+#include <lib/i2p/i2np/DatabaseLookup.h>
+#include <lib/i2p/i2np/DatabaseSearchReply.h>
+#include <lib/i2p/i2np/DatabaseStore.h>
+#include <lib/i2p/kad/RoutingTable.h>
+#include <i2pcpp/Transport.h>
+#include <i2pcpp/datatypes/RouterIdentity.h>
+#include <i2pcpp/datatypes/RouterInfo.h>
+#include <i2pcpp/util/make_unique.h>
 #include <random>
+#include <set>
+#include <boost/filesystem.hpp>
 #include <boost/test/unit_test.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/hashed_index.hpp>
@@ -170,3 +183,346 @@ BOOST_AUTO_TEST_CASE(StateContainerCountHash)
 }
 
 BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(RoutingTableTests)
+
+/**
+ * @return a key in bucket 0 of a table around the zero key, the rest of
+ *  which is \a i
+ */
+static Kad::RoutingTable::key_type bucketZeroKey(unsigned i)
+{
+    Kad::RoutingTable::key_type k;
+    k.fill(0);
+    k[0] = 0x80;
+    k[KEY_SIZE - 2] = i >> 8;
+    k[KEY_SIZE - 1] = i;
+    return k;
+}
+
+static RouterHash hashOf(unsigned i)
+{
+    RouterHash rh;
+    rh.fill(0);
+    rh[0] = i >> 8;
+    rh[1] = i;
+    return rh;
+}
+
+BOOST_AUTO_TEST_CASE(BucketIsBounded)
+{
+    Kad::RoutingTable::key_type ref;
+    ref.fill(0);
+    Kad::RoutingTable rt(ref);
+
+    RouterHash questionable;
+    for(unsigned i = 0; i < 5 * K_VALUE; ++i)
+        rt.update(hashOf(i), bucketZeroKey(i), true, questionable);
+
+    BOOST_CHECK_EQUAL(rt.size(), K_VALUE);
+}
+
+BOOST_AUTO_TEST_CASE(LeastRecentlySeenIsQuestionable)
+{
+    Kad::RoutingTable::key_type ref;
+    ref.fill(0);
+    Kad::RoutingTable rt(ref);
+
+    RouterHash questionable;
+    for(unsigned i = 0; i < K_VALUE; ++i)
+        BOOST_CHECK(!rt.update(hashOf(i), bucketZeroKey(i), false, questionable));
+
+    // Seen just now, so the next oldest entry is the one to ping
+    BOOST_CHECK(!rt.update(hashOf(0), bucketZeroKey(0), true, questionable));
+
+    BOOST_REQUIRE(rt.update(hashOf(K_VALUE), bucketZeroKey(K_VALUE), false, questionable));
+    BOOST_CHECK(questionable == hashOf(1));
+
+    // Not while the ping is outstanding
+    rt.pinging(hashOf(1));
+    BOOST_CHECK(!rt.update(hashOf(K_VALUE + 1), bucketZeroKey(K_VALUE + 1), false, questionable));
+}
+
+BOOST_AUTO_TEST_CASE(FailedIsReplaced)
+{
+    Kad::RoutingTable::key_type ref;
+    ref.fill(0);
+    Kad::RoutingTable rt(ref);
+
+    RouterHash questionable;
+    for(unsigned i = 0; i <= K_VALUE; ++i)
+        rt.update(hashOf(i), bucketZeroKey(i), true, questionable);
+
+    auto before = rt.closest(bucketZeroKey(K_VALUE), 1);
+    BOOST_REQUIRE_EQUAL(before.size(), 1);
+    BOOST_CHECK(before[0] != hashOf(K_VALUE));
+
+    rt.failed(hashOf(0));
+    BOOST_CHECK_EQUAL(rt.size(), K_VALUE);
+
+    auto after = rt.closest(bucketZeroKey(K_VALUE), 1);
+    BOOST_REQUIRE_EQUAL(after.size(), 1);
+    BOOST_CHECK(after[0] == hashOf(K_VALUE));
+}
+
+BOOST_AUTO_TEST_CASE(ClosestIsSorted)
+{
+    std::default_random_engine rng;
+    std::uniform_int_distribution<unsigned> byte(0, 255);
+
+    Kad::RoutingTable::key_type ref;
+    ref.fill(0);
+    Kad::RoutingTable rt(ref);
+
+    std::unordered_map<RouterHash, Kad::RoutingTable::key_type> keys;
+    RouterHash questionable;
+    for(unsigned i = 0; i < 1000; ++i) {
+        Kad::RoutingTable::key_type k;
+        for(auto& b: k)
+            b = byte(rng);
+
+        keys[hashOf(i)] = k;
+        rt.update(hashOf(i), k, true, questionable);
+    }
+
+    Kad::RoutingTable::key_type q;
+    for(auto& b: q)
+        b = byte(rng);
+
+    auto distance = [&](RouterHash const &rh) {
+        Kad::RoutingTable::key_type d;
+        std::transform(keys[rh].cbegin(), keys[rh].cend(), q.cbegin(), d.begin(), std::bit_xor<unsigned char>());
+        return d;
+    };
+
+    auto closest = rt.closest(q, K_VALUE);
+    BOOST_REQUIRE_EQUAL(closest.size(), K_VALUE);
+    for(std::size_t i = 1; i < closest.size(); ++i)
+        BOOST_CHECK(distance(closest[i - 1]) < distance(closest[i]));
+}
+
+BOOST_AUTO_TEST_CASE(ClosestMatchesBruteForce)
+{
+    std::default_random_engine rng;
+    std::uniform_int_distribution<unsigned> byte(0, 255);
+
+    // A random key in bucket b of a table around the zero key
+    auto bucketKey = [&](std::size_t b) {
+        Kad::RoutingTable::key_type k;
+        for(auto& x: k)
+            x = byte(rng);
+
+        for(std::size_t i = 0; i < b; ++i)
+            k[i / 8] &= ~(0x80 >> (i % 8));
+        k[b / 8] |= 0x80 >> (b % 8);
+
+        return k;
+    };
+
+    Kad::RoutingTable::key_type ref;
+    ref.fill(0);
+    Kad::RoutingTable rt(ref);
+
+    std::vector<std::pair<Kad::RoutingTable::key_type, RouterHash>> entries;
+    RouterHash questionable;
+    for(std::size_t b = 0; b < 200; ++b) {
+        if(b == 100)
+            continue;
+
+        for(unsigned i = 0; i < 5; ++i) {
+            entries.push_back(std::make_pair(bucketKey(b), hashOf(entries.size())));
+            rt.update(entries.back().second, entries.back().first, true, questionable);
+        }
+    }
+
+    // Shared prefixes, so that ties on the first word must be broken
+    const Kad::RoutingTable::key_type shared = bucketKey(100);
+    for(unsigned i = 0; i < K_VALUE; ++i) {
+        Kad::RoutingTable::key_type k = bucketKey(100);
+        std::copy(shared.cbegin(), shared.cbegin() + 16, k.begin());
+
+        entries.push_back(std::make_pair(k, hashOf(entries.size())));
+        rt.update(entries.back().second, k, true, questionable);
+    }
+
+    BOOST_REQUIRE_EQUAL(rt.size(), entries.size());
+
+    for(int i = 0; i < 20; ++i) {
+        const Kad::RoutingTable::key_type q = (i % 2 ? bucketKey(byte(rng) % 200) : shared);
+
+        auto distance = [&q](Kad::RoutingTable::key_type const &k) {
+            Kad::RoutingTable::key_type d;
+            std::transform(k.cbegin(), k.cend(), q.cbegin(), d.begin(), std::bit_xor<unsigned char>());
+            return d;
+        };
+
+        auto expected = entries;
+        std::sort(expected.begin(), expected.end(), [&](decltype(entries)::value_type const &a, decltype(entries)::value_type const &b) {
+            return distance(a.first) < distance(b.first);
+        });
+
+        auto closest = rt.closest(q, K_VALUE);
+        BOOST_REQUIRE_EQUAL(closest.size(), K_VALUE);
+        for(std::size_t j = 0; j < closest.size(); ++j)
+            BOOST_CHECK(closest[j] == expected[j].second);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/**
+ * Keeps what would have been sent, instead of sending it.
+ */
+class CapturingTransport : public Transport {
+    public:
+        void connect(RouterInfo const &) {}
+
+        void send(RouterHash const &rh, uint32_t msgId, ByteArray const &msg)
+        {
+            sent.emplace_back(rh, I2NP::Message::fromBytes(msgId, msg, false));
+        }
+
+        void disconnect(RouterHash const &) {}
+        uint32_t numPeers() const { return 0; }
+        bool isConnected(RouterHash const &) const { return true; }
+
+        std::vector<std::pair<RouterHash, I2NP::MessagePtr>> sent;
+};
+
+/**
+ * A floodfill router on a temporary database, whose replies are captured.
+ */
+struct FloodfillFixture {
+    FloodfillFixture() :
+        file((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string())
+    {
+        Database::createDb(file);
+        db = std::make_shared<Database>(file);
+        db->setConfigValue("floodfill", "1");
+
+        ctx = std::make_unique<RouterContext>(db, ios);
+        transport = std::make_shared<CapturingTransport>();
+        ctx->getOutMsgDisp().registerTransport(transport);
+        ctx->getDHT()->getFloodfill().begin();
+    }
+
+    ~FloodfillFixture()
+    {
+        ctx.reset();
+        db.reset();
+
+        for(auto suffix: {"", "-wal", "-shm"})
+            boost::filesystem::remove(file + suffix);
+    }
+
+    static RouterInfo makeRouter(unsigned char c, std::string const &caps)
+    {
+        Mapping options;
+        options.setValue("caps", caps);
+        return RouterInfo(RouterIdentity(ByteArray(256, c), ByteArray(128, c), Certificate()), Date(), options);
+    }
+
+    static RouterHash hashOf(unsigned char c)
+    {
+        return makeRouter(c, "").getIdentity().getHash();
+    }
+
+    /**
+     * Adds routers 1 to 8 as floodfills and 11 to 18 as other routers.
+     */
+    void addRouters()
+    {
+        for(unsigned char c = 1; c <= 8; ++c)
+            db->getDirectory().add(hashOf(c), makeRouter(c, "fOR"));
+        for(unsigned char c = 11; c <= 18; ++c)
+            db->getDirectory().add(hashOf(c), makeRouter(c, "OR"));
+    }
+
+    /**
+     * @return the hashes in the reply to the lookup of \a key, which must
+     *  be a DatabaseSearchReply sent to the sender of the lookup
+     */
+    std::set<RouterHash> search(StaticByteArray<32> const &key, std::list<RouterHash> const &excluded)
+    {
+        const RouterHash from = hashOf(0xaa);
+        ctx->getDHT()->getFloodfill().lookup(from, I2NP::DatabaseLookup(key, from, 0, excluded));
+
+        BOOST_REQUIRE_EQUAL(transport->sent.size(), 1);
+        BOOST_CHECK(transport->sent[0].first == from);
+        BOOST_REQUIRE(transport->sent[0].second->getType() == I2NP::Message::Type::DB_SEARCH_REPLY);
+
+        auto dsr = std::static_pointer_cast<I2NP::DatabaseSearchReply>(transport->sent[0].second);
+        transport->sent.clear();
+
+        return std::set<RouterHash>(dsr->getHashes().cbegin(), dsr->getHashes().cend());
+    }
+
+    std::string file;
+    boost::asio::io_service ios;
+    std::shared_ptr<Database> db;
+    std::unique_ptr<RouterContext> ctx;
+    std::shared_ptr<CapturingTransport> transport;
+};
+
+BOOST_FIXTURE_TEST_SUITE(FloodfillTests, FloodfillFixture)
+
+BOOST_AUTO_TEST_CASE(KnownKeyAnsweredWithStore)
+{
+    addRouters();
+
+    const RouterHash from = hashOf(0xaa);
+    ctx->getDHT()->getFloodfill().lookup(from, I2NP::DatabaseLookup(hashOf(12), from, 0));
+
+    BOOST_REQUIRE_EQUAL(transport->sent.size(), 1);
+    BOOST_REQUIRE(transport->sent[0].second->getType() == I2NP::Message::Type::DB_STORE);
+    BOOST_CHECK(std::static_pointer_cast<I2NP::DatabaseStore>(transport->sent[0].second)->getKey() == hashOf(12));
+}
+
+BOOST_AUTO_TEST_CASE(ExcludedNotReturned)
+{
+    addRouters();
+
+    std::list<RouterHash> excluded;
+    for(unsigned char c = 1; c <= 5; ++c)
+        excluded.push_back(hashOf(c));
+
+    // Only floodfills are returned, and only three of them are left
+    BOOST_CHECK(search(hashOf(0xbb), excluded) == (std::set<RouterHash>{hashOf(6), hashOf(7), hashOf(8)}));
+
+    excluded.push_back(hashOf(6));
+    excluded.push_back(hashOf(7));
+    BOOST_CHECK(search(hashOf(0xbb), excluded) == (std::set<RouterHash>{hashOf(8)}));
+}
+
+BOOST_AUTO_TEST_CASE(ExploratoryReturnsOthers)
+{
+    addRouters();
+
+    // The all-zero hash asks for routers that are not floodfills
+    std::list<RouterHash> excluded = {RouterHash()};
+    for(unsigned char c = 11; c <= 15; ++c)
+        excluded.push_back(hashOf(c));
+
+    BOOST_CHECK(search(hashOf(0xbb), excluded) == (std::set<RouterHash>{hashOf(16), hashOf(17), hashOf(18)}));
+}
+
+BOOST_AUTO_TEST_CASE(EncryptedReplyDropped)
+{
+    addRouters();
+
+    // A lookup of a key we hold, asking for the reply to be encrypted with no session tags
+    const RouterHash from = hashOf(0xaa);
+    I2NP::DatabaseLookup dl(hashOf(12), from, 0);
+    ByteArray b = dl.toBytes(false);
+    b[5 + 64] |= 0x02;
+    b.insert(b.end(), 33, 0x00);
+
+    auto m = I2NP::Message::fromBytes(1, b, false);
+    auto encrypted = std::static_pointer_cast<I2NP::DatabaseLookup>(m);
+    BOOST_REQUIRE(encrypted->isReplyEncrypted());
+
+    ctx->getDHT()->getFloodfill().lookup(from, *encrypted);
+    BOOST_CHECK(transport->sent.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,121 @@
+#include <lib/i2p/i2np/DatabaseLookup.h>
+#include <boost/test/unit_test.hpp>
+
+using namespace i2pcpp;
+
+static RouterHash makeHash(unsigned char c)
+{
+    RouterHash rh;
+    rh.fill(c);
+    return rh;
+}
+
+/**
+ * @return the body of \a dl, without the 5B short header
+ */
+static ByteArray body(I2NP::DatabaseLookup const &dl)
+{
+    ByteArray b = dl.toBytes(false);
+    b.erase(b.begin(), b.begin() + 5);
+    return b;
+}
+
+static I2NP::DatabaseLookup parse(ByteArray const &b)
+{
+    auto begin = b.cbegin();
+    I2NP::DatabaseLookup dl = I2NP::DatabaseLookup::parse(begin, b.cend());
+    BOOST_CHECK(begin == b.cend());
+    return dl;
+}
+
+BOOST_AUTO_TEST_SUITE(DatabaseLookupTests)
+
+BOOST_AUTO_TEST_CASE(RoundTripDirect)
+{
+    const std::list<RouterHash> excluded = {makeHash(3), makeHash(4)};
+    I2NP::DatabaseLookup dl(makeHash(1), makeHash(2), 0, excluded);
+
+    ByteArray b = body(dl);
+    BOOST_CHECK_EQUAL(b.size(), 32 + 32 + 1 + 2 + 2 * 32);
+    BOOST_CHECK_EQUAL(b[64], 0x00);
+
+    I2NP::DatabaseLookup p = parse(b);
+    BOOST_CHECK(p.getKey() == makeHash(1));
+    BOOST_CHECK(p.getFrom() == makeHash(2));
+    BOOST_CHECK_EQUAL(p.getSendReplyTo(), 0);
+    BOOST_CHECK(p.getExcludedPeers() == excluded);
+    BOOST_CHECK(!p.isReplyEncrypted());
+}
+
+BOOST_AUTO_TEST_CASE(RoundTripTunnel)
+{
+    const std::list<RouterHash> excluded = {makeHash(3)};
+    I2NP::DatabaseLookup dl(makeHash(1), makeHash(2), 0x01020304, excluded);
+
+    ByteArray b = body(dl);
+    BOOST_CHECK_EQUAL(b.size(), 32 + 32 + 1 + 4 + 2 + 32);
+    BOOST_CHECK_EQUAL(b[64], 0x01);
+
+    I2NP::DatabaseLookup p = parse(b);
+    BOOST_CHECK(p.getKey() == makeHash(1));
+    BOOST_CHECK(p.getFrom() == makeHash(2));
+    BOOST_CHECK_EQUAL(p.getSendReplyTo(), 0x01020304);
+    BOOST_CHECK(p.getExcludedPeers() == excluded);
+
+    auto m = I2NP::Message::fromBytes(1, dl.toBytes(false), false);
+    BOOST_CHECK(m->getType() == I2NP::Message::Type::DB_LOOKUP);
+    BOOST_CHECK_EQUAL(std::static_pointer_cast<I2NP::DatabaseLookup>(m)->getSendReplyTo(), 0x01020304);
+}
+
+BOOST_AUTO_TEST_CASE(Truncated)
+{
+    for(uint32_t tunnelId: {0, 42}) {
+        I2NP::DatabaseLookup dl(makeHash(1), makeHash(2), tunnelId, {makeHash(3), makeHash(4)});
+        const ByteArray b = body(dl);
+
+        // Every prefix, so every field boundary and every cut within a field
+        for(std::size_t n = 0; n < b.size(); ++n) {
+            const ByteArray t(b.cbegin(), b.cbegin() + n);
+            auto begin = t.cbegin();
+            BOOST_CHECK_THROW(I2NP::DatabaseLookup::parse(begin, t.cend()), std::runtime_error);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ExclusionCountTooLarge)
+{
+    I2NP::DatabaseLookup dl(makeHash(1), makeHash(2), 0, {makeHash(3), makeHash(4)});
+
+    for(uint16_t count: {3, 0xffff}) {
+        ByteArray b = body(dl);
+        b[65] = count >> 8;
+        b[66] = count;
+
+        auto begin = b.cbegin();
+        BOOST_CHECK_THROW(I2NP::DatabaseLookup::parse(begin, b.cend()), std::runtime_error);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(EncryptedReply)
+{
+    I2NP::DatabaseLookup dl(makeHash(1), makeHash(2), 0, {makeHash(3)});
+
+    // Session key and two session tags after the excluded peers
+    ByteArray b = body(dl);
+    b[64] |= 0x02;
+    b.insert(b.end(), 32, 0x05);
+    b.insert(b.end(), 2);
+    b.insert(b.end(), 2 * 32, 0x06);
+
+    I2NP::DatabaseLookup p = parse(b);
+    BOOST_CHECK(p.isReplyEncrypted());
+    BOOST_CHECK(p.getExcludedPeers() == std::list<RouterHash>{makeHash(3)});
+
+    for(std::size_t n = body(dl).size(); n < b.size(); ++n) {
+        const ByteArray t(b.cbegin(), b.cbegin() + n);
+        auto begin = t.cbegin();
+        BOOST_CHECK_THROW(I2NP::DatabaseLookup::parse(begin, t.cend()), std::runtime_error);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,652 @@
+#include <lib/i2p/RouterContext.h>
+#include <lib/i2p/i2np/DatabaseLookup.h>
+#include <lib/i2p/tunnel/BandwidthLimiter.h>
+#include <lib/i2p/tunnel/BuildReplyProcessor.h>
+#include <lib/i2p/tunnel/ElGamalPool.h>
+#include <lib/i2p/tunnel/FirstFragment.h>
+#include <lib/i2p/tunnel/FollowOnFragment.h>
+#include <lib/i2p/tunnel/FragmentHandler.h>
+#include <lib/i2p/tunnel/IdAllocator.h>
+#include <lib/i2p/tunnel/ReplayFilter.h>
+#include <i2pcpp/Transport.h>
+#include <i2pcpp/util/make_unique.h>
+#include <chrono>
+#include <map>
+#include <set>
+#include <thread>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <botan/dl_group.h>
+#include <botan/numthry.h>
+
+using namespace i2pcpp;
+
+BOOST_AUTO_TEST_SUITE(IdAllocatorTests)
+
+BOOST_AUTO_TEST_CASE(AllocateUnique)
+{
+    Tunnel::IdAllocator ids;
+    std::set<uint32_t> allocated, slots;
+
+    for(int i = 0; i < 1000; ++i) {
+        uint32_t id = ids.allocate();
+        BOOST_CHECK(id);
+        BOOST_CHECK(allocated.insert(id).second);
+        BOOST_CHECK(slots.insert(ids.getSlot(id)).second);
+    }
+
+    BOOST_CHECK_EQUAL(ids.size(), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(ReserveInUse)
+{
+    Tunnel::IdAllocator ids;
+
+    BOOST_CHECK(ids.reserve(42));
+    BOOST_CHECK(!ids.reserve(42));
+    BOOST_CHECK(!ids.reserve(0));
+    BOOST_CHECK_EQUAL(ids.size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(ReleaseKeepsCluster)
+{
+    Tunnel::IdAllocator ids;
+    std::map<uint32_t, uint32_t> slots;
+
+    // At up to half load, consecutive IDs form clusters in the table
+    for(uint32_t id = 1; id <= 2000; ++id) {
+        BOOST_REQUIRE(ids.reserve(id));
+        slots[id] = ids.getSlot(id);
+    }
+
+    for(uint32_t id = 1; id <= 2000; id += 2)
+        ids.release(id);
+
+    BOOST_CHECK_EQUAL(ids.size(), 1000);
+
+    for(uint32_t id = 1; id <= 2000; ++id) {
+        if(id % 2)
+            BOOST_CHECK_EQUAL(ids.getSlot(id), Tunnel::IdAllocator::NO_SLOT);
+        else
+            BOOST_CHECK_EQUAL(ids.getSlot(id), slots[id]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ReleaseReusesSlot)
+{
+    Tunnel::IdAllocator ids;
+
+    BOOST_REQUIRE(ids.reserve(1));
+    BOOST_REQUIRE(ids.reserve(2));
+    uint32_t slot = ids.getSlot(1);
+
+    ids.release(1);
+    ids.release(1);
+    BOOST_CHECK_EQUAL(ids.size(), 1);
+
+    BOOST_REQUIRE(ids.reserve(3));
+    BOOST_CHECK_EQUAL(ids.getSlot(3), slot);
+    BOOST_CHECK(ids.reserve(1));
+    BOOST_CHECK(ids.getSlot(1) != ids.getSlot(2));
+    BOOST_CHECK(ids.getSlot(1) != ids.getSlot(3));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(ElGamalPoolTests)
+
+static bool isValid(Tunnel::ElGamalPool::Pair const &p)
+{
+    static const Botan::DL_Group group("modp/ietf/2048");
+    return Botan::power_mod(group.get_g(), p.k, group.get_p()) == p.gk;
+}
+
+BOOST_AUTO_TEST_CASE(PooledPairsMatch)
+{
+    Tunnel::ElGamalPool pool(4, 8);
+
+    for(int i = 0; i < 100 && pool.size() < 4; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_REQUIRE(pool.size());
+
+    for(int i = 0; i < 8; ++i)
+        BOOST_CHECK(isValid(pool.take()));
+}
+
+BOOST_AUTO_TEST_CASE(InlinePairsMatch)
+{
+    Tunnel::ElGamalPool pool(0, 0);
+
+    for(int i = 0; i < 4; ++i)
+        BOOST_CHECK(isValid(pool.take()));
+    BOOST_CHECK_EQUAL(pool.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentPairsMatch)
+{
+    // Takes outpace the generator, so pairs come from both paths at once
+    Tunnel::ElGamalPool pool(2, 4);
+    std::vector<std::vector<Tunnel::ElGamalPool::Pair>> taken(4);
+
+    std::vector<std::thread> threads;
+    for(auto& t: taken)
+        threads.emplace_back([&pool, &t]() {
+            for(int i = 0; i < 8; ++i)
+                t.push_back(pool.take());
+        });
+
+    for(auto& t: threads)
+        t.join();
+
+    for(auto& t: taken)
+        for(auto& p: t)
+            BOOST_CHECK(isValid(p));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+class RecordingTransport : public Transport {
+    public:
+        void connect(RouterInfo const &) {}
+
+        void send(RouterHash const &rh, uint32_t msgId, ByteArray const &msg)
+        {
+            sent.emplace_back(rh, I2NP::Message::fromBytes(msgId, msg, false));
+        }
+
+        void disconnect(RouterHash const &) {}
+        uint32_t numPeers() const { return 0; }
+        bool isConnected(RouterHash const &) const { return true; }
+
+        std::vector<std::pair<RouterHash, I2NP::MessagePtr>> sent;
+};
+
+/**
+ * A fragment handler on a temporary database, whose reassembled messages
+ * are forwarded to a router and captured.
+ */
+struct FragmentFixture {
+    FragmentFixture() :
+        file((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string())
+    {
+        Database::createDb(file);
+        db = std::make_shared<Database>(file);
+
+        ctx = std::make_unique<RouterContext>(db, ios);
+        transport = std::make_shared<RecordingTransport>();
+        ctx->getOutMsgDisp().registerTransport(transport);
+
+        handler = std::make_unique<Tunnel::FragmentHandler>(ios, *ctx);
+
+        for(unsigned char c = 0; c < 70; ++c) {
+            RouterHash rh;
+            rh.fill(c);
+            excluded.push_back(rh);
+        }
+
+        // Three fragments of 964, 996 and 363 bytes
+        const ByteArray data = I2NP::DatabaseLookup(to(), to(), 0, excluded).toBytes();
+        auto pos = data.cbegin();
+
+        auto first = std::make_unique<Tunnel::FirstFragment>();
+        first->setDeliveryMode(Tunnel::FirstFragment::DeliveryMode::ROUTER);
+        first->setToHash(to());
+        first->setFragmented(true);
+        first->setMsgId(msgId);
+        first->setPayload(pos, data.cend(), 1003);
+        fragments.push_back(std::move(first));
+
+        for(uint8_t n = 1; pos != data.cend(); ++n) {
+            auto fof = std::make_unique<Tunnel::FollowOnFragment>(msgId, n);
+            fof->setPayload(pos, data.cend(), 1003);
+            fof->setLast(pos == data.cend());
+            fragments.push_back(std::move(fof));
+        }
+
+        BOOST_REQUIRE_EQUAL(fragments.size(), 3);
+    }
+
+    ~FragmentFixture()
+    {
+        handler.reset();
+        ctx.reset();
+        db.reset();
+
+        for(auto suffix: {"", "-wal", "-shm"})
+            boost::filesystem::remove(file + suffix);
+    }
+
+    static RouterHash to()
+    {
+        RouterHash rh;
+        rh.fill(0xaa);
+        return rh;
+    }
+
+    /**
+     * Hands a copy of fragment \a n to the handler, in a tunnel message of
+     * its own.
+     */
+    void receive(std::size_t n)
+    {
+        const ByteArray b = fragments[n]->compile();
+        auto begin = b.cbegin();
+
+        std::list<Tunnel::FragmentPtr> l;
+        l.push_back(Tunnel::Fragment::parse(begin, b.cend()));
+        handler->receiveFragments(RouterHash(), std::move(l));
+    }
+
+    /**
+     * Checks that the message was forwarded exactly once, intact.
+     */
+    void checkDelivered()
+    {
+        BOOST_CHECK_EQUAL(handler->getCompleted(), 1);
+        BOOST_REQUIRE_EQUAL(transport->sent.size(), 1);
+        BOOST_CHECK(transport->sent[0].first == to());
+        BOOST_REQUIRE(transport->sent[0].second->getType() == I2NP::Message::Type::DB_LOOKUP);
+        BOOST_CHECK(std::static_pointer_cast<I2NP::DatabaseLookup>(transport->sent[0].second)->getExcludedPeers() == excluded);
+    }
+
+    static constexpr uint32_t msgId = 0x01020304;
+
+    std::string file;
+    std::shared_ptr<Database> db;
+    boost::asio::io_service ios;
+    std::unique_ptr<RouterContext> ctx;
+    std::shared_ptr<RecordingTransport> transport;
+    std::unique_ptr<Tunnel::FragmentHandler> handler;
+
+    std::list<RouterHash> excluded;
+    std::vector<Tunnel::FragmentPtr> fragments;
+};
+
+constexpr uint32_t FragmentFixture::msgId;
+
+BOOST_FIXTURE_TEST_SUITE(FragmentHandlerTests, FragmentFixture)
+
+BOOST_AUTO_TEST_CASE(InOrder)
+{
+    for(std::size_t n = 0; n < 3; ++n)
+        receive(n);
+
+    checkDelivered();
+}
+
+BOOST_AUTO_TEST_CASE(OutOfOrder)
+{
+    // The follow-on fragments wait for the first one, last one first
+    receive(2);
+    receive(1);
+    BOOST_CHECK(transport->sent.empty());
+
+    receive(0);
+    checkDelivered();
+}
+
+BOOST_AUTO_TEST_CASE(LastBeforeMiddle)
+{
+    receive(0);
+    receive(2);
+    BOOST_CHECK(transport->sent.empty());
+
+    receive(1);
+    checkDelivered();
+}
+
+BOOST_AUTO_TEST_CASE(Duplicate)
+{
+    // A duplicate of a buffered fragment and of a contiguous one
+    receive(2);
+    receive(2);
+    receive(0);
+    receive(0);
+    BOOST_CHECK(transport->sent.empty());
+
+    receive(1);
+    checkDelivered();
+}
+
+BOOST_AUTO_TEST_CASE(Expired)
+{
+    receive(0);
+    receive(2);
+
+    handler->expire(std::chrono::steady_clock::now() - std::chrono::minutes(2));
+    BOOST_CHECK_EQUAL(handler->getExpired(), 0);
+
+    handler->expire(std::chrono::steady_clock::now() + std::chrono::seconds(1));
+    BOOST_CHECK_EQUAL(handler->getExpired(), 1);
+
+    // The rest of the message starts a new partial message
+    receive(1);
+    BOOST_CHECK(transport->sent.empty());
+    BOOST_CHECK_EQUAL(handler->getCompleted(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/**
+ * @return the IV and first encrypted block of tunnel message \a n
+ */
+static ByteArray tunnelMessage(uint32_t n)
+{
+    ByteArray b(32, 0x5a);
+    b[3] = n >> 24;
+    b[4] = n >> 16;
+    b[5] = n >> 8;
+    b[6] = n;
+    return b;
+}
+
+BOOST_AUTO_TEST_SUITE(ReplayFilterTests)
+
+BOOST_AUTO_TEST_CASE(Duplicate)
+{
+    boost::asio::io_service ios;
+    Tunnel::ReplayFilter rf(ios, std::chrono::seconds(600), 1000, 1e-9);
+
+    for(uint32_t n = 0; n < 1000; ++n)
+        BOOST_CHECK(!rf.isReplay(tunnelMessage(n).data()));
+
+    for(uint32_t n = 0; n < 1000; ++n)
+        BOOST_CHECK(rf.isReplay(tunnelMessage(n).data()));
+
+    BOOST_CHECK_EQUAL(rf.getChecked(), 2000);
+    BOOST_CHECK_EQUAL(rf.getDuplicates(), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(SameKey)
+{
+    boost::asio::io_service ios;
+    Tunnel::ReplayFilter rf(ios, std::chrono::seconds(600), 1000, 1e-9);
+
+    // A different IV and first block with the same XOR is the same message
+    ByteArray b = tunnelMessage(1);
+    BOOST_CHECK(!rf.isReplay(b.data()));
+
+    b[0] ^= 0xff;
+    b[16] ^= 0xff;
+    BOOST_CHECK(rf.isReplay(b.data()));
+}
+
+BOOST_AUTO_TEST_CASE(AgesOut)
+{
+    boost::asio::io_service ios;
+    Tunnel::ReplayFilter rf(ios, std::chrono::seconds(600), 1000, 1e-9);
+
+    BOOST_CHECK(!rf.isReplay(tunnelMessage(1).data()));
+    BOOST_CHECK(!rf.isReplay(tunnelMessage(2).data()));
+
+    // Still remembered in the previous generation
+    rf.rotate();
+    BOOST_CHECK(rf.isReplay(tunnelMessage(1).data()));
+    BOOST_CHECK(!rf.isReplay(tunnelMessage(3).data()));
+
+    /* Message 2 was not seen again, so it's gone with its generation.
+     * Seeing message 1 again put it back in to the current one.
+     */
+    rf.rotate();
+    BOOST_CHECK(!rf.isReplay(tunnelMessage(2).data()));
+    BOOST_CHECK(rf.isReplay(tunnelMessage(1).data()));
+    BOOST_CHECK(rf.isReplay(tunnelMessage(3).data()));
+
+    rf.rotate();
+    rf.rotate();
+    for(uint32_t n = 1; n <= 3; ++n)
+        BOOST_CHECK(!rf.isReplay(tunnelMessage(n).data()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(BandwidthLimiterTests)
+
+BOOST_AUTO_TEST_CASE(PerTunnelCap)
+{
+    Tunnel::BandwidthLimiter bl(10000, 1000000);
+    bl.add(0, 100);
+    bl.add(1, 101);
+
+    // A full bucket holds one second worth of traffic
+    BOOST_CHECK(bl.consume(0, 6000));
+    BOOST_CHECK(bl.consume(0, 3000));
+    BOOST_CHECK(!bl.consume(0, 3000));
+
+    // The other tunnel has a bucket of its own
+    BOOST_CHECK(bl.consume(1, 9000));
+
+    BOOST_CHECK(!bl.consume(2, 1));
+    bl.remove(1);
+    BOOST_CHECK(!bl.consume(1, 1));
+
+    // Only messages over a limit count as dropped
+    BOOST_CHECK_EQUAL(bl.getDropped(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(AggregateCap)
+{
+    Tunnel::BandwidthLimiter bl(10000, 15000);
+    bl.add(0, 100);
+    bl.add(1, 101);
+
+    BOOST_CHECK(bl.consume(0, 9000));
+    BOOST_CHECK(!bl.consume(1, 9000));
+    BOOST_CHECK(bl.consume(1, 5000));
+
+    auto heaviest = bl.getHeaviest(2);
+    BOOST_REQUIRE_EQUAL(heaviest.size(), 2);
+    BOOST_CHECK_EQUAL(heaviest[0].tunnelId, 100);
+    BOOST_CHECK_EQUAL(heaviest[1].tunnelId, 101);
+    BOOST_CHECK_EQUAL(heaviest[1].bytes, 5000);
+    BOOST_CHECK_EQUAL(heaviest[1].dropped, 1);
+}
+
+BOOST_AUTO_TEST_CASE(Refill)
+{
+    Tunnel::BandwidthLimiter bl(10000, 1000000);
+    bl.add(0, 100);
+
+    BOOST_CHECK(bl.consume(0, 10000));
+    BOOST_CHECK(!bl.consume(0, 1000));
+
+    // At least 2000 bytes are earned back, but not the whole bucket
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    BOOST_CHECK(bl.consume(0, 2000));
+    BOOST_CHECK(!bl.consume(0, 8000));
+}
+
+BOOST_AUTO_TEST_CASE(RefillCapped)
+{
+    Tunnel::BandwidthLimiter bl(10000, 1000000, 0.1);
+    bl.add(0, 100);
+
+    BOOST_CHECK(bl.consume(0, 1000));
+
+    // Long enough to earn 3000 bytes, but the bucket only holds 1000
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    BOOST_CHECK(bl.consume(0, 1000));
+    BOOST_CHECK(!bl.consume(0, 500));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/**
+ * A tunnel whose hops have known reply keys, and which can answer its own
+ * build request.
+ */
+class ReplyingTunnel : public Tunnel::Tunnel {
+    public:
+        ReplyingTunnel(std::size_t n)
+        {
+            m_tunnelId = 42;
+
+            for(std::size_t i = 0; i < n; ++i) {
+                auto r = std::make_shared<BuildRequestRecord>();
+
+                RouterHash rh;
+                rh.fill(i + 1);
+                r->setLocalHash(rh);
+
+                SessionKey key;
+                key.fill(i + 0x10);
+                r->setReplyKey(key);
+
+                StaticByteArray<16> iv;
+                iv.fill(i + 0x20);
+                r->setReplyIV(iv);
+
+                m_hops.push_back(r);
+            }
+        }
+
+        Direction getDirection() const
+        {
+            return Direction::OUTBOUND;
+        }
+
+        /**
+         * @return the reply records after every hop has put \a replies[i]
+         * in its own record and encrypted all the records with its reply
+         * key, followed by \a extra records for no hop
+         */
+        std::list<BuildRecordPtr> reply(std::vector<BuildResponseRecord::Reply> const &replies, std::size_t extra = 0) const
+        {
+            std::vector<BuildRecordPtr> records(m_hops.size() + extra);
+            for(auto& r: records)
+                r = std::make_shared<BuildRecord>();
+
+            std::size_t i = 0;
+            for(auto& h: m_hops) {
+                auto resp = std::make_shared<BuildResponseRecord>(replies[i]);
+                resp->compile();
+                records[i++] = resp;
+
+                auto hop = std::static_pointer_cast<BuildRequestRecord>(h);
+                for(auto& r: records)
+                    r->encrypt(hop->getReplyIV(), hop->getReplyKey());
+            }
+
+            return std::list<BuildRecordPtr>(records.cbegin(), records.cend());
+        }
+};
+
+/**
+ * Runs the records of a reply through a processor, and keeps what it
+ * reported.
+ */
+struct BuildReplyFixture {
+    void process(Tunnel::TunnelPtr const &t, std::list<BuildRecordPtr> records)
+    {
+        boost::asio::io_service ios;
+        bool done = false;
+
+        Tunnel::BuildReplyProcessor brp(ios, [&](Tunnel::TunnelPtr r, bool s, std::vector<Tunnel::BuildReplyProcessor::HopReply> h) {
+            BOOST_CHECK(r == t);
+            success = s;
+            replies = h;
+            done = true;
+            ios.stop();
+        });
+
+        brp.submit(t, std::move(records));
+
+        boost::asio::io_service::work work(ios);
+        boost::asio::deadline_timer timeout(ios, boost::posix_time::seconds(10));
+        timeout.async_wait([&](boost::system::error_code const &) { ios.stop(); });
+        ios.run();
+
+        BOOST_REQUIRE(done);
+    }
+
+    /**
+     * Checks that hop \a hop is the \a n th one reported, with \a reply.
+     */
+    void checkReply(std::size_t n, unsigned char hop, BuildResponseRecord::Reply reply)
+    {
+        RouterHash rh;
+        rh.fill(hop + 1);
+
+        BOOST_REQUIRE_GT(replies.size(), n);
+        BOOST_CHECK(replies[n].hop == rh);
+        BOOST_CHECK(replies[n].reply == reply);
+    }
+
+    bool success = false;
+    std::vector<Tunnel::BuildReplyProcessor::HopReply> replies;
+};
+
+BOOST_FIXTURE_TEST_SUITE(BuildReplyProcessorTests, BuildReplyFixture)
+
+typedef BuildResponseRecord::Reply Reply;
+
+BOOST_AUTO_TEST_CASE(AllAccept)
+{
+    auto t = std::make_shared<ReplyingTunnel>(4);
+
+    // Records beyond those of the hops are ignored
+    process(t, t->reply({Reply::SUCCESS, Reply::SUCCESS, Reply::SUCCESS, Reply::SUCCESS}, 2));
+
+    BOOST_CHECK(success);
+    BOOST_REQUIRE_EQUAL(replies.size(), 4);
+    for(std::size_t n = 0; n < 4; ++n)
+        checkReply(n, 3 - n, Reply::SUCCESS);
+}
+
+BOOST_AUTO_TEST_CASE(HopRejects)
+{
+    auto t = std::make_shared<ReplyingTunnel>(4);
+    process(t, t->reply({Reply::SUCCESS, Reply::BANDWIDTH, Reply::SUCCESS, Reply::SUCCESS}));
+
+    // Hop 0 comes after the rejection, so it is not reported
+    BOOST_CHECK(!success);
+    BOOST_REQUIRE_EQUAL(replies.size(), 3);
+    checkReply(0, 3, Reply::SUCCESS);
+    checkReply(1, 2, Reply::SUCCESS);
+    checkReply(2, 1, Reply::BANDWIDTH);
+}
+
+BOOST_AUTO_TEST_CASE(LastHopRejects)
+{
+    auto t = std::make_shared<ReplyingTunnel>(3);
+    process(t, t->reply({Reply::SUCCESS, Reply::SUCCESS, Reply::TRANSIENT_OVERLOAD}));
+
+    BOOST_CHECK(!success);
+    BOOST_REQUIRE_EQUAL(replies.size(), 1);
+    checkReply(0, 2, Reply::TRANSIENT_OVERLOAD);
+}
+
+BOOST_AUTO_TEST_CASE(CorruptRecord)
+{
+    auto t = std::make_shared<ReplyingTunnel>(4);
+    std::list<BuildRecordPtr> records = t->reply({Reply::SUCCESS, Reply::SUCCESS, Reply::SUCCESS, Reply::SUCCESS});
+
+    // The hash of hop 1's response no longer matches
+    auto r = std::next(records.begin());
+    ByteArray b = (*r)->serialize();
+    b[100] ^= 0x01;
+    auto begin = b.cbegin();
+    *r = std::make_shared<BuildRecord>(begin, b.cend());
+
+    process(t, records);
+
+    BOOST_CHECK(!success);
+    BOOST_REQUIRE_EQUAL(replies.size(), 3);
+    checkReply(1, 2, Reply::SUCCESS);
+    checkReply(2, 1, Reply::CRITICAL);
+}
+
+BOOST_AUTO_TEST_CASE(TooFewRecords)
+{
+    auto t = std::make_shared<ReplyingTunnel>(3);
+    std::list<BuildRecordPtr> records = t->reply({Reply::SUCCESS, Reply::SUCCESS, Reply::SUCCESS});
+    records.pop_back();
+
+    process(t, records);
+
+    BOOST_CHECK(!success);
+    BOOST_CHECK(replies.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()